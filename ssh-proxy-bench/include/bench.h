@@ -0,0 +1,92 @@
+#pragma once
+#include "common.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How the relay is driven.
+//   InProcess  BenchChannel (in-memory IChannel) → Socks5Session →
+//              TcpConnection/IoEngine → loopback echo server.  No SSH.
+//   Ssh        Full path through ssh_proxy::Connect and a (loopback) sshd:
+//              the bench is the SOCKS5 client on the sshd side.
+enum class BenchMode { InProcess, Ssh };
+
+struct BenchOptions {
+    BenchMode    mode              = BenchMode::InProcess;
+    uint32_t     sessions          = 8;
+    uint64_t     bytes_per_session = 16ull * 1024 * 1024;
+    uint32_t     chunk_bytes       = 16 * 1024;
+    uint32_t     timeout_s         = 120;
+    std::string  json_path;        // empty = stdout
+
+    // Ssh mode only
+    std::string  ssh_host;
+    uint16_t     ssh_port          = 22;
+    std::string  username;
+    std::string  password;
+    uint16_t     forward_port      = 1080;
+};
+
+// Parses argv into opts.  Returns false (after printing usage) on bad input
+// or --help; `help` tells the two apart.
+bool ParseBenchArgs(int argc, char* argv[], BenchOptions& opts, bool& help);
+
+// Per-session measurements.  Times are steady_clock seconds relative to the
+// start of the run; a negative value means the event never happened.
+struct SessionSample {
+    double   t_request    = -1;   // CONNECT request handed to the proxy
+    double   t_first_byte = -1;   // first echoed payload byte back at the client
+    double   t_done       = -1;   // last echoed payload byte back at the client
+    uint64_t bytes        = 0;    // payload bytes echoed back
+    bool     ok           = false;
+};
+
+struct BenchResult {
+    std::vector<SessionSample> samples;
+    double                     wall_s      = 0;
+    uint64_t                   allocations = 0;   // global operator new calls during the run
+};
+
+// Loopback TCP echo server: one blocking thread per accepted connection.
+class EchoServer {
+public:
+    EchoServer() = default;
+    ~EchoServer() { Stop(); }
+
+    EchoServer(const EchoServer&) = delete;
+    EchoServer& operator=(const EchoServer&) = delete;
+
+    // Listens on 127.0.0.1 with an ephemeral port.
+    ErrorCode Start();
+    void      Stop();
+    uint16_t  port() const { return m_port; }
+
+private:
+    void AcceptLoop();
+
+    SOCKET                   m_listen = INVALID_SOCKET;
+    uint16_t                 m_port   = 0;
+    std::atomic<bool>        m_stop{false};
+    std::thread              m_acceptor;
+    std::mutex               m_mutex;
+    std::vector<std::thread> m_workers;
+};
+
+BenchResult RunInProcess(const BenchOptions& opts, uint16_t echo_port);
+BenchResult RunOverSsh(const BenchOptions& opts, uint16_t echo_port);
+
+// Writes the result as one JSON object.
+std::string FormatJson(const BenchOptions& opts, const BenchResult& result);
+
+// Number of global operator new calls so far (counted in main.cpp).
+uint64_t AllocationCount();
+
+// Seconds since the first call — shared time base for SessionSample.
+double BenchClock();
+
+// A 64 KB block of payload bytes, the source of every chunk sent.
+const uint8_t* PayloadPattern();
+constexpr size_t kPayloadPatternSize = 64 * 1024;
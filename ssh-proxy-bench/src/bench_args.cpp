@@ -0,0 +1,117 @@
+#include "bench.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void PrintUsage(const char* exe) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "\n"
+        "Relays payload through Socks5Session to a local echo server and\n"
+        "reports throughput, connect-to-first-byte latency and allocations as JSON.\n"
+        "\n"
+        "Options:\n"
+        "  --sessions N            Parallel sessions (default: 8)\n"
+        "  --bytes N               Payload bytes per session (default: 16777216)\n"
+        "  --chunk N               Client write size in bytes, <= 65536 (default: 16384)\n"
+        "  --timeout-s N           Give up after N seconds (default: 120)\n"
+        "  --json PATH             Write the JSON result to PATH (default: stdout)\n"
+        "\n"
+        "End-to-end over SSH (all four required to enable):\n"
+        "  --server HOST           Loopback sshd to tunnel through\n"
+        "  --username / -u USER    SSH username\n"
+        "  --password / -p PASS    SSH password\n"
+        "  --forward-port / -f N   Remote forward port on the sshd host (default: 1080)\n"
+        "  --port PORT             SSH port (default: 22)\n"
+        "  --help                  Show this help\n",
+        exe);
+}
+
+static bool ParseU64(const char* val, uint64_t& out) {
+    char* end = nullptr;
+    unsigned long long v = strtoull(val, &end, 10);
+    if (end == val || *end != '\0' || v == 0) return false;
+    out = v;
+    return true;
+}
+
+bool ParseBenchArgs(int argc, char* argv[], BenchOptions& opts, bool& help) {
+    opts = BenchOptions{};
+    help = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            PrintUsage(argv[0]);
+            help = true;
+            return false;
+        }
+
+        // All remaining flags require a value argument
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Error: %s requires a value\n", arg);
+            return false;
+        }
+        const char* val = argv[++i];
+        uint64_t n = 0;
+
+        if (strcmp(arg, "--sessions") == 0) {
+            if (!ParseU64(val, n) || n > 4096) {
+                fprintf(stderr, "Error: invalid sessions '%s'\n", val);
+                return false;
+            }
+            opts.sessions = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--bytes") == 0) {
+            if (!ParseU64(val, n)) {
+                fprintf(stderr, "Error: invalid bytes '%s'\n", val);
+                return false;
+            }
+            opts.bytes_per_session = n;
+        } else if (strcmp(arg, "--chunk") == 0) {
+            if (!ParseU64(val, n) || n > kPayloadPatternSize) {
+                fprintf(stderr, "Error: invalid chunk '%s'\n", val);
+                return false;
+            }
+            opts.chunk_bytes = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--timeout-s") == 0) {
+            if (!ParseU64(val, n)) {
+                fprintf(stderr, "Error: invalid timeout '%s'\n", val);
+                return false;
+            }
+            opts.timeout_s = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--json") == 0) {
+            opts.json_path = val;
+        } else if (strcmp(arg, "--server") == 0) {
+            opts.ssh_host = val;
+        } else if (strcmp(arg, "--port") == 0) {
+            if (!ParseU64(val, n) || n > 65535) {
+                fprintf(stderr, "Error: invalid port '%s'\n", val);
+                return false;
+            }
+            opts.ssh_port = static_cast<uint16_t>(n);
+        } else if (strcmp(arg, "--username") == 0 || strcmp(arg, "-u") == 0) {
+            opts.username = val;
+        } else if (strcmp(arg, "--password") == 0 || strcmp(arg, "-p") == 0) {
+            opts.password = val;
+        } else if (strcmp(arg, "--forward-port") == 0 || strcmp(arg, "-f") == 0) {
+            if (!ParseU64(val, n) || n > 65535) {
+                fprintf(stderr, "Error: invalid forward-port '%s'\n", val);
+                return false;
+            }
+            opts.forward_port = static_cast<uint16_t>(n);
+        } else {
+            fprintf(stderr, "Error: unknown option '%s'\n", arg);
+            return false;
+        }
+    }
+
+    if (!opts.ssh_host.empty()) {
+        if (opts.username.empty() || opts.password.empty()) {
+            fprintf(stderr, "Error: --server needs --username and --password\n");
+            return false;
+        }
+        opts.mode = BenchMode::Ssh;
+    }
+    return true;
+}
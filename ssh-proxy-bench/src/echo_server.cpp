@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "logger.h"
+
+//
+// ── EchoServer ────────────────────────────────────────────────────────────────
+//
+// Deliberately simple blocking sockets: the server is the fixed reference
+// point of the benchmark, so it should cost the same in every build.  Each
+// connection echoes until the peer (TcpConnection) closes.
+//
+
+ErrorCode EchoServer::Start()
+{
+    m_listen = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (m_listen == INVALID_SOCKET) return ErrorCode::SocketError;
+
+    struct sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    addr.sin_port        = 0;
+    int len = static_cast<int>(sizeof(addr));
+    if (::bind(m_listen, reinterpret_cast<struct sockaddr*>(&addr), len) != 0 ||
+        ::listen(m_listen, SOMAXCONN) != 0 ||
+        ::getsockname(m_listen, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0)
+    {
+        Logger::Error("Echo server setup failed: %d", ::WSAGetLastError());
+        ::closesocket(m_listen);
+        m_listen = INVALID_SOCKET;
+        return ErrorCode::SocketError;
+    }
+    m_port = ::ntohs(addr.sin_port);
+
+    m_acceptor = std::thread([this]() { AcceptLoop(); });
+    return ErrorCode::Success;
+}
+
+void EchoServer::AcceptLoop()
+{
+    while (!m_stop.load())
+    {
+        SOCKET s = ::accept(m_listen, nullptr, nullptr);
+        if (s == INVALID_SOCKET) break;   // Stop() closed the listener
+
+        BOOL nodelay = TRUE;
+        ::setsockopt(s, IPPROTO_TCP, TCP_NODELAY,
+                     reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_workers.emplace_back([s]()
+        {
+            char buf[64 * 1024];
+            for (;;)
+            {
+                int n = ::recv(s, buf, static_cast<int>(sizeof(buf)), 0);
+                if (n <= 0) break;
+                for (int off = 0; off < n; )
+                {
+                    int w = ::send(s, buf + off, n - off, 0);
+                    if (w <= 0) { n = -1; break; }
+                    off += w;
+                }
+                if (n < 0) break;
+            }
+            ::closesocket(s);
+        });
+    }
+}
+
+void EchoServer::Stop()
+{
+    m_stop.store(true);
+    if (m_listen != INVALID_SOCKET)
+    {
+        ::closesocket(m_listen);
+        m_listen = INVALID_SOCKET;
+    }
+    if (m_acceptor.joinable()) m_acceptor.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& t : m_workers)
+        if (t.joinable()) t.join();
+    m_workers.clear();
+}
@@ -0,0 +1,112 @@
+#include "bench.h"
+#include "async_io.h"
+#include "logger.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// ── Allocation counting ───────────────────────────────────────────────────────
+// Replacing the global operator new counts every C++ heap allocation in the
+// process; the array and aligned forms forward to these.
+
+static std::atomic<uint64_t> g_allocations{0};
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept                          { std::free(p); }
+void operator delete(void* p, size_t) noexcept                  { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept   { std::free(p); }
+
+uint64_t AllocationCount()
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+double BenchClock()
+{
+    static const auto t0 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+const uint8_t* PayloadPattern()
+{
+    static const std::vector<uint8_t> pattern = []()
+    {
+        std::vector<uint8_t> p(kPayloadPatternSize);
+        for (size_t i = 0; i < p.size(); ++i) p[i] = static_cast<uint8_t>(i * 31 + 7);
+        return p;
+    }();
+    return pattern.data();
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions opts;
+    bool help = false;
+    if (!ParseBenchArgs(argc, argv, opts, help))
+        return help ? 0 : 1;
+
+    Logger::SetMinLevel(ssh_proxy::LogLevel::Warn);
+    Logger::SetCallback([](const LogEntry& e) {
+        fprintf(stderr, "%s %s\n", e.timestamp.c_str(), e.message.c_str());
+    });
+
+    if (IoEngine::Init(0) != ErrorCode::Success)
+    {
+        fprintf(stderr, "Fatal: IoEngine init failed\n");
+        return 1;
+    }
+    BenchClock();
+    PayloadPattern();
+
+    EchoServer echo;
+    if (echo.Start() != ErrorCode::Success)
+    {
+        fprintf(stderr, "Fatal: echo server failed to start\n");
+        return 1;
+    }
+
+    BenchResult result;
+    try {
+        result = opts.mode == BenchMode::Ssh ? RunOverSsh(opts, echo.port())
+                                             : RunInProcess(opts, echo.port());
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Fatal: %s\n", e.what());
+        return 1;
+    }
+    echo.Stop();
+    Logger::Flush();
+
+    std::string json = FormatJson(opts, result);
+    if (opts.json_path.empty())
+    {
+        fputs(json.c_str(), stdout);
+    }
+    else
+    {
+        FILE* f = nullptr;
+        if (fopen_s(&f, opts.json_path.c_str(), "w") != 0 || f == nullptr)
+        {
+            fprintf(stderr, "Error: cannot write %s\n", opts.json_path.c_str());
+            return 1;
+        }
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+
+    size_t errors = 0;
+    for (const auto& s : result.samples) errors += s.ok ? 0 : 1;
+    return errors == 0 ? 0 : 2;
+}
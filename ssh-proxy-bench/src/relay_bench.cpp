@@ -0,0 +1,308 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Relay benchmark drivers
+//
+// IN-PROCESS
+//   Each session gets a BenchChannel — an IChannel that plays the SOCKS5
+//   client: it hands the proxy a method request + CONNECT to the echo
+//   server, then the payload, and counts what comes back through Write().
+//   A single driver thread stands in for the SSH I/O thread and pumps every
+//   session with PumpSshRead(), honouring SetReadInterest() the way the
+//   transport does.  Everything below IChannel — Socks5Session,
+//   TcpConnection, IoEngine, BufferPool — is the production code.
+//
+// OVER SSH
+//   ssh_proxy::Connect tunnels to a (loopback) sshd; the bench connects to
+//   the remote forward port as an ordinary SOCKS5 client, so the path also
+//   includes libssh2, the SSH transport's I/O thread and sshd itself.
+//
+// MEASUREMENTS
+//   Per session: CONNECT request → first echoed byte (connect-to-first-
+//   byte) and CONNECT request → last echoed byte (throughput).  Allocations
+//   are global operator new calls in this process for the whole run; in SSH
+//   mode libssh2's own malloc calls are not included.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "bench.h"
+#include "socks5_session.h"
+#include "logger.h"
+#include "../../ssh-proxy-lib/public/ssh_proxy.h"
+#include <cstring>
+#include <memory>
+
+namespace {
+
+// Method request {VER, NMETHODS, NO_AUTH} + CONNECT 127.0.0.1:port.
+std::vector<uint8_t> Handshake(uint16_t port)
+{
+    return {
+        0x05, 0x01, 0x00,
+        0x05, 0x01, 0x00, 0x01, 127, 0, 0, 1,
+        static_cast<uint8_t>(port >> 8), static_cast<uint8_t>(port & 0xFF),
+    };
+}
+
+// Method response (2) + CONNECT reply with an IPv4 BND address (10).
+constexpr uint64_t kReplyBytes = 12;
+
+// ── BenchChannel ──────────────────────────────────────────────────────────────
+
+class BenchChannel : public IChannel {
+public:
+    BenchChannel(uint16_t echo_port, uint64_t payload, size_t chunk)
+        : m_handshake(Handshake(echo_port)), m_payload(payload), m_chunk(chunk) {}
+
+    // Driver thread only.
+    ErrorCode Read(uint8_t* buf, size_t len, size_t& bytes_read) override
+    {
+        bytes_read = 0;
+        if (!m_handshake_sent)
+        {
+            if (len < m_handshake.size()) return ErrorCode::BufferTooSmall;
+            std::memcpy(buf, m_handshake.data(), m_handshake.size());
+            bytes_read = m_handshake.size();
+            m_handshake_sent = true;
+            ++m_reads;
+            sample.t_request = BenchClock();
+            return ErrorCode::Success;
+        }
+        if (m_sent < m_payload)
+        {
+            size_t n = static_cast<size_t>((std::min)(m_payload - m_sent,
+                                            static_cast<uint64_t>((std::min)(len, m_chunk))));
+            std::memcpy(buf, PayloadPattern(), n);
+            m_sent += n;
+            ++m_reads;
+            bytes_read = n;
+            return ErrorCode::Success;
+        }
+        // All sent: hold the channel open until the echo is complete, then EOF.
+        return m_done.load() ? ErrorCode::Success : ErrorCode::WouldBlock;
+    }
+
+    // Any thread: the method reply comes from the driver thread, the CONNECT
+    // reply and the echoed payload from IOCP workers.
+    ErrorCode Write(const uint8_t* buf, size_t len) override
+    {
+        uint64_t prev = m_written.fetch_add(len);
+        uint64_t now  = prev + len;
+        if (prev == 2 && len >= 2 && buf[1] != 0)
+            m_failed.store(true);   // CONNECT reply with REP != success
+        if (now > kReplyBytes && prev <= kReplyBytes)
+            sample.t_first_byte = BenchClock();
+        if (now >= kReplyBytes + m_payload && prev < kReplyBytes + m_payload)
+        {
+            sample.t_done = BenchClock();
+            m_done.store(true);
+        }
+        return ErrorCode::Success;
+    }
+
+    void SendEof() override {}
+    void Close()   override { m_closed.store(true); }
+    bool IsEof()   const override { return m_done.load(); }
+
+    void SetReadInterest(bool wanted) override { m_interest.store(wanted); }
+    bool     interest() const { return m_interest.load(); }
+    bool     closed()   const { return m_closed.load(); }
+    uint64_t reads()    const { return m_reads; }
+
+    // Final figures; call once the session has finished.
+    SessionSample Finish()
+    {
+        uint64_t echoed = m_written.load();
+        sample.bytes = echoed > kReplyBytes ? echoed - kReplyBytes : 0;
+        sample.ok    = m_done.load() && !m_failed.load();
+        return sample;
+    }
+
+    SessionSample sample;
+
+private:
+    std::vector<uint8_t>  m_handshake;
+    uint64_t              m_payload;
+    size_t                m_chunk;
+    bool                  m_handshake_sent = false;
+    uint64_t              m_sent = 0;
+    uint64_t              m_reads = 0;
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<bool>     m_done{false};
+    std::atomic<bool>     m_failed{false};
+    std::atomic<bool>     m_closed{false};
+    std::atomic<bool>     m_interest{true};
+};
+
+bool RecvAll(SOCKET s, uint8_t* buf, size_t len)
+{
+    while (len > 0)
+    {
+        int n = ::recv(s, reinterpret_cast<char*>(buf), static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        buf += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// One blocking SOCKS5 client session through the SSH tunnel.
+SessionSample RunSocksClient(const BenchOptions& opts, uint16_t echo_port)
+{
+    SessionSample sample;
+    SOCKET s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) return sample;
+
+    struct sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    addr.sin_port        = ::htons(opts.forward_port);
+
+    BOOL nodelay = TRUE;
+    ::setsockopt(s, IPPROTO_TCP, TCP_NODELAY,
+                 reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+
+    sample.t_request = BenchClock();
+    std::vector<uint8_t> hello = Handshake(echo_port);
+    uint8_t reply[kReplyBytes];
+    if (::connect(s, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::send(s, reinterpret_cast<const char*>(hello.data()),
+               static_cast<int>(hello.size()), 0) != static_cast<int>(hello.size()) ||
+        !RecvAll(s, reply, sizeof(reply)) || reply[1] != 0x00 || reply[3] != 0x00)
+    {
+        ::closesocket(s);
+        return sample;
+    }
+
+    // Receive on a second thread so the echo never backs up into our sends.
+    std::thread receiver([&]()
+    {
+        std::vector<uint8_t> buf(kPayloadPatternSize);
+        while (sample.bytes < opts.bytes_per_session)
+        {
+            int n = ::recv(s, reinterpret_cast<char*>(buf.data()),
+                           static_cast<int>(buf.size()), 0);
+            if (n <= 0) return;
+            if (sample.bytes == 0) sample.t_first_byte = BenchClock();
+            sample.bytes += static_cast<uint64_t>(n);
+        }
+        sample.t_done = BenchClock();
+        sample.ok     = true;
+    });
+
+    for (uint64_t sent = 0; sent < opts.bytes_per_session; )
+    {
+        int n = static_cast<int>((std::min)(static_cast<uint64_t>(opts.chunk_bytes),
+                                            opts.bytes_per_session - sent));
+        int w = ::send(s, reinterpret_cast<const char*>(PayloadPattern()), n, 0);
+        if (w <= 0) break;
+        sent += static_cast<uint64_t>(w);
+    }
+    ::shutdown(s, SD_SEND);
+    receiver.join();
+    ::closesocket(s);
+    return sample;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// RunInProcess
+//
+// Creates every session up front, then pumps them round-robin until each
+// has finished (PumpSshRead() returned false or the session closed its
+// channel) or the timeout expires.  A pass in which
+// no session moved any bytes yields the thread instead of spinning.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+BenchResult RunInProcess(const BenchOptions& opts, uint16_t echo_port)
+{
+    struct Live {
+        std::shared_ptr<Socks5Session> session;
+        BenchChannel*                  channel;
+        bool                           running;
+    };
+
+    BenchResult result;
+    std::vector<Live> live;
+    live.reserve(opts.sessions);
+
+    uint64_t allocs_before = AllocationCount();
+    double   t_start       = BenchClock();
+
+    for (uint32_t i = 0; i < opts.sessions; ++i)
+    {
+        auto ch = std::make_unique<BenchChannel>(echo_port, opts.bytes_per_session,
+                                                 opts.chunk_bytes);
+        BenchChannel* raw = ch.get();
+        auto session = std::make_shared<Socks5Session>(std::move(ch));
+        session->Start();
+        live.push_back(Live{ std::move(session), raw, true });
+    }
+
+    double deadline = t_start + opts.timeout_s;
+    size_t running  = live.size();
+    while (running > 0 && BenchClock() < deadline)
+    {
+        bool progress = false;
+        for (auto& l : live)
+        {
+            if (!l.running) continue;
+            // After its EOF a session waits, parked, for the echo server's
+            // FIN; it finishes by closing rather than by a pump.
+            if (l.channel->closed())
+            {
+                l.running = false;
+                --running;
+                continue;
+            }
+            if (!l.channel->interest()) continue;
+            uint64_t before = l.channel->reads();
+            if (!l.session->PumpSshRead())
+            {
+                l.running = false;
+                --running;
+            }
+            progress = progress || l.channel->reads() != before;
+        }
+        if (!progress) std::this_thread::yield();
+    }
+
+    result.wall_s = BenchClock() - t_start;
+    for (auto& l : live)
+        result.samples.push_back(l.channel->Finish());
+    result.allocations = AllocationCount() - allocs_before;
+
+    live.clear();   // closes any session that timed out
+    return result;
+}
+
+//
+// ── RunOverSsh ────────────────────────────────────────────────────────────────
+//
+// One blocking client thread per session against the remote forward port.
+// The tunnel is established before the clock starts.
+//
+
+BenchResult RunOverSsh(const BenchOptions& opts, uint16_t echo_port)
+{
+    BenchResult result;
+    ssh_proxy::Connect tunnel(opts.ssh_host, opts.username, opts.password,
+                              opts.ssh_port, opts.forward_port,
+                              10000, 30000, ssh_proxy::LogLevel::Warn);
+
+    result.samples.resize(opts.sessions);
+    uint64_t allocs_before = AllocationCount();
+    double   t_start       = BenchClock();
+
+    std::vector<std::thread> clients;
+    clients.reserve(opts.sessions);
+    for (uint32_t i = 0; i < opts.sessions; ++i)
+        clients.emplace_back([&, i]() { result.samples[i] = RunSocksClient(opts, echo_port); });
+    for (auto& t : clients) t.join();
+
+    result.wall_s      = BenchClock() - t_start;
+    result.allocations = AllocationCount() - allocs_before;
+    return result;
+}
@@ -0,0 +1,87 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+
+//
+// ── FormatJson ────────────────────────────────────────────────────────────────
+//
+// One flat-ish JSON object, stable key order, so results from two builds can
+// be diffed or fed to a script directly.  MB = 10^6 bytes.  Only successful
+// sessions contribute to the throughput and latency figures; `errors` counts
+// the rest.
+//
+
+namespace {
+
+constexpr double kMB = 1e6;
+
+// Nearest-rank percentile of an ascending-sorted vector.
+double Percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size()) + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > sorted.size()) rank = sorted.size();
+    return sorted[rank - 1];
+}
+
+void Append(std::string& out, const char* fmt, double v)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), fmt, v);
+    out += buf;
+}
+
+} // namespace
+
+std::string FormatJson(const BenchOptions& opts, const BenchResult& result)
+{
+    std::vector<double> mbps, ttfb_ms;
+    uint64_t total_bytes = 0;
+    uint32_t errors      = 0;
+    for (const auto& s : result.samples)
+    {
+        total_bytes += s.bytes;
+        if (!s.ok || s.t_done <= s.t_request)
+        {
+            ++errors;
+            continue;
+        }
+        mbps.push_back(static_cast<double>(s.bytes) / kMB / (s.t_done - s.t_request));
+        ttfb_ms.push_back((s.t_first_byte - s.t_request) * 1000.0);
+    }
+    std::sort(mbps.begin(), mbps.end());
+    std::sort(ttfb_ms.begin(), ttfb_ms.end());
+
+    double mean = 0;
+    for (double v : mbps) mean += v;
+    if (!mbps.empty()) mean /= static_cast<double>(mbps.size());
+
+    // Both directions cross the relay, so allocations are per MB relayed.
+    double relayed_mb = 2.0 * static_cast<double>(total_bytes) / kMB;
+
+    std::string out = "{\n";
+    out += std::string("  \"mode\": \"") +
+           (opts.mode == BenchMode::Ssh ? "ssh" : "inproc") + "\",\n";
+    out += "  \"sessions\": "          + std::to_string(opts.sessions) + ",\n";
+    out += "  \"bytes_per_session\": " + std::to_string(opts.bytes_per_session) + ",\n";
+    out += "  \"chunk_bytes\": "       + std::to_string(opts.chunk_bytes) + ",\n";
+    out += "  \"errors\": "            + std::to_string(errors) + ",\n";
+    Append(out, "  \"wall_seconds\": %.6f,\n", result.wall_s);
+    Append(out, "  \"aggregate_mb_per_s\": %.3f,\n",
+           result.wall_s > 0 ? static_cast<double>(total_bytes) / kMB / result.wall_s : 0.0);
+    out += "  \"per_session_mb_per_s\": {";
+    Append(out, " \"min\": %.3f,",  mbps.empty() ? 0.0 : mbps.front());
+    Append(out, " \"p50\": %.3f,",  Percentile(mbps, 50));
+    Append(out, " \"mean\": %.3f,", mean);
+    Append(out, " \"max\": %.3f },\n", mbps.empty() ? 0.0 : mbps.back());
+    out += "  \"connect_to_first_byte_ms\": {";
+    Append(out, " \"p50\": %.3f,", Percentile(ttfb_ms, 50));
+    Append(out, " \"p99\": %.3f,", Percentile(ttfb_ms, 99));
+    Append(out, " \"max\": %.3f },\n", ttfb_ms.empty() ? 0.0 : ttfb_ms.back());
+    out += "  \"allocations\": " + std::to_string(result.allocations) + ",\n";
+    Append(out, "  \"allocations_per_mb\": %.3f\n",
+           relayed_mb > 0 ? static_cast<double>(result.allocations) / relayed_mb : 0.0);
+    out += "}\n";
+    return out;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "../public/ssh_proxy.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// TokenBucket — `rate` tokens a second, holding at most `burst` (0 = rate),
+// full at construction.  Kept in thousandths of a token so refills at any
+// millisecond granularity are exact.  Not thread-safe — AdmissionControl
+// serialises access.
+class TokenBucket {
+public:
+    TokenBucket(uint32_t rate, uint32_t burst, uint64_t now_ms);
+
+    // Takes one token if there is one.
+    bool TryTake(uint64_t now_ms);
+
+private:
+    uint64_t m_rate;        // milli-tokens per millisecond == tokens per second
+    uint64_t m_capacity;    // milli-tokens
+    uint64_t m_level;
+    uint64_t m_last_ms;
+};
+
+enum class AdmissionVerdict : uint8_t {
+    Admitted,
+    SessionLimit,   // max_sessions reached
+    AcceptRate,     // accepts_per_sec bucket empty
+    TargetLimit,    // max_per_target reached for the CONNECT's destination
+};
+
+class AdmissionControl;
+
+// One session's admission: a concurrent-session slot (when admitted) and,
+// after ClaimTarget, a slot for its destination.  Both go back on Release
+// or destruction.  Move-only; not thread-safe — the session claims on the
+// SSH I/O thread and releases from its Close, which runs once.
+class AdmissionTicket {
+public:
+    AdmissionTicket() = default;   // admitted, nothing tracked
+    ~AdmissionTicket() { Release(); }
+
+    AdmissionTicket(AdmissionTicket&& other) noexcept;
+    AdmissionTicket& operator=(AdmissionTicket&& other) noexcept;
+    AdmissionTicket(const AdmissionTicket&)            = delete;
+    AdmissionTicket& operator=(const AdmissionTicket&) = delete;
+
+    AdmissionVerdict verdict() const { return m_verdict; }
+    bool admitted() const { return m_verdict == AdmissionVerdict::Admitted; }
+
+    // True if ClaimTarget can refuse — only then is a key worth building.
+    bool LimitsTargets() const;
+
+    // Takes a slot for `target` (a WarmSockets::Key).  False, with the
+    // verdict set to TargetLimit, if the destination is at its cap.
+    bool ClaimTarget(const std::string& target);
+
+    void Release();
+
+private:
+    friend class AdmissionControl;
+
+    std::shared_ptr<AdmissionControl> m_owner;
+    AdmissionVerdict                  m_verdict = AdmissionVerdict::Admitted;
+    bool                              m_holds_session = false;
+    std::string                       m_target;   // non-empty while holding a target slot
+};
+
+// AdmissionControl — the accept-path limits of one Connect
+// (ssh_proxy::AdmissionLimits), shared by its transports.  Thread-safe.
+class AdmissionControl : public std::enable_shared_from_this<AdmissionControl> {
+public:
+    static std::shared_ptr<AdmissionControl> Create(const ssh_proxy::AdmissionLimits& limits);
+
+    // Decides on a newly accepted channel.  A refused ticket holds nothing.
+    AdmissionTicket Admit();
+    AdmissionTicket Admit(uint64_t now_ms);
+
+    ssh_proxy::AdmissionStats GetStats() const;
+
+    explicit AdmissionControl(const ssh_proxy::AdmissionLimits& limits);   // use Create
+
+private:
+    friend class AdmissionTicket;
+
+    bool ClaimTarget(const std::string& target);
+    void ReleaseTarget(const std::string& target);
+    void ReleaseSession();
+
+    const ssh_proxy::AdmissionLimits m_limits;
+
+    // Admit serialises on m_mutex only when a session or rate limit is set;
+    // m_active may drop concurrently, which only makes a check conservative.
+    std::mutex            m_mutex;
+    TokenBucket           m_bucket;   // guarded by m_mutex
+    std::atomic<uint32_t> m_active{0};
+
+    std::mutex                                m_target_mutex;
+    std::unordered_map<std::string, uint32_t> m_targets;   // sessions per destination
+
+    std::atomic<uint64_t> m_admitted{0};
+    std::atomic<uint64_t> m_refused_sessions{0};
+    std::atomic<uint64_t> m_refused_rate{0};
+    std::atomic<uint64_t> m_refused_target{0};
+};
@@ -1,66 +1,199 @@
 #pragma once
 #include "common.h"
-#include <functional>
-
-// Completion key used to signal worker threads to exit
-static constexpr ULONG_PTR IOCP_SHUTDOWN_KEY = 0xDEAD;
+#include "inline_function.h"
+#include "io_affinity.h"
+#include <atomic>
+#include <vector>
 
 // I/O operation types
 enum class IoOp : uint8_t {
     Connect,
+    Accept,
+    Disconnect,   // StartDisconnect for socket reuse, WarmSockets::Recycle
     Send,
     Recv,
     Timer,
     Work,   // explicitly-posted work item (use instead of repurposing Timer)
 };
 
-// Extends OVERLAPPED — must be allocated for each async operation.
-// The IOCP callback receives the OVERLAPPED* and static_casts back to IoContext*.
+// One buffer of a recv or gathered send: WSABUF on Windows, iovec elsewhere.
+#ifdef _WIN32
+using IoBuffer = WSABUF;
+inline IoBuffer MakeIoBuffer(void* data, size_t len)
+{
+    IoBuffer b;
+    b.buf = static_cast<char*>(data);
+    b.len = static_cast<ULONG>(len);
+    return b;
+}
+#else
+using IoBuffer = iovec;
+inline IoBuffer MakeIoBuffer(void* data, size_t len) { return IoBuffer{ data, len }; }
+#endif
+
+struct IoContext;
+
+// Completion callback: (IoContext*, bytes transferred, ErrorCode).  Inline
+// storage for four pointers — a shared_ptr to the owner plus one more.
+using IoCallback = InlineFunction<void(IoContext*, DWORD, ErrorCode), 32>;
+
+// PostWork / PostWorkAfter item.  Sized for a std::function plus a
+// shared_ptr and a little more (DnsResolver's delivery).
+using WorkFunction = InlineFunction<void(), 96>;
+
+// Per-operation state — one per outstanding operation, reused only once its
+// completion has been delivered.  On Windows it extends OVERLAPPED and the
+// IOCP worker static_casts the dequeued OVERLAPPED* back to IoContext*.
+// Carries no data buffer of its own: a recv points `buffer` at a
+// PooledBuffer owned by the connection, so connect and work contexts stay
+// small.
+#ifdef _WIN32
 struct IoContext : OVERLAPPED {
-    IoOp    op;
-    SOCKET  socket;
-    WSABUF  wsa_buf;
-    uint8_t inline_buf[4096]{ 0 };
-    void*   user_data;
+#else
+struct IoContext {
+#endif
+    IoOp     op;
+    SOCKET   socket;
+    IoBuffer buffer;      // StartRecv target
+    void*    user_data;
 
-    // Callback: (IoContext*, DWORD bytes_transferred, ErrorCode)
-    std::function<void(IoContext*, DWORD, ErrorCode)> callback;
+    IoCallback callback;
 
     IoContext()
     {
-        ::ZeroMemory(static_cast<OVERLAPPED*>(this), sizeof(OVERLAPPED));
+        Reset();
         op = IoOp::Recv;
         socket = INVALID_SOCKET;
-        wsa_buf.buf = reinterpret_cast<char*>(inline_buf);
-        wsa_buf.len = sizeof(inline_buf);
+        buffer = MakeIoBuffer(nullptr, 0);
         user_data = nullptr;
     }
+
+    // Clears the backend's per-operation state before the context is reused.
+    void Reset()
+    {
+#ifdef _WIN32
+        ::ZeroMemory(static_cast<OVERLAPPED*>(this), sizeof(OVERLAPPED));
+#endif
+    }
+};
+
+// PostWork's one-shot context: the item travels with it and both are freed
+// after the item has run.
+struct WorkContext : IoContext {
+    WorkFunction fn;
 };
 
-// Singleton IOCP engine — owns the completion port and worker threads.
+// Process-wide proactor — owns the worker threads that run every completion
+// callback.  One interface, one backend per platform, chosen at compile time:
+//
+//   Windows  async_io.cpp        I/O completion port, ConnectEx/AcceptEx/DisconnectEx
+//   POSIX    async_io_epoll.cpp  epoll readiness, the operation done by the engine
+//
+// Operations follow the IOCP model on both.  A Start* call that returns
+// Success has started the operation: its completion reaches ctx->callback on
+// a worker thread — also when it finished at once, never on the caller's
+// stack.  Any other result means it was not started and no completion
+// follows.  One context carries one operation at a time.
+//
+// On Windows an operation that completes at once when started from a worker
+// is handed to that same worker, which runs it after the current callback
+// returns, without a trip through the port (FILE_SKIP_COMPLETION_PORT_ON_SUCCESS).
 class IoEngine {
 public:
-    // Initialize with given thread count (0 = CPU count).
-    static ErrorCode Init(int thread_count);
+    // Initialize with given thread count (0 = CPU count; with affinity, the
+    // processors left after the I/O threads' share).  `affinity` pins the
+    // workers per PlanIoAffinity and reserves `io_processors` processors
+    // for threads that call PinIoThread.  Only the first Init applies.
+    static ErrorCode Init(int thread_count, IoAffinity affinity = IoAffinity::None,
+                          uint32_t io_processors = 1);
 
-    // Shut down: post shutdown completions, join workers, close IOCP handle.
+    // Shut down: stop and join the workers, release the backend.
     static void Shutdown();
 
-    // Associate a socket with the IOCP.
-    static ErrorCode Associate(SOCKET sock, ULONG_PTR key = 0);
+    // Pins the calling thread to the processors Init reserved for the SSH
+    // I/O threads, apart from the workers.  No-op without affinity.
+    static void PinIoThread();
+
+    // Associate a socket with the engine (IOCP port / epoll set).  Required
+    // before the first Start* on the socket.
+    static ErrorCode Associate(SOCKET sock);
+
+    // A new TCP socket of `family`, associated and ready for StartConnect
+    // (on Windows bound to the family's wildcard, as ConnectEx requires).
+    static SOCKET OpenSocket(int family, ErrorCode& error);
+
+    // Closes an associated socket.  Its pending operations complete with
+    // ErrorCode::Shutdown.
+    static void CloseSocket(SOCKET sock);
 
-    // Load ConnectEx function pointer for a socket family.
-    static LPFN_CONNECTEX GetConnectEx();
+    // Aborts the socket's pending operations (ErrorCode::Shutdown) and
+    // leaves it open.
+    static void CancelIo(SOCKET sock);
+
+    // Connects ctx->socket to addr.  After a successful completion call
+    // FinishConnect before any other socket call.
+    static ErrorCode StartConnect(IoContext* ctx, const sockaddr* addr, int addr_len);
+    static void      FinishConnect(SOCKET sock);
+
+    // Receives into ctx->buffer; 0 bytes with Success is the peer's FIN.
+    static ErrorCode StartRecv(IoContext* ctx);
+
+    // Sends the `count` buffers as one write; the completion reports how many
+    // bytes were taken.  The buffers must stay valid until it arrives.
+    static ErrorCode StartSend(IoContext* ctx, const IoBuffer* buffers, size_t count);
+
+    // Disconnects ctx->socket and keeps it open for another StartConnect
+    // (DisconnectEx(TF_REUSE_SOCKET)).  Only where SupportsSocketReuse().
+    static ErrorCode StartDisconnect(IoContext* ctx);
+    static bool      SupportsSocketReuse();
+
+    // Accepts a connection on the listening ctx->socket into `accept_socket`,
+    // a fresh unassociated socket of the listener's family (AcceptEx; on
+    // POSIX the connection is moved onto it).  Windows writes both addresses
+    // to addr_buf, addr_len bytes each, with no receive area.  For
+    // DirectForward's listener.
+    static ErrorCode StartAccept(IoContext* ctx, SOCKET accept_socket, void* addr_buf, DWORD addr_len);
 
     // Post a manual completion to wake a worker.
     static void PostCompletion(IoContext* ctx, DWORD bytes = 0);
 
+    // Run fn on a worker thread.  Allocates a one-shot WorkContext that is
+    // freed after fn returns — for callers that own no IoContext of their own.
+    static void PostWork(WorkFunction fn);
+
+    // Run fn on a worker thread after delay_ms.  One-shot and not
+    // cancellable — fn must check whether it is still wanted.
+    static void PostWorkAfter(DWORD delay_ms, WorkFunction fn);
+
+    // Completions dequeued by each worker since Init(), in worker order.
+    // Thread-safe; must not race Shutdown().
+    static std::vector<uint64_t> GetWorkerCompletions();
+
 private:
+    // One cache line per worker: each counter has a single writer.
+    struct alignas(64) WorkerCounters {
+        std::atomic<uint64_t> completions{0};
+        uint64_t              affinity = 0;   // processor mask, applied at start; 0 = unpinned
+    };
+
+    // Completions a worker dequeues per wait.
+    static constexpr size_t kDequeueBatch = 32;
+
+    static WorkerCounters*   s_worker_counters;
+    static int               s_thread_count;
+    static bool              s_initialized;
+    static uint64_t          s_io_thread_affinity;
+
+#ifdef _WIN32
     static DWORD WINAPI WorkerThread(LPVOID param);
 
     static HANDLE            s_iocp;
     static HANDLE*           s_threads;
-    static int               s_thread_count;
     static LPFN_CONNECTEX    s_connect_ex;
-    static bool              s_initialized;
+    static LPFN_ACCEPTEX     s_accept_ex;
+    static LPFN_DISCONNECTEX s_disconnect_ex;
+#else
+    static void WorkerThread(WorkerCounters* counters);
+    static void PollerThread();
+#endif
 };
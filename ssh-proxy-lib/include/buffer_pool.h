@@ -0,0 +1,139 @@
+#pragma once
+#include "common.h"
+#include <atomic>
+
+// Slab — header of one pooled relay buffer; the payload follows in the same
+// allocation.  [begin, end) is the window of valid, not yet consumed bytes.
+//
+// `next` is the intrusive link used by the pool's freelists and by
+// MpscQueue<Slab>, so a slab can be linked into at most one list at a time.
+// A default-constructed Slab (capacity 0) serves as an MpscQueue stub.
+struct Slab {
+    std::atomic<Slab*>    next{nullptr};
+    std::atomic<uint32_t> refs{0};
+    uint32_t              capacity = 0;
+    uint32_t              begin    = 0;
+    uint32_t              end      = 0;
+    int64_t               queued_at = 0;   // QPC; set while queued for a channel write
+
+    uint8_t* base() { return reinterpret_cast<uint8_t*>(this + 1); }
+};
+
+// PooledBuffer — refcounted handle to a Slab.
+//
+// Copying shares the slab (and its window); moving transfers the reference.
+// When the last handle goes away the slab returns to the pool.  Detach() and
+// Adopt() hand a reference through intrusive queues without touching the
+// count.
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    PooledBuffer(const PooledBuffer& other);
+    PooledBuffer(PooledBuffer&& other) noexcept : m_slab(other.m_slab) { other.m_slab = nullptr; }
+    PooledBuffer& operator=(PooledBuffer other) noexcept { std::swap(m_slab, other.m_slab); return *this; }
+    ~PooledBuffer() { Reset(); }
+
+    // Takes over a reference previously released by Detach().
+    static PooledBuffer Adopt(Slab* slab) { PooledBuffer b; b.m_slab = slab; return b; }
+    // Gives up the reference without dropping it; the caller must Adopt() it later.
+    Slab* Detach() { Slab* s = m_slab; m_slab = nullptr; return s; }
+
+    void Reset();
+
+    explicit operator bool() const { return m_slab != nullptr; }
+
+    // Unconsumed bytes.
+    uint8_t* data()  const { return m_slab->base() + m_slab->begin; }
+    size_t   size()  const { return m_slab->end - m_slab->begin; }
+    bool     empty() const { return m_slab == nullptr || m_slab->begin == m_slab->end; }
+
+    // Free space after the valid bytes — the target of a recv.
+    uint8_t* tail()     const { return m_slab->base() + m_slab->end; }
+    size_t   tailroom() const { return m_slab->capacity - m_slab->end; }
+    size_t   capacity() const { return m_slab->capacity; }
+
+    // Marks n bytes at tail() as valid (after a recv/read into tail()).
+    void Commit(size_t n)  { m_slab->end   += static_cast<uint32_t>(n); }
+    // Drops n bytes from the front (after a partial write).
+    void Consume(size_t n) { m_slab->begin += static_cast<uint32_t>(n); }
+
+private:
+    Slab* m_slab = nullptr;
+};
+
+// BufferPool — process-wide source of PooledBuffers.
+//
+// Three size classes (kTinySlab, kSmallSlab, kLargeSlab).  Each thread keeps
+// a bounded freelist per class; overflow moves in batches to a shared depot
+// that other threads refill from, so buffers received on IOCP workers and
+// released on the SSH I/O thread circulate without a lock per buffer.  Requests above
+// kLargeSlab get an exact-size heap slab that is never pooled.
+class BufferPool {
+public:
+    static constexpr size_t kTinySlab  = 4 * 1024;
+    static constexpr size_t kSmallSlab = 16 * 1024;
+    static constexpr size_t kLargeSlab = 64 * 1024;
+
+    // Returns an empty buffer with capacity >= min_capacity.
+    static PooledBuffer Acquire(size_t min_capacity = kSmallSlab);
+
+    // Acquire + copy — for data that did not originate in a pooled buffer.
+    static PooledBuffer CopyOf(const uint8_t* data, size_t len);
+
+private:
+    friend class PooledBuffer;
+    static void Recycle(Slab* slab);
+};
+
+// RecvSizer — adaptive read size for one relay direction.
+//
+// Starts at `min` and doubles (up to `max`) after kGrowAfter consecutive reads
+// that filled the whole request — a bulk transfer quickly reaches large reads.
+// Halves (down to `min`) after kShrinkAfter consecutive reads that used under
+// a quarter of it, so an idle or interactive session returns to small slabs.
+// min == max gives a fixed size.  Not thread-safe: one reader per instance.
+class RecvSizer {
+public:
+    static constexpr int kGrowAfter   = 2;
+    static constexpr int kShrinkAfter = 8;
+
+    RecvSizer(size_t min, size_t max)
+        : m_min(min), m_max(max < min ? min : max), m_size(min) {}
+
+    size_t Next() const { return m_size; }
+
+    // Feed back the byte count of the read issued with Next().
+    void Record(size_t bytes)
+    {
+        if (bytes >= m_size)
+        {
+            m_small = 0;
+            if (++m_full >= kGrowAfter && m_size < m_max)
+            {
+                m_size = (m_size * 2 < m_max) ? m_size * 2 : m_max;
+                m_full = 0;
+            }
+        }
+        else if (bytes < m_size / 4)
+        {
+            m_full = 0;
+            if (++m_small >= kShrinkAfter && m_size > m_min)
+            {
+                m_size = (m_size / 2 > m_min) ? m_size / 2 : m_min;
+                m_small = 0;
+            }
+        }
+        else
+        {
+            m_full  = 0;
+            m_small = 0;
+        }
+    }
+
+private:
+    size_t m_min;
+    size_t m_max;
+    size_t m_size;
+    int    m_full  = 0;
+    int    m_small = 0;
+};
@@ -1,17 +1,7 @@
 #pragma once
 
-// Windows headers — order matters
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
-#endif
-#ifndef NOMINMAX
-#define NOMINMAX
-#endif
-
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#include <mswsock.h>
-#include <windows.h>
+// Windows or POSIX socket headers
+#include "platform.h"
 
 #include <libssh2.h>
 
@@ -84,6 +74,7 @@ inline const char* ErrorCodeToString(ErrorCode ec)
     return "Unknown";
 }
 
+#ifdef _WIN32
 // Convert a WinSock error to ErrorCode
 inline ErrorCode WsaToErrorCode(int wsa_error)
 {
@@ -97,6 +88,26 @@ inline ErrorCode WsaToErrorCode(int wsa_error)
     default:             return ErrorCode::SocketError;
     }
 }
+#endif
+
+// Convert LastSocketError() to ErrorCode on either platform
+inline ErrorCode SocketErrorToErrorCode(int error)
+{
+#ifdef _WIN32
+    return WsaToErrorCode(error);
+#else
+    switch (error) {
+    case 0:            return ErrorCode::Success;
+    case ECONNRESET:
+    case EPIPE:        return ErrorCode::ConnectionReset;
+    case ECONNREFUSED: return ErrorCode::ConnectionRefused;
+    case ETIMEDOUT:    return ErrorCode::ConnectionTimeout;
+    case EHOSTUNREACH: return ErrorCode::HostUnreachable;
+    case ENETUNREACH:  return ErrorCode::NetworkUnreachable;
+    default:           return ErrorCode::SocketError;
+    }
+#endif
+}
 
 // A result type that pairs an ErrorCode with an optional diagnostic message.
 // Used by setup functions that cannot throw but need to propagate a human-readable
@@ -164,8 +175,20 @@ struct SshListenerDeleter {
 };
 using SshListenerPtr = std::unique_ptr<LIBSSH2_LISTENER, SshListenerDeleter>;
 
-// SOCKET is a UINT_PTR (integer handle), not a pointer, so unique_ptr
-// cannot wrap it directly.  WinSocket is a minimal move-only RAII guard.
+// LIBSSH2_AGENT* — disconnect → free.  Disconnecting an agent that never
+// connected is a no-op.
+struct SshAgentDeleter {
+    void operator()(LIBSSH2_AGENT* a) const
+    {
+        ::libssh2_agent_disconnect(a);
+        ::libssh2_agent_free(a);
+    }
+};
+using SshAgentPtr = std::unique_ptr<LIBSSH2_AGENT, SshAgentDeleter>;
+
+// SOCKET is an integer handle (UINT_PTR, or an fd on POSIX), not a pointer,
+// so unique_ptr cannot wrap it directly.  WinSocket is a minimal move-only
+// RAII guard.
 struct WinSocket {
     SOCKET s = INVALID_SOCKET;
 
@@ -208,6 +231,18 @@ private:
     }
 };
 
+#ifdef _WIN32
+// WSAEVENT — WSACloseEvent.  WSAEVENT is a HANDLE (void*), so unique_ptr<void>
+// can own it directly; WSA_INVALID_EVENT is nullptr, so operator bool works.
+struct WsaEventDeleter {
+    void operator()(WSAEVENT e) const
+    {
+        ::WSACloseEvent(e);
+    }
+};
+using WsaEventPtr = std::unique_ptr<void, WsaEventDeleter>;
+#endif
+
 // addrinfo* — freeaddrinfo.
 struct AddrInfoDeleter {
     void operator()(addrinfo* ai) const
@@ -0,0 +1,110 @@
+#pragma once
+#include "common.h"
+#ifndef _WIN32
+#include <csignal>
+#endif
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One resolved address.  The port is left zero — callers fill it in.
+struct ResolvedAddress {
+    sockaddr_storage addr{};
+    int              len = 0;
+
+    int family() const { return addr.ss_family; }
+};
+using AddressList = std::vector<ResolvedAddress>;
+
+// DnsCache — bounded LRU of host → resolution result with per-entry expiry.
+//
+// Positive results live for ttl_ms, definitive failures (host not found /
+// no data) for negative_ttl_ms.  Keys are case-insensitive and ignore a
+// trailing dot.  A TTL of zero disables caching for that kind of result.
+// Not thread-safe — DnsResolver serialises access.
+class DnsCache {
+public:
+    struct Entry {
+        ErrorCode                           status = ErrorCode::Success;
+        std::shared_ptr<const AddressList>  addresses;   // null on failure
+    };
+
+    DnsCache(size_t max_entries, uint32_t ttl_ms, uint32_t negative_ttl_ms);
+
+    void Configure(size_t max_entries, uint32_t ttl_ms, uint32_t negative_ttl_ms);
+
+    // Returns true and fills `out` on a live hit.  Expired entries are
+    // removed on lookup.
+    bool Lookup(const std::string& host, uint64_t now_ms, Entry& out);
+
+    void Insert(const std::string& host, Entry entry, uint64_t now_ms);
+
+    void   Clear();
+    size_t size() const { return m_index.size(); }
+
+    static std::string NormalizeHost(const std::string& host);
+
+private:
+    struct Node {
+        std::string key;
+        Entry       entry;
+        uint64_t    expires_ms;
+    };
+    void Evict();
+
+    size_t   m_max_entries;
+    uint32_t m_ttl_ms;
+    uint32_t m_negative_ttl_ms;
+
+    std::list<Node>                                         m_lru;    // front = most recent
+    std::unordered_map<std::string, std::list<Node>::iterator> m_index;
+};
+
+// DnsResolver — process-wide asynchronous resolver (GetAddrInfoExW on
+// Windows, getaddrinfo_a on POSIX).
+//
+// Lookups never block a thread: a cache hit is answered immediately, a miss
+// issues an asynchronous query, and concurrent lookups of the same host
+// share one query (up to kMaxWaitersPerQuery of them).  A query that runs
+// past its timeout is cancelled and its waiters fail.  Results are always
+// delivered on an IoEngine worker thread (IoEngine::PostWork), never on the
+// caller's stack.
+class DnsResolver {
+public:
+    using OnResolved = std::function<void(ErrorCode, std::shared_ptr<const AddressList>)>;
+
+    static void Resolve(const std::string& host, OnResolved on_resolved);
+
+    // Applies cache limits and the query timeout (0 = none); existing
+    // entries keep their expiry, queries in flight their timeout.
+    // Thread-safe.
+    static void Configure(size_t max_entries, uint32_t ttl_ms, uint32_t negative_ttl_ms,
+                          uint32_t timeout_ms = kDefaultTimeoutMs);
+
+    static void ClearCache();
+
+    // Cancels every query in flight; their waiters get ErrorCode::Shutdown.
+    // Connect calls it when the last instance goes.  Thread-safe.
+    static void CancelAll();
+
+    static constexpr size_t   kDefaultMaxEntries    = 256;
+    static constexpr uint32_t kDefaultTtlMs         = 60000;
+    static constexpr uint32_t kDefaultNegativeTtlMs = 5000;
+    static constexpr uint32_t kDefaultTimeoutMs     = 10000;
+    static constexpr size_t   kMaxWaitersPerQuery   = 1024;
+
+private:
+    struct Query;
+    struct State;
+    static State& GetState();
+#ifdef _WIN32
+    static void CALLBACK QueryComplete(DWORD error, DWORD bytes, LPWSAOVERLAPPED overlapped);
+#else
+    static void QueryComplete(sigval value);
+#endif
+    static void FinishQuery(Query* q, int error);
+    static void ExpireQuery(const std::string& key, uint64_t id);
+    static void AbandonQuery(const std::shared_ptr<Query>& q);
+};
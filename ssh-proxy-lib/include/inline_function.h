@@ -0,0 +1,119 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only callable with fixed inline storage — std::function without the
+// heap.  The callable is constructed inside the object itself; one that does
+// not fit in Capacity bytes is a compile error rather than an allocation, so
+// a capture that grows shows up where it is written.  Used for IoEngine
+// completion callbacks and work items, which are set once per operation on
+// the data path.
+//
+// A moved-from InlineFunction is empty (std::function leaves it unspecified).
+// Invoking an empty one is undefined; callers test it first.
+template <typename Signature, size_t Capacity>
+class InlineFunction;
+
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+public:
+    InlineFunction() noexcept = default;
+    InlineFunction(std::nullptr_t) noexcept {}
+
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same<std::decay_t<F>, InlineFunction>::value>>
+    InlineFunction(F&& f)
+    {
+        Emplace(std::forward<F>(f));
+    }
+
+    InlineFunction(InlineFunction&& other) noexcept { MoveFrom(other); }
+
+    InlineFunction& operator=(InlineFunction&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Clear();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(std::nullptr_t) noexcept
+    {
+        Clear();
+        return *this;
+    }
+
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same<std::decay_t<F>, InlineFunction>::value>>
+    InlineFunction& operator=(F&& f)
+    {
+        Clear();
+        Emplace(std::forward<F>(f));
+        return *this;
+    }
+
+    InlineFunction(const InlineFunction&)            = delete;
+    InlineFunction& operator=(const InlineFunction&) = delete;
+
+    ~InlineFunction() { Clear(); }
+
+    explicit operator bool() const noexcept { return m_invoke != nullptr; }
+
+    R operator()(Args... args) { return m_invoke(&m_storage, std::forward<Args>(args)...); }
+
+private:
+    enum class Op { Move, Destroy };
+
+    using Invoker = R (*)(void*, Args&&...);
+    using Manager = void (*)(Op, void* self, void* other);
+
+    template <typename F>
+    void Emplace(F&& f)
+    {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= Capacity,
+                      "callable does not fit InlineFunction — capture less or raise Capacity");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "over-aligned callable");
+        static_assert(std::is_nothrow_move_constructible<Fn>::value,
+                      "callable must be nothrow-movable");
+
+        ::new (static_cast<void*>(&m_storage)) Fn(std::forward<F>(f));
+        m_invoke = [](void* p, Args&&... args) -> R
+        {
+            return (*static_cast<Fn*>(p))(std::forward<Args>(args)...);
+        };
+        m_manage = [](Op op, void* self, void* other)
+        {
+            if (op == Op::Move)
+                ::new (self) Fn(std::move(*static_cast<Fn*>(other)));
+            static_cast<Fn*>(op == Op::Move ? other : self)->~Fn();
+        };
+    }
+
+    // Leaves other empty.
+    void MoveFrom(InlineFunction& other) noexcept
+    {
+        if (!other.m_invoke) return;
+        other.m_manage(Op::Move, &m_storage, &other.m_storage);
+        m_invoke       = other.m_invoke;
+        m_manage       = other.m_manage;
+        other.m_invoke = nullptr;
+        other.m_manage = nullptr;
+    }
+
+    void Clear() noexcept
+    {
+        if (!m_invoke) return;
+        m_manage(Op::Destroy, &m_storage, nullptr);
+        m_invoke = nullptr;
+        m_manage = nullptr;
+    }
+
+    std::aligned_storage_t<Capacity, alignof(std::max_align_t)> m_storage;
+    Invoker m_invoke = nullptr;
+    Manager m_manage = nullptr;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include "common.h"
+#include "../public/ssh_proxy.h"
+#include <atomic>
+
+// QueryPerformanceCounter ticks (CLOCK_MONOTONIC nanoseconds on POSIX) and
+// their conversion — the clock for every latency measured on the data path.
+int64_t  QpcNow();
+uint64_t QpcToUs(int64_t ticks);
+double   QpcToSeconds(int64_t ticks);
+
+// LatencyHistogram — log-bucketed distribution of microsecond durations.
+//
+// Values below kExactBelow get a bucket each; above that, every power of two
+// is split into kSubBuckets linear sub-buckets, so any recorded value sits
+// within 12.5% of its bucket's bounds across the full uint64_t range.
+// Record() is a handful of relaxed atomic adds — wait-free, callable from any
+// thread — and Summarize() reads the buckets without stopping writers, so a
+// summary taken under load may be off by the few records in flight.
+class LatencyHistogram {
+public:
+    static constexpr size_t kExactBelow  = 16;
+    static constexpr size_t kSubBuckets  = 8;
+    static constexpr size_t kBucketCount = kExactBelow + (64 - 4) * kSubBuckets;
+
+    void Record(uint64_t us);
+    ssh_proxy::LatencyStats Summarize() const;
+    void Reset();
+
+    static size_t   BucketOf(uint64_t us);
+    static uint64_t BucketUpperBound(size_t bucket);   // largest value in the bucket
+
+private:
+    std::atomic<uint64_t> m_buckets[kBucketCount] = {};
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_sum_us{0};
+    std::atomic<uint64_t> m_max_us{0};
+};
+
+// The instrumented hot-path points.  Each has one process-wide histogram and
+// one TraceLogging event of the same name.
+enum class LatencyPoint {
+    SocksConnect,     // SOCKS5 CONNECT parsed → target connected
+    DnsResolve,       // TcpConnection resolve start → DnsResolver answer
+    TcpConnect,       // one ConnectEx attempt: issued → completed
+    IoLoopTick,       // one SSH I/O loop iteration, excluding the idle wait
+    WriteQueueWait,   // PostChannelWrite → dequeued by the I/O thread
+    kCount
+};
+
+// Instrumentation — the histograms plus the "SshReverseSocksProxy" ETW
+// provider (TraceLogging, GUID 5605eb62-b286-56fc-7d12-fcd8dc33e328).
+//
+// RecordLatency() always feeds the histogram; the event is written only while
+// a trace session has the provider enabled at verbose level for the point's
+// keyword, which TraceLoggingWrite checks before building the event.
+// Register() / Unregister() are called by IoEngine::Init / Shutdown; no
+// thread may be recording while Unregister() runs.
+class Instrumentation {
+public:
+    static void Register();
+    static void Unregister();
+
+    static void RecordLatency(LatencyPoint point, uint64_t us);
+
+    static ssh_proxy::LatencyStats Summarize(LatencyPoint point);
+    static void Reset();   // tests and the soak target only
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Where IoEngine's threads may run (see io_affinity.cpp).
+enum class IoAffinity : uint8_t {
+    None,       // the scheduler decides (default)
+    Core,       // each worker on one logical processor of its own
+    NumaNode,   // each worker on the processors of one NUMA node, nodes in turn
+};
+
+// Processor masks: bit i is logical processor i of the process's processor
+// group (Windows) or CPU i (POSIX); only the first 64 are used.
+struct IoAffinityPlan {
+    std::vector<uint64_t> workers;        // one mask per worker; empty = unpinned
+    uint64_t              io_threads = 0; // SSH I/O threads; 0 = unpinned
+};
+
+// The processors this process may use and, where known, each NUMA node's
+// share of them.
+struct ProcessorLayout {
+    uint64_t              available = 0;
+    std::vector<uint64_t> nodes;
+};
+
+// Splits `layout` for `workers` worker threads.  The lowest io_processors
+// available processors go to the I/O threads — never all of them, so at
+// least one is left for workers — and the workers share the rest per `mode`.
+// Pure, for tests.
+IoAffinityPlan PlanIoAffinity(IoAffinity mode, const ProcessorLayout& layout,
+                              int workers, uint32_t io_processors);
+
+// Number of processors in `mask`.
+int ProcessorCount(uint64_t mask);
+
+// The running process's layout.
+ProcessorLayout QueryProcessorLayout();
+
+// Restricts the calling thread to `mask`; false if the OS refused.
+bool PinCurrentThread(uint64_t mask);
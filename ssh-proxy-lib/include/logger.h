@@ -1,17 +1,13 @@
 #pragma once
 #include "common.h"
 #include "../public/ssh_proxy.h"
-#include <deque>
-#include <mutex>
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <functional>
 
-struct LogEntry {
-    std::string          timestamp;  // "YYYY-MM-DD HH:MM:SS.mmm"
-    ssh_proxy::LogLevel  level;
-    std::string          message;
-};
+using LogEntry = ssh_proxy::LogRecord;
 
 class Logger {
 public:
@@ -22,22 +18,43 @@ public:
     static void Warn (const char* fmt, ...);
     static void Error(const char* fmt, ...);
 
-    // Optional real-time callback — fires on the calling thread for each entry
-    // that passes the min-level filter. Used by the CLI to mirror entries to stderr.
-    // Pass nullptr to clear.
+    // Optional real-time callback — fires on the logger's drain thread for
+    // each entry that passes the min-level filter and was logged after the
+    // callback was installed. Used by the CLI to mirror entries to stderr.
+    // Pass nullptr to clear; SetCallback() returns only once any in-flight
+    // invocation of the previous callback has finished. The callback may
+    // log, but must not call SetCallback() or Flush().
     using LogCallback = std::function<void(const LogEntry&)>;
     static void SetCallback(LogCallback cb);
 
-    // Snapshot the buffer for ssh_proxy::GetLog().
+    // Block until every entry logged before the call has been handed to the
+    // callback. No-op when no callback is installed.
+    static void Flush();
+
+    // Snapshot the most recent k_max_entries entries for ssh_proxy::GetLog().
     static std::vector<LogEntry> Snapshot();
 
+    // Entries with seq > after_seq still in the ring, oldest first, at most
+    // max_entries — for ssh_proxy::GetLogSince().  Ends early at an entry
+    // still being written, so passing the last seq returned never skips one.
+    static std::vector<LogEntry> Since(uint64_t after_seq, size_t max_entries);
+
+    // Resizes the ring to `entries` rounded up to a power of two within
+    // [k_min_ring_entries, k_max_ring_entries], keeping the newest entries
+    // that fit.  Only the first resize takes effect, since a replaced ring
+    // is never freed; a later one that would change the capacity logs a
+    // warning and returns false.
+    static bool   SetCapacity(size_t entries);
+    static size_t Capacity();
+
+    static constexpr size_t k_max_entries      = 100;      // Snapshot() depth
+    static constexpr size_t k_ring_entries     = 256;      // default capacity
+    static constexpr size_t k_min_ring_entries = 128;      // > k_max_entries
+    static constexpr size_t k_max_ring_entries = 131072;   // 128 MiB of records
+    static constexpr size_t k_message_bytes    = 1024;     // longer messages are truncated
+
 private:
     static void Log(ssh_proxy::LogLevel level, const char* fmt, va_list args);
 
-    static std::mutex            s_mutex;
-    static std::deque<LogEntry>  s_buffer;    // capped at k_max_entries
-    static ssh_proxy::LogLevel   s_min_level;
-    static LogCallback           s_callback;
-
-    static constexpr size_t k_max_entries = 100;
+    static std::atomic<ssh_proxy::LogLevel> s_min_level;
 };
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+
+// Intrusive multi-producer / single-consumer queue (D. Vyukov's algorithm).
+//
+// Node must expose `std::atomic<Node*> next` and be default-constructible
+// (one node is embedded as the stub).  Push() is wait-free and safe from any
+// thread; Pop() must only be called by the single consumer thread.  The queue
+// never allocates — callers own node memory.
+//
+// Pop() can transiently return nullptr while a producer is between its two
+// atomic steps.  Callers must use an external signal (e.g. a "dirty" flag set
+// after Push returns) to retry later rather than treating nullptr as "empty
+// forever".
+template <typename Node>
+class MpscQueue {
+public:
+    MpscQueue()
+        : m_head(&m_stub)
+        , m_tail(&m_stub)
+    {
+        m_stub.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue&)            = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void Push(Node* n)
+    {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = m_head.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+    }
+
+    // Consumer only.
+    Node* Pop()
+    {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub)
+        {
+            if (next == nullptr) return nullptr;
+            m_tail = next;
+            tail   = next;
+            next   = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr)
+        {
+            m_tail = next;
+            return tail;
+        }
+        if (tail != m_head.load(std::memory_order_acquire))
+            return nullptr;  // a producer is mid-Push; retry later
+
+        Push(&m_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr)
+        {
+            m_tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+private:
+    std::atomic<Node*> m_head;
+    Node*              m_tail;   // consumer-owned
+    Node               m_stub;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+// Operating-system headers, and the socket spellings shared code uses on
+// every platform.  Windows gets Winsock (the include order matters).  The
+// POSIX build gets the BSD socket API plus aliases for the Winsock names
+// that appear outside the I/O backends (SOCKET, INVALID_SOCKET,
+// closesocket, SD_*, DWORD, INFINITE) and for GetTickCount64, so a socket handle and
+// a millisecond timestamp read the same in both.
+
+#ifdef _WIN32
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mswsock.h>
+#include <windows.h>
+
+#else
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+
+using SOCKET    = int;
+using DWORD     = uint32_t;
+using ULONG_PTR = uintptr_t;
+
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int    SOCKET_ERROR   = -1;
+constexpr DWORD  INFINITE       = 0xFFFFFFFF;
+
+constexpr int SD_RECEIVE = SHUT_RD;
+constexpr int SD_SEND    = SHUT_WR;
+constexpr int SD_BOTH    = SHUT_RDWR;
+
+inline int closesocket(SOCKET s) { return ::close(s); }
+
+// Milliseconds of a monotonic clock, like the Win32 call.
+inline uint64_t GetTickCount64()
+{
+    timespec ts{};
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000u + static_cast<uint64_t>(ts.tv_nsec) / 1000000u;
+}
+
+#endif
+
+// The calling thread's last socket error — WSAGetLastError() or errno.
+inline int LastSocketError()
+{
+#ifdef _WIN32
+    return ::WSAGetLastError();
+#else
+    return errno;
+#endif
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "common.h"
+#include <random>
+
+// ReconnectBackoff — the delays between reconnect attempts of one transport.
+//
+// Exponential with "equal jitter": retry n waits a random time in [c/2, c],
+// where c = min(initial_ms << n, max_ms).  Transports that dropped together
+// (a server restart, a flapping uplink) spread their retries out instead of
+// reconnecting in lock-step, yet none retries sooner than half its nominal
+// delay.  The first attempt after a drop is not delayed at all — Next() is
+// only asked once that attempt has failed.
+class ReconnectBackoff {
+public:
+    ReconnectBackoff(uint32_t initial_ms, uint32_t max_ms, uint32_t seed);
+
+    // Delay before the next retry; advances the exponent.
+    uint32_t Next();
+
+    // Back to initial_ms, after a successful reconnect.
+    void Reset() { m_attempt = 0; }
+
+    uint32_t attempts() const { return m_attempt; }
+
+private:
+    uint32_t          m_initial_ms;
+    uint32_t          m_max_ms;
+    uint32_t          m_attempt = 0;
+    std::minstd_rand  m_rng;
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include "common.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// SessionPool — recycles the memory of a session's long-lived objects.
+//
+// One Block is a cache-line-aligned kBlockSize chunk that a session's
+// objects (and their shared_ptr control blocks) are carved from with
+// SessionAllocator.  Each sub-allocation starts on its own cache line, so
+// objects written by different threads never share one.  The block goes
+// back to the pool's free list once the last object carved from it is
+// deallocated — whichever thread that happens on — and is handed to the
+// next Acquire() without touching the heap.
+//
+// Blocks keep their pool alive while in use, so a pool may be dropped while
+// IOCP completions still hold sessions.  Carving (Allocate) is done by one
+// thread between Acquire() and the creator's Release(); an allocation that
+// does not fit falls back to the heap and is counted in Stats::overflows.
+class SessionPool : public std::enable_shared_from_this<SessionPool> {
+public:
+    static constexpr size_t kBlockSize = 4096;
+    static constexpr size_t kCacheLine = 64;
+    static constexpr size_t kMaxIdle   = 128;   // free blocks kept; the rest go back to the heap
+
+    struct Block;
+
+    static std::shared_ptr<SessionPool> Create();
+    ~SessionPool();
+
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    // Hands out an empty block holding one reference for the caller — drop
+    // it with Release() once the block's objects are constructed.
+    Block* Acquire();
+    static void Release(Block* block);
+
+    static void* Allocate(Block* block, size_t bytes, size_t align);
+    static void  Deallocate(Block* block, void* p, size_t align);
+
+    struct Stats {
+        uint64_t acquired  = 0;
+        uint64_t reused    = 0;   // acquisitions served from the free list
+        uint64_t overflows = 0;   // allocations that did not fit a block
+        size_t   idle      = 0;
+    };
+    Stats GetStats() const;
+
+private:
+    SessionPool() = default;
+    void Recycle(Block* block);
+
+    mutable std::mutex     m_mutex;
+    std::vector<Block*>    m_idle;
+    std::atomic<uint64_t>  m_acquired{0};
+    std::atomic<uint64_t>  m_reused{0};
+    std::atomic<uint64_t>  m_overflows{0};
+};
+
+// Standard allocator over one SessionPool block, for std::allocate_shared.
+template <class T>
+class SessionAllocator {
+public:
+    using value_type = T;
+
+    explicit SessionAllocator(SessionPool::Block* block) : m_block(block) {}
+    template <class U>
+    SessionAllocator(const SessionAllocator<U>& other) : m_block(other.block()) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(SessionPool::Allocate(m_block, n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t) { SessionPool::Deallocate(m_block, p, alignof(T)); }
+
+    SessionPool::Block* block() const { return m_block; }
+
+    template <class U>
+    bool operator==(const SessionAllocator<U>& other) const { return m_block == other.block(); }
+    template <class U>
+    bool operator!=(const SessionAllocator<U>& other) const { return m_block != other.block(); }
+
+private:
+    SessionPool::Block* m_block;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include "common.h"
+
+// SocketWaiter — the SSH I/O thread's blocking wait on its socket (see
+// socket_ops.cpp).  Wait() returns once the socket is readable or closed,
+// writable (when asked for), Wake() was called, or the timeout ran out.
+// Attach() and Wait() belong to the owning thread; Wake() is thread-safe.
+class SocketWaiter {
+public:
+    SocketWaiter() = default;
+    ~SocketWaiter();
+
+    SocketWaiter(const SocketWaiter&)            = delete;
+    SocketWaiter& operator=(const SocketWaiter&) = delete;
+
+    // Registers `sock` for the wait and switches it to non-blocking mode,
+    // which is what libssh2 expects once the handshake is done.  The socket
+    // itself stays owned by the caller.
+    Result Attach(SOCKET sock);
+
+    // timeout_ms = INFINITE waits for an event only.  `want_write` asks to
+    // wake on write readiness too; pass it only while a send on the socket
+    // would block — POSIX poll() is level-triggered, so asking while the
+    // socket is writable returns at once.  Windows' FD_WRITE only fires after
+    // a send would have blocked and is always on.  Sets peer_closed if the
+    // peer closed the connection.
+    void Wait(DWORD timeout_ms, bool want_write, bool& peer_closed);
+
+    void Wake();
+
+private:
+    void Release();
+
+    SOCKET      m_socket = INVALID_SOCKET;
+#ifdef _WIN32
+    WsaEventPtr m_socket_event;   // WSAEventSelect target (FD_READ/WRITE/CLOSE)
+    WsaEventPtr m_wake_event;     // signalled by Wake()
+#else
+    int         m_wake_fd = -1;   // eventfd written by Wake()
+#endif
+};
+
+// SO_RCVTIMEO / SO_SNDTIMEO for a blocking socket's connect and handshake.
+void SetSocketTimeouts(SOCKET sock, DWORD timeout_ms);
+
+// True if received bytes are waiting in the socket (FIONREAD).
+bool SocketHasInput(SOCKET sock);
+
+// The kernel's smoothed round-trip time for a connected TCP socket.  False
+// where the OS cannot report it (Windows before 10 1703).
+bool ReadTcpRttUs(SOCKET sock, uint32_t& rtt_us);
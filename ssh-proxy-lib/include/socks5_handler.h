@@ -30,10 +30,12 @@ static constexpr uint8_t REP_TTL_EXPIRED              = 0x06;
 static constexpr uint8_t REP_COMMAND_NOT_SUPPORTED    = 0x07;
 static constexpr uint8_t REP_ADDRESS_TYPE_NOT_SUPPORTED = 0x08;
 
-// Parsed connect request
+// Parsed connect request.  Address literals stay binary — they go straight
+// to ConnectEx via ToSockaddr(), never through a string or the resolver.
 struct ConnectRequest {
+    uint8_t     cmd;
     uint8_t     atyp;
-    std::string host;       // For ATYP_DOMAIN or string form of IP
+    std::string host;       // ATYP_DOMAIN only
     uint8_t     ipv4[4];    // For ATYP_IPV4
     uint8_t     ipv6[16];   // For ATYP_IPV6
     uint16_t    port;
@@ -58,6 +60,19 @@ ByteBuffer BuildConnectReply(uint8_t reply_code,
                              const uint8_t* bind_addr = nullptr,
                              uint16_t bind_port = 0);
 
+// Fills `out` (port included) for an ATYP_IPV4 / ATYP_IPV6 request and
+// returns its length; returns 0 for a domain, which needs resolving.
+int ToSockaddr(const ConnectRequest& req, sockaddr_storage& out);
+
+// The CONNECT a client would send for host:port — an address literal as
+// ATYP_IPV4 / ATYP_IPV6, anything else as a domain.  Used for fixed-target
+// forwards, which have no client request.
+ConnectRequest MakeConnectRequest(const std::string& host, uint16_t port);
+
+// Writes "host:port" ("[v6]:port" for IPv6) into buf, NUL-terminated and
+// truncated to fit.  Returns the length written.
+size_t FormatTarget(const ConnectRequest& req, char* buf, size_t cap);
+
 // Map a Windows socket error to a SOCKS5 reply code.
 uint8_t ErrorCodeToSocks5Reply(ErrorCode ec);
 
@@ -1,42 +1,103 @@
 #pragma once
 #include "common.h"
+#include "admission.h"
 #include "ssh_channel.h"
 #include "tcp_connection.h"
 #include "socks5_handler.h"
+#include "session_pool.h"
+#include "../public/ssh_proxy.h"
 #include <atomic>
 #include <memory>
+#include <string>
 #include <vector>
 
+// Per-session relay tuning.  Defaults match ConnectionConfig.
+struct RelayOptions {
+    // Flow-control thresholds (bytes queued towards the other side).
+    size_t high_watermark      = 1024 * 1024;
+    size_t low_watermark       = 256 * 1024;
+    // Adaptive read size, both directions (WSARecv from the target and
+    // channel reads in PumpSshRead).
+    size_t recv_min            = TcpConnection::kDefaultRecvMin;
+    size_t recv_max            = TcpConnection::kDefaultRecvMax;
+    // Cap on one gathered WSASend towards the target.
+    size_t send_batch_bytes    = TcpConnection::kDefaultSendBatchBytes;
+    size_t send_batch_segments = TcpConnection::kDefaultSendBatchSegments;
+};
+
 // Socks5Session manages one forwarded-tcpip channel end-to-end:
 //   SOCKS5 handshake (over IChannel) → async TCP connect → bidirectional relay.
+// With a fixed target (SetFixedTarget) there is no handshake: the session
+// is a plain relay to that target, for fixed host:port remote forwards.
 //
 // Lifetime: created on the SSH I/O thread when a channel is accepted;
-// destroyed when both sides have closed.
+// destroyed when both relay directions have ended (EOF each way) or either
+// side failed.
 class Socks5Session : public std::enable_shared_from_this<Socks5Session> {
 public:
-    explicit Socks5Session(std::unique_ptr<IChannel> channel);
+    explicit Socks5Session(std::unique_ptr<IChannel> channel,
+                           RelayOptions options = {});
+    Socks5Session(std::unique_ptr<IChannel> channel,
+                  std::shared_ptr<TcpConnection> tcp,
+                  RelayOptions options);
     ~Socks5Session();
 
+    // The session and its TcpConnection, both carved from one block of
+    // `pool` (see SessionPool) instead of two heap allocations.
+    static std::shared_ptr<Socks5Session> Create(std::unique_ptr<IChannel> channel,
+                                                 RelayOptions options,
+                                                 SessionPool& pool);
+
     Socks5Session(const Socks5Session&) = delete;
     Socks5Session& operator=(const Socks5Session&) = delete;
 
+    // The session's AdmissionControl decision, before Start().  A refused
+    // ticket fails the CONNECT with REP_GENERAL_FAILURE; an admitted one
+    // also claims the destination's slot at CONNECT time.  Without a call
+    // the session is admitted with no limits.
+    void SetAdmission(AdmissionTicket ticket) { m_admission = std::move(ticket); }
+
+    // Makes the session a raw relay to `target`, before Start(): Start()
+    // connects at once and every channel byte is client data.  Nothing is
+    // ever written to the channel but target data — a refused admission or
+    // failed connect just closes it.
+    void SetFixedTarget(Socks5::ConnectRequest target);
+
     // Called on the SSH I/O thread once the session is set up.
-    // Currently a no-op: the full lifecycle (handshake through relay) is driven
-    // non-blocking by PumpSshRead(). Kept for call-site clarity.
+    // Arms the relay watermarks on both legs; the rest of the lifecycle
+    // (handshake through relay) is driven non-blocking by PumpSshRead().
+    // A fixed-target session starts its connect here.
     void Start();
 
-    // Called by the SSH I/O thread on every loop iteration.
+    // Called by the SSH I/O thread whenever the channel has inbound data or EOF
+    // pending.  From Connecting on, client data goes straight to the target's
+    // send queue; a client EOF half-closes the target instead of ending the
+    // session.
     // Drives the full session lifecycle: SOCKS5 handshake (ReadingMethods /
     // ReadingRequest) and bidirectional relay (Relaying) without blocking.
     // Returns false when the session is done (pump will be deregistered).
     bool PumpSshRead();
 
+    // Load counters for the metrics API (see ssh_proxy::SessionStats).
+    // Thread-safe; the counters are relaxed atomics with a single writer each.
+    struct Stats {
+        ssh_proxy::SessionState state = ssh_proxy::SessionState::Handshake;
+        std::string             target;
+        uint64_t                bytes_to_target    = 0;
+        uint64_t                bytes_to_client    = 0;
+        uint32_t                connect_latency_us = 0;
+        uint64_t                queued_to_target   = 0;
+        uint64_t                queued_to_client   = 0;
+    };
+    Stats GetStats() const;
+
 private:
     // State machine transitions:
     //
     //   ReadingMethods → ReadingRequest → Connecting → Relaying → Closed
     //                                                              ↑
-    //                       error or EOF at any phase ────────────┘
+    //       error at any phase, EOF during the handshake ─────────┤
+    //       EOF in both directions (Connecting / Relaying) ───────┘
     enum class State {
         ReadingMethods,
         ReadingRequest,
@@ -45,17 +106,37 @@ private:
         Closed,
     };
 
-    void OnChannelData(const uint8_t* data, size_t len);
+    void OnChannelData(PooledBuffer data);
 
-    void HandleMethodNegotiation(const uint8_t* data, size_t len);
-    void HandleConnectRequest(const uint8_t* data, size_t len);
-    void StartTcpConnect(const Socks5::ConnectRequest& req);
+    // Each handler consumes its message from the front of `data` and leaves
+    // it untouched while the message is incomplete.
+    void HandleMethodNegotiation(PooledBuffer& data);
+    void HandleConnectRequest(PooledBuffer& data);
+    bool Admit(const Socks5::ConnectRequest& req);   // false: refused and closed
+    void StartTcpConnect(Socks5::ConnectRequest req);
     void OnTcpConnected(ErrorCode ec);
     void StartRelay();
+    void RelayToTarget(PooledBuffer data);
+    void OnClientEof();
+    void EndLeg();   // one relay direction has ended; the second closes the session
     void Close();
 
     std::unique_ptr<IChannel>           m_channel;
     std::shared_ptr<TcpConnection>      m_tcp;
     std::atomic<State>         m_state{State::ReadingMethods};
-    std::vector<uint8_t>       m_inbound_buf;   // data from SSH channel
+    std::vector<uint8_t>       m_inbound_buf;   // a handshake message split across reads
+    RelayOptions               m_options;
+    RecvSizer                  m_ssh_read_sizer;  // PumpSshRead (I/O thread)
+    bool                       m_client_eof = false;   // (I/O thread) target half-closed
+    std::atomic<int>           m_legs_open{2};         // relay directions not yet ended
+    AdmissionTicket            m_admission;            // released by Close()
+    bool                       m_fixed = false;        // SetFixedTarget: no SOCKS replies
+
+    // Stats.  m_request is written once, before the Connecting state is
+    // published, and read only by GetStats() callers that observed it.
+    Socks5::ConnectRequest     m_request{};
+    int64_t                    m_connect_started = 0;   // QPC ticks
+    std::atomic<uint64_t>      m_bytes_to_target{0};    // written on the I/O thread
+    std::atomic<uint64_t>      m_bytes_to_client{0};    // written by the TCP recv loop
+    std::atomic<uint32_t>      m_connect_latency_us{0};
 };
@@ -0,0 +1,50 @@
+#pragma once
+#include "common.h"
+#include "../public/ssh_proxy.h"
+#include <memory>
+#include <string>
+
+// A private key file's contents, read once per process (SshKeyCache) and
+// shared by every transport that authenticates with it.
+struct SshPrivateKey {
+    std::string path;
+    std::string pem;          // file contents: OpenSSH or PEM private key
+    std::string passphrase;   // empty for an unencrypted key
+};
+
+// SshKeyCache — process-wide private keys, keyed by path and passphrase.
+//
+// Load() reads the file on first use and hands out the same immutable key
+// to every later caller, so every transport of a Connect, its reconnects and each
+// DirectForward authenticate from memory without touching the disk.
+// Failed reads are not cached: a key that appears later is picked up.
+class SshKeyCache {
+public:
+    static Result Load(const std::string& path, const std::string& passphrase,
+                       std::shared_ptr<const SshPrivateKey>& key);
+
+    static size_t Size();
+    static void   Clear();   // tests only
+};
+
+// How SshTransport::Connect authenticates.  The configured methods are tried
+// in the order agent → public key → password; with more than one, the
+// server's userauth list decides which are attempted at all.
+struct SshAuth {
+    std::string                           username;
+    std::string                           password;     // empty: no password auth
+    std::shared_ptr<const SshPrivateKey>  key;          // null: no public-key auth
+    bool                                  use_agent = false;   // Pageant / OpenSSH agent
+
+    bool HasMethod() const { return use_agent || key != nullptr || !password.empty(); }
+};
+
+// Authenticates a session that has completed its handshake.  Blocking mode
+// expected.  On failure Result::what() names the methods that were tried.
+Result SshAuthenticate(LIBSSH2_SESSION* session, const SshAuth& auth);
+
+// Builds the SshAuth for username/password plus the public options, loading
+// the key through SshKeyCache.  Fails if the key cannot be read or no method
+// is configured at all.
+Result MakeSshAuth(const std::string& username, const std::string& password,
+                   const ssh_proxy::AuthOptions& options, SshAuth& auth);
@@ -1,5 +1,6 @@
 #pragma once
 #include "common.h"
+#include "buffer_pool.h"
 #include <atomic>
 #include <functional>
 #include <vector>
@@ -18,14 +19,45 @@ public:
     // the write is queued for the SSH I/O thread to drain.
     virtual ErrorCode Write(const uint8_t* buf, size_t len) = 0;
 
-    // Signal EOF on the write side (half-close). Thread-safe.
+    // Write a pooled buffer, handing over ownership.  Implementations that
+    // queue can keep the buffer instead of copying it.  Default: Write().
+    virtual ErrorCode WriteBuffer(PooledBuffer buf)
+    {
+        return buf.empty() ? ErrorCode::Success : Write(buf.data(), buf.size());
+    }
+
+    // Signal EOF on the write side (half-close). Thread-safe.  Data written
+    // before the call is delivered ahead of the EOF.
     virtual void SendEof() = 0;
 
-    // Close the channel. Thread-safe.
+    // Close the channel. Thread-safe.  Data written before the call is still
+    // delivered; reads fail from here on.
     virtual void Close() = 0;
 
     // True if the remote side has sent EOF.
     virtual bool IsEof() const = 0;
+
+    // Tell the transport whether this channel should be pumped when inbound
+    // data arrives.  Sessions switch interest off while they cannot consume
+    // channel data (e.g. waiting for the target TCP connect) so the I/O thread
+    // skips them entirely.  Thread-safe.  Default: no-op (test doubles).
+    virtual void SetReadInterest(bool /*wanted*/) {}
+
+    // Flow control for data accepted by Write() but not yet handed to the
+    // wire.  Once more than `high` bytes are queued, IsWriteBacklogged()
+    // reports true (Write() still accepts data); on_drained fires once the
+    // backlog falls to `low` bytes or fewer.  Call once, on the SSH I/O
+    // thread, before the first cross-thread Write().  Default: no-op — test
+    // doubles and synchronous channels never report a backlog.
+    virtual void SetWriteWatermarks(size_t /*high*/, size_t /*low*/,
+                                    std::function<void()> /*on_drained*/) {}
+
+    // True while the write backlog is above the high watermark.  Thread-safe.
+    virtual bool IsWriteBacklogged() const { return false; }
+
+    // Bytes accepted by Write() and not yet handed to the wire.  Thread-safe;
+    // for metrics only.  Default: 0.
+    virtual size_t WriteBacklogBytes() const { return 0; }
 };
 
 // Concrete implementation wrapping a LIBSSH2_CHANNEL*.
@@ -34,25 +66,49 @@ public:
 // thread. Write/SendEof/Close are thread-safe: when ThreadingHooks are provided
 // (set by SshTransport when accepting a channel), calls arriving from IOCP worker
 // threads are marshalled back to the I/O thread via queues instead of touching
-// libssh2 directly.
+// libssh2 directly.  Writes are queued from every thread, the I/O thread
+// included, so a full channel window never blocks the caller; SendEof and
+// Close are carried out behind the writes already queued.
 class SshChannel : public IChannel {
 public:
     // Posts write data to the SSH I/O thread's per-channel queue.
-    using PostWriteFn  = std::function<void(std::vector<uint8_t>)>;
+    using PostWriteFn  = std::function<void(PooledBuffer)>;
     // Posts an arbitrary callback to run on the SSH I/O thread.
     using PostIoFn     = std::function<void(std::function<void()>)>;
-    // Called synchronously at the start of Close(), before channel_free is posted.
-    // Used by SshTransport to remove the channel from the write queue while it is
-    // still valid, preventing DrainWriteQueues from writing to a freed channel.
-    using PreCloseFn   = std::function<void(LIBSSH2_CHANNEL*)>;
+    // Queues CHANNEL_EOF behind the writes already posted.
+    using SendEofFn    = std::function<void()>;
+    // Hands the channel over to be closed and freed on the SSH I/O thread
+    // once its queued writes (and a requested EOF) are on the wire.  Called
+    // by Close() after the channel pointer has been cleared, so nothing on
+    // the SshChannel side can touch it again.
+    using CloseFn      = std::function<void()>;
+    // Updates the transport's scheduling state for this channel.  Always
+    // invoked on the SSH I/O thread (SshChannel marshals via post_io).
+    using ReadInterestFn = std::function<void(bool)>;
+    // Arms the transport's write-backlog watermarks for this channel.
+    using WriteWatermarksFn = std::function<void(size_t, size_t, std::function<void()>)>;
+    // Reports whether the transport's write backlog is above the high mark.
+    using WriteBackloggedFn = std::function<bool()>;
+    // Reports the transport's write backlog in bytes.
+    using WriteBacklogBytesFn = std::function<size_t()>;
+    // Reports whether the transport failed a write on this channel (I/O
+    // thread only).  Read() then fails as well, so a half-closed session
+    // learns that the peer is gone instead of relaying into a dead channel.
+    using WriteFailedFn = std::function<bool()>;
 
     // Transport-internal thread-marshalling hooks — grouped as a single parameter
     // so callers read them as one "transport plumbing" concern rather than three
     // independent callbacks.
     struct ThreadingHooks {
-        PostWriteFn post_write;
-        PostIoFn    post_io;
-        PreCloseFn  pre_close;
+        PostWriteFn         post_write;
+        PostIoFn            post_io;
+        SendEofFn           send_eof;
+        CloseFn             close;
+        ReadInterestFn      read_interest;
+        WriteWatermarksFn   write_watermarks;
+        WriteBackloggedFn   write_backlogged;
+        WriteBacklogBytesFn write_backlog_bytes;
+        WriteFailedFn       write_failed;
     };
 
     explicit SshChannel(LIBSSH2_CHANNEL* ch, ThreadingHooks hooks = {});
@@ -63,11 +119,20 @@ public:
 
     ErrorCode Read(uint8_t* buf, size_t len, size_t& bytes_read) override;
     ErrorCode Write(const uint8_t* buf, size_t len) override;
+    ErrorCode WriteBuffer(PooledBuffer buf) override;
     void SendEof() override;
     void Close() override;
     bool IsEof() const override;
+    void SetReadInterest(bool wanted) override;
+    void SetWriteWatermarks(size_t high, size_t low,
+                            std::function<void()> on_drained) override;
+    bool IsWriteBacklogged() const override;
+    size_t WriteBacklogBytes() const override;
 
 private:
+    // Writes straight to libssh2; only for channels without hooks.
+    ErrorCode WriteDirect(const uint8_t* buf, size_t len);
+
     std::atomic<LIBSSH2_CHANNEL*> m_channel;
     ThreadingHooks                m_hooks;
 };
@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <string>
 #include <stdexcept>
+#include <vector>
 #include "../public/ssh_proxy.h"
 
 // Internal configuration struct — NOT part of the public API.
@@ -16,6 +17,59 @@ struct ConnectionConfig {
     uint16_t             forward_port           = 1080;
     ssh_proxy::LogLevel  log_level              = ssh_proxy::LogLevel::Info;
 
+    // Independent SSH transports; transport i forwards forward_port + i.
+    uint32_t             transport_count         = 1;
+
+    // Per-session relay flow control, applied in both directions.  A side
+    // stops being read once more than relay_high_watermark bytes are queued
+    // towards the other side, and resumes at relay_low_watermark or below.
+    uint32_t             relay_high_watermark   = 1024 * 1024;
+    uint32_t             relay_low_watermark    = 256 * 1024;
+
+    // Relay read size, per session and direction: starts at recv_buffer_min
+    // and doubles towards recv_buffer_max while reads keep filling the buffer.
+    // Set both equal for a fixed size.
+    uint32_t             recv_buffer_min         = 4 * 1024;
+    uint32_t             recv_buffer_max         = 64 * 1024;
+
+    // Cap on one scatter/gather WSASend towards a target: queued buffers are
+    // coalesced up to this many bytes / WSABUF segments per syscall.
+    uint32_t             send_batch_max_bytes    = 256 * 1024;
+    uint32_t             send_batch_max_segments = 16;
+
+    // Target name resolution cache (process-wide).  Successful lookups are
+    // reused for dns_cache_ttl_ms, "host not found" answers for
+    // dns_negative_ttl_ms; zero disables that kind of caching.  A lookup
+    // still unanswered after dns_timeout_ms is abandoned and fails its
+    // waiters (0 = wait for the system resolver however long it takes).
+    uint32_t             dns_cache_ttl_ms        = 60000;
+    uint32_t             dns_negative_ttl_ms     = 5000;
+    uint32_t             dns_cache_max_entries   = 256;
+    uint32_t             dns_timeout_ms          = 10000;
+
+    // Re-establishing dropped transports (ssh_proxy::ReconnectPolicy).
+    bool                 reconnect_enabled            = false;
+    uint32_t             reconnect_initial_backoff_ms = 500;
+    uint32_t             reconnect_max_backoff_ms     = 30000;
+    bool                 hot_standby                  = false;
+
+    // KEX / host key / cipher / MAC / compression preferences; empty lists
+    // select the performance profile (ssh_methods.cpp).
+    ssh_proxy::SshAlgorithms ssh_algorithms;
+
+    // Pre-connected and recycled target sockets (process-wide, WarmSockets).
+    ssh_proxy::WarmConnectOptions warm;
+    // IoEngine worker count and affinity (process-wide, the first Init applies).
+    ssh_proxy::IoThreadOptions    io_threads;
+    // Accept-path session, rate and per-destination limits (AdmissionControl).
+    ssh_proxy::AdmissionLimits    admission;
+    // Further remote ports per transport, SOCKS5 or fixed target.
+    std::vector<ssh_proxy::RemoteForward> forwards;
+
+    static constexpr uint32_t kMaxTransports = 64;
+    static constexpr uint32_t kMaxIoWorkers  = 256;
+    static constexpr size_t   kMaxForwards   = 16;
+
     // Validate fields that would cause silent failures later.
     // Throws std::runtime_error with a descriptive message on bad input.
     void validate() const
@@ -28,7 +82,62 @@ struct ConnectionConfig {
             throw std::runtime_error("username must not be empty");
         if (forward_port == 0)
             throw std::runtime_error("forward_port must not be zero");
+        if (transport_count == 0 || transport_count > kMaxTransports)
+            throw std::runtime_error("transport_count must be between 1 and 64");
+        if (static_cast<uint32_t>(forward_port) + transport_count - 1 > 65535)
+            throw std::runtime_error("forward_port range exceeds 65535");
         if (connect_timeout_ms == 0)
             throw std::runtime_error("connect_timeout_ms must not be zero");
+        if (relay_high_watermark == 0)
+            throw std::runtime_error("relay_high_watermark must not be zero");
+        if (relay_low_watermark >= relay_high_watermark)
+            throw std::runtime_error("relay_low_watermark must be below relay_high_watermark");
+        if (recv_buffer_min == 0 || recv_buffer_max < recv_buffer_min)
+            throw std::runtime_error("recv_buffer_min must be non-zero and not above recv_buffer_max");
+        if (send_batch_max_bytes == 0 || send_batch_max_segments == 0)
+            throw std::runtime_error("send batch limits must not be zero");
+        if (reconnect_enabled &&
+            (reconnect_initial_backoff_ms == 0 ||
+             reconnect_max_backoff_ms < reconnect_initial_backoff_ms))
+            throw std::runtime_error("reconnect backoff must be non-zero and not above its maximum");
+        if (warm.per_target > 0 && (warm.max_idle_ms == 0 || warm.max_targets == 0))
+            throw std::runtime_error("warm connections need a non-zero max_idle_ms and max_targets");
+        if (io_threads.workers > kMaxIoWorkers)
+            throw std::runtime_error("io_threads.workers must not exceed 256");
+        if (io_threads.affinity != ssh_proxy::IoAffinity::None && io_threads.io_processors == 0)
+            throw std::runtime_error("io_processors must not be zero with affinity");
+        if (admission.accept_burst != 0 && admission.accepts_per_sec == 0)
+            throw std::runtime_error("admission accept_burst requires accepts_per_sec");
+        if (hot_standby && !reconnect_enabled)
+            throw std::runtime_error("hot_standby requires reconnect to be enabled");
+        validate_forwards();
+    }
+
+    // Every forward's port range (remote_port + transport i) must fit and
+    // stay clear of forward_port's and of each other's.
+    void validate_forwards() const
+    {
+        if (forwards.size() > kMaxForwards)
+            throw std::runtime_error("at most 16 additional forwards");
+        for (size_t i = 0; i < forwards.size(); ++i)
+        {
+            const ssh_proxy::RemoteForward& f = forwards[i];
+            if (f.remote_port == 0)
+                throw std::runtime_error("forward remote_port must not be zero");
+            if (static_cast<uint32_t>(f.remote_port) + transport_count - 1 > 65535)
+                throw std::runtime_error("forward remote_port range exceeds 65535");
+            if (f.target_host.empty() != (f.target_port == 0))
+                throw std::runtime_error("forward target_host and target_port go together");
+            if (overlaps(f.remote_port, forward_port))
+                throw std::runtime_error("forward remote_port range overlaps forward_port");
+            for (size_t j = 0; j < i; ++j)
+                if (overlaps(f.remote_port, forwards[j].remote_port))
+                    throw std::runtime_error("forward remote_port ranges overlap");
+        }
+    }
+
+    bool overlaps(uint16_t a, uint16_t b) const
+    {
+        return static_cast<uint32_t>(a < b ? b - a : a - b) < transport_count;
     }
 };
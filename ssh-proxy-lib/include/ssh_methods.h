@@ -0,0 +1,30 @@
+#pragma once
+#include "common.h"
+#include "../public/ssh_proxy.h"
+#include <string>
+#include <vector>
+
+// The methods a session settled on during its key exchange.  Directional
+// methods read "client-to-server/server-to-client" when the two differ.
+struct SshNegotiated {
+    std::string kex;
+    std::string host_key;
+    std::string cipher;
+    std::string mac;
+    std::string compression;
+};
+
+// Sets the KEX, host key, cipher, MAC and compression preferences on a
+// session before its handshake — see ssh_methods.cpp for the default
+// profile.  Fails if a list given in `algorithms` names no method this
+// libssh2 build supports.
+Result ApplySshAlgorithms(LIBSSH2_SESSION* session, const ssh_proxy::SshAlgorithms& algorithms);
+
+// Reads what the completed handshake negotiated.
+SshNegotiated ReadSshNegotiated(LIBSSH2_SESSION* session);
+
+// `preferred` (comma-separated) followed by every name in `supported` it does
+// not already contain, in supported's order.  The default profile's list:
+// its methods come first, nothing libssh2 could negotiate is taken away.
+std::string MergeMethodPreference(const std::string& preferred,
+                                  const std::vector<std::string>& supported);
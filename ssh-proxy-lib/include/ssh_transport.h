@@ -1,29 +1,45 @@
 #pragma once
 #include "common.h"
+#include "ssh_auth.h"
 #include "ssh_channel.h"
+#include "ssh_methods.h"
+#include "socket_ops.h"
+#include "mpsc_queue.h"
+#include <deque>
 #include <functional>
 #include <memory>
 #include <string>
 #include <thread>
 #include <atomic>
 #include <mutex>
-#include <deque>
 #include <vector>
 
 // SshTransport owns the full SSH connection lifecycle:
-//   TCP connect → SSH handshake → auth → tcpip-forward request → channel-accept loop.
+//   TCP connect → SSH handshake → auth → tcpip-forward requests → channel-accept loop.
+// One session can listen on several remote ports; the accept loop serves all
+// of them and tells the callback which port each channel arrived on.
+// Without a forward it carries direct-tcpip channels opened through
+// OpenDirectChannel instead (DirectForward), or idles as a hot standby
+// until RequestForward hands it its ports.
 // All libssh2 calls happen on an internal I/O thread; this class is not thread-safe
 // for concurrent Connect/Close calls — use from a single controlling thread.
 class SshTransport {
 public:
-    // Called on every I/O thread loop iteration. Returns false when done
-    // (automatically removed from the pump list).
+    // Called on the I/O thread when the session's channel has inbound data or
+    // EOF pending (or right after registration / re-enabled read interest).
+    // Returns false when done (automatically removed from the pump list).
     using SessionPumpFn     = std::function<bool()>;
 
-    // Fires on the SSH I/O thread for each inbound forwarded-tcpip channel.
-    // The returned SessionPumpFn (if non-null) is auto-registered as a per-iteration
-    // pump — callers do not need to call RegisterSessionPump separately.
-    using OnChannelAccepted = std::function<SessionPumpFn(std::unique_ptr<SshChannel>)>;
+    // Fires on the SSH I/O thread for each inbound forwarded-tcpip channel,
+    // with the remote port it was accepted on.
+    // The returned SessionPumpFn (if non-null) is auto-registered as the
+    // channel's pump — callers do not need to call RegisterSessionPump separately.
+    using OnChannelAccepted = std::function<SessionPumpFn(uint16_t port, std::unique_ptr<SshChannel>)>;
+
+    // Fires on the SSH I/O thread with a channel opened by OpenDirectChannel,
+    // or with nullptr if the server refused it or the session dropped first.
+    // A returned SessionPumpFn is registered like an accepted channel's.
+    using OnDirectChannel   = std::function<SessionPumpFn(std::unique_ptr<SshChannel>)>;
 
     // Fires on the SSH I/O thread when the session drops.
     using OnDisconnected    = std::function<void(ErrorCode)>;
@@ -34,64 +50,291 @@ public:
     SshTransport(const SshTransport&) = delete;
     SshTransport& operator=(const SshTransport&) = delete;
 
-    // Blocking: TCP connect + SSH handshake + password auth + tcpip-forward request.
+    // Blocking: TCP connect + SSH handshake (with the ApplySshAlgorithms
+    // preferences) + user auth (SshAuthenticate) + one tcpip-forward request
+    // per entry of forward_ports (none: no remote forward).
     // Returns Result::ok() on success; on failure Result::what() carries the reason.
     // Must be called before StartAccepting().
-    Result Connect(const std::string& host, uint16_t port,
-                   const std::string& username, const std::string& password,
-                   uint16_t forward_port, uint32_t timeout_ms,
+    Result Connect(const std::string& host, uint16_t port, const SshAuth& auth,
+                   const ssh_proxy::SshAlgorithms& algorithms,
+                   const std::vector<uint16_t>& forward_ports, uint32_t timeout_ms,
                    uint32_t keepalive_interval_ms);
 
+    // What the handshake negotiated.  Set by a successful Connect() and
+    // unchanged afterwards, so readable from any thread once the transport
+    // has been handed out.
+    const SshNegotiated& Negotiated() const { return m_negotiated; }
+
     // Spawns the I/O thread. on_channel fires for each accepted forwarded-tcpip
-    // channel; on_disconnect fires once when the session drops.
+    // channel (may be empty without a remote forward); on_disconnect fires once
+    // when the session drops.
     // Must only be called after a successful Connect().
     void StartAccepting(OnChannelAccepted on_channel, OnDisconnected on_disconnect);
 
+    // Asks the server to connect to host:port (direct-tcpip, RFC 4254 §7.2)
+    // and delivers the channel to on_open on the I/O thread.  Thread-safe;
+    // requests are opened one at a time in call order.
+    void OpenDirectChannel(std::string host, uint16_t port, OnDirectChannel on_open);
+
+    // Completion of RequestForward, on the I/O thread.
+    using OnForwardDone     = std::function<void(Result)>;
+
+    // Issues the tcpip-forward requests for `ports` on a transport that was
+    // connected without a forward and is already accepting — a hot standby
+    // taking over a dropped transport's ports.  on_channel then replaces the
+    // one given to StartAccepting.  All or nothing: the ports are listened
+    // on in order and a refusal drops those already bound.  Thread-safe;
+    // on_done fires once, with the failure if the server refused, a forward
+    // was already active or the session dropped first — except for a
+    // request that races the loop's exit, which is never run, so callers
+    // bound their wait.
+    void RequestForward(std::vector<uint16_t> ports, OnChannelAccepted on_channel,
+                        OnForwardDone on_done);
+
     // Signals the I/O thread to stop and waits for it to exit.
     // Closes the libssh2 session and the TCP socket.
     void Close();
 
     bool IsConnected() const;
 
+    // True while an SshChannel handed out by this transport still exists.
+    // Its hooks point back here, so a transport replaced after a drop must
+    // outlive them; sessions go once the loop has exited, but one that an
+    // IOCP completion is still holding lingers until that returns.
+    bool HasLiveChannels() const;
+
+    // Load counters, readable from any thread.  Bytes are channel payload
+    // (SOCKS traffic), not SSH framing; received = server → targets.
+    // channels_accepted includes direct-tcpip channels opened.  EAGAIN counts
+    // are channel reads with nothing pending and channel writes stopped by a
+    // full window or socket; drain_write_us is time spent in DrainWriteQueues.
+    // rtt_us is the kernel's RTT estimate for the SSH socket (0 = unknown).
+    struct Stats {
+        uint64_t channels_accepted  = 0;
+        uint64_t channels_open      = 0;
+        uint64_t bytes_received     = 0;
+        uint64_t bytes_sent         = 0;
+        uint64_t loop_iterations    = 0;
+        uint64_t eagain_reads       = 0;
+        uint64_t eagain_writes      = 0;
+        uint64_t drain_write_us     = 0;
+        uint32_t drain_write_us_max = 0;
+        uint32_t rtt_us             = 0;
+    };
+    Stats GetStats() const;
+
 private:
     void IoThreadProc(OnChannelAccepted on_channel, OnDisconnected on_disconnect);
-    void DrainWriteQueues();
-    void DrainIoCallbacks();
-    void PumpSessions();
 
-    // Post data to a channel's write queue (thread-safe — called from IOCP threads).
-    void PostChannelWrite(LIBSSH2_CHANNEL* ch, std::vector<uint8_t> data);
+    // Blocks until the SSH socket is readable/writable/closed, work is posted
+    // via PostChannelWrite/PostToIoThread, or timeout_ms elapses.
+    // Sets peer_closed if the peer closed the connection.
+    void WaitForWork(DWORD timeout_ms, bool& peer_closed);
+
+    // Each returns true if it did any work (so the loop should not block).
+    bool DrainWriteQueues();
+    bool DrainIoCallbacks();
+    bool OpenPendingChannels();
+    bool ListenPending(OnChannelAccepted& on_channel);
+    bool AcceptChannels(const OnChannelAccepted& on_channel, bool& busy);   // false: session error
+    bool PumpSessions();
+
+    // End-of-iteration stats publication (I/O thread only).
+    void PublishStats(uint64_t drain_us);
+    void SampleRtt();
 
-    // Remove a channel's write queue entry (thread-safe).
-    void RemoveChannelWriteQueue(LIBSSH2_CHANNEL* ch);
+    // Drains the socket into libssh2 when there is no listener to do it.
+    // Returns false if the transport failed.
+    bool PollTransport(bool& busy);
+
+    // Wakes the I/O thread out of WaitForWork. Thread-safe.
+    void Wake();
 
     // Post a callback to run on the SSH I/O thread. Thread-safe.
     void PostToIoThread(std::function<void()> fn);
 
-    // Register a pump to be called on every I/O thread loop iteration.
+    // Per-channel state, shared with the channel's ThreadingHooks.
+    // `close_requested` is set from any thread by the close hook — the
+    // session is done, its pump goes and further posts are dropped — while
+    // the channel itself stays valid until FlushChannelWrites has written
+    // what was queued, frees it and sets `closed`.  Fields marked (I/O) are
+    // touched on the I/O thread only.
+    struct ChannelSlot {
+        LIBSSH2_CHANNEL*  channel = nullptr;
+        std::atomic<bool> close_requested{false};
+        std::atomic<bool> eof_requested{false};
+        std::atomic<bool> closed{false};
+        bool              eof_sent = false; // (I/O) CHANNEL_EOF is out
+        bool              write_failed = false;  // (I/O) reads fail from now on
+        bool              parked  = false;  // (I/O) read interest off — never pumped
+        bool              kicked  = false;  // (I/O) in m_kicked_slots — pump next round
+        size_t            pump_index = SIZE_MAX;   // (I/O) position in m_session_pumps
+
+        // Write path: producers push pooled slabs (linked through Slab::next,
+        // so posting allocates nothing) onto `writes`, then enlist the slot in
+        // m_dirty_slots if `dirty` was clear.  While enlisted, `dirty_ref`
+        // keeps the slot alive; the I/O thread moves it out when it dequeues.
+        MpscQueue<Slab>              writes;
+        std::atomic<bool>            dirty{false};
+        ChannelSlot*                 dirty_next = nullptr;
+        std::shared_ptr<ChannelSlot> dirty_ref;
+        PooledBuffer                 write_front;       // (I/O) partially written buffer
+        bool                         stalled = false;   // (I/O) in m_stalled_slots
+        bool                         queued  = false;   // (I/O) in this or the next write round
+
+        // Flow control: pending_bytes counts posted-but-unwritten bytes.
+        // A post that takes it above high_mark sets `backlogged`; the I/O
+        // thread clears it and fires on_drained once it falls to low_mark.
+        // The marks and callback are set once, before the first post.
+        std::atomic<size_t>          pending_bytes{0};
+        std::atomic<bool>            backlogged{false};
+        size_t                       high_mark = SIZE_MAX;
+        size_t                       low_mark  = 0;
+        std::function<void()>        on_drained;
+
+        ~ChannelSlot();
+    };
+
+    // Post data to a channel's write queue.  Thread-safe and lock-free —
+    // called from IOCP threads.  Discards silently once the channel closed.
+    void PostChannelWrite(const std::shared_ptr<ChannelSlot>& slot, PooledBuffer data);
+
+    // Bytes a channel may write per DrainWriteQueues round — two full SSH
+    // packets, so one bulk channel cannot hold the socket for the others.
+    static constexpr size_t kWriteQuantum = 64 * 1024;
+
+    // Writes a slot's queued buffers until empty, EAGAIN or `budget` bytes
+    // (I/O thread only).  A slot stopped by EAGAIN is parked on
+    // m_stalled_slots, one stopped by the budget on m_ready_slots.
+    bool FlushChannelWrites(const std::shared_ptr<ChannelSlot>& slot, size_t budget);
+
+    // Drops the slot's unwritten buffers, keeping pending_bytes in step.
+    static void DiscardChannelWrites(ChannelSlot& s);
+
+    // Puts the slot on m_dirty_slots (once) and wakes the I/O thread, so
+    // FlushChannelWrites visits it.  Thread-safe and lock-free.
+    void EnlistDirty(const std::shared_ptr<ChannelSlot>& slot);
+
+    // Fires on_drained if the slot was backlogged and has drained to its low
+    // watermark (I/O thread only).
+    static void NotifyIfDrained(ChannelSlot& s);
+
+    // Drops the references held by m_dirty_slots, m_stalled_slots and
+    // m_ready_slots once the I/O loop has exited.
+    void ReleaseWriteSlots();
+
+    // Wraps a new channel in a slot + SshChannel, hands it to on_channel and
+    // registers the returned pump (I/O thread only).  Accepted channels come
+    // through a wrapper that adds their port.
+    void AdoptChannel(LIBSSH2_CHANNEL* ch, const OnDirectChannel& on_channel);
+
+    struct PendingOpen {
+        std::string     host;
+        uint16_t        port  = 0;
+        OnDirectChannel on_open;
+        bool            control = false;   // PollTransport's control channel
+    };
+
+    // An active tcpip-forward and the remote port it was requested for.
+    struct Listener {
+        SshListenerPtr listener;
+        uint16_t       port = 0;
+    };
+
+    struct PendingForward {
+        std::vector<uint16_t> ports;
+        OnChannelAccepted     on_channel;
+        OnForwardDone         on_done;
+        std::vector<Listener> bound;   // ports[0 .. bound.size()) are listening
+    };
+
+    struct SessionPump {
+        std::shared_ptr<ChannelSlot> slot;
+        SessionPumpFn                fn;
+    };
+
+    // True if libssh2 already holds inbound data or EOF for the channel.
+    // No socket I/O, but it walks the session's queued packets.
+    static bool HasPendingRead(LIBSSH2_CHANNEL* ch);
+
+    // Register the pump for an accepted channel.
     // MUST be called on the SSH I/O thread.
-    void RegisterSessionPump(SessionPumpFn fn);
+    void RegisterSessionPump(std::shared_ptr<ChannelSlot> slot, SessionPumpFn fn);
+
+    // Swaps the slot's pump out of m_session_pumps (I/O thread only).
+    void RemoveSessionPump(ChannelSlot& slot);
+
+    // Puts the slot on m_kicked_slots (once), so PumpSessions runs its pump
+    // next round whatever libssh2 holds for it (I/O thread only).
+    void Kick(const std::shared_ptr<ChannelSlot>& slot);
 
-    // SSH resources — declared in this order so m_listener is destroyed before
+    // Readiness wait on m_socket, woken by Wake() when cross-thread work is
+    // posted — declared first so it outlives the socket and session.
+    SocketWaiter      m_waiter;
+
+    // SSH resources — declared in this order so m_listeners are destroyed before
     // m_session (C++ destroys members in reverse declaration order).
-    WinSocket         m_socket;
-    SshSessionPtr     m_session;
-    SshListenerPtr    m_listener;
+    WinSocket              m_socket;
+    SshSessionPtr          m_session;
+    std::vector<Listener>  m_listeners;
 
     std::thread       m_io_thread;
     std::atomic<bool> m_cancel{false};
     std::atomic<bool> m_connected{false};
+    uint32_t          m_keepalive_interval_ms = 0;
+    SshNegotiated     m_negotiated;
 
-    // Per-channel write queues: channel ptr → pending buffers
-    struct ChannelQueue {
-        LIBSSH2_CHANNEL*          channel;
-        std::deque<std::vector<uint8_t>> pending;
-    };
-    std::mutex                   m_queues_mutex;
-    std::vector<ChannelQueue>    m_write_queues;
+    // GetStats() counters.  Written by the I/O thread only; bytes and EAGAINs
+    // are accumulated thread-locally and published once per loop iteration.
+    std::atomic<uint64_t> m_channels_accepted{0};
+    std::atomic<uint64_t> m_channels_open{0};
+    std::atomic<uint64_t> m_bytes_received{0};
+    std::atomic<uint64_t> m_bytes_sent{0};
+    std::atomic<uint64_t> m_loop_iterations{0};
+    std::atomic<uint64_t> m_eagain_reads{0};
+    std::atomic<uint64_t> m_eagain_writes{0};
+    std::atomic<uint64_t> m_drain_write_us{0};
+    std::atomic<uint32_t> m_drain_write_us_max{0};
+    std::atomic<uint32_t> m_rtt_us{0};
+
+    // Channels with newly posted writes: a lock-free intrusive stack.
+    // Producers CAS-push; the I/O thread takes the whole list with one
+    // exchange, so there is no ABA hazard and no lock around libssh2 calls.
+    std::atomic<ChannelSlot*>                  m_dirty_slots{nullptr};
+
+    // Channels whose last flush stopped on EAGAIN, channels that used up
+    // their quantum and still have data, and the round being drained
+    // (I/O thread only).
+    std::vector<std::shared_ptr<ChannelSlot>>  m_stalled_slots;
+    std::vector<std::shared_ptr<ChannelSlot>>  m_ready_slots;
+    std::vector<std::shared_ptr<ChannelSlot>>  m_write_round;
+
+    // Session pumps, at their slot's pump_index; the slots PumpSessions
+    // runs next — kicked, or found data or EOF for by the read scan — and
+    // the round being run.  The scan: the socket read count it last saw,
+    // the pumps its pass has still to check, and where it resumes
+    // (I/O thread only).
+    std::vector<SessionPump>                   m_session_pumps;
+    std::vector<std::shared_ptr<ChannelSlot>>  m_kicked_slots;
+    std::vector<std::shared_ptr<ChannelSlot>>  m_pump_round;
+    uint64_t                                   m_reads_at_scan = UINT64_MAX;
+    size_t                                     m_scan_left     = 0;
+    size_t                                     m_scan_cursor   = 0;
+
+    // direct-tcpip opens not yet completed; the head is in flight (I/O thread only).
+    std::deque<PendingOpen>      m_pending_opens;
+
+    // The session channel PollTransport reads through, and whether the
+    // server refused the last open of it (I/O thread only).
+    LIBSSH2_CHANNEL*             m_control_channel = nullptr;
+    bool                         m_control_refused = false;
+
+    // RequestForward in flight, retried until it stops returning EAGAIN
+    // (I/O thread only).
+    std::unique_ptr<PendingForward> m_pending_forward;
 
-    // Session pumps: driven by I/O thread each loop iteration (I/O thread only).
-    std::vector<SessionPumpFn>   m_session_pumps;
+    // One copy per live SshChannel (captured by its hooks); see HasLiveChannels.
+    std::shared_ptr<int>         m_channel_refs = std::make_shared<int>(0);
 
     // Callbacks posted from IOCP threads to run on the I/O thread.
     std::mutex                           m_io_callbacks_mutex;
@@ -1,21 +1,28 @@
 #pragma once
 #include "common.h"
 #include "async_io.h"
+#include "buffer_pool.h"
+#include "dns_resolver.h"
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
-#include <queue>
+#include <vector>
 
-// Async outbound TCP connection to a target host.
+// Async TCP connection: outbound to a target host (ConnectAsync), or an
+// accepted local caller taken over with Adopt().
 //
 // Lifetime: always heap-allocated via std::make_shared<TcpConnection>().
 // IoContext callbacks capture shared_ptr<TcpConnection> so the object stays
-// alive until all pending IOCP completions have been processed.
+// alive until all pending IoEngine completions have been processed.
 class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 public:
     using OnConnected    = std::function<void(ErrorCode)>;
-    using OnDataReceived = std::function<void(const uint8_t*, size_t)>;
+    // Receives ownership of the pooled buffer the recv filled.
+    using OnDataReceived = std::function<void(PooledBuffer)>;
+    // Success: the peer sent FIN (our send side stays open).  Otherwise the
+    // error that ended the recv loop.
     using OnDisconnected = std::function<void(ErrorCode)>;
 
     TcpConnection();
@@ -24,42 +31,167 @@ public:
     TcpConnection(const TcpConnection&) = delete;
     TcpConnection& operator=(const TcpConnection&) = delete;
 
-    // Post DNS resolution + async connect to an IOCP worker thread.
+    // Async DNS resolution (DnsResolver) + async connect.
     // Fire-and-forget: returns immediately; all results arrive via on_connected callback.
+    // A warm socket for the destination (WarmSockets) replaces both.
     void ConnectAsync(const std::string& host, uint16_t port, OnConnected on_connected);
 
-    // Start async reads. Data delivered via on_data on IOCP threads.
+    // Connect to an address literal (port set): skips DnsResolver entirely.
+    // on_connected still fires on an IoEngine worker thread.
+    void ConnectAsync(const ResolvedAddress& target, OnConnected on_connected);
+
+    // Marks a pre-connect made on behalf of WarmSockets: ConnectAsync does
+    // not look for a warm socket.  Call before ConnectAsync.
+    void SetWarmup() { m_warmup = true; }
+
+    // Hands the connected socket over (WarmSockets) and leaves the object
+    // closed without touching it.  `family` receives its address family.
+    SOCKET Detach(int& family);
+
+    // Takes ownership of an already-connected socket (e.g. from AcceptEx)
+    // instead of ConnectAsync: associates it with IoEngine and marks the
+    // connection established.  The socket is closed on failure.
+    ErrorCode Adopt(SOCKET connected);
+
+    // Start async reads. Data delivered via on_data on IoEngine workers.
+    // on_disconnect gets Success for the peer's FIN, or the first error of
+    // either direction — a failed send reports too, once, on a worker.
     void StartReading(OnDataReceived on_data, OnDisconnected on_disconnect);
 
-    // Async send. Data is queued and sent in order.
+    // Async send. Data is queued and sent in order.  The PooledBuffer
+    // overload queues the buffer itself; the pointer overload copies once.
+    // May be called while ConnectAsync is still in flight: the data waits in
+    // the queue and goes out as soon as the connect completes.
+    ErrorCode Send(PooledBuffer data);
     ErrorCode Send(const uint8_t* data, size_t len);
 
+    // Half-close: once everything queued has been sent, shutdown(SD_SEND)
+    // sends the peer a FIN; reading goes on.  on_done fires once, on the
+    // calling or a worker thread — Success after the FIN, or the error that
+    // failed a send first.  Not fired if Close() comes first.  Later Send()
+    // calls fail.  Thread-safe.
+    using OnSendShutdown = std::function<void(ErrorCode)>;
+    void ShutdownSend(OnSendShutdown on_done);
+
+    // Stop / restart the recv loop without closing.  While paused, the
+    // completion in flight (if any) is still delivered but the recv is not
+    // reposted.  Both are thread-safe and idempotent.
+    void PauseReading();
+    void ResumeReading();
+
+    // Send-queue flow control.  Once more than `high` bytes are queued,
+    // IsSendBacklogged() reports true (Send() still accepts data); on_drained
+    // fires on a worker thread once the queue falls to `low` bytes or fewer.
+    // Call before the first Send().
+    void SetSendWatermarks(size_t high, size_t low, std::function<void()> on_drained);
+    bool IsSendBacklogged() const { return m_send_backlogged.load(); }
+
+    // Bytes accepted by Send() and not yet taken by the kernel.  Thread-safe;
+    // for metrics only (relaxed, may lag the queue slightly).
+    size_t SendQueuedBytes() const { return m_send_queued_depth.load(std::memory_order_relaxed); }
+
+    // Bounds the adaptive recv size (see RecvSizer).  Call before
+    // StartReading().
+    void SetRecvSizeLimits(size_t min_bytes, size_t max_bytes);
+
+    // Caps one gathered send at max_bytes / max_segments buffers.
+    // Call before the first Send().
+    void SetSendBatchLimits(size_t max_bytes, size_t max_segments);
+
+    static constexpr size_t kDefaultRecvMin           = 4 * 1024;
+    static constexpr size_t kDefaultRecvMax           = 64 * 1024;
+    static constexpr size_t kDefaultSendBatchBytes    = 256 * 1024;
+    static constexpr size_t kDefaultSendBatchSegments = 16;
+
+    // RFC 8305 "Connection Attempt Delay": the next address is tried once the
+    // current attempt has failed or has been pending this long.
+    static constexpr DWORD  kConnectAttemptDelayMs    = 250;
+
     // Close the connection.
     void Close();
 
     SOCKET GetSocket() const { return m_socket; }
 
 private:
-    // Runs on an IOCP worker thread: DNS + socket setup + ConnectEx.
-    void DoConnectOnWorkerThread(std::string host, uint16_t port);
+    // One in-flight connect of the happy-eyeballs race.  Owns its socket
+    // until it either wins (the socket moves to m_socket) or is closed.
+    struct ConnectAttempt {
+        IoContext       ctx;
+        SOCKET          socket = INVALID_SOCKET;
+        ResolvedAddress target;
+        int64_t         started = 0;   // QPC when the connect was started
+    };
+
+    // Opens a new socket for StartConnect and disables Nagle on it.
+    static SOCKET OpenConnectSocket(int family, ErrorCode& error);
+    // Takes a warm socket in place of a connect (on a worker thread).
+    void UseWarmSocket(SOCKET warm, int family);
+    // Flushes data and a half-close queued while connecting.
+    void FlushAfterConnect();
+    // Runs on a worker thread with the DNS result: orders the
+    // addresses and starts the first connect attempt.
+    void OnResolved(const std::string& host, uint16_t port, ErrorCode dns_ec,
+                    std::shared_ptr<const AddressList> addresses);
+    // Starts attempts until one is pending or the addresses run out.
+    // Returns true if the connect has failed.  Caller holds m_connect_mutex.
+    bool StartNextAttempt();
+    void OnAttemptDelay(size_t attempts_at_schedule);
+    void OnAttemptComplete(ConnectAttempt* attempt, ErrorCode ec);
+    // Closes every attempt socket except `keep`.  Caller holds m_connect_mutex.
+    void CloseAttempts(const ConnectAttempt* keep);
     void PostRecv();
     void OnRecvComplete(IoContext* ctx, DWORD bytes, ErrorCode ec);
     void FlushSendQueue();
     void OnSendComplete(IoContext* ctx, DWORD bytes, ErrorCode ec);
+    // Ends the send side on its first error: drops the queue, resets the
+    // depth and backlog, posts the error to on_disconnect.  Caller holds
+    // m_send_mutex.
+    void FailSends(ErrorCode ec);
+    void PostSendFailure(ErrorCode ec);
+    void NotifyDisconnect(ErrorCode ec);
+    // Sends the FIN once a requested shutdown has nothing left to wait for,
+    // and hands back on_done with its result for the caller to invoke
+    // outside the lock.  Caller holds m_send_mutex.
+    OnSendShutdown TakeSendShutdown(ErrorCode& result);
 
     SOCKET                m_socket;
+    int                   m_family     = AF_UNSPEC;
+    bool                  m_warmup     = false;
+    bool                  m_recyclable = false;   // connected by us: WarmSockets::Recycle may take it
     std::atomic<bool>     m_connected{false};
     std::atomic<bool>     m_reading{false};
-    std::atomic<bool>     m_abort{false};   // set by Close(); guards DoConnectOnWorkerThread
+    std::atomic<bool>     m_abort{false};   // set by Close(); guards OnResolved
+    std::atomic<bool>     m_recv_paused{false};
+    std::atomic<bool>     m_recv_parked{false};  // paused with no recv outstanding
+    std::atomic<bool>     m_disconnect_failed{false};   // an error went to on_disconnect
 
-    IoContext             m_dns_ctx;        // work item: DNS + connect setup on worker thread
-    IoContext             m_connect_ctx;
+    std::mutex            m_connect_mutex;
+    std::vector<ResolvedAddress> m_targets;       // interleaved by family, port set
+    size_t                m_next_target = 0;
+    std::vector<std::unique_ptr<ConnectAttempt>> m_attempts;   // kept until destruction
+    size_t                m_attempts_pending = 0;
+    bool                  m_connect_done = false;   // on_connected delivered or about to be
+    ErrorCode             m_connect_error = ErrorCode::ConnectionRefused;   // last failure
     IoContext             m_recv_ctx;
+    PooledBuffer          m_recv_buf;       // target of the outstanding recv
+    RecvSizer             m_recv_sizer{ kDefaultRecvMin, kDefaultRecvMax };
     IoContext             m_send_ctx;
     bool                  m_send_in_progress;
 
     std::mutex            m_send_mutex;
-    std::queue<ByteBuffer> m_send_queue;
+    std::deque<PooledBuffer> m_send_queue;
+    size_t                m_send_queued_bytes = 0;       // guarded by m_send_mutex
+    std::atomic<size_t>   m_send_queued_depth{0};        // lock-free copy for SendQueuedBytes()
+    size_t                m_send_high_mark    = SIZE_MAX;
+    size_t                m_send_low_mark     = 0;
+    std::atomic<bool>     m_send_backlogged{false};
+    std::function<void()> m_on_send_drained;
+    size_t                m_send_batch_bytes    = kDefaultSendBatchBytes;
+    size_t                m_send_batch_segments = kDefaultSendBatchSegments;
+    std::vector<IoBuffer> m_send_bufs;          // buffers of the outstanding send
+    bool                  m_send_shutdown = false;              // ShutdownSend called
+    OnSendShutdown        m_on_send_shutdown;                   // until the FIN is sent
+    ErrorCode             m_send_error = ErrorCode::Success;    // first failed send
 
     OnConnected          m_on_connected;
     OnDataReceived       m_on_data;
@@ -0,0 +1,93 @@
+#pragma once
+#include "common.h"
+#include "dns_resolver.h"
+#include <string>
+#include <unordered_map>
+
+// HotTargets — which destinations are connected to often enough to keep
+// warm.  CONNECTs are counted per window_ms window; a destination is hot
+// once its window reaches `threshold`, and stays hot through the following
+// window, so a steady stream does not cool off at each window boundary.
+// At most max_tracked destinations are counted — while full, windows that
+// have run out make room and new destinations are otherwise ignored.
+// Not thread-safe — WarmSockets serialises access.
+class HotTargets {
+public:
+    HotTargets(uint32_t threshold, uint32_t window_ms, size_t max_tracked);
+
+    void Configure(uint32_t threshold, uint32_t window_ms, size_t max_tracked);
+
+    // Counts one CONNECT to `key`; true if the destination is (now) hot.
+    bool Record(const std::string& key, uint64_t now_ms);
+
+    // True if `key` is hot in the window that contains now_ms.
+    bool IsHot(const std::string& key, uint64_t now_ms) const;
+
+    void   Clear() { m_targets.clear(); }
+    size_t size() const { return m_targets.size(); }
+
+private:
+    struct Window {
+        uint64_t started_ms = 0;
+        uint32_t connects   = 0;
+        bool     was_hot    = false;   // the previous window reached threshold
+    };
+    void Prune(uint64_t now_ms);
+
+    uint32_t m_threshold;
+    uint32_t m_window_ms;
+    size_t   m_max_tracked;
+    std::unordered_map<std::string, Window> m_targets;
+};
+
+// WarmSockets — process-wide reuse of target TCP connections (see
+// warm_sockets.cpp).  Two independent mechanisms, both off by default:
+//
+//   Warm targets     hot destinations keep up to per_target pre-connected
+//                    sockets; TcpConnection::ConnectAsync takes one instead
+//                    of resolving and connecting.
+//   Socket recycling closed target sockets go through
+//                    DisconnectEx(TF_REUSE_SOCKET) and come back bound and
+//                    IOCP-associated for the next ConnectEx of their family.
+//
+// All members are thread-safe.
+class WarmSockets {
+public:
+    struct Options {
+        uint32_t per_target   = 0;       // warm sockets per hot destination; 0 = off
+        uint32_t hot_connects = 4;       // CONNECTs within kHotWindowMs that make it hot
+        uint32_t max_idle_ms  = 10000;   // unused warm sockets are closed after this
+        uint32_t max_targets  = 16;      // destinations kept warm at once
+        bool     recycle      = false;   // DisconnectEx(TF_REUSE_SOCKET) on close
+    };
+
+    static void Configure(const Options& options);
+
+    // Destination keys: a host name (normalised as for the DNS cache) or an
+    // address literal, plus the port.
+    static std::string Key(const std::string& host, uint16_t port);
+    static std::string Key(const ResolvedAddress& target);
+
+    // Counts a CONNECT to the destination and hands over one of its warm
+    // sockets if there is a live one: connected, associated with IoEngine,
+    // FinishConnect done.  INVALID_SOCKET otherwise.  Either way
+    // a hot destination is topped up in the background.  `family` receives
+    // the socket's address family.
+    static SOCKET Take(const std::string& host, uint16_t port, int& family);
+    static SOCKET Take(const ResolvedAddress& target, int& family);
+
+    // A recycled socket of `family`, ready for StartConnect; INVALID_SOCKET if none.
+    static SOCKET TakeRecycled(int family);
+
+    // Takes over a connected target socket whose I/O has been cancelled and
+    // disconnects it for reuse.  False when recycling is off or the socket
+    // cannot be disconnected — the caller then closes it as usual.
+    static bool Recycle(SOCKET socket, int family);
+
+    // Closes every warm and recycled socket (tests, shutdown).
+    static void Clear();
+
+    static constexpr uint32_t kHotWindowMs   = 10000;
+    static constexpr size_t   kMaxTracked    = 256;   // HotTargets bound
+    static constexpr size_t   kMaxRecycled   = 64;    // per address family
+};
@@ -1,6 +1,8 @@
 #pragma once
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 
 // This library exposes two entry points:
 //   ssh_proxy::Connect   (this header)  — reverse SOCKS5 proxy over an SSH tunnel
@@ -11,11 +13,258 @@ namespace ssh_proxy {
 // ── Log level ──────────────────────────────────────────────────────────────────
 enum class LogLevel { Debug, Info, Warn, Error };
 
+// ── Per-transport load ─────────────────────────────────────────────────────────
+// One entry per SSH transport of a Connect (see transport_count).  Byte
+// counts are SOCKS payload: received = client → target, sent = target → client.
+// Counters are cumulative since the transport (last) connected; *_per_sec fields
+// cover the interval since the previous GetMetrics() call (see Metrics) and
+// are 0 in GetTransportStats().
+struct TransportStats {
+    uint16_t  forward_port      = 0;
+    bool      connected         = false;
+    uint32_t  reconnects        = 0;   // times the transport was re-established (ReconnectPolicy)
+
+    // Negotiated SSH methods (see SshAlgorithms); "client-to-server/server-to-client"
+    // where the directions differ, empty while not connected.
+    std::string  kex;
+    std::string  host_key;
+    std::string  cipher;
+    std::string  mac;
+    std::string  compression;
+
+    uint64_t  channels_accepted = 0;
+    uint64_t  channels_open     = 0;
+    uint64_t  bytes_received    = 0;
+    uint64_t  bytes_sent        = 0;
+
+    // SSH I/O loop
+    uint64_t  io_loop_iterations         = 0;
+    double    io_loop_iterations_per_sec = 0;
+    uint64_t  eagain_reads               = 0;  // channel reads with nothing pending
+    uint64_t  eagain_writes              = 0;  // channel writes stopped by a full window/socket
+    uint64_t  drain_write_us_total       = 0;  // time spent flushing channel write queues
+    uint32_t  drain_write_us_max         = 0;  // longest single flush pass
+    uint32_t  rtt_us                     = 0;  // SSH TCP connection round trip; 0 = unknown
+};
+
+// ── Per-session load ───────────────────────────────────────────────────────────
+enum class SessionState { Handshake, Connecting, Relaying, Closed };
+
+// One entry per live session, SOCKS5 or fixed forward (RemoteForward).
+// Queue depths are bytes accepted by one side and not yet handed to the
+// other (towards the target: TCP send queue; towards the client: SSH
+// channel write queue).
+struct SessionStats {
+    uint64_t      id                 = 0;   // unique per Connect, in accept order
+    uint16_t      forward_port       = 0;   // remote port the channel arrived on
+    SessionState  state              = SessionState::Handshake;
+    std::string   target;                   // "host:port" once CONNECT was parsed
+    uint64_t      bytes_to_target    = 0;   // client → target
+    uint64_t      bytes_to_client    = 0;   // target → client
+    uint32_t      connect_latency_us = 0;   // CONNECT request → target connected; 0 until then
+    uint64_t      queued_to_target   = 0;
+    uint64_t      queued_to_client   = 0;
+};
+
+// ── IOCP worker load ───────────────────────────────────────────────────────────
+// Process-wide: the IOCP workers are shared by every Connect.
+struct WorkerStats {
+    uint64_t  completions         = 0;
+    double    completions_per_sec = 0;
+};
+
+// ── Hot-path latency ───────────────────────────────────────────────────────────
+// Distribution of one instrumented duration, in microseconds.  Percentiles
+// come from a log-bucketed histogram and are accurate to within 12.5%.
+struct LatencyStats {
+    uint64_t  count   = 0;
+    double    mean_us = 0;
+    uint64_t  p50_us  = 0;
+    uint64_t  p90_us  = 0;
+    uint64_t  p99_us  = 0;
+    uint64_t  p999_us = 0;
+    uint64_t  max_us  = 0;
+};
+
+// Process-wide and cumulative since the library was first initialised: the
+// histograms, like the IOCP workers, are shared by every Connect.
+struct LatencyMetrics {
+    LatencyStats  socks_connect;      // SOCKS5 CONNECT parsed → target connected
+    LatencyStats  dns_resolve;        // per target lookup, cache hits included
+    LatencyStats  tcp_connect;        // per ConnectEx attempt
+    LatencyStats  io_loop_tick;       // one SSH I/O loop iteration, idle wait excluded
+    LatencyStats  write_queue_wait;   // buffer queued for the SSH channel → dequeued
+};
+
+// Accept-path refusals (see AdmissionLimits).  active_sessions counts the
+// sessions currently holding an admission, whatever the limits.
+struct AdmissionStats {
+    uint32_t  active_sessions  = 0;
+    uint64_t  admitted         = 0;
+    uint64_t  refused_sessions = 0;   // over max_sessions
+    uint64_t  refused_rate     = 0;   // over accepts_per_sec
+    uint64_t  refused_target   = 0;   // over max_per_target
+};
+
+// ── Metrics snapshot ───────────────────────────────────────────────────────────
+// Counters are maintained with relaxed atomics on the data path and are only
+// gathered here, so an unread snapshot costs nothing.  Rates cover the
+// interval since the previous GetMetrics() call on the same Connect (or
+// since construction for the first call).
+struct Metrics {
+    uint64_t                     uptime_ms = 0;
+    double                       interval_s = 0;   // period the rates cover
+    std::vector<TransportStats>  transports;
+    std::vector<SessionStats>    sessions;
+    std::vector<WorkerStats>     workers;
+    LatencyMetrics               latency;
+    AdmissionStats               admission;
+};
+
+// One JSON object, stable key order, no trailing newline.
+std::string FormatMetricsJson(const Metrics& metrics);
+
+// ── Reconnect policy ───────────────────────────────────────────────────────────
+// Without it (enabled = false) a transport that drops stays down.  With it a
+// supervisor thread re-establishes the transport — TCP, handshake, auth and
+// the forward on the same port — retrying with exponential backoff from
+// initial_backoff_ms up to max_backoff_ms, each delay jittered into the upper
+// half of its window.  The first retry after a drop is immediate.
+//
+// hot_standby keeps one extra SSH session connected and authenticated but
+// forwarding nothing.  On a drop the standby only has to send the
+// tcpip-forward request, so the port is served again within a round trip;
+// a new standby is then built in the background.  If the server still holds
+// the old forward (it has not noticed the drop yet), the request is refused
+// and retried on the backoff schedule like a full reconnect.
+//
+// The initial connect is not retried: the constructor still throws.
+struct ReconnectPolicy {
+    bool      enabled            = false;
+    uint32_t  initial_backoff_ms = 500;
+    uint32_t  max_backoff_ms     = 30000;
+    bool      hot_standby        = false;
+};
+
+// ── Authentication ─────────────────────────────────────────────────────────────
+// Besides the password, Connect (and ssh_tunnel::DirectForward) can
+// authenticate with a private key file or an SSH agent (Pageant).  Configured
+// methods are tried agent → key → password; at least one must be given (an
+// empty password means none).  The key file is read once per process and
+// shared by every transport, reconnect and forward that names it.
+struct AuthOptions {
+    std::string  private_key_file;    // OpenSSH / PEM private key; empty = none
+    std::string  key_passphrase;      // for an encrypted key
+    bool         use_agent = false;
+};
+
+// ── SSH algorithm preferences ──────────────────────────────────────────────────
+// Comma-separated OpenSSH method names, most preferred first.  An empty list
+// selects the built-in performance profile: curve25519 key exchange and AEAD
+// ciphers (AES-GCM, then chacha20-poly1305) first, followed by every other
+// method the libssh2 build supports, so no server is refused that the
+// library's defaults would have reached.  A non-empty list is used as given:
+// methods not named are never negotiated.
+//
+// compression offers zlib, falling back to none if the server declines.  It
+// spends I/O-thread CPU to save bandwidth — worth it for text-heavy traffic
+// over a slow link, a loss on a fast one.  Applies to the whole session.
+struct SshAlgorithms {
+    std::string  kex;
+    std::string  host_key;
+    std::string  ciphers;
+    std::string  macs;
+    bool         compression = false;
+};
+
+// ── Warm target connections ────────────────────────────────────────────────────
+// For clients that open the same destination over and over (health checks,
+// polling).  A destination that sees hot_connects CONNECTs within 10 s keeps
+// up to per_target pre-connected sockets: the next CONNECTs to it skip DNS
+// and the TCP handshake, and each socket taken is replaced in the
+// background.  Warm sockets unused for max_idle_ms are closed; at most
+// max_targets destinations are kept warm.  Note that a pre-connect opens a
+// connection on the target before any client asked for it.
+//
+// recycle_sockets closes target sockets with DisconnectEx(TF_REUSE_SOCKET)
+// and reuses them for later connects, saving socket creation, bind and IOCP
+// association.
+//
+// Both are off by default and process-wide, like the DNS cache: the most
+// recently constructed Connect sets them.
+struct WarmConnectOptions {
+    uint32_t  per_target      = 0;       // 0 = no pre-connects
+    uint32_t  hot_connects    = 4;
+    uint32_t  max_idle_ms     = 10000;
+    uint32_t  max_targets     = 16;
+    bool      recycle_sockets = false;
+};
+
+// ── I/O threads ────────────────────────────────────────────────────────────────
+// The IOCP workers that run target-side I/O are process-wide: the first
+// Connect (or ssh_tunnel::DirectForward) creates them and these options only
+// apply there.  workers = 0 means one per logical processor.
+//
+// With affinity Core each worker is pinned to one logical processor, with
+// NumaNode to the processors of one NUMA node (nodes in turn), so a
+// connection's completions keep hitting warm caches.  Either way the lowest
+// io_processors processors are kept for the SSH I/O threads — the one serial
+// stage of the relay — and no worker runs there.  Off by default: on a
+// machine shared with other load, pinning only narrows the scheduler's choices.
+enum class IoAffinity { None, Core, NumaNode };
+
+struct IoThreadOptions {
+    uint32_t    workers       = 0;
+    IoAffinity  affinity      = IoAffinity::None;
+    uint32_t    io_processors = 1;
+};
+
+// ── Admission control ──────────────────────────────────────────────────────────
+// Limits on the accept path, shared by all transports of a Connect; 0 = no
+// limit.  max_sessions caps concurrent SOCKS sessions and accepts_per_sec
+// the rate of new ones (a token bucket holding accept_burst, by default one
+// second's worth).  A channel over either limit is still answered: it gets
+// REP_GENERAL_FAILURE for its CONNECT without any DNS lookup or target
+// connection.  max_per_target caps concurrent sessions to one destination
+// (host name or address, and port, as the client sent it); the CONNECT over
+// it gets REP_CONNECTION_NOT_ALLOWED.
+//
+// libssh2 does not report a forwarded channel's originator address, so
+// there are no per-client limits.
+struct AdmissionLimits {
+    uint32_t  max_sessions    = 0;
+    uint32_t  accepts_per_sec = 0;
+    uint32_t  accept_burst    = 0;
+    uint32_t  max_per_target  = 0;
+};
+
+// ── Additional remote forwards ─────────────────────────────────────────────────
+// Each entry is one more tcpip-forward on every transport, served by the same
+// SSH session, I/O thread, admission limits and metrics as forward_port.
+// Like forward_port, transport i listens on remote_port + i.  With an empty
+// target_host the port is another SOCKS5 endpoint; otherwise every channel
+// on it is relayed as-is to target_host:target_port, like `ssh -R`, with no
+// SOCKS handshake.
+struct RemoteForward {
+    uint16_t     remote_port = 0;
+    std::string  target_host;          // empty = SOCKS5
+    uint16_t     target_port = 0;
+};
+
 // ── RAII connection handle ─────────────────────────────────────────────────────
 // Constructor synchronously connects to the SSH server and starts an internal
 // I/O thread that runs the channel-accept loop.
 // Throws std::runtime_error with a descriptive message on failure.
 // Destructor cancels the session and joins the I/O thread.
+//
+// transport_count > 1 opens that many independent SSH sessions to the same
+// server, each with its own TCP connection, cipher stream and I/O thread.
+// Transport i requests the remote forward on forward_port + i, so the ports
+// forward_port .. forward_port + transport_count - 1 are served.  The
+// transports do not share load among themselves — a client is served by the
+// transport of the port it connected to — so spreading clients evenly needs
+// a balancer (or client-side port selection) in front of those ports.
+// `forwards` adds further ports to each transport (see RemoteForward).
 class Connect {
 public:
     Connect(
@@ -26,7 +275,15 @@ public:
         uint16_t     forward_port          = 1080,
         uint32_t     connect_timeout_ms    = 10000,
         uint32_t     keepalive_interval_ms = 30000,
-        LogLevel     log_level             = LogLevel::Info
+        LogLevel     log_level             = LogLevel::Info,
+        uint32_t     transport_count       = 1,
+        const ReconnectPolicy& reconnect   = {},
+        const AuthOptions&     auth        = {},
+        const SshAlgorithms&   algorithms  = {},
+        const WarmConnectOptions& warm     = {},
+        const IoThreadOptions&    io_threads = {},
+        const AdmissionLimits&    admission  = {},
+        const std::vector<RemoteForward>& forwards = {}
     );
 
     ~Connect();
@@ -39,9 +296,29 @@ public:
     void Cancel();
 
     // True while the session is active. Becomes false after Cancel()
-    // or an unexpected session drop.
+    // or an unexpected session drop.  With several transports: true while
+    // at least one of them is still connected.  A reconnecting transport
+    // counts as down until it is back.
     bool IsConnected() const;
 
+    // True until Cancel() — and, without a reconnect policy, until the last
+    // transport drops.  What a caller waiting for the proxy to end polls.
+    bool IsRunning() const;
+
+    // Snapshot of every transport's load, in forward-port order.  Thread-safe.
+    std::vector<TransportStats> GetTransportStats() const;
+
+    // Full snapshot: transports, live sessions, IOCP workers and admission
+    // counters.  Thread-safe.
+    Metrics GetMetrics() const;
+
+    // Calls sink with FormatMetricsJson(GetMetrics()) every interval_ms on an
+    // IOCP worker thread.  interval_ms = 0 (or an empty sink) stops the dump.
+    // Replaces any previous dump; the destructor stops it.  The sink must not
+    // call SetMetricsDump().
+    using MetricsSink = std::function<void(const std::string& json)>;
+    void SetMetricsDump(uint32_t interval_ms, MetricsSink sink);
+
 private:
     struct Impl;
     Impl* m_impl;
@@ -52,4 +329,26 @@ private:
 // Each line: "YYYY-MM-DD HH:MM:SS.mmm [LEVEL] message\n"
 std::string GetLog();
 
+// One log entry.  seq numbers the entries that pass the min level, from 1
+// in logging order; a gap between two records means the entries between
+// were overwritten before they were read.
+struct LogRecord {
+    uint64_t     seq = 0;
+    std::string  timestamp;   // "YYYY-MM-DD HH:MM:SS.mmm"
+    LogLevel     level = LogLevel::Info;
+    std::string  message;
+};
+
+// Entries logged after `after_seq` (0 = everything held), oldest first, at
+// most max_entries.  Pass the last seq returned to poll for new entries;
+// the call takes no lock and never blocks logging threads.
+std::vector<LogRecord> GetLogSince(uint64_t after_seq, size_t max_entries = 1000);
+
+// Sets how many entries the log holds (default 256), rounded up to a power
+// of two between 128 and 131072.  Each entry costs about 1 KiB.  The newest
+// entries carry over.  Call once at startup, before Connect(): only the
+// first resize takes effect, and a later call that would change the size is
+// ignored with a warning in the log.
+void SetLogCapacity(size_t entries);
+
 } // namespace ssh_proxy
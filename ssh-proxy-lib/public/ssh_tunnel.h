@@ -1,9 +1,20 @@
 #pragma once
+#include "ssh_proxy.h"
 #include <cstdint>
 #include <string>
 
 namespace ssh_tunnel {
 
+// SingleAccept: genau ein lokaler Aufrufer pro Instanz (Standard, bisheriges Verhalten).
+// Persistent:   eine SSH-Session für beliebig viele Aufrufer — der Listener
+//               bleibt offen, jede angenommene Verbindung bekommt einen eigenen
+//               direct_tcpip-Kanal; alle Kanäle laufen auf dem I/O-Thread
+//               der einen SSH-Session.
+enum class DirectForwardMode {
+    SingleAccept,
+    Persistent,
+};
+
 // Baut einen SSH Local Port Forward auf:
 //   lauscht auf 127.0.0.1:local_port()  (ephemeraler Port, Single-Accept)
 //   → öffnet direct_tcpip-Kanal zu target_host:target_port (Sicht des SSH-Servers)
@@ -12,9 +23,22 @@ namespace ssh_tunnel {
 // Single-Accept: akzeptiert genau eine eingehende TCP-Verbindung.
 // Danach kein weiteres Accept — Retry erzeugt eine neue DirectForward-Instanz.
 //
+// Persistent: Handshake + Auth nur einmal im Konstruktor; jede neue lokale
+// Verbindung kostet nur noch einen Channel-Open-Roundtrip (z.B. DB-Connection-
+// Pool). Kann das Ziel nicht erreicht werden, wird nur die betroffene lokale
+// Verbindung geschlossen. is_alive() wird false, wenn die SSH-Session abbricht.
+//
+// Threads: kein eigener Relay-Thread pro Forward. Die SSH-Seite läuft auf dem
+// I/O-Thread eines SshTransport (einer pro Session), die lokalen Sockets
+// (AcceptEx, WSARecv/WSASend) auf den gemeinsamen IoEngine-Workern.
+//
 // Tunnel-Drop-Propagation: Bricht der SSH-Kanal ab, schließt DirectForward den
 // lokalen Socket. NetworkClient::listen() bekommt POLLHUP und beendet die Sitzung.
 //
+// Authentifizierung: Passwort und/oder auth (Schlüsseldatei, Agent/Pageant),
+// wie bei ssh_proxy::Connect. Die Schlüsseldatei wird pro Prozess nur einmal
+// gelesen und von allen Forwards und Transports gemeinsam genutzt.
+//
 // Konstruktor wirft std::runtime_error bei Fehler (analog ssh_proxy::Connect).
 // Kein Reconnect; Retry liegt in main.cpp.
 class DirectForward {
@@ -26,7 +50,9 @@ public:
         uint16_t     target_port,
         std::string  target_host        = "127.0.0.1",
         uint16_t     ssh_port           = 22,
-        uint32_t     connect_timeout_ms = 10000
+        uint32_t     connect_timeout_ms = 10000,
+        DirectForwardMode mode          = DirectForwardMode::SingleAccept,
+        const ssh_proxy::AuthOptions& auth = {}
     );
     ~DirectForward();
 
@@ -41,9 +67,6 @@ public:
 
 private:
     struct Impl;
-    static bool accept_connection(Impl*);
-    static void run_relay_loop(Impl*);
-    static void run_relay(Impl*);
 
     Impl* m_impl;
 };
@@ -0,0 +1,207 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// AdmissionControl — session, accept-rate and per-destination limits
+//
+// PURPOSE
+//   Without limits a burst of SOCKS clients makes the proxy open as many
+//   target connections as the server forwards channels, and one hot
+//   destination can take every session the machine has.  AdmissionControl
+//   refuses the excess early and cheaply: a refused CONNECT is answered from
+//   the handshake state, with no DNS lookup, target socket or IOCP work.
+//
+// WHERE EACH LIMIT APPLIES
+//   Admit() runs in the session factory, on the I/O thread of the transport
+//   that accepted the channel, before the SOCKS handshake: max_sessions and
+//   the accepts_per_sec bucket.  The session still answers the method
+//   negotiation and fails its CONNECT, so the client sees a SOCKS error
+//   rather than a reset.  ClaimTarget() runs once the CONNECT is parsed,
+//   since that is where the destination is known: max_per_target.
+//
+// RELEASE
+//   Slots are held by the session's AdmissionTicket and returned from its
+//   Close(), not its destructor — a closed session an IOCP completion is
+//   still holding does not count.  The ticket keeps AdmissionControl alive,
+//   so sessions may outlive their Connect.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "admission.h"
+#include "platform.h"
+#include <algorithm>
+
+// ── TokenBucket ───────────────────────────────────────────────────────────────
+
+TokenBucket::TokenBucket(uint32_t rate, uint32_t burst, uint64_t now_ms)
+    : m_rate(rate)
+    , m_capacity(uint64_t{burst != 0 ? burst : rate} * 1000)
+    , m_level(m_capacity)
+    , m_last_ms(now_ms)
+{}
+
+bool TokenBucket::TryTake(uint64_t now_ms)
+{
+    if (now_ms > m_last_ms)
+    {
+        // Past full_ms the bucket is full anyway; clamping first keeps a
+        // long idle gap from overflowing the product.
+        uint64_t full_ms = m_rate != 0 ? m_capacity / m_rate + 1 : 0;
+        uint64_t elapsed = (std::min)(now_ms - m_last_ms, full_ms);
+        m_level   = (std::min)(m_capacity, m_level + elapsed * m_rate);
+        m_last_ms = now_ms;
+    }
+    if (m_level < 1000) return false;
+    m_level -= 1000;
+    return true;
+}
+
+// ── AdmissionTicket ───────────────────────────────────────────────────────────
+
+AdmissionTicket::AdmissionTicket(AdmissionTicket&& other) noexcept
+    : m_owner(std::move(other.m_owner))
+    , m_verdict(other.m_verdict)
+    , m_holds_session(other.m_holds_session)
+    , m_target(std::move(other.m_target))
+{
+    other.m_holds_session = false;
+    other.m_target.clear();
+}
+
+AdmissionTicket& AdmissionTicket::operator=(AdmissionTicket&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        m_owner         = std::move(other.m_owner);
+        m_verdict       = other.m_verdict;
+        m_holds_session = other.m_holds_session;
+        m_target        = std::move(other.m_target);
+        other.m_holds_session = false;
+        other.m_target.clear();
+    }
+    return *this;
+}
+
+bool AdmissionTicket::LimitsTargets() const
+{
+    return m_owner && m_owner->m_limits.max_per_target != 0;
+}
+
+bool AdmissionTicket::ClaimTarget(const std::string& target)
+{
+    if (!m_owner || !m_target.empty()) return true;
+    if (!m_owner->ClaimTarget(target))
+    {
+        m_verdict = AdmissionVerdict::TargetLimit;
+        return false;
+    }
+    if (m_owner->m_limits.max_per_target != 0) m_target = target;
+    return true;
+}
+
+void AdmissionTicket::Release()
+{
+    if (!m_owner) return;
+    if (!m_target.empty())
+    {
+        m_owner->ReleaseTarget(m_target);
+        m_target.clear();
+    }
+    if (m_holds_session)
+    {
+        m_owner->ReleaseSession();
+        m_holds_session = false;
+    }
+}
+
+// ── AdmissionControl ──────────────────────────────────────────────────────────
+
+std::shared_ptr<AdmissionControl> AdmissionControl::Create(const ssh_proxy::AdmissionLimits& limits)
+{
+    return std::make_shared<AdmissionControl>(limits);
+}
+
+AdmissionControl::AdmissionControl(const ssh_proxy::AdmissionLimits& limits)
+    : m_limits(limits)
+    , m_bucket(limits.accepts_per_sec, limits.accept_burst, ::GetTickCount64())
+{}
+
+AdmissionTicket AdmissionControl::Admit()
+{
+    return Admit(::GetTickCount64());
+}
+
+AdmissionTicket AdmissionControl::Admit(uint64_t now_ms)
+{
+    AdmissionTicket ticket;
+    ticket.m_owner = shared_from_this();
+
+    if (m_limits.max_sessions != 0 || m_limits.accepts_per_sec != 0)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_limits.max_sessions != 0 && m_active.load() >= m_limits.max_sessions)
+            ticket.m_verdict = AdmissionVerdict::SessionLimit;
+        else if (m_limits.accepts_per_sec != 0 && !m_bucket.TryTake(now_ms))
+            ticket.m_verdict = AdmissionVerdict::AcceptRate;
+        else
+            m_active.fetch_add(1);
+    }
+    else
+    {
+        m_active.fetch_add(1);
+    }
+
+    switch (ticket.m_verdict) {
+    case AdmissionVerdict::Admitted:
+        ticket.m_holds_session = true;
+        m_admitted.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case AdmissionVerdict::SessionLimit:
+        m_refused_sessions.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case AdmissionVerdict::AcceptRate:
+        m_refused_rate.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case AdmissionVerdict::TargetLimit:
+        break;
+    }
+    return ticket;
+}
+
+bool AdmissionControl::ClaimTarget(const std::string& target)
+{
+    if (m_limits.max_per_target == 0) return true;
+
+    std::lock_guard<std::mutex> lock(m_target_mutex);
+    uint32_t& count = m_targets[target];
+    if (count >= m_limits.max_per_target)
+    {
+        m_refused_target.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    ++count;
+    return true;
+}
+
+void AdmissionControl::ReleaseTarget(const std::string& target)
+{
+    std::lock_guard<std::mutex> lock(m_target_mutex);
+    auto it = m_targets.find(target);
+    if (it != m_targets.end() && --it->second == 0)
+        m_targets.erase(it);
+}
+
+void AdmissionControl::ReleaseSession()
+{
+    m_active.fetch_sub(1);
+}
+
+ssh_proxy::AdmissionStats AdmissionControl::GetStats() const
+{
+    ssh_proxy::AdmissionStats st;
+    st.active_sessions  = m_active.load(std::memory_order_relaxed);
+    st.admitted         = m_admitted.load(std::memory_order_relaxed);
+    st.refused_sessions = m_refused_sessions.load(std::memory_order_relaxed);
+    st.refused_rate     = m_refused_rate.load(std::memory_order_relaxed);
+    st.refused_target   = m_refused_target.load(std::memory_order_relaxed);
+    return st;
+}
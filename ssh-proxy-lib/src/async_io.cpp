@@ -1,36 +1,122 @@
 //////////////////////////////////////////////////////////////////////////////
 //
-// IoEngine — process-wide IOCP singleton, worker thread pool, ConnectEx loader
+// IoEngine — Windows backend: IOCP singleton, worker thread pool, ConnectEx loader
 //
 // PURPOSE
 //   Owns the one Windows I/O Completion Port shared by all TcpConnection
 //   objects.  Provides the worker thread pool that dequeues completions and
-//   invokes the per-operation callbacks stored in each IoContext.
+//   invokes the per-operation callbacks stored in each IoContext.  The
+//   POSIX build compiles async_io_epoll.cpp against the same interface.
 //
 // DESIGN
 //   All members are static — IoEngine is never instantiated.  Init() is
 //   idempotent so callers do not need to coordinate first-caller semantics.
 //
-// CONNECTEX
+// CONNECTEX / ACCEPTEX
 //   ConnectEx is not a normal Winsock symbol; it must be retrieved at runtime
 //   via WSAIoctl(SIO_GET_EXTENSION_FUNCTION_POINTER).  Init() loads it once
-//   into s_connect_ex; GetConnectEx() hands it to TcpConnection callers.
+//   into s_connect_ex for StartConnect.  AcceptEx (overlapped accept for
+//   DirectForward's local listener) is loaded the same way into s_accept_ex,
+//   and DisconnectEx (StartDisconnect, WarmSockets' socket recycling) into
+//   s_disconnect_ex — the only one Init() can do without.
+//
+// OPERATIONS
+//   The Start* calls are thin wrappers: WSARecv, WSASend, ConnectEx, AcceptEx
+//   and DisconnectEx on the context's OVERLAPPED.  Associate sets
+//   FILE_SKIP_COMPLETION_PORT_ON_SUCCESS when every TCP provider is an IFS
+//   one (no layered provider that could complete behind our back), so a call
+//   that succeeds at once queues no packet.  Its completion is still
+//   delivered on a worker, as the interface promises: started on a worker,
+//   it joins that worker's deferred list and runs right after the current
+//   callback returns — no kernel transition, no other thread woken;
+//   started elsewhere (the SSH I/O thread), it is posted to the port.
+//   kInlineBudget bounds how many deferred completions one dequeued packet
+//   may chain, so a socket that always has data waiting still yields.
+//
+// DEQUEUE
+//   Workers take up to kDequeueBatch packets per GetQueuedCompletionStatusEx
+//   call.  A packet's status is read from its OVERLAPPED (Internal holds the
+//   NTSTATUS); WSAGetOverlappedResult translates a failure into a Winsock
+//   error.
+//
+// AFFINITY
+//   With Init's affinity on, each worker pins itself to its PlanIoAffinity
+//   mask as it starts; PinIoThread gives the SSH I/O threads the reserved
+//   processors (io_affinity.cpp).
 //
 // SHUTDOWN PROTOCOL
 //   Shutdown() posts one IOCP_SHUTDOWN_KEY packet per worker thread.  Each
-//   worker breaks its dequeue loop on that sentinel and returns, which is
-//   detected by WaitForMultipleObjects before handle and memory cleanup.
+//   worker finishes its batch and returns on that sentinel, re-posting any
+//   extra sentinels the same batch took so every worker sees one; the exit
+//   is detected by WaitForMultipleObjects before handle and memory cleanup.
 //
 //////////////////////////////////////////////////////////////////////////////
 
+#ifdef _WIN32
+
 #include "async_io.h"
 #include "logger.h"
+#include "instrumentation.h"
+#include <memory>
+
+// Completion key used to signal worker threads to exit
+static constexpr ULONG_PTR IOCP_SHUTDOWN_KEY = 0xDEAD;
 
 HANDLE          IoEngine::s_iocp = nullptr;
 HANDLE*         IoEngine::s_threads = nullptr;
+IoEngine::WorkerCounters* IoEngine::s_worker_counters = nullptr;
 int             IoEngine::s_thread_count = 0;
 LPFN_CONNECTEX  IoEngine::s_connect_ex = nullptr;
+LPFN_ACCEPTEX   IoEngine::s_accept_ex = nullptr;
+LPFN_DISCONNECTEX IoEngine::s_disconnect_ex = nullptr;
 bool            IoEngine::s_initialized = false;
+uint64_t        IoEngine::s_io_thread_affinity = 0;
+
+namespace {
+
+// Deferred completions one dequeued packet may chain on its worker.
+constexpr size_t kInlineBudget = 16;
+
+// NTSTATUS of an aborted operation (ntstatus.h clashes with windows.h).
+constexpr DWORD kStatusCancelled = 0xC0000120;
+
+// Set once in Init, before any socket is associated.
+bool g_skip_on_success = false;
+
+struct Deferred {
+    IoContext* ctx;
+    DWORD      bytes;
+};
+
+// A worker's completions of operations it started that finished at once.
+struct WorkerLocal {
+    std::vector<Deferred> deferred;
+    size_t                budget = 0;
+};
+
+thread_local WorkerLocal* t_worker = nullptr;
+
+// FILE_SKIP_COMPLETION_PORT_ON_SUCCESS is only safe when every TCP
+// provider hands out IFS handles: a layered provider may complete an
+// operation without going through the handle, and its completion would
+// then be lost.
+bool SkipOnSuccessIsSafe()
+{
+    int   protocols[] = { IPPROTO_TCP, 0 };
+    DWORD len = 0;
+    ::WSAEnumProtocolsW(protocols, nullptr, &len);
+    if (len == 0) return false;
+    std::vector<char> buf(len);
+    auto* info = reinterpret_cast<WSAPROTOCOL_INFOW*>(buf.data());
+    int count = ::WSAEnumProtocolsW(protocols, info, &len);
+    if (count == SOCKET_ERROR || count == 0) return false;
+    for (int i = 0; i < count; ++i)
+        if ((info[i].dwServiceFlags1 & XP1_IFS_HANDLES) == 0)
+            return false;
+    return true;
+}
+
+} // namespace
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -43,7 +129,7 @@ bool            IoEngine::s_initialized = false;
 //
 //////////////////////////////////////////////////////////////////////////////
 
-ErrorCode IoEngine::Init(int thread_count)
+ErrorCode IoEngine::Init(int thread_count, IoAffinity affinity, uint32_t io_processors)
 {
     if (s_initialized)
         return ErrorCode::Success;
@@ -56,14 +142,26 @@ ErrorCode IoEngine::Init(int thread_count)
         return ErrorCode::SocketError;
     }
 
-    // Determine thread count
+    // Determine thread count — with affinity, one worker per processor the
+    // I/O threads leave over
+    ProcessorLayout layout;
+    if (affinity != IoAffinity::None)
+        layout = QueryProcessorLayout();
     if (thread_count <= 0)
     {
         SYSTEM_INFO si;
         ::GetSystemInfo(&si);
         thread_count = static_cast<int>(si.dwNumberOfProcessors);
+        if (affinity != IoAffinity::None)
+        {
+            IoAffinityPlan probe = PlanIoAffinity(affinity, layout, 1, io_processors);
+            if (probe.io_threads != 0)
+                thread_count = ProcessorCount(layout.available & ~probe.io_threads);
+        }
         if (thread_count < 1) thread_count = 1;
     }
+    IoAffinityPlan plan = PlanIoAffinity(affinity, layout, thread_count, io_processors);
+    g_skip_on_success = SkipOnSuccessIsSafe();
 
     // Create completion port
     s_iocp = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, static_cast<DWORD>(thread_count));
@@ -73,7 +171,7 @@ ErrorCode IoEngine::Init(int thread_count)
         return ErrorCode::SocketError;
     }
 
-    // Load ConnectEx
+    // Load ConnectEx, AcceptEx and DisconnectEx
     SOCKET tmp = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (tmp != INVALID_SOCKET)
     {
@@ -83,20 +181,35 @@ ErrorCode IoEngine::Init(int thread_count)
                    &guid, sizeof(guid),
                    &s_connect_ex, sizeof(s_connect_ex),
                    &bytes, nullptr, nullptr);
+        GUID accept_guid = WSAID_ACCEPTEX;
+        ::WSAIoctl(tmp, SIO_GET_EXTENSION_FUNCTION_POINTER,
+                   &accept_guid, sizeof(accept_guid),
+                   &s_accept_ex, sizeof(s_accept_ex),
+                   &bytes, nullptr, nullptr);
+        GUID disconnect_guid = WSAID_DISCONNECTEX;
+        ::WSAIoctl(tmp, SIO_GET_EXTENSION_FUNCTION_POINTER,
+                   &disconnect_guid, sizeof(disconnect_guid),
+                   &s_disconnect_ex, sizeof(s_disconnect_ex),
+                   &bytes, nullptr, nullptr);
         ::closesocket(tmp);
     }
-    if (s_connect_ex == nullptr)
+    if (s_connect_ex == nullptr || s_accept_ex == nullptr)
     {
-        Logger::Error("Failed to load ConnectEx");
+        Logger::Error("Failed to load ConnectEx/AcceptEx");
         return ErrorCode::SocketError;
     }
 
     // Start worker threads
     s_thread_count = thread_count;
     s_threads = new HANDLE[thread_count]{};
+    s_worker_counters = new WorkerCounters[thread_count];
+    for (int i = 0; i < thread_count && !plan.workers.empty(); ++i)
+        s_worker_counters[i].affinity = plan.workers[static_cast<size_t>(i)];
+    s_io_thread_affinity = plan.io_threads;
     for (int i = 0; i < thread_count; ++i)
     {
-        s_threads[i] = ::CreateThread(nullptr, 0, WorkerThread, nullptr, 0, nullptr);
+        s_threads[i] = ::CreateThread(nullptr, 0, WorkerThread,
+                                      &s_worker_counters[i], 0, nullptr);
         if (s_threads[i] == nullptr)
         {
             Logger::Error("CreateThread failed: %lu", ::GetLastError());
@@ -108,6 +221,8 @@ ErrorCode IoEngine::Init(int thread_count)
             for (int j = 0; j < i; ++j) ::CloseHandle(s_threads[j]);
             delete[] s_threads;
             s_threads = nullptr;
+            delete[] s_worker_counters;
+            s_worker_counters = nullptr;
             ::CloseHandle(s_iocp);
             s_iocp = nullptr;
             ::WSACleanup();
@@ -115,8 +230,11 @@ ErrorCode IoEngine::Init(int thread_count)
         }
     }
 
+    Instrumentation::Register();
     s_initialized = true;
-    Logger::Info("IoEngine initialized with %d worker threads", thread_count);
+    Logger::Info("IoEngine initialized with %d worker threads%s%s", thread_count,
+                 plan.workers.empty() ? "" : ", pinned",
+                 g_skip_on_success ? "" : ", completion port on success");
     return ErrorCode::Success;
 }
 
@@ -147,11 +265,15 @@ void IoEngine::Shutdown()
     }
     delete[] s_threads;
     s_threads = nullptr;
+    delete[] s_worker_counters;
+    s_worker_counters = nullptr;
+    s_io_thread_affinity = 0;
 
     ::CloseHandle(s_iocp);
     s_iocp = nullptr;
 
     ::WSACleanup();
+    Instrumentation::Unregister();
     s_initialized = false;
 
     Logger::Info("IoEngine shut down");
@@ -161,24 +283,191 @@ void IoEngine::Shutdown()
 // ── Associate ─────────────────────────────────────────────────────────────────
 //
 // Binds sock to the shared IOCP so that subsequent overlapped operations on it
-// complete via the worker thread pool.  Must be called before the first
-// WSARecv, WSASend, or ConnectEx on the socket.
+// complete via the worker thread pool, and turns off the packet for
+// operations that succeed at once (see OPERATIONS).  Must be called before
+// the first Start* on the socket.
 //
 
-ErrorCode IoEngine::Associate(SOCKET sock, ULONG_PTR key)
+ErrorCode IoEngine::Associate(SOCKET sock)
 {
-    HANDLE h = ::CreateIoCompletionPort(reinterpret_cast<HANDLE>(sock), s_iocp, key, 0);
+    HANDLE h = ::CreateIoCompletionPort(reinterpret_cast<HANDLE>(sock), s_iocp, 0, 0);
     if (h == nullptr)
     {
         Logger::Error("Associate socket to IOCP failed: %lu", ::GetLastError());
         return ErrorCode::SocketError;
     }
+    // Every Start* on an associated socket relies on the mode being set.
+    if (g_skip_on_success &&
+        !::SetFileCompletionNotificationModes(reinterpret_cast<HANDLE>(sock),
+            FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE))
+    {
+        Logger::Error("SetFileCompletionNotificationModes failed: %lu", ::GetLastError());
+        return ErrorCode::SocketError;
+    }
+    return ErrorCode::Success;
+}
+
+void IoEngine::PinIoThread()
+{
+    if (s_io_thread_affinity != 0 && !PinCurrentThread(s_io_thread_affinity))
+        Logger::Warn("Pinning the SSH I/O thread failed: %lu", ::GetLastError());
+}
+
+// ── Sockets and operations ────────────────────────────────────────────────────
+
+SOCKET IoEngine::OpenSocket(int family, ErrorCode& error)
+{
+    SOCKET s = ::WSASocketW(family, SOCK_STREAM, IPPROTO_TCP,
+                            nullptr, 0, WSA_FLAG_OVERLAPPED);
+    if (s == INVALID_SOCKET)
+    {
+        error = ErrorCode::SocketError;
+        return INVALID_SOCKET;
+    }
+
+    // ConnectEx requires the socket to be bound — to the wildcard of its family
+    struct sockaddr_storage bind_addr{};
+    int bind_len = 0;
+    if (family == AF_INET6)
+    {
+        auto* a6 = reinterpret_cast<sockaddr_in6*>(&bind_addr);
+        a6->sin6_family = AF_INET6;
+        a6->sin6_addr   = in6addr_any;
+        bind_len = static_cast<int>(sizeof(sockaddr_in6));
+    }
+    else
+    {
+        auto* a4 = reinterpret_cast<sockaddr_in*>(&bind_addr);
+        a4->sin_family      = AF_INET;
+        a4->sin_addr.s_addr = INADDR_ANY;
+        bind_len = static_cast<int>(sizeof(sockaddr_in));
+    }
+
+    if (::bind(s, reinterpret_cast<struct sockaddr*>(&bind_addr), bind_len) != 0)
+    {
+        Logger::Error("bind failed: %d", ::WSAGetLastError());
+        ::closesocket(s);
+        error = ErrorCode::SocketError;
+        return INVALID_SOCKET;
+    }
+
+    ErrorCode ec = Associate(s);
+    if (ec != ErrorCode::Success)
+    {
+        ::closesocket(s);
+        error = ec;
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+// Closing the handle aborts whatever is still pending on it; those
+// completions arrive with ERROR_OPERATION_ABORTED.
+void IoEngine::CloseSocket(SOCKET sock)
+{
+    ::closesocket(sock);
+}
+
+void IoEngine::CancelIo(SOCKET sock)
+{
+    ::CancelIoEx(reinterpret_cast<HANDLE>(sock), nullptr);
+}
+
+namespace {
+
+// A failed overlapped call is only an error when it is not pending.
+ErrorCode Started(int err)
+{
+    return err == WSA_IO_PENDING ? ErrorCode::Success : WsaToErrorCode(err);
+}
+
+// An overlapped call that succeeded at once.  Without the skip mode its
+// packet is already queued; with it, nothing is, and delivery is ours.
+ErrorCode CompletedAtOnce(IoContext* ctx, DWORD bytes)
+{
+    if (!g_skip_on_success)
+        return ErrorCode::Success;
+    if (t_worker != nullptr && t_worker->budget > 0)
+    {
+        --t_worker->budget;
+        t_worker->deferred.push_back({ ctx, bytes });
+    }
+    else
+    {
+        IoEngine::PostCompletion(ctx, bytes);
+    }
     return ErrorCode::Success;
 }
 
-LPFN_CONNECTEX IoEngine::GetConnectEx()
+} // namespace
+
+ErrorCode IoEngine::StartConnect(IoContext* ctx, const sockaddr* addr, int addr_len)
+{
+    ctx->Reset();
+    if (s_connect_ex(ctx->socket, addr, addr_len, nullptr, 0, nullptr, ctx))
+        return CompletedAtOnce(ctx, 0);
+    return Started(::WSAGetLastError());
+}
+
+// SO_UPDATE_CONNECT_CONTEXT makes a ConnectEx'd socket behave like one from
+// connect() for shutdown, getpeername and the like.
+void IoEngine::FinishConnect(SOCKET sock)
+{
+    ::setsockopt(sock, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, nullptr, 0);
+}
+
+ErrorCode IoEngine::StartRecv(IoContext* ctx)
+{
+    ctx->Reset();
+    DWORD flags = 0;
+    DWORD bytes = 0;
+    if (::WSARecv(ctx->socket, &ctx->buffer, 1, &bytes, &flags, ctx, nullptr) == 0)
+        return CompletedAtOnce(ctx, bytes);
+    return Started(::WSAGetLastError());
+}
+
+ErrorCode IoEngine::StartSend(IoContext* ctx, const IoBuffer* buffers, size_t count)
+{
+    ctx->Reset();
+    DWORD bytes = 0;
+    // WSASend does not write through lpBuffers; the cast only drops const.
+    if (::WSASend(ctx->socket, const_cast<IoBuffer*>(buffers), static_cast<DWORD>(count),
+                  &bytes, 0, ctx, nullptr) == 0)
+        return CompletedAtOnce(ctx, bytes);
+    return Started(::WSAGetLastError());
+}
+
+ErrorCode IoEngine::StartDisconnect(IoContext* ctx)
+{
+    if (s_disconnect_ex == nullptr) return ErrorCode::InvalidArgument;
+    ctx->Reset();
+    if (s_disconnect_ex(ctx->socket, ctx, TF_REUSE_SOCKET, 0))
+        return CompletedAtOnce(ctx, 0);
+    return Started(::WSAGetLastError());
+}
+
+bool IoEngine::SupportsSocketReuse()
 {
-    return s_connect_ex;
+    return s_disconnect_ex != nullptr;
+}
+
+ErrorCode IoEngine::StartAccept(IoContext* ctx, SOCKET accept_socket, void* addr_buf, DWORD addr_len)
+{
+    ctx->Reset();
+    DWORD bytes = 0;
+    if (s_accept_ex(ctx->socket, accept_socket, addr_buf, 0, addr_len, addr_len, &bytes, ctx))
+        return CompletedAtOnce(ctx, bytes);
+    return Started(::WSAGetLastError());
+}
+
+std::vector<uint64_t> IoEngine::GetWorkerCompletions()
+{
+    std::vector<uint64_t> out;
+    if (s_worker_counters == nullptr) return out;
+    out.reserve(static_cast<size_t>(s_thread_count));
+    for (int i = 0; i < s_thread_count; ++i)
+        out.push_back(s_worker_counters[i].completions.load(std::memory_order_relaxed));
+    return out;
 }
 
 //
@@ -186,83 +475,194 @@ LPFN_CONNECTEX IoEngine::GetConnectEx()
 //
 // Manually queues ctx as a synthetic completion packet.  Used to dispatch
 // arbitrary work (e.g. DNS resolve, TcpConnection::ConnectAsync) onto IOCP
-// worker threads without an actual I/O operation.
+// worker threads without an actual I/O operation, and for operations that
+// completed at once off a worker.  The packet reports success: the worker
+// reads the status from Internal, which an earlier operation may have left
+// set.
 //
 
 void IoEngine::PostCompletion(IoContext* ctx, DWORD bytes)
 {
+    ctx->Internal = 0;
     ::PostQueuedCompletionStatus(s_iocp, bytes, 0, ctx);
 }
 
+// The worker moves the callback out of ctx before invoking it, so the
+// callback may delete its own context.
+void IoEngine::PostWork(WorkFunction fn)
+{
+    auto* ctx = new WorkContext();
+    ctx->op = IoOp::Work;
+    ctx->fn = std::move(fn);
+    ctx->callback = [](IoContext* self, DWORD, ErrorCode)
+    {
+        std::unique_ptr<WorkContext> owner(static_cast<WorkContext*>(self));
+        owner->fn();
+    };
+    PostCompletion(ctx);
+}
+
+namespace {
+
+struct DelayedWork {
+    WorkFunction fn;
+    PTP_TIMER    timer = nullptr;
+};
+
+// The timer object is closed from inside its own callback, which the
+// threadpool allows; fn itself is forwarded to the IOCP workers.
+VOID CALLBACK OnDelayedWorkTimer(PTP_CALLBACK_INSTANCE, PVOID param, PTP_TIMER)
+{
+    std::unique_ptr<DelayedWork> owner(static_cast<DelayedWork*>(param));
+    ::CloseThreadpoolTimer(owner->timer);
+    IoEngine::PostWork(std::move(owner->fn));
+}
+
+} // namespace
+
+// A one-shot threadpool timer that hands fn to PostWork when it fires, so
+// delayed work runs on the IOCP workers like everything else.
+void IoEngine::PostWorkAfter(DWORD delay_ms, WorkFunction fn)
+{
+    auto* work = new DelayedWork{ std::move(fn) };
+    work->timer = ::CreateThreadpoolTimer(&OnDelayedWorkTimer, work, nullptr);
+    if (work->timer == nullptr)
+    {
+        Logger::Error("CreateThreadpoolTimer failed: %lu", ::GetLastError());
+        PostWork(std::move(work->fn));
+        delete work;
+        return;
+    }
+
+    // Negative due time = relative, in 100 ns units.
+    ULARGE_INTEGER due;
+    due.QuadPart = static_cast<ULONGLONG>(-static_cast<LONGLONG>(delay_ms) * 10000);
+    FILETIME ft;
+    ft.dwLowDateTime  = due.LowPart;
+    ft.dwHighDateTime = due.HighPart;
+    ::SetThreadpoolTimer(work->timer, &ft, 0, 0);
+}
+
+namespace {
+
+// The packet's result, from the NTSTATUS the system left in Internal.
+ErrorCode CompletionStatus(IoContext* ctx)
+{
+    DWORD status = static_cast<DWORD>(ctx->Internal);
+    if (status == 0)
+        return ErrorCode::Success;
+    if (status == kStatusCancelled)
+        return ErrorCode::Shutdown;   // socket closed or CancelIoEx
+
+    DWORD bytes = 0, flags = 0;
+    if (::WSAGetOverlappedResult(ctx->socket, ctx, &bytes, FALSE, &flags))
+        return ErrorCode::Success;
+    int err = ::WSAGetLastError();
+    if (err == WSA_OPERATION_ABORTED)
+        return ErrorCode::Shutdown;
+    ErrorCode ec = WsaToErrorCode(err);
+    return ec == ErrorCode::Success ? ErrorCode::SocketError : ec;
+}
+
+// Move out before calling: releases any shared_ptr captured in the callback
+// immediately after the call, breaking self-reference cycles (e.g. IoContext
+// callback → shared_ptr<TcpConnection> → IoContext).
+void Dispatch(IoContext* ctx, DWORD bytes, ErrorCode ec)
+{
+    if (ctx->callback)
+    {
+        IoCallback cb = std::move(ctx->callback);
+        cb(ctx, bytes, ec);
+    }
+}
+
+// Runs the completions the last callback deferred, and any those defer in
+// turn, until the list is empty.  Returns how many ran.
+uint64_t RunDeferred(WorkerLocal& local)
+{
+    uint64_t ran = 0;
+    for (size_t i = 0; i < local.deferred.size(); ++i, ++ran)
+    {
+        Deferred d = local.deferred[i];
+        Dispatch(d.ctx, d.bytes, ErrorCode::Success);
+    }
+    local.deferred.clear();
+    return ran;
+}
+
+} // namespace
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // WorkerThread
 //
 // IOCP dequeue loop.  Runs on each worker thread for the lifetime of the
-// engine.  On each iteration it blocks in GetQueuedCompletionStatus then
-// dispatches to the callback stored in the IoContext.
-//
-// The callback is moved out of ctx before being called.  This releases any
-// shared_ptr captured in the lambda immediately after the call, breaking
-// self-reference cycles (e.g. IoContext callback → shared_ptr<TcpConnection>
-// → IoContext) that would otherwise prevent destruction.
+// engine.  On each iteration it takes a batch from GetQueuedCompletionStatusEx
+// and dispatches each packet to the callback stored in its IoContext, then
+// the completions that callback deferred (see OPERATIONS).  param is the
+// worker's own WorkerCounters slot (read by GetWorkerCompletions for the
+// metrics API, and carrying its affinity mask).
 //
 //////////////////////////////////////////////////////////////////////////////
 
-DWORD WINAPI IoEngine::WorkerThread(LPVOID /*param*/)
+DWORD WINAPI IoEngine::WorkerThread(LPVOID param)
 {
     Logger::Debug("IOCP worker thread started");
+    auto* slot = static_cast<WorkerCounters*>(param);
+    std::atomic<uint64_t>& completions = slot->completions;
+    if (slot->affinity != 0 && !PinCurrentThread(slot->affinity))
+        Logger::Warn("Pinning IOCP worker failed: %lu", ::GetLastError());
 
+    WorkerLocal local;
+    local.deferred.reserve(kInlineBudget);
+    t_worker = &local;
+
+    OVERLAPPED_ENTRY entries[kDequeueBatch];
     for (;;)
     {
-        DWORD bytes_transferred = 0;
-        ULONG_PTR completion_key = 0;
-        LPOVERLAPPED overlapped = nullptr;
-
-        BOOL ok = ::GetQueuedCompletionStatus(
-            s_iocp, &bytes_transferred, &completion_key, &overlapped, INFINITE);
-
-        // Shutdown signal
-        if (completion_key == IOCP_SHUTDOWN_KEY)
+        ULONG count = 0;
+        if (!::GetQueuedCompletionStatusEx(s_iocp, entries, static_cast<ULONG>(kDequeueBatch),
+                                           &count, INFINITE, FALSE))
         {
-            Logger::Debug("IOCP worker thread shutting down");
-            break;
-        }
-
-        if (overlapped == nullptr)
-        {
-            // Spurious wake or error with no overlapped
+            if (::GetLastError() == ERROR_ABANDONED_WAIT_0) break;   // port closed
             continue;
         }
 
-        auto* ctx = static_cast<IoContext*>(overlapped);
-
-        ErrorCode ec = ErrorCode::Success;
-        if (!ok)
+        uint64_t ran   = 0;
+        ULONG    stops = 0;
+        for (ULONG i = 0; i < count; ++i)
         {
-            DWORD err = ::GetLastError();
-            if (err == ERROR_OPERATION_ABORTED)
+            // Shutdown signal — the rest of the batch still runs
+            if (entries[i].lpCompletionKey == IOCP_SHUTDOWN_KEY)
             {
-                // Cancelled — socket was closed
-                ec = ErrorCode::Shutdown;
-            }
-            else
-            {
-                ec = WsaToErrorCode(static_cast<int>(err));
-                if (ec == ErrorCode::Success)
-                    ec = ErrorCode::SocketError;
+                ++stops;
+                continue;
             }
+            if (entries[i].lpOverlapped == nullptr)
+                continue;
+
+            auto* ctx = static_cast<IoContext*>(entries[i].lpOverlapped);
+            local.budget = kInlineBudget;
+            Dispatch(ctx, entries[i].dwNumberOfBytesTransferred, CompletionStatus(ctx));
+            ran += 1 + RunDeferred(local);
         }
 
-        if (ctx->callback)
+        // Sole writer — a plain relaxed store, no locked increment.
+        completions.store(completions.load(std::memory_order_relaxed) + ran,
+                          std::memory_order_relaxed);
+
+        if (stops > 0)
         {
-            // Move out before calling: releases any shared_ptr captured in the
-            // callback immediately after the call, breaking self-reference cycles
-            // (e.g. IoContext callback → shared_ptr<TcpConnection> → IoContext).
-            auto cb = std::move(ctx->callback);
-            cb(ctx, bytes_transferred, ec);
+            // One sentinel is ours; hand the others on to the workers they were for.
+            for (ULONG i = 1; i < stops; ++i)
+                ::PostQueuedCompletionStatus(s_iocp, 0, IOCP_SHUTDOWN_KEY, nullptr);
+            Logger::Debug("IOCP worker thread shutting down");
+            break;
         }
     }
 
+    t_worker = nullptr;
     return 0;
 }
+
+#endif // _WIN32
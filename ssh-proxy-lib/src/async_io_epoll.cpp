@@ -0,0 +1,745 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// IoEngine — POSIX backend: completion semantics over epoll readiness
+//
+// PURPOSE
+//   The Linux counterpart of async_io.cpp, behind the same interface.  Callers
+//   see IOCP semantics — start an operation, get its result in a callback on
+//   a worker thread — while the engine itself waits for readiness and does
+//   the recv/send/connect.
+//
+// THREADS
+//   One poller thread owns the epoll set and the timer heap; a pool of
+//   worker threads (CPU count by default, as on Windows) runs the callbacks
+//   from a shared completion queue, each taking a fair share of it (at
+//   most kDequeueBatch) per lock.
+//   The poller only performs the non-blocking syscalls and queues their
+//   results, so a slow callback never delays readiness handling.  Worker
+//   affinity follows Init's plan as on Windows; the poller is not pinned.
+//
+// OPERATIONS
+//   Every Start* tries its syscall at once.  If it completes — data was
+//   waiting, the send buffer had room — the result is queued straight away;
+//   only EAGAIN / EINPROGRESS parks the context on the socket's entry in
+//   the socket table until epoll reports the socket ready.  Interest is
+//   level-triggered and follows the parked operations (EPOLLIN while a recv
+//   or accept waits, EPOLLOUT while a send or connect does).  A socket with
+//   nothing parked is not in the epoll set at all: epoll reports
+//   EPOLLHUP/EPOLLERR whatever the mask, so an idle socket that took a reset
+//   would otherwise come back from every epoll_wait.  At most one recv, one send, one
+//   connect and one accept may be parked per socket — the same
+//   one-per-direction discipline TcpConnection already keeps for IOCP.
+//
+// LOCKING
+//   Each socket's SocketOps has its own mutex, held across the syscall that
+//   tries an operation, so a worker starting a recv and the poller finishing
+//   a send on the same socket serialize — and nothing else does.  The table
+//   from fd to SocketOps is split into kSocketShards shards by fd; a shard's
+//   lock covers the map lookup, insert or erase alone, never a syscall or a
+//   SocketOps lock.  An entry that CloseSocket removed while another thread
+//   still held it is marked closed, so the late holder leaves it alone.
+//
+// ACCEPT
+//   AcceptEx fills a socket the caller created; accept4 creates its own.
+//   StartAccept keeps the AcceptEx contract: the accepted connection is
+//   dup3'd onto the caller's socket, so DirectForward's accept loop reads
+//   the same on both platforms.
+//
+// CANCELLATION
+//   CancelIo and CloseSocket complete every parked operation with
+//   ErrorCode::Shutdown, as IOCP does for an aborted operation, which takes
+//   the socket out of the epoll set; CloseSocket also drops its table entry
+//   before closing the fd, so a reused fd number never inherits it.
+//
+// TIMERS
+//   PostWorkAfter pushes onto a min-heap that bounds the poller's
+//   epoll_wait timeout; due items are handed to PostWork like everything
+//   else.  An eventfd in the epoll set interrupts the wait when an earlier
+//   timer arrives or the engine shuts down.
+//
+// SOCKET REUSE
+//   There is no DisconnectEx here: SupportsSocketReuse() is false and
+//   WarmSockets recycling stays off; warm (pre-connected) sockets work as on
+//   Windows.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef _WIN32
+
+#include "async_io.h"
+#include "logger.h"
+#include "instrumentation.h"
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+
+IoEngine::WorkerCounters* IoEngine::s_worker_counters = nullptr;
+int                       IoEngine::s_thread_count    = 0;
+bool                      IoEngine::s_initialized     = false;
+uint64_t                  IoEngine::s_io_thread_affinity = 0;
+
+namespace {
+
+struct Completion {
+    IoContext* ctx;
+    DWORD      bytes;
+    ErrorCode  ec;
+};
+
+// Operations parked on one socket until epoll reports it ready.  `mutex`
+// guards the rest, including the syscalls that try the operations.
+struct SocketOps {
+    std::mutex      mutex;
+    bool            closed    = false;   // removed from the table by CloseSocket
+    IoContext*      recv      = nullptr;
+    IoContext*      send      = nullptr;
+    const IoBuffer* send_bufs = nullptr;
+    size_t          send_count = 0;
+    IoContext*      connect   = nullptr;
+    IoContext*      accept    = nullptr;
+    SOCKET          accept_into = INVALID_SOCKET;   // the caller's socket (ACCEPT)
+    uint32_t        interest  = 0;   // events currently registered; 0 = not in the set
+};
+
+using SocketOpsPtr = std::shared_ptr<SocketOps>;
+
+// One slice of the socket table (see LOCKING).
+constexpr size_t kSocketShards = 64;
+struct alignas(64) SocketShard {
+    std::mutex                             mutex;
+    std::unordered_map<int, SocketOpsPtr>  sockets;
+};
+
+struct Timer {
+    uint64_t     due_ms;
+    uint64_t     seq;       // FIFO among equal due times
+    WorkFunction fn;
+};
+struct TimerLater {
+    bool operator()(const Timer& a, const Timer& b) const
+    {
+        return a.due_ms != b.due_ms ? a.due_ms > b.due_ms : a.seq > b.seq;
+    }
+};
+
+// Intentionally leaked, as in DnsResolver: the engine is process-wide and
+// usually never shut down, so its threads may still run while static
+// destructors do at exit.
+struct EngineState {
+    int                                    epoll   = -1;
+    int                                    wake_fd = -1;
+    std::thread                            poller;
+    std::vector<std::thread>               workers;
+
+    std::mutex                             queue_mutex;
+    std::condition_variable                queue_cv;
+    std::deque<Completion>                 queue;
+    bool                                   stopping = false;
+
+    SocketShard                            shards[kSocketShards];
+
+    std::mutex                             timers_mutex;
+    std::priority_queue<Timer, std::vector<Timer>, TimerLater> timers;
+    uint64_t                               timer_seq = 0;
+};
+
+EngineState& State()
+{
+    static EngineState* state = new EngineState();
+    return *state;
+}
+
+SocketShard& ShardOf(int fd)
+{
+    return State().shards[static_cast<size_t>(fd) % kSocketShards];
+}
+
+// The socket's entry, or null if it was never associated or is closed.
+SocketOpsPtr FindSocket(int fd)
+{
+    SocketShard& shard = ShardOf(fd);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sockets.find(fd);
+    return it == shard.sockets.end() ? nullptr : it->second;
+}
+
+uint64_t NowMs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Enqueue(IoContext* ctx, DWORD bytes, ErrorCode ec)
+{
+    EngineState& st = State();
+    {
+        std::lock_guard<std::mutex> lock(st.queue_mutex);
+        st.queue.push_back({ ctx, bytes, ec });
+    }
+    st.queue_cv.notify_one();
+}
+
+void WakePoller()
+{
+    EngineState& st = State();
+    uint64_t one = 1;
+    ssize_t n = ::write(st.wake_fd, &one, sizeof(one));
+    (void)n;   // a full counter already means "wake up"
+}
+
+// Re-registers the socket's interest to match its parked operations: added
+// to the set by the first one, removed once none is left.  Caller holds
+// ops.mutex.
+void UpdateInterest(int fd, SocketOps& ops)
+{
+    EngineState& st = State();
+    uint32_t want = 0;
+    if (ops.recv != nullptr)                          want |= EPOLLIN | EPOLLRDHUP;
+    if (ops.accept != nullptr)                        want |= EPOLLIN;
+    if (ops.send != nullptr || ops.connect != nullptr) want |= EPOLLOUT;
+    if (want == ops.interest) return;
+
+    epoll_event ev{};
+    ev.events  = want;
+    ev.data.fd = fd;
+    int op = want == 0 ? EPOLL_CTL_DEL : ops.interest == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (::epoll_ctl(st.epoll, op, fd, want == 0 ? nullptr : &ev) != 0)
+        Logger::Error("epoll_ctl(%d) failed: %d", op, errno);
+    ops.interest = want;
+}
+
+// Completes every parked operation with Shutdown.  Caller holds ops.mutex.
+void AbortParked(SocketOps& ops)
+{
+    for (IoContext** op : { &ops.recv, &ops.send, &ops.connect, &ops.accept })
+    {
+        if (*op != nullptr) Enqueue(*op, 0, ErrorCode::Shutdown);
+        *op = nullptr;
+    }
+    ops.send_bufs   = nullptr;
+    ops.send_count  = 0;
+    ops.accept_into = INVALID_SOCKET;
+}
+
+// One attempt at each operation.  True once it has completed (its result
+// queued); false on EAGAIN — it stays parked.
+bool TryRecv(IoContext* ctx)
+{
+    ssize_t n = ::recv(ctx->socket, ctx->buffer.iov_base, ctx->buffer.iov_len, 0);
+    if (n >= 0)
+    {
+        Enqueue(ctx, static_cast<DWORD>(n), ErrorCode::Success);
+        return true;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return false;
+    Enqueue(ctx, 0, SocketErrorToErrorCode(errno));
+    return true;
+}
+
+bool TrySend(IoContext* ctx, const IoBuffer* buffers, size_t count)
+{
+    msghdr msg{};
+    msg.msg_iov    = const_cast<IoBuffer*>(buffers);
+    msg.msg_iovlen = count;
+    ssize_t n = ::sendmsg(ctx->socket, &msg, MSG_NOSIGNAL);
+    if (n >= 0)
+    {
+        Enqueue(ctx, static_cast<DWORD>(n), ErrorCode::Success);
+        return true;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return false;
+    Enqueue(ctx, 0, SocketErrorToErrorCode(errno));
+    return true;
+}
+
+// A connection reset before it was taken (ECONNABORTED) leaves the accept
+// parked, as AcceptEx never reports one.
+bool TryAccept(IoContext* ctx, SOCKET into)
+{
+    int fd = ::accept4(ctx->socket, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED)
+            return false;
+        Enqueue(ctx, 0, SocketErrorToErrorCode(errno));
+        return true;
+    }
+    int moved = ::dup3(fd, into, O_CLOEXEC);
+    int err   = errno;
+    ::close(fd);
+    Enqueue(ctx, 0, moved < 0 ? SocketErrorToErrorCode(err) : ErrorCode::Success);
+    return true;
+}
+
+// Runs on the poller thread for each ready socket.
+void HandleReady(int fd, uint32_t events)
+{
+    SocketOpsPtr entry = FindSocket(fd);
+    if (!entry) return;                   // closed since epoll_wait returned
+    SocketOps& ops = *entry;
+    std::lock_guard<std::mutex> lock(ops.mutex);
+    if (ops.closed) return;
+
+    bool failed = (events & (EPOLLERR | EPOLLHUP)) != 0;
+    if (ops.recv != nullptr && (failed || (events & (EPOLLIN | EPOLLRDHUP)) != 0))
+    {
+        if (TryRecv(ops.recv)) ops.recv = nullptr;
+    }
+    if (ops.accept != nullptr && (failed || (events & EPOLLIN) != 0))
+    {
+        if (TryAccept(ops.accept, ops.accept_into))
+        {
+            ops.accept      = nullptr;
+            ops.accept_into = INVALID_SOCKET;
+        }
+    }
+    if (ops.connect != nullptr && (failed || (events & EPOLLOUT) != 0))
+    {
+        int       err = 0;
+        socklen_t len = sizeof(err);
+        ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        Enqueue(ops.connect, 0, SocketErrorToErrorCode(err));
+        ops.connect = nullptr;
+    }
+    if (ops.send != nullptr && (failed || (events & EPOLLOUT) != 0))
+    {
+        if (TrySend(ops.send, ops.send_bufs, ops.send_count))
+        {
+            ops.send       = nullptr;
+            ops.send_bufs  = nullptr;
+            ops.send_count = 0;
+        }
+    }
+    UpdateInterest(fd, ops);
+}
+
+// Hands due timers to the workers; returns the wait until the next one
+// (-1 = none).
+int RunDueTimers()
+{
+    EngineState& st = State();
+    std::vector<WorkFunction> due;
+    int wait_ms = -1;
+    {
+        std::lock_guard<std::mutex> lock(st.timers_mutex);
+        uint64_t now = NowMs();
+        while (!st.timers.empty() && st.timers.top().due_ms <= now)
+        {
+            due.push_back(std::move(const_cast<Timer&>(st.timers.top()).fn));
+            st.timers.pop();
+        }
+        if (!st.timers.empty())
+            wait_ms = static_cast<int>((std::min)(st.timers.top().due_ms - now, uint64_t{INT32_MAX}));
+    }
+    for (auto& fn : due) IoEngine::PostWork(std::move(fn));
+    return wait_ms;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Init
+//
+// The epoll set with its wake eventfd, then the poller and the workers.  A
+// failure before any thread starts rolls back and returns SocketError.
+// Idempotent, like the IOCP backend.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+ErrorCode IoEngine::Init(int thread_count, IoAffinity affinity, uint32_t io_processors)
+{
+    EngineState& st = State();
+    if (s_initialized)
+        return ErrorCode::Success;
+
+    ProcessorLayout layout;
+    if (affinity != IoAffinity::None)
+        layout = QueryProcessorLayout();
+    if (thread_count <= 0)
+    {
+        thread_count = static_cast<int>(std::thread::hardware_concurrency());
+        if (affinity != IoAffinity::None)
+        {
+            IoAffinityPlan probe = PlanIoAffinity(affinity, layout, 1, io_processors);
+            if (probe.io_threads != 0)
+                thread_count = ProcessorCount(layout.available & ~probe.io_threads);
+        }
+        if (thread_count < 1) thread_count = 1;
+    }
+    IoAffinityPlan plan = PlanIoAffinity(affinity, layout, thread_count, io_processors);
+
+    st.epoll   = ::epoll_create1(EPOLL_CLOEXEC);
+    st.wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (st.epoll < 0 || st.wake_fd < 0)
+    {
+        Logger::Error("epoll/eventfd setup failed: %d", errno);
+        if (st.epoll >= 0)   ::close(st.epoll);
+        if (st.wake_fd >= 0) ::close(st.wake_fd);
+        st.epoll = st.wake_fd = -1;
+        return ErrorCode::SocketError;
+    }
+    epoll_event ev{};
+    ev.events  = EPOLLIN;
+    ev.data.fd = st.wake_fd;
+    ::epoll_ctl(st.epoll, EPOLL_CTL_ADD, st.wake_fd, &ev);
+
+    {
+        std::lock_guard<std::mutex> lock(st.queue_mutex);
+        st.stopping = false;
+    }
+    s_thread_count    = thread_count;
+    s_worker_counters = new WorkerCounters[thread_count];
+    for (int i = 0; i < thread_count && !plan.workers.empty(); ++i)
+        s_worker_counters[i].affinity = plan.workers[static_cast<size_t>(i)];
+    s_io_thread_affinity = plan.io_threads;
+    st.poller = std::thread(&IoEngine::PollerThread);
+    st.workers.reserve(static_cast<size_t>(thread_count));
+    for (int i = 0; i < thread_count; ++i)
+        st.workers.emplace_back(&IoEngine::WorkerThread, &s_worker_counters[i]);
+
+    Instrumentation::Register();
+    s_initialized = true;
+    Logger::Info("IoEngine initialized with %d worker threads (epoll%s)", thread_count,
+                 plan.workers.empty() ? "" : ", pinned");
+    return ErrorCode::Success;
+}
+
+//
+// ── Shutdown ──────────────────────────────────────────────────────────────────
+//
+// Workers drain what is already queued, then exit; the poller leaves its
+// wait via the eventfd.  Pending timers are dropped, as a Windows threadpool
+// timer outliving the engine would find no IOCP to post to.
+//
+
+void IoEngine::Shutdown()
+{
+    EngineState& st = State();
+    if (!s_initialized)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(st.queue_mutex);
+        st.stopping = true;
+    }
+    st.queue_cv.notify_all();
+    WakePoller();
+
+    for (auto& t : st.workers) t.join();
+    st.workers.clear();
+    st.poller.join();
+
+    ::close(st.epoll);
+    ::close(st.wake_fd);
+    st.epoll = st.wake_fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(st.timers_mutex);
+        st.timers = {};
+    }
+    delete[] s_worker_counters;
+    s_worker_counters = nullptr;
+
+    Instrumentation::Unregister();
+    s_initialized = false;
+    Logger::Info("IoEngine shut down");
+}
+
+//
+// ── Associate ─────────────────────────────────────────────────────────────────
+//
+// Switches sock to non-blocking and enters it in the socket table; it joins
+// the epoll set when its first operation parks.
+//
+
+ErrorCode IoEngine::Associate(SOCKET sock)
+{
+    int flags = ::fcntl(sock, F_GETFL, 0);
+    if (flags < 0 || ::fcntl(sock, F_SETFL, flags | O_NONBLOCK) != 0)
+    {
+        Logger::Error("fcntl(O_NONBLOCK) failed: %d", errno);
+        return ErrorCode::SocketError;
+    }
+
+    auto ops = std::make_shared<SocketOps>();
+    SocketShard& shard = ShardOf(sock);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.sockets[sock] = std::move(ops);
+    return ErrorCode::Success;
+}
+
+// ── Sockets and operations ────────────────────────────────────────────────────
+
+SOCKET IoEngine::OpenSocket(int family, ErrorCode& error)
+{
+    SOCKET s = ::socket(family, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (s == INVALID_SOCKET)
+    {
+        error = ErrorCode::SocketError;
+        return INVALID_SOCKET;
+    }
+    ErrorCode ec = Associate(s);
+    if (ec != ErrorCode::Success)
+    {
+        ::close(s);
+        error = ec;
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+void IoEngine::CloseSocket(SOCKET sock)
+{
+    SocketOpsPtr entry;
+    {
+        SocketShard& shard = ShardOf(sock);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sockets.find(sock);
+        if (it != shard.sockets.end())
+        {
+            entry = std::move(it->second);
+            shard.sockets.erase(it);
+        }
+    }
+    if (entry)
+    {
+        std::lock_guard<std::mutex> lock(entry->mutex);
+        AbortParked(*entry);
+        UpdateInterest(sock, *entry);
+        entry->closed = true;
+    }
+    ::close(sock);
+}
+
+void IoEngine::CancelIo(SOCKET sock)
+{
+    SocketOpsPtr entry = FindSocket(sock);
+    if (!entry) return;
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (entry->closed) return;
+    AbortParked(*entry);
+    UpdateInterest(sock, *entry);
+}
+
+ErrorCode IoEngine::StartConnect(IoContext* ctx, const sockaddr* addr, int addr_len)
+{
+    SocketOpsPtr entry = FindSocket(ctx->socket);
+    if (!entry) return ErrorCode::InvalidArgument;
+    SocketOps& ops = *entry;
+    std::lock_guard<std::mutex> lock(ops.mutex);
+    if (ops.closed || ops.connect != nullptr) return ErrorCode::InvalidArgument;
+
+    if (::connect(ctx->socket, addr, static_cast<socklen_t>(addr_len)) == 0)
+    {
+        Enqueue(ctx, 0, ErrorCode::Success);
+        return ErrorCode::Success;
+    }
+    if (errno != EINPROGRESS) return SocketErrorToErrorCode(errno);
+    ops.connect = ctx;
+    UpdateInterest(ctx->socket, ops);
+    return ErrorCode::Success;
+}
+
+// Nothing to finish: POSIX has no SO_UPDATE_CONNECT_CONTEXT counterpart.
+void IoEngine::FinishConnect(SOCKET)
+{
+}
+
+ErrorCode IoEngine::StartRecv(IoContext* ctx)
+{
+    SocketOpsPtr entry = FindSocket(ctx->socket);
+    if (!entry) return ErrorCode::InvalidArgument;
+    SocketOps& ops = *entry;
+    std::lock_guard<std::mutex> lock(ops.mutex);
+    if (ops.closed || ops.recv != nullptr) return ErrorCode::InvalidArgument;
+
+    if (TryRecv(ctx)) return ErrorCode::Success;
+    ops.recv = ctx;
+    UpdateInterest(ctx->socket, ops);
+    return ErrorCode::Success;
+}
+
+ErrorCode IoEngine::StartSend(IoContext* ctx, const IoBuffer* buffers, size_t count)
+{
+    SocketOpsPtr entry = FindSocket(ctx->socket);
+    if (!entry) return ErrorCode::InvalidArgument;
+    SocketOps& ops = *entry;
+    std::lock_guard<std::mutex> lock(ops.mutex);
+    if (ops.closed || ops.send != nullptr) return ErrorCode::InvalidArgument;
+
+    if (TrySend(ctx, buffers, count)) return ErrorCode::Success;
+    ops.send       = ctx;
+    ops.send_bufs  = buffers;
+    ops.send_count = count;
+    UpdateInterest(ctx->socket, ops);
+    return ErrorCode::Success;
+}
+
+ErrorCode IoEngine::StartAccept(IoContext* ctx, SOCKET accept_socket, void* /*addr_buf*/,
+                                DWORD /*addr_len*/)
+{
+    SocketOpsPtr entry = FindSocket(ctx->socket);
+    if (!entry) return ErrorCode::InvalidArgument;
+    SocketOps& ops = *entry;
+    std::lock_guard<std::mutex> lock(ops.mutex);
+    if (ops.closed || ops.accept != nullptr) return ErrorCode::InvalidArgument;
+
+    if (TryAccept(ctx, accept_socket)) return ErrorCode::Success;
+    ops.accept      = ctx;
+    ops.accept_into = accept_socket;
+    UpdateInterest(ctx->socket, ops);
+    return ErrorCode::Success;
+}
+
+ErrorCode IoEngine::StartDisconnect(IoContext*)
+{
+    return ErrorCode::InvalidArgument;
+}
+
+bool IoEngine::SupportsSocketReuse()
+{
+    return false;
+}
+
+std::vector<uint64_t> IoEngine::GetWorkerCompletions()
+{
+    std::vector<uint64_t> out;
+    if (s_worker_counters == nullptr) return out;
+    out.reserve(static_cast<size_t>(s_thread_count));
+    for (int i = 0; i < s_thread_count; ++i)
+        out.push_back(s_worker_counters[i].completions.load(std::memory_order_relaxed));
+    return out;
+}
+
+// ── Posted work ───────────────────────────────────────────────────────────────
+
+void IoEngine::PostCompletion(IoContext* ctx, DWORD bytes)
+{
+    Enqueue(ctx, bytes, ErrorCode::Success);
+}
+
+// The worker moves the callback out of ctx before invoking it, so the
+// callback may delete its own context.
+void IoEngine::PostWork(WorkFunction fn)
+{
+    auto* ctx = new WorkContext();
+    ctx->op = IoOp::Work;
+    ctx->fn = std::move(fn);
+    ctx->callback = [](IoContext* self, DWORD, ErrorCode)
+    {
+        std::unique_ptr<WorkContext> owner(static_cast<WorkContext*>(self));
+        owner->fn();
+    };
+    PostCompletion(ctx);
+}
+
+void IoEngine::PostWorkAfter(DWORD delay_ms, WorkFunction fn)
+{
+    EngineState& st = State();
+    bool earliest = false;
+    {
+        std::lock_guard<std::mutex> lock(st.timers_mutex);
+        uint64_t due = NowMs() + delay_ms;
+        earliest = st.timers.empty() || due < st.timers.top().due_ms;
+        st.timers.push(Timer{ due, st.timer_seq++, std::move(fn) });
+    }
+    if (earliest) WakePoller();
+}
+
+//
+// ── Threads ───────────────────────────────────────────────────────────────────
+//
+// The worker loop mirrors the IOCP one: take a batch, count it, and for
+// each completion move the callback out of the context (breaking callback →
+// shared_ptr → context cycles) and call it.  The poller waits for readiness
+// or the next timer.
+//
+
+void IoEngine::PinIoThread()
+{
+    if (s_io_thread_affinity != 0 && !PinCurrentThread(s_io_thread_affinity))
+        Logger::Warn("Pinning the SSH I/O thread failed: %d", errno);
+}
+
+void IoEngine::WorkerThread(WorkerCounters* counters)
+{
+    EngineState& st = State();
+    Logger::Debug("epoll worker thread started");
+    std::atomic<uint64_t>& completions = counters->completions;
+    if (counters->affinity != 0 && !PinCurrentThread(counters->affinity))
+        Logger::Warn("Pinning epoll worker failed: %d", errno);
+
+    Completion batch[kDequeueBatch];
+    for (;;)
+    {
+        size_t count = 0;
+        {
+            std::unique_lock<std::mutex> lock(st.queue_mutex);
+            st.queue_cv.wait(lock, [&st] { return st.stopping || !st.queue.empty(); });
+            if (st.queue.empty()) break;   // stopping and drained
+            // A fair share, so one slow callback cannot hold up completions
+            // the idle workers could have run.
+            size_t take = (std::min)(kDequeueBatch,
+                (std::max)(size_t{1}, st.queue.size() / static_cast<size_t>(s_thread_count)));
+            while (count < take)
+            {
+                batch[count++] = st.queue.front();
+                st.queue.pop_front();
+            }
+        }
+
+        completions.store(completions.load(std::memory_order_relaxed) + count,
+                          std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i)
+        {
+            IoContext* ctx = batch[i].ctx;
+            if (ctx->callback)
+            {
+                IoCallback cb = std::move(ctx->callback);
+                cb(ctx, batch[i].bytes, batch[i].ec);
+            }
+        }
+    }
+    Logger::Debug("epoll worker thread shutting down");
+}
+
+void IoEngine::PollerThread()
+{
+    EngineState& st = State();
+    epoll_event events[64];
+    for (;;)
+    {
+        int wait_ms = RunDueTimers();
+        int n = ::epoll_wait(st.epoll, events, 64, wait_ms);
+        if (n < 0 && errno != EINTR)
+        {
+            Logger::Error("epoll_wait failed: %d", errno);
+            break;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            if (events[i].data.fd == st.wake_fd)
+            {
+                uint64_t drained = 0;
+                ssize_t r = ::read(st.wake_fd, &drained, sizeof(drained));
+                (void)r;
+                continue;
+            }
+            HandleReady(events[i].data.fd, events[i].events);
+        }
+
+        std::lock_guard<std::mutex> lock(st.queue_mutex);
+        if (st.stopping) break;
+    }
+}
+
+#endif // !_WIN32
@@ -0,0 +1,183 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// BufferPool — pooled, refcounted slabs for the relay data path
+//
+// PURPOSE
+//   One relayed chunk lives in one slab from the moment WSARecv (or
+//   libssh2_channel_read) fills it until the last byte is written to the
+//   other side.  Handing it on moves a reference; partial writes advance the
+//   slab's begin offset.  No per-chunk vector allocation, no copy.
+//
+// PER-THREAD CACHE + DEPOT
+//   The typical slab is acquired on one thread and released on another
+//   (IOCP worker → SSH I/O thread and back).  Each thread pushes freed slabs
+//   onto its own freelist; once that list exceeds kLocalMax, kBatch slabs
+//   move to the depot under a mutex.  A thread whose list is empty refills a
+//   batch from the depot before falling back to the heap.  The depot is
+//   capped at kDepotMax per class — beyond that slabs go back to the heap,
+//   so a burst does not pin its peak footprint forever.
+//
+// LIFETIME
+//   The depot is intentionally leaked: IOCP workers may release slabs after
+//   static destructors have run.  A thread's cache flushes to the depot when
+//   the thread exits.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "buffer_pool.h"
+#include <mutex>
+#include <new>
+
+namespace {
+
+constexpr size_t kClassCount = 3;
+constexpr size_t kLocalMax   = 64;
+constexpr size_t kBatch      = 32;
+constexpr size_t kDepotMax   = 512;
+
+constexpr size_t kClassSize[kClassCount] = {
+    BufferPool::kTinySlab, BufferPool::kSmallSlab, BufferPool::kLargeSlab
+};
+
+// Returns the size class for a capacity, or kClassCount if unpooled.
+size_t ClassOf(size_t capacity)
+{
+    for (size_t i = 0; i < kClassCount; ++i)
+        if (capacity == kClassSize[i]) return i;
+    return kClassCount;
+}
+
+Slab* NewSlab(size_t capacity)
+{
+    void* mem = ::operator new(sizeof(Slab) + capacity);
+    Slab* s = new (mem) Slab();
+    s->capacity = static_cast<uint32_t>(capacity);
+    return s;
+}
+
+void DeleteSlab(Slab* s)
+{
+    s->~Slab();
+    ::operator delete(s);
+}
+
+struct Depot {
+    std::mutex         mutex;
+    std::vector<Slab*> free[kClassCount];
+};
+
+Depot& GetDepot()
+{
+    static Depot* depot = new Depot();
+    return *depot;
+}
+
+struct ThreadCache {
+    std::vector<Slab*> free[kClassCount];
+
+    ~ThreadCache()
+    {
+        for (size_t c = 0; c < kClassCount; ++c)
+            Spill(c, free[c].size());
+    }
+
+    // Moves the last n slabs of class c to the depot (or the heap once the
+    // depot is full).
+    void Spill(size_t c, size_t n)
+    {
+        auto& local = free[c];
+        Depot& depot = GetDepot();
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        while (n-- > 0 && !local.empty())
+        {
+            Slab* s = local.back();
+            local.pop_back();
+            if (depot.free[c].size() < kDepotMax) depot.free[c].push_back(s);
+            else                                  DeleteSlab(s);
+        }
+    }
+
+    // Pulls up to kBatch slabs of class c from the depot.
+    void Refill(size_t c)
+    {
+        Depot& depot = GetDepot();
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        auto& shared = depot.free[c];
+        for (size_t i = 0; i < kBatch && !shared.empty(); ++i)
+        {
+            free[c].push_back(shared.back());
+            shared.pop_back();
+        }
+    }
+};
+
+thread_local ThreadCache t_cache;
+
+} // namespace
+
+// ── PooledBuffer ──────────────────────────────────────────────────────────────
+
+PooledBuffer::PooledBuffer(const PooledBuffer& other)
+    : m_slab(other.m_slab)
+{
+    if (m_slab != nullptr) m_slab->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PooledBuffer::Reset()
+{
+    Slab* s = m_slab;
+    m_slab = nullptr;
+    if (s != nullptr && s->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        BufferPool::Recycle(s);
+}
+
+// ── BufferPool ────────────────────────────────────────────────────────────────
+
+PooledBuffer BufferPool::Acquire(size_t min_capacity)
+{
+    size_t capacity = min_capacity <= kTinySlab  ? kTinySlab
+                    : min_capacity <= kSmallSlab ? kSmallSlab
+                    : min_capacity <= kLargeSlab ? kLargeSlab
+                    : min_capacity;
+    size_t c = ClassOf(capacity);
+
+    Slab* s = nullptr;
+    if (c < kClassCount)
+    {
+        auto& local = t_cache.free[c];
+        if (local.empty()) t_cache.Refill(c);
+        if (!local.empty())
+        {
+            s = local.back();
+            local.pop_back();
+        }
+    }
+    if (s == nullptr) s = NewSlab(capacity);
+
+    s->next.store(nullptr, std::memory_order_relaxed);
+    s->refs.store(1, std::memory_order_relaxed);
+    s->begin = 0;
+    s->end   = 0;
+    return PooledBuffer::Adopt(s);
+}
+
+PooledBuffer BufferPool::CopyOf(const uint8_t* data, size_t len)
+{
+    PooledBuffer buf = Acquire(len);
+    if (len > 0) std::memcpy(buf.tail(), data, len);
+    buf.Commit(len);
+    return buf;
+}
+
+void BufferPool::Recycle(Slab* s)
+{
+    size_t c = ClassOf(s->capacity);
+    if (c == kClassCount)
+    {
+        DeleteSlab(s);
+        return;
+    }
+    auto& local = t_cache.free[c];
+    local.push_back(s);
+    if (local.size() > kLocalMax) t_cache.Spill(c, kBatch);
+}
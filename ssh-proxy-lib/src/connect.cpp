@@ -8,40 +8,691 @@
 //   auth + remote port-forward request), then starts the SSH I/O thread.
 //
 //   The constructor throws std::runtime_error on any failure — there are no
-//   zombie Connect objects.  The destructor joins the I/O thread by calling
-//   transport.Close() before deleting Impl.
+//   zombie Connect objects.  The destructor joins the I/O threads by calling
+//   Close() on every transport before deleting Impl.
+//
+// INDEPENDENT TRANSPORTS
+//   One SshTransport is one TCP connection, one libssh2 session, one cipher
+//   stream and one I/O thread, so it tops out at roughly a core's worth of
+//   SSH crypto.  With transport_count = N the Impl holds N independent
+//   transports; transport i requests the remote forward on forward_port + i.
+//   All of them share the process-wide IoEngine, BufferPool and DnsResolver.
+//   The library does no load distribution: a channel is served by the
+//   transport whose port the client picked, and a channel cannot move to
+//   another session.  sshd binds a forward port for one session only, so
+//   there is no shared port to route from either.  Balancing, least-loaded
+//   or otherwise, is the job of whatever picks the port on the server
+//   side; GetTransportStats() shows how the load actually spread.
+//
+// REMOTE FORWARDS
+//   Each RemoteForward adds a port to every transport (remote_port + i), so
+//   transport i asks for forward_port + i and then each of those in one
+//   session.  The slot keeps the list as its `forwards`, SOCKS port first;
+//   the factory looks up the port a channel arrived on and either lets
+//   Socks5Session run the handshake or gives it the fixed target
+//   (Socks5Session::SetFixedTarget), which relays with no SOCKS bytes.
+//   A reconnect or standby takeover asks for the whole list again.
 //
 // SESSION FACTORY
 //   The on_channel lambda passed to StartAccepting bridges SshTransport and
 //   Socks5Session: it constructs a session for each accepted forwarded-tcpip
 //   channel and returns its PumpSshRead bound as a SessionPumpFn.  The SSH
-//   I/O thread calls that pump each loop iteration to drain SSH→TCP data.
+//   I/O thread calls that pump whenever the channel has data pending to
+//   drain SSH→TCP.  Each session is also recorded (weakly) in its transport's
+//   session list for GetMetrics().  Sessions are built by
+//   Socks5Session::Create from the transport's SessionPool, so a session and
+//   its TcpConnection share one recycled block rather than two allocations.
+//   Before Start() each session gets its AdmissionTicket from the Impl's
+//   AdmissionControl, which all transports share, so the limits hold for
+//   the Connect as a whole.
+//
+// RECONNECT
+//   Without a ReconnectPolicy a dropped transport stays down, as before.
+//   With one, each Transport slot holds its SshTransport behind a
+//   shared_ptr that a supervisor thread swaps for a new one after a drop:
+//   the I/O thread's on_disconnect only queues a notice, the supervisor
+//   re-establishes the slot (immediately, then on a ReconnectBackoff
+//   schedule) and installs the result under supervisor_mutex unless Cancel
+//   got there first.  A hot standby — connected, authenticated, forwarding
+//   nothing — turns the reconnect into one tcpip-forward request
+//   (SshTransport::RequestForward).  Replaced transports are retired, not
+//   destroyed: the channel hooks of sessions still finishing point back at
+//   them, so they go once HasLiveChannels() says the last one is gone.
+//
+// METRICS
+//   Nothing is aggregated on the data path: GetMetrics() reads the relaxed
+//   counters of every transport, live session and IOCP worker when called.
+//   Rates are derived against the previous call's totals (rates_mutex).  The
+//   optional periodic dump is a self-rescheduling PostWorkAfter chain whose
+//   shared MetricsDump state is detached under its mutex when stopped, so a
+//   timer that fires late finds nothing to do.
 //
 //////////////////////////////////////////////////////////////////////////////
 
 #include "../public/ssh_proxy.h"
+#include "admission.h"
 #include "ssh_transport.h"
 #include "socks5_session.h"
 #include "logger.h"
 #include "ssh_config.h"
 #include "async_io.h"
+#include "dns_resolver.h"
+#include "instrumentation.h"
+#include "reconnect.h"
+#include "warm_sockets.h"
 #include <stdexcept>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 namespace ssh_proxy {
 
     // ── Connect::Impl ─────────────────────────────────────────────────────────────
 
     struct Connect::Impl {
-        ConnectionConfig  config;
-        SshTransport      transport;
-        std::atomic<bool> connected{false};
+        struct SessionRef {
+            uint64_t                     id = 0;
+            uint16_t                     forward_port = 0;
+            std::weak_ptr<Socks5Session> session;
+        };
+
+        // One remote port of a transport and what its channels get.
+        struct Forward {
+            uint16_t                 port  = 0;
+            bool                     fixed = false;   // false: SOCKS5
+            Socks5::ConnectRequest   target;          // when fixed
+        };
+
+        struct Transport {
+            uint16_t              forward_port = 0;   // the SOCKS port, forwards[0]
+            std::vector<Forward>  forwards;
+            std::atomic<bool>     connected{false};
+            std::atomic<uint32_t> reconnects{0};
+
+            // The slot's current SSH session; the supervisor replaces it
+            // after a drop, everyone else takes a reference.
+            mutable std::mutex            transport_mutex;
+            std::shared_ptr<SshTransport> transport;
+
+            std::shared_ptr<SshTransport> Current() const
+            {
+                std::lock_guard<std::mutex> lock(transport_mutex);
+                return transport;
+            }
+
+            // Storage for this transport's sessions, recycled across channels.
+            std::shared_ptr<SessionPool> session_pool = SessionPool::Create();
+
+            // Live sessions for GetMetrics().  Touched once per channel on
+            // the I/O thread and by metrics readers — never on the data path.
+            std::mutex               sessions_mutex;
+            std::vector<SessionRef>  sessions;
+            size_t                   prune_at = 64;   // erase expired refs at this size
+
+            std::vector<uint16_t> Ports() const
+            {
+                std::vector<uint16_t> ports;
+                for (const Forward& f : forwards) ports.push_back(f.port);
+                return ports;
+            }
+
+            const Forward* ForwardFor(uint16_t port) const
+            {
+                for (const Forward& f : forwards)
+                    if (f.port == port) return &f;
+                return nullptr;
+            }
+
+            void AddSession(uint64_t id, uint16_t port,
+                            const std::shared_ptr<Socks5Session>& session)
+            {
+                std::lock_guard<std::mutex> lock(sessions_mutex);
+                if (sessions.size() >= prune_at)
+                {
+                    sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+                        [](const SessionRef& r) { return r.session.expired(); }),
+                        sessions.end());
+                    prune_at = (std::max)(size_t{64}, sessions.size() * 2);
+                }
+                sessions.push_back(SessionRef{ id, port, session });
+            }
+        };
+
+        ConnectionConfig                         config;
+        SshAuth                                  auth;   // key material shared by every transport
+        std::vector<std::unique_ptr<Transport>>  transports;
+        std::atomic<uint64_t>                    next_session_id{1};
+        std::shared_ptr<AdmissionControl>        admission;
+        const int64_t                            started = QpcNow();
+
+        // Totals at the previous GetMetrics(), for the *_per_sec fields.
+        std::mutex                               rates_mutex;
+        int64_t                                  rates_at = started;
+        std::vector<uint64_t>                    last_loop_iterations;
+        std::vector<uint64_t>                    last_completions;
+
+        // Shared between the Impl and the dump timer; `impl` is cleared
+        // under `mutex` when the dump stops.
+        struct MetricsDump {
+            std::mutex   mutex;
+            Impl*        impl = nullptr;
+            uint32_t     interval_ms = 0;
+            MetricsSink  sink;
+        };
+        std::shared_ptr<MetricsDump>             dump;   // guarded by dump_mutex
+        std::mutex                               dump_mutex;
+
+        // Reconnect supervisor (see RECONNECT).  `stopping` and `drops` are
+        // written under supervisor_mutex; `standby` and `retired` belong to
+        // the supervisor thread.
+        std::thread                                 supervisor;
+        std::mutex                                  supervisor_mutex;
+        std::condition_variable                     supervisor_cv;
+        std::atomic<bool>                           stopping{false};
+        std::vector<const SshTransport*>            drops;
+        std::shared_ptr<SshTransport>               standby;
+        std::vector<std::shared_ptr<SshTransport>>  retired;
 
         Impl() = default;
+
+        // Stops the dump, every I/O thread and the supervisor before any
+        // member goes away — the session factories, drop handlers and the
+        // dump timer capture this Impl.
+        ~Impl()
+        {
+            StopDump();
+            CloseAll();
+            if (supervisor.joinable()) supervisor.join();
+        }
+
+        void CloseAll()
+        {
+            {
+                std::lock_guard<std::mutex> lock(supervisor_mutex);
+                stopping.store(true);
+            }
+            supervisor_cv.notify_all();
+            for (auto& t : transports) t->Current()->Close();
+        }
+
+        void StopDump()
+        {
+            std::shared_ptr<MetricsDump> d;
+            {
+                std::lock_guard<std::mutex> lock(dump_mutex);
+                d.swap(dump);
+            }
+            if (d)
+            {
+                // Waits out a sink call in progress.
+                std::lock_guard<std::mutex> lock(d->mutex);
+                d->impl = nullptr;
+            }
+        }
+
+        static TransportStats ToPublic(const Transport& t);
+        Metrics Collect();
+        static void ScheduleDump(std::shared_ptr<MetricsDump> d);
+
+        Result ConnectTransport(SshTransport& st, const std::vector<uint16_t>& ports) const;
+        SshTransport::OnChannelAccepted SessionFactory(Transport* slot);
+        SshTransport::OnDisconnected    DropHandler(Transport* slot, const SshTransport* which);
+        void OnDropped(Transport* slot, const SshTransport* which, ErrorCode reason);
+
+        // Supervisor thread.
+        void   SupervisorProc();
+        Result Reestablish(Transport& t);
+        bool   Install(Transport& t, std::shared_ptr<SshTransport> fresh, bool start);
+        Result BuildStandby();
+        Transport* Find(const SshTransport* which) const;
+        void   Retire(std::shared_ptr<SshTransport> t);
+        void   PruneRetired();
     };
 
+    TransportStats Connect::Impl::ToPublic(const Transport& t)
+    {
+        std::shared_ptr<SshTransport> current = t.Current();
+        SshTransport::Stats st = current->GetStats();
+        TransportStats ts;
+        ts.forward_port         = t.forward_port;
+        ts.connected            = t.connected.load();
+        ts.reconnects           = t.reconnects.load(std::memory_order_relaxed);
+        if (ts.connected)
+        {
+            const SshNegotiated& n = current->Negotiated();
+            ts.kex         = n.kex;
+            ts.host_key    = n.host_key;
+            ts.cipher      = n.cipher;
+            ts.mac         = n.mac;
+            ts.compression = n.compression;
+        }
+        ts.channels_accepted    = st.channels_accepted;
+        ts.channels_open        = st.channels_open;
+        ts.bytes_received       = st.bytes_received;
+        ts.bytes_sent           = st.bytes_sent;
+        ts.io_loop_iterations   = st.loop_iterations;
+        ts.eagain_reads         = st.eagain_reads;
+        ts.eagain_writes        = st.eagain_writes;
+        ts.drain_write_us_total = st.drain_write_us;
+        ts.drain_write_us_max   = st.drain_write_us_max;
+        ts.rtt_us               = st.rtt_us;
+        return ts;
+    }
+
+    //
+    // ── Impl::Collect ─────────────────────────────────────────────────────────────
+    //
+    // Gathers one Metrics snapshot.  Session stats are read through a locked
+    // weak_ptr so a session finishing mid-walk is either fully reported or
+    // skipped; the registry lock is held only while copying the refs.
+    //
+
+    Metrics Connect::Impl::Collect()
+    {
+        Metrics m;
+        for (const auto& t : transports)
+        {
+            m.transports.push_back(ToPublic(*t));
+
+            std::vector<SessionRef> refs;
+            {
+                std::lock_guard<std::mutex> lock(t->sessions_mutex);
+                refs = t->sessions;
+            }
+            for (const auto& r : refs)
+            {
+                auto session = r.session.lock();
+                if (!session) continue;
+                Socks5Session::Stats st = session->GetStats();
+                if (st.state == SessionState::Closed) continue;
+
+                SessionStats ss;
+                ss.id                 = r.id;
+                ss.forward_port       = r.forward_port;
+                ss.state              = st.state;
+                ss.target             = std::move(st.target);
+                ss.bytes_to_target    = st.bytes_to_target;
+                ss.bytes_to_client    = st.bytes_to_client;
+                ss.connect_latency_us = st.connect_latency_us;
+                ss.queued_to_target   = st.queued_to_target;
+                ss.queued_to_client   = st.queued_to_client;
+                m.sessions.push_back(std::move(ss));
+            }
+        }
+
+        std::vector<uint64_t> completions = IoEngine::GetWorkerCompletions();
+        for (uint64_t c : completions)
+        {
+            WorkerStats w;
+            w.completions = c;
+            m.workers.push_back(w);
+        }
+
+        m.latency.socks_connect    = Instrumentation::Summarize(LatencyPoint::SocksConnect);
+        m.latency.dns_resolve      = Instrumentation::Summarize(LatencyPoint::DnsResolve);
+        m.latency.tcp_connect      = Instrumentation::Summarize(LatencyPoint::TcpConnect);
+        m.latency.io_loop_tick     = Instrumentation::Summarize(LatencyPoint::IoLoopTick);
+        m.latency.write_queue_wait = Instrumentation::Summarize(LatencyPoint::WriteQueueWait);
+        m.admission                = admission->GetStats();
+
+        std::lock_guard<std::mutex> lock(rates_mutex);
+        int64_t now  = QpcNow();
+        m.uptime_ms  = static_cast<uint64_t>(QpcToSeconds(now - started) * 1000.0);
+        m.interval_s = QpcToSeconds(now - rates_at);
+        last_loop_iterations.resize(m.transports.size(), 0);
+        last_completions.resize(m.workers.size(), 0);
+        if (m.interval_s > 0)
+        {
+            for (size_t i = 0; i < m.transports.size(); ++i)
+                m.transports[i].io_loop_iterations_per_sec =
+                    static_cast<double>(m.transports[i].io_loop_iterations -
+                                        last_loop_iterations[i]) / m.interval_s;
+            for (size_t i = 0; i < m.workers.size(); ++i)
+                m.workers[i].completions_per_sec =
+                    static_cast<double>(m.workers[i].completions - last_completions[i]) /
+                    m.interval_s;
+        }
+        for (size_t i = 0; i < m.transports.size(); ++i)
+            last_loop_iterations[i] = m.transports[i].io_loop_iterations;
+        for (size_t i = 0; i < m.workers.size(); ++i)
+            last_completions[i] = m.workers[i].completions;
+        rates_at = now;
+        return m;
+    }
+
+    void Connect::Impl::ScheduleDump(std::shared_ptr<MetricsDump> d)
+    {
+        DWORD delay_ms = d->interval_ms;
+        IoEngine::PostWorkAfter(delay_ms, [d = std::move(d)]()
+        {
+            std::lock_guard<std::mutex> lock(d->mutex);
+            if (d->impl == nullptr) return;   // stopped or replaced
+            d->sink(FormatMetricsJson(d->impl->Collect()));
+            ScheduleDump(d);
+        });
+    }
+
+    Result Connect::Impl::ConnectTransport(SshTransport& st,
+                                           const std::vector<uint16_t>& ports) const
+    {
+        // Blocking connect (TCP + SSH handshake + auth + port-forward requests)
+        return st.Connect(config.server_host,
+                          config.server_port,
+                          auth,
+                          config.ssh_algorithms,
+                          ports,
+                          config.connect_timeout_ms,
+                          config.keepalive_interval_ms);
+    }
+
+    //
+    // ── Impl::SessionFactory / DropHandler ────────────────────────────────────────
+    //
+    // The two callbacks every transport of a slot is started with.  Both run
+    // on that transport's I/O thread; `slot` outlives them (Transports are
+    // never removed), `which` is only compared, never dereferenced, once the
+    // notice reaches the supervisor.
+    //
+
+    SshTransport::OnChannelAccepted Connect::Impl::SessionFactory(Transport* slot)
+    {
+        return [this, slot](uint16_t port,
+                            std::unique_ptr<SshChannel> ch) -> SshTransport::SessionPumpFn
+        {
+            const Forward* fwd = slot->ForwardFor(port);
+            if (fwd == nullptr) return {};   // not one of ours; the channel is dropped
+
+            RelayOptions opts;
+            opts.high_watermark      = config.relay_high_watermark;
+            opts.low_watermark       = config.relay_low_watermark;
+            opts.recv_min            = config.recv_buffer_min;
+            opts.recv_max            = config.recv_buffer_max;
+            opts.send_batch_bytes    = config.send_batch_max_bytes;
+            opts.send_batch_segments = config.send_batch_max_segments;
+            auto session = Socks5Session::Create(std::move(ch), opts, *slot->session_pool);
+            session->SetAdmission(admission->Admit());
+            if (fwd->fixed) session->SetFixedTarget(fwd->target);
+            slot->AddSession(next_session_id.fetch_add(1), port, session);
+            session->Start();
+            return [session]() -> bool
+            {
+                return session->PumpSshRead();
+            };
+        };
+    }
+
+    SshTransport::OnDisconnected Connect::Impl::DropHandler(Transport* slot,
+                                                            const SshTransport* which)
+    {
+        return [this, slot, which](ErrorCode reason)
+        {
+            OnDropped(slot, which, reason);
+        };
+    }
+
+    void Connect::Impl::OnDropped(Transport* slot, const SshTransport* which, ErrorCode reason)
+    {
+        if (slot != nullptr && slot->Current().get() == which)
+        {
+            Logger::Warn("SSH session disconnected (forward port %u): %s",
+                         static_cast<unsigned>(slot->forward_port),
+                         ErrorCodeToString(reason));
+            slot->connected.store(false);
+        }
+        if (!config.reconnect_enabled) return;
+
+        {
+            std::lock_guard<std::mutex> lock(supervisor_mutex);
+            if (stopping.load()) return;
+            drops.push_back(which);
+        }
+        supervisor_cv.notify_one();
+    }
+
+    //////////////////////////////////////////////////////////////////////////////
+    //
+    // Impl::SupervisorProc — the reconnect supervisor thread
+    //
+    // Each pass: resolve the drop notices to slots (a notice for a transport
+    // that is no longer current, or is connected again, is stale), run every
+    // retry that is due, rebuild the standby if one is wanted, then destroy
+    // retired transports whose channels are all gone.  The blocking connects
+    // run without supervisor_mutex, so drop notices and Cancel() are never
+    // held up; a Cancel() during a connect waits for it (connect_timeout_ms)
+    // when the destructor joins.
+    //
+    //////////////////////////////////////////////////////////////////////////////
+
+    void Connect::Impl::SupervisorProc()
+    {
+        struct Retry {
+            Transport*       slot;
+            ReconnectBackoff backoff;
+            uint64_t        at;   // GetTickCount64
+        };
+        const uint32_t initial_ms = config.reconnect_initial_backoff_ms;
+        const uint32_t max_ms     = config.reconnect_max_backoff_ms;
+        const uint32_t seed       = static_cast<uint32_t>(QpcNow());
+
+        std::vector<Retry> retries;
+        ReconnectBackoff   standby_backoff(initial_ms, max_ms, seed);
+        uint64_t          standby_at = 0;
+
+        std::unique_lock<std::mutex> lock(supervisor_mutex);
+        while (!stopping.load())
+        {
+            std::vector<const SshTransport*> notices;
+            notices.swap(drops);
+            lock.unlock();
+
+            uint64_t now = ::GetTickCount64();
+            for (const SshTransport* which : notices)
+            {
+                if (standby && standby.get() == which)
+                {
+                    Logger::Warn("Hot standby SSH session dropped");
+                    Retire(std::move(standby));
+                    standby_at = now + standby_backoff.Next();
+                    continue;
+                }
+                Transport* slot = Find(which);
+                if (slot == nullptr || which->IsConnected()) continue;
+                slot->connected.store(false);
+                bool queued = std::any_of(retries.begin(), retries.end(),
+                    [slot](const Retry& r) { return r.slot == slot; });
+                if (queued) continue;
+                Logger::Info("Reconnecting forward port %u",
+                             static_cast<unsigned>(slot->forward_port));
+                retries.push_back(Retry{ slot,
+                    ReconnectBackoff(initial_ms, max_ms, seed + slot->forward_port), now });
+            }
+
+            for (auto it = retries.begin(); it != retries.end() && !stopping.load();)
+            {
+                if (it->at > ::GetTickCount64()) { ++it; continue; }
+                Result r = Reestablish(*it->slot);
+                if (r.ok() || r.code == ErrorCode::Shutdown)
+                {
+                    it = retries.erase(it);
+                    continue;
+                }
+                uint32_t delay = it->backoff.Next();
+                Logger::Warn("Reconnect of forward port %u failed (attempt %u): %s — retrying in %u ms",
+                             static_cast<unsigned>(it->slot->forward_port),
+                             it->backoff.attempts(), r.what(), delay);
+                it->at = ::GetTickCount64() + delay;
+                ++it;
+            }
+
+            if (config.hot_standby && !standby && !stopping.load() &&
+                ::GetTickCount64() >= standby_at)
+            {
+                Result r = BuildStandby();
+                if (r.ok())
+                {
+                    standby_backoff.Reset();
+                }
+                else
+                {
+                    uint32_t delay = standby_backoff.Next();
+                    Logger::Warn("Hot standby connect failed: %s — retrying in %u ms",
+                                 r.what(), delay);
+                    standby_at = ::GetTickCount64() + delay;
+                }
+            }
+
+            PruneRetired();
+
+            // Sleep until the next retry or standby build is due; retired
+            // transports are looked at again every second.
+            now = ::GetTickCount64();
+            uint64_t wake = ULLONG_MAX;
+            for (const Retry& r : retries) wake = (std::min)(wake, r.at);
+            if (config.hot_standby && !standby) wake = (std::min)(wake, standby_at);
+            if (!retired.empty()) wake = (std::min)(wake, now + 1000);
+
+            lock.lock();
+            if (stopping.load() || !drops.empty()) continue;
+            if (wake == ULLONG_MAX)
+                supervisor_cv.wait(lock);
+            else if (wake > now)
+                supervisor_cv.wait_for(lock, std::chrono::milliseconds(wake - now));
+        }
+        lock.unlock();
+
+        standby.reset();
+        retired.clear();
+    }
+
+    //
+    // ── Impl::Reestablish ─────────────────────────────────────────────────────────
+    //
+    // Serves the slot's forward port again.  With a live standby that is one
+    // tcpip-forward request on it; a refusal keeps the standby (the server
+    // most likely still holds the old forward) while a standby that does not
+    // answer within connect_timeout_ms is given up.  Without one it is a full
+    // Connect().  ErrorCode::Shutdown: Cancel() came first, nothing installed.
+    //
+
+    Result Connect::Impl::Reestablish(Transport& t)
+    {
+        if (standby && standby->IsConnected())
+        {
+            auto done = std::make_shared<std::promise<Result>>();
+            std::future<Result> result = done->get_future();
+            standby->RequestForward(t.Ports(), SessionFactory(&t),
+                                    [done](Result r) { done->set_value(std::move(r)); });
+            if (result.wait_for(std::chrono::milliseconds(config.connect_timeout_ms)) !=
+                std::future_status::ready)
+            {
+                Retire(std::move(standby));
+                return { ErrorCode::ConnectionTimeout,
+                         "hot standby did not answer the tcpip-forward request" };
+            }
+            Result r = result.get();
+            if (!r.ok()) return r;
+
+            std::shared_ptr<SshTransport> promoted = std::move(standby);
+            if (!Install(t, std::move(promoted), /*start=*/false))
+                return Result(ErrorCode::Shutdown);
+            Logger::Info("Hot standby took over forward port %u",
+                         static_cast<unsigned>(t.forward_port));
+            return {};
+        }
+
+        auto fresh = std::make_shared<SshTransport>();
+        Result r = ConnectTransport(*fresh, t.Ports());
+        if (!r.ok()) return r;
+        if (!Install(t, std::move(fresh), /*start=*/true))
+            return Result(ErrorCode::Shutdown);
+        Logger::Info("Reconnected forward port %u", static_cast<unsigned>(t.forward_port));
+        return {};
+    }
+
+    // Makes `fresh` the slot's transport unless Cancel() already ran — under
+    // supervisor_mutex, so CloseAll() either sees it or is seen first.  An
+    // uninstalled transport is closed by its last reference going.
+    bool Connect::Impl::Install(Transport& t, std::shared_ptr<SshTransport> fresh, bool start)
+    {
+        std::shared_ptr<SshTransport> old;
+        {
+            std::lock_guard<std::mutex> lock(supervisor_mutex);
+            if (stopping.load()) return false;
+            {
+                std::lock_guard<std::mutex> tlock(t.transport_mutex);
+                old = t.transport;
+                t.transport = fresh;
+            }
+            t.connected.store(true);
+            t.reconnects.fetch_add(1, std::memory_order_relaxed);
+            if (start)
+                fresh->StartAccepting(SessionFactory(&t), DropHandler(&t, fresh.get()));
+        }
+        Retire(std::move(old));
+        return true;
+    }
+
+    // A connected session with no forward whose loop only runs keepalives
+    // until Reestablish hands it a port.  Its drop handler has no slot: the
+    // supervisor resolves a promoted standby's drop through Find().
+    Result Connect::Impl::BuildStandby()
+    {
+        auto st = std::make_shared<SshTransport>();
+        Result r = ConnectTransport(*st, {});
+        if (!r.ok()) return r;
+        st->StartAccepting({}, DropHandler(nullptr, st.get()));
+        standby = std::move(st);
+        Logger::Info("Hot standby SSH session ready");
+        return {};
+    }
+
+    Connect::Impl::Transport* Connect::Impl::Find(const SshTransport* which) const
+    {
+        for (const auto& t : transports)
+            if (t->Current().get() == which) return t.get();
+        return nullptr;
+    }
+
+    void Connect::Impl::Retire(std::shared_ptr<SshTransport> t)
+    {
+        if (t) retired.push_back(std::move(t));
+    }
+
+    void Connect::Impl::PruneRetired()
+    {
+        // Destroying a transport joins its (finished) I/O thread, whose drop
+        // handler may still be waiting for supervisor_mutex — never held here.
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+            [](const std::shared_ptr<SshTransport>& t) { return !t->HasLiveChannels(); }),
+            retired.end());
+    }
+
+    namespace {
+
+    ::IoAffinity ToEngineAffinity(IoAffinity a)
+    {
+        switch (a)
+        {
+        case IoAffinity::Core:     return ::IoAffinity::Core;
+        case IoAffinity::NumaNode: return ::IoAffinity::NumaNode;
+        default:                   return ::IoAffinity::None;
+        }
+    }
+
+    // Connect instances constructed and not yet destroyed.  The process-wide
+    // services they share outlive each one; the last to go cancels what they
+    // still have running (DNS lookups).
+    std::atomic<int> g_live_connects{0};
+
+    } // namespace
+
     //////////////////////////////////////////////////////////////////////////////
     //
     // Constructor
@@ -50,11 +701,18 @@ namespace ssh_proxy {
     // between allocation and the final guard.release() automatically destroys
     // all resources without per-branch cleanup.
     //
-    //   Step 1  Validate config (throws on bad input before any I/O)
-    //   Step 2  IoEngine::Init — Winsock, IOCP, worker threads (idempotent)
+    //   Step 1  Validate config (throws on bad input before any I/O) and load
+    //           the private key, if any (SshKeyCache)
+    //   Step 2  IoEngine::Init — Winsock, IOCP, worker threads and their
+    //           affinity (idempotent: the first Connect's IoThreadOptions win);
+    //           DnsResolver cache limits, WarmSockets options
     //   Step 3  libssh2_init (idempotent)
-    //   Step 4  SshTransport::Connect — TCP + handshake + auth + port-forward
-    //   Step 5  StartAccepting — launches SSH I/O thread, registers session factory
+    //   Step 4  SshTransport::Connect — TCP + handshake + auth + port-forwards,
+    //           once per transport (forward_port + i, each remote_port + i)
+    //   Step 5  StartAccepting — launches each SSH I/O thread, registers the
+    //           session factory
+    //   Step 6  With a reconnect policy: the supervisor thread, which also
+    //           builds the hot standby
     //
     //////////////////////////////////////////////////////////////////////////////
 
@@ -66,7 +724,15 @@ namespace ssh_proxy {
         uint16_t     forward_port,
         uint32_t     connect_timeout_ms,
         uint32_t     keepalive_interval_ms,
-        LogLevel     log_level)
+        LogLevel     log_level,
+        uint32_t     transport_count,
+        const ReconnectPolicy& reconnect,
+        const AuthOptions&     auth,
+        const SshAlgorithms&   algorithms,
+        const WarmConnectOptions& warm,
+        const IoThreadOptions&    io_threads,
+        const AdmissionLimits&    admission,
+        const std::vector<RemoteForward>& forwards)
     {
         std::unique_ptr<Impl> guard(new Impl());
 
@@ -78,79 +744,313 @@ namespace ssh_proxy {
         guard->config.connect_timeout_ms    = connect_timeout_ms;
         guard->config.keepalive_interval_ms = keepalive_interval_ms;
         guard->config.log_level             = log_level;
+        guard->config.transport_count       = transport_count;
+        guard->config.reconnect_enabled            = reconnect.enabled;
+        guard->config.reconnect_initial_backoff_ms = reconnect.initial_backoff_ms;
+        guard->config.reconnect_max_backoff_ms     = reconnect.max_backoff_ms;
+        guard->config.hot_standby                  = reconnect.hot_standby;
+        guard->config.ssh_algorithms               = algorithms;
+        guard->config.warm                         = warm;
+        guard->config.io_threads                   = io_threads;
+        guard->config.admission                    = admission;
+        guard->config.forwards                     = forwards;
 
         // Validate before doing any I/O (throws std::runtime_error on bad input).
         guard->config.validate();
 
+        // Load the private key once for all transports and reconnects.
+        Result auth_result = MakeSshAuth(guard->config.username, guard->config.password,
+                                         auth, guard->auth);
+        if (!auth_result.ok())
+            throw std::runtime_error(auth_result.what());
+
         Logger::SetMinLevel(log_level);
+        guard->admission = AdmissionControl::Create(admission);
 
         // Initialize IOCP engine (idempotent)
-        ErrorCode ec = IoEngine::Init(0);
+        ErrorCode ec = IoEngine::Init(static_cast<int>(io_threads.workers),
+                                      ToEngineAffinity(io_threads.affinity),
+                                      io_threads.io_processors);
         if (ec != ErrorCode::Success)
             throw std::runtime_error(std::string("IoEngine init failed: ") + ErrorCodeToString(ec));
 
+        DnsResolver::Configure(guard->config.dns_cache_max_entries,
+                               guard->config.dns_cache_ttl_ms,
+                               guard->config.dns_negative_ttl_ms,
+                               guard->config.dns_timeout_ms);
+
+        WarmSockets::Options warm_options;
+        warm_options.per_target   = warm.per_target;
+        warm_options.hot_connects = warm.hot_connects;
+        warm_options.max_idle_ms  = warm.max_idle_ms;
+        warm_options.max_targets  = warm.max_targets;
+        warm_options.recycle      = warm.recycle_sockets;
+        WarmSockets::Configure(warm_options);
+
         // Initialize libssh2 (idempotent)
         if (::libssh2_init(0) != 0)
             throw std::runtime_error("libssh2_init failed");
 
         const auto& cfg = guard->config;
+        Impl* impl = guard.get();
+
+        for (uint32_t i = 0; i < cfg.transport_count; ++i)
+        {
+            auto t = std::make_unique<Impl::Transport>();
+            t->forward_port = static_cast<uint16_t>(cfg.forward_port + i);
+            t->forwards.push_back(Impl::Forward{ t->forward_port, false, {} });
+            for (const RemoteForward& f : cfg.forwards)
+            {
+                Impl::Forward fwd;
+                fwd.port  = static_cast<uint16_t>(f.remote_port + i);
+                fwd.fixed = !f.target_host.empty();
+                if (fwd.fixed) fwd.target = Socks5::MakeConnectRequest(f.target_host, f.target_port);
+                t->forwards.push_back(std::move(fwd));
+            }
 
-        // Blocking connect (TCP + SSH handshake + auth + port-forward request)
-        auto connect_result = guard->transport.Connect(
-            cfg.server_host,
-            cfg.server_port,
-            cfg.username,
-            cfg.password,
-            cfg.forward_port,
-            cfg.connect_timeout_ms,
-            cfg.keepalive_interval_ms);
+            auto st = std::make_shared<SshTransport>();
+            auto connect_result = impl->ConnectTransport(*st, t->Ports());
+            if (!connect_result.ok())
+                throw std::runtime_error(connect_result.what());
 
-        if (!connect_result.ok())
-            throw std::runtime_error(connect_result.what());
+            t->transport = st;
+            t->connected.store(true);
+            Impl::Transport* raw = t.get();
+            impl->transports.push_back(std::move(t));
 
-        guard->connected.store(true);
+            // Start the channel-accept loop on this transport's I/O thread.
+            // on_channel returns a pump function that the transport auto-registers.
+            st->StartAccepting(impl->SessionFactory(raw), impl->DropHandler(raw, st.get()));
+        }
 
-        // Start the channel-accept loop on the internal I/O thread.
-        // on_channel returns a pump function that the transport auto-registers.
-        Impl* impl = guard.get();
-        impl->transport.StartAccepting(
-            [impl](std::unique_ptr<SshChannel> ch) -> SshTransport::SessionPumpFn
-            {
-                auto session = std::make_shared<Socks5Session>(std::move(ch));
-                session->Start();
-                return [session]() -> bool
-                {
-                    return session->PumpSshRead();
-                };
-            },
-            [impl](ErrorCode reason)
-            {
-                Logger::Warn("SSH session disconnected: %s", ErrorCodeToString(reason));
-                impl->connected.store(false);
-            });
+        if (cfg.transport_count > 1)
+            Logger::Info("Independent transports: %u SSH sessions on forward ports %u-%u",
+                         cfg.transport_count, static_cast<unsigned>(cfg.forward_port),
+                         static_cast<unsigned>(cfg.forward_port + cfg.transport_count - 1));
+        for (const RemoteForward& f : cfg.forwards)
+        {
+            if (f.target_host.empty())
+                Logger::Info("SOCKS5 forward on remote port %u", static_cast<unsigned>(f.remote_port));
+            else
+                Logger::Info("Fixed forward: remote port %u -> %s:%u",
+                             static_cast<unsigned>(f.remote_port), f.target_host.c_str(),
+                             static_cast<unsigned>(f.target_port));
+        }
+
+        // Started last: it reads `transports`, which is complete from here on.
+        if (cfg.reconnect_enabled)
+            impl->supervisor = std::thread(&Impl::SupervisorProc, impl);
 
         m_impl = guard.release();
+        g_live_connects.fetch_add(1);
     }
 
     Connect::~Connect()
     {
         if (m_impl != nullptr)
         {
-            m_impl->transport.Close();
+            m_impl->CloseAll();
             delete m_impl;
             m_impl = nullptr;
+            if (g_live_connects.fetch_sub(1) == 1)
+                DnsResolver::CancelAll();
         }
     }
 
     void Connect::Cancel()
     {
         if (m_impl != nullptr)
-            m_impl->transport.Close();
+            m_impl->CloseAll();
     }
 
     bool Connect::IsConnected() const
     {
-        return m_impl != nullptr && m_impl->connected.load();
+        if (m_impl == nullptr) return false;
+        for (const auto& t : m_impl->transports)
+            if (t->connected.load()) return true;
+        return false;
+    }
+
+    bool Connect::IsRunning() const
+    {
+        if (m_impl == nullptr) return false;
+        if (!m_impl->config.reconnect_enabled) return IsConnected();
+        return !m_impl->stopping.load();
+    }
+
+    std::vector<TransportStats> Connect::GetTransportStats() const
+    {
+        std::vector<TransportStats> out;
+        if (m_impl == nullptr) return out;
+        out.reserve(m_impl->transports.size());
+        for (const auto& t : m_impl->transports)
+            out.push_back(Impl::ToPublic(*t));
+        return out;
+    }
+
+    Metrics Connect::GetMetrics() const
+    {
+        return m_impl != nullptr ? m_impl->Collect() : Metrics{};
+    }
+
+    void Connect::SetMetricsDump(uint32_t interval_ms, MetricsSink sink)
+    {
+        if (m_impl == nullptr) return;
+        m_impl->StopDump();
+        if (interval_ms == 0 || !sink) return;
+
+        auto d = std::make_shared<Impl::MetricsDump>();
+        d->impl        = m_impl;
+        d->interval_ms = interval_ms;
+        d->sink        = std::move(sink);
+        {
+            std::lock_guard<std::mutex> lock(m_impl->dump_mutex);
+            m_impl->dump = d;
+        }
+        Impl::ScheduleDump(std::move(d));
+    }
+
+    //
+    // ── FormatMetricsJson ─────────────────────────────────────────────────────────
+    //
+    // Single line, stable key order, so successive dumps can be diffed or
+    // appended to a JSON-lines file.  Session targets come from the SOCKS
+    // client and are escaped.
+    //
+
+    namespace {
+
+    const char* SessionStateName(SessionState s)
+    {
+        switch (s) {
+        case SessionState::Handshake:  return "handshake";
+        case SessionState::Connecting: return "connecting";
+        case SessionState::Relaying:   return "relaying";
+        case SessionState::Closed:     return "closed";
+        }
+        return "unknown";
+    }
+
+    void AppendJsonString(std::string& out, const std::string& v)
+    {
+        out += '"';
+        for (unsigned char c : v)
+        {
+            if (c == '"' || c == '\\') { out += '\\'; out += static_cast<char>(c); }
+            else if (c < 0x20)
+            {
+                char esc[8];
+                ::snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out += esc;
+            }
+            else out += static_cast<char>(c);
+        }
+        out += '"';
+    }
+
+    void AppendField(std::string& out, const char* key, uint64_t v, bool last = false)
+    {
+        out += '"'; out += key; out += "\":"; out += std::to_string(v);
+        if (!last) out += ',';
+    }
+
+    void AppendRate(std::string& out, const char* key, double v, bool last = false)
+    {
+        char buf[64];
+        ::snprintf(buf, sizeof(buf), "\"%s\":%.1f%s", key, v, last ? "" : ",");
+        out += buf;
+    }
+
+    void AppendLatency(std::string& out, const char* key, const LatencyStats& l, bool last = false)
+    {
+        out += '"'; out += key; out += "\":{";
+        AppendField(out, "count", l.count);
+        AppendRate (out, "mean_us", l.mean_us);
+        AppendField(out, "p50_us", l.p50_us);
+        AppendField(out, "p90_us", l.p90_us);
+        AppendField(out, "p99_us", l.p99_us);
+        AppendField(out, "p999_us", l.p999_us);
+        AppendField(out, "max_us", l.max_us, true);
+        out += last ? "}" : "},";
+    }
+
+    } // namespace
+
+    std::string FormatMetricsJson(const Metrics& m)
+    {
+        std::string out = "{";
+        AppendField(out, "uptime_ms", m.uptime_ms);
+        AppendRate(out, "interval_s", m.interval_s);
+
+        out += "\"transports\":[";
+        for (size_t i = 0; i < m.transports.size(); ++i)
+        {
+            const TransportStats& t = m.transports[i];
+            out += i ? ",{" : "{";
+            AppendField(out, "forward_port", t.forward_port);
+            out += "\"connected\":"; out += t.connected ? "true," : "false,";
+            AppendField(out, "reconnects", t.reconnects);
+            out += "\"ssh_methods\":{";
+            out += "\"kex\":";         AppendJsonString(out, t.kex);         out += ',';
+            out += "\"host_key\":";    AppendJsonString(out, t.host_key);    out += ',';
+            out += "\"cipher\":";      AppendJsonString(out, t.cipher);      out += ',';
+            out += "\"mac\":";         AppendJsonString(out, t.mac);         out += ',';
+            out += "\"compression\":"; AppendJsonString(out, t.compression); out += "},";
+            AppendField(out, "channels_accepted", t.channels_accepted);
+            AppendField(out, "channels_open", t.channels_open);
+            AppendField(out, "bytes_received", t.bytes_received);
+            AppendField(out, "bytes_sent", t.bytes_sent);
+            AppendField(out, "io_loop_iterations", t.io_loop_iterations);
+            AppendRate (out, "io_loop_iterations_per_sec", t.io_loop_iterations_per_sec);
+            AppendField(out, "eagain_reads", t.eagain_reads);
+            AppendField(out, "eagain_writes", t.eagain_writes);
+            AppendField(out, "drain_write_us_total", t.drain_write_us_total);
+            AppendField(out, "drain_write_us_max", t.drain_write_us_max);
+            AppendField(out, "rtt_us", t.rtt_us, true);
+            out += '}';
+        }
+
+        out += "],\"sessions\":[";
+        for (size_t i = 0; i < m.sessions.size(); ++i)
+        {
+            const SessionStats& s = m.sessions[i];
+            out += i ? ",{" : "{";
+            AppendField(out, "id", s.id);
+            AppendField(out, "forward_port", s.forward_port);
+            out += "\"state\":\""; out += SessionStateName(s.state); out += "\",";
+            out += "\"target\":"; AppendJsonString(out, s.target); out += ',';
+            AppendField(out, "bytes_to_target", s.bytes_to_target);
+            AppendField(out, "bytes_to_client", s.bytes_to_client);
+            AppendField(out, "connect_latency_us", s.connect_latency_us);
+            AppendField(out, "queued_to_target", s.queued_to_target);
+            AppendField(out, "queued_to_client", s.queued_to_client, true);
+            out += '}';
+        }
+
+        out += "],\"workers\":[";
+        for (size_t i = 0; i < m.workers.size(); ++i)
+        {
+            out += i ? ",{" : "{";
+            AppendField(out, "completions", m.workers[i].completions);
+            AppendRate (out, "completions_per_sec", m.workers[i].completions_per_sec, true);
+            out += '}';
+        }
+
+        out += "],\"latency\":{";
+        AppendLatency(out, "socks_connect", m.latency.socks_connect);
+        AppendLatency(out, "dns_resolve", m.latency.dns_resolve);
+        AppendLatency(out, "tcp_connect", m.latency.tcp_connect);
+        AppendLatency(out, "io_loop_tick", m.latency.io_loop_tick);
+        AppendLatency(out, "write_queue_wait", m.latency.write_queue_wait, true);
+
+        out += "},\"admission\":{";
+        AppendField(out, "active_sessions", m.admission.active_sessions);
+        AppendField(out, "admitted", m.admission.admitted);
+        AppendField(out, "refused_sessions", m.admission.refused_sessions);
+        AppendField(out, "refused_rate", m.admission.refused_rate);
+        AppendField(out, "refused_target", m.admission.refused_target, true);
+        out += "}}";
+        return out;
     }
 
 } // namespace ssh_proxy
@@ -1,6 +1,6 @@
 //////////////////////////////////////////////////////////////////////////////
 //
-// DirectForward — purpose and socket naming
+// DirectForward — purpose and threading
 //
 // PURPOSE
 //   Implements SSH local-port-forwarding in-process (no OpenSSH client needed).
@@ -13,166 +13,250 @@
 //   db.internal:5432 from the SSH server.
 //
 // SSH CHANNEL TYPE: direct-tcpip  (RFC 4254 §7.2, equivalent to `ssh -L`)
-//   libssh2_channel_direct_tcpip() asks the SSH server to open an outbound TCP
-//   connection to (target_host, target_port) on the caller's behalf.  Bytes
-//   written to the channel arrive at the target; reads return what the target
-//   sends back.
+//   SshTransport::OpenDirectChannel() asks the SSH server to open an outbound
+//   TCP connection to (target_host, target_port) on the caller's behalf.
+//   Bytes written to the channel arrive at the target; reads return what the
+//   target sends back.
 //
-// THE THREE SOCKETS
-//   m_ssh_socket  — raw TCP socket to the SSH server.  libssh2 owns its data;
-//                   we keep it only so the destructor can close it to unblock
-//                   the relay thread.
+// BUILT ON THE PROXY'S OWN MACHINERY
+//   SSH side   — an SshTransport without a remote forward.  Its I/O thread owns
+//                libssh2, pumps each channel only when data is pending and
+//                drains per-channel write queues, exactly as for the SOCKS5
+//                proxy.  One thread per SSH session, however many callers.
+//   Local side — the listener takes callers with IoEngine::StartAccept
+//                (AcceptEx; accept4 on POSIX) and each accepted socket
+//                becomes a TcpConnection (Adopt), so its reads and writes
+//                are completions on the shared IoEngine workers.
+//   No thread is dedicated to a forward, nothing polls: an idle forward costs
+//   no CPU, and a slow local reader only stalls its own channel (its send
+//   queue backs up, channel read interest goes off, the SSH window closes).
 //
-//   m_listen_sock — server socket bound to 127.0.0.1:0 (ephemeral port reported
-//                   by local_port()).  Accepts exactly one caller, then closes.
+// MODES
+//   SingleAccept — the constructor opens the channel (so an unreachable
+//                  target throws, as before) and parks it until the one
+//                  permitted caller arrives; the listener then closes.
+//   Persistent   — one session for every caller: each accepted socket gets
+//                  its own direct-tcpip channel, opened in accept order.
 //
-//   m_relay_sock  — the accepted local caller's socket.  The relay thread
-//                   shuttles bytes between this and the SSH channel.
+// SHUTDOWN
+//   ForwardState is shared by the acceptor's IOCP callbacks and by the
+//   destructor.  Stop() marks it stopped and closes the listener under its
+//   mutex (IoEngine::CloseSocket, which aborts the pending accept on either
+//   backend), so a late accept completion never touches the transport; the
+//   destructor then closes every relay and joins the transport's I/O thread.
+//   A dropped SSH session runs the same Stop() from on_disconnect, which
+//   closes every local socket — callers observe the tunnel drop as a close.
 //
 //////////////////////////////////////////////////////////////////////////////
 
 #include "ssh_tunnel.h"
 #include "common.h"
+#include "async_io.h"
+#include "logger.h"
+#include "socks5_session.h"
+#include "ssh_auth.h"
+#include "ssh_transport.h"
+#include "tcp_connection.h"
+#include <algorithm>
 #include <stdexcept>
-#include <thread>
 #include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <string>
 
 namespace ssh_tunnel {
 
-    struct DirectForward::Impl {
-        ::SOCKET            m_ssh_socket  = INVALID_SOCKET;
-        ::LIBSSH2_SESSION*  m_session     = nullptr;
-        ::LIBSSH2_CHANNEL*  m_channel     = nullptr;
-
-        std::mutex          m_socket_mutex;
-        ::SOCKET            m_listen_sock = INVALID_SOCKET;
-        ::SOCKET            m_relay_sock  = INVALID_SOCKET;
-
-        ::uint16_t          m_local_port  = 0;
-        std::thread         m_relay_thread;
-        std::atomic<bool>   m_cancel{ false };
-        std::atomic<bool>   m_alive{ true };
-    };
-
     namespace {
 
         //
-        // ── connect_tcp ───────────────────────────────────────────────────────────────
-        //
-        // DNS-resolve host:port and establish a blocking TCP connection with a
-        // send/receive timeout. Returns the connected WinSocket; throws
-        // std::runtime_error on any failure.
-
-        WinSocket connect_tcp(const std::string& host, uint16_t port, uint32_t timeout_ms)
-        {
-            struct addrinfo hints{};
-            hints.ai_family   = AF_UNSPEC;
-            hints.ai_socktype = SOCK_STREAM;
-            hints.ai_protocol = IPPROTO_TCP;
-
-            char port_str[8];
-            ::snprintf(port_str, sizeof(port_str), "%u", static_cast<unsigned>(port));
-
-            addrinfo* raw_addr = nullptr;
-            if (::getaddrinfo(host.c_str(), port_str, &hints, &raw_addr) != 0)
-                throw std::runtime_error("DNS resolve failed for " + host);
-            if (raw_addr == nullptr)
-                throw std::runtime_error("getaddrinfo returned null for " + host);
-
-            AddrInfoPtr addr(raw_addr);
-
-            WinSocket sock(::socket(addr->ai_family, SOCK_STREAM, IPPROTO_TCP));
-            if (sock.get() == INVALID_SOCKET)
-                throw std::runtime_error("socket() failed for " + host);
-
-            DWORD tv_ms = timeout_ms;
-            ::setsockopt(sock.get(), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv_ms), sizeof(tv_ms));
-            ::setsockopt(sock.get(), SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&tv_ms), sizeof(tv_ms));
-
-            if (::connect(sock.get(), addr->ai_addr, static_cast<int>(addr->ai_addrlen)) != 0)
-                throw std::runtime_error("TCP connect to " + host + ":" + std::to_string(port) + " failed (WSA " + std::to_string(::WSAGetLastError()) + ")");
-
-            return sock;
-        }
-
-        //
-        // ── throw_ssh_error ───────────────────────────────────────────────────────────
+        // ── ForwardSession ────────────────────────────────────────────────────────────
         //
-
-        [[noreturn]] void throw_ssh_error(LIBSSH2_SESSION* s, std::string msg)
-        {
-            char* errmsg = nullptr;
-            ::libssh2_session_last_error(s, &errmsg, nullptr, 0);
-            if (errmsg != nullptr)
-            { 
-                msg += ": "; 
-                msg += errmsg; 
+        // One local caller ↔ one direct-tcpip channel: the relay half of
+        // Socks5Session, with the same watermarks in both directions and the
+        // same half-close — EOF from either side is passed on, and the session
+        // closes once both directions have ended.  Created on the SSH I/O thread
+        // when the channel opens; the channel stays parked until Attach()
+        // supplies the caller's connection.
+
+        class ForwardSession : public std::enable_shared_from_this<ForwardSession> {
+        public:
+            ForwardSession(std::unique_ptr<SshChannel> channel, RelayOptions options,
+                           std::function<void()> on_closed)
+                : m_channel(std::move(channel))
+                , m_options(options)
+                , m_read_sizer(options.recv_min, options.recv_max)
+                , m_on_closed(std::move(on_closed))
+            {}
+
+            ~ForwardSession() { Close(); }
+
+            // SSH I/O thread, before the pump is registered.
+            void Start()
+            {
+                std::weak_ptr<ForwardSession> weak = weak_from_this();
+                m_channel->SetWriteWatermarks(m_options.high_watermark, m_options.low_watermark,
+                    [weak]()
+                    {
+                        if (auto self = weak.lock()) self->m_tcp->ResumeReading();
+                    });
+                m_channel->SetReadInterest(false);
             }
-            throw std::runtime_error(std::move(msg));
-        }
-
-        //
-        // ── open_ssh_session ──────────────────────────────────────────────────────────
-        //
-        // Steps 3+4: init a libssh2 session over sock, complete the handshake, authenticate.
-        // Returns a session in blocking mode; caller switches to non-blocking when ready.
 
-        SshSessionPtr open_ssh_session(SOCKET sock, const std::string& username, const std::string& password)
-        {
-            SshSessionPtr session(::libssh2_session_init());
-            if (session == nullptr)
+            // Any thread.  Starts both relay directions.
+            void Attach(std::shared_ptr<TcpConnection> tcp)
             {
-                throw std::runtime_error("DirectForward: libssh2_session_init failed");
-            }
+                std::weak_ptr<ForwardSession> weak = weak_from_this();
+                tcp->SetSendWatermarks(m_options.high_watermark, m_options.low_watermark,
+                    [weak]()
+                    {
+                        if (auto self = weak.lock()) self->m_channel->SetReadInterest(true);
+                    });
+                tcp->SetSendBatchLimits(m_options.send_batch_bytes, m_options.send_batch_segments);
+                tcp->SetRecvSizeLimits(m_options.recv_min, m_options.recv_max);
+                {
+                    std::lock_guard<std::mutex> lock(m_tcp_mutex);
+                    if (m_closed.load())
+                    {
+                        tcp->Close();
+                        return;
+                    }
+                    m_tcp = tcp;
+                    m_attached.store(true);
+                }
 
-            ::libssh2_session_set_blocking(session.get(), 1);
+                // Local caller → SSH channel (IOCP threads)
+                tcp->StartReading(
+                    [weak](PooledBuffer data)
+                    {
+                        auto self = weak.lock();
+                        if (!self) return;
+                        self->m_channel->WriteBuffer(std::move(data));
+                        if (self->m_channel->IsWriteBacklogged())
+                        {
+                            self->m_tcp->PauseReading();
+                            if (!self->m_channel->IsWriteBacklogged())
+                                self->m_tcp->ResumeReading();
+                        }
+                    },
+                    [weak](ErrorCode ec)
+                    {
+                        auto self = weak.lock();
+                        if (!self) return;
+                        if (ec != ErrorCode::Success)
+                        {
+                            self->Close();
+                            return;
+                        }
+                        self->m_channel->SendEof();   // caller half-closed
+                        self->EndLeg();
+                    });
 
-            if (::libssh2_session_handshake(session.get(), sock) != 0)
-            {
-                throw_ssh_error(session.get(), "DirectForward: SSH handshake failed");
+                // SSH channel → local caller: the posted un-park pumps once right
+                // away, picking up whatever the target sent before the caller came.
+                m_channel->SetReadInterest(true);
             }
 
-            // Handshake complete — deleter may now send SSH_MSG_DISCONNECT on cleanup.
-            session.get_deleter().send_disconnect = true;
-
-            if (::libssh2_userauth_password(session.get(), username.c_str(), password.c_str()) != 0)
+            // SSH I/O thread, when the channel has data or EOF pending.
+            bool Pump()
             {
-                throw_ssh_error(session.get(), "DirectForward: SSH auth failed for user " + username);
-            }
+                if (m_closed.load()) return false;
+                if (!m_attached.load()) return true;   // kicked at registration, still parked
+
+                size_t want = m_read_sizer.Next();
+                PooledBuffer buf = BufferPool::Acquire(want);
+                size_t bytes_read = 0;
+                ErrorCode ec = m_channel->Read(buf.tail(), (std::min)(want, buf.tailroom()), bytes_read);
+                if (ec == ErrorCode::WouldBlock) return true;
+                if (ec == ErrorCode::ChannelClosed && m_channel->IsEof())
+                {
+                    // Target half-closed: FIN the caller once its queue drains,
+                    // and park — libssh2 reports the EOF on every iteration.
+                    m_channel->SetReadInterest(false);
+                    if (m_channel_eof) return true;
+                    m_channel_eof = true;
+                    std::weak_ptr<ForwardSession> weak = weak_from_this();
+                    m_tcp->ShutdownSend([weak](ErrorCode shutdown_ec)
+                    {
+                        auto self = weak.lock();
+                        if (!self) return;
+                        if (shutdown_ec != ErrorCode::Success) self->Close();
+                        else                                   self->EndLeg();
+                    });
+                    return true;
+                }
+                if (ec != ErrorCode::Success || bytes_read == 0)
+                {
+                    Close();
+                    return false;
+                }
 
-            return session;
-        }
+                m_read_sizer.Record(bytes_read);
+                buf.Commit(bytes_read);
+                m_tcp->Send(std::move(buf));
+                if (m_tcp->IsSendBacklogged()) m_channel->SetReadInterest(false);
+                return true;
+            }
 
-        //
-        // ── open_direct_tcpip ─────────────────────────────────────────────────────────
-        //
-        // Step 5: ask the SSH server to connect outward to target_host:target_port and
-        // attach that TCP stream to a new SSH channel.
+            // Any thread; runs once.
+            void Close()
+            {
+                if (m_closed.exchange(true)) return;
 
-        SshChannelPtr open_direct_tcpip(LIBSSH2_SESSION* session, const std::string& target_host, uint16_t target_port)
-        {
-            SshChannelPtr channel(::libssh2_channel_direct_tcpip(session, target_host.c_str(), static_cast<int>(target_port)));
+                std::shared_ptr<TcpConnection> tcp;
+                {
+                    std::lock_guard<std::mutex> lock(m_tcp_mutex);
+                    tcp = m_tcp;
+                }
+                if (tcp) tcp->Close();
+                m_channel->SendEof();
+                m_channel->Close();
+                if (m_on_closed) m_on_closed();
+            }
 
-            if (channel == nullptr)
+        private:
+            void EndLeg()
             {
-                throw_ssh_error(session, "DirectForward: channel_direct_tcpip to " + target_host + ":" + std::to_string(target_port) + " failed");
+                if (m_legs_open.fetch_sub(1) == 1) Close();
             }
 
-            return channel;
+            std::unique_ptr<SshChannel>     m_channel;
+            std::mutex                      m_tcp_mutex;   // Attach vs. Close
+            std::shared_ptr<TcpConnection>  m_tcp;         // set once, before read interest
+            std::atomic<bool>               m_attached{false};
+            std::atomic<bool>               m_closed{false};
+            RelayOptions                    m_options;
+            RecvSizer                       m_read_sizer;  // Pump (I/O thread)
+            bool                            m_channel_eof = false;   // Pump (I/O thread)
+            std::atomic<int>                m_legs_open{2};          // directions not yet ended
+            std::function<void()>           m_on_closed;
+        };
+
+        // AcceptEx writes both addresses after the (empty) receive area.
+        constexpr DWORD kAcceptAddrLen = sizeof(sockaddr_in) + 16;
+
+        // An IPv4 TCP socket for the listener or an accept: overlapped on
+        // Windows, close-on-exec on POSIX.
+        SOCKET NewLocalSocket()
+        {
+#ifdef _WIN32
+            return ::WSASocketW(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+#else
+            return ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+#endif
         }
 
         //
         // ── create_local_listener ─────────────────────────────────────────────────────
         //
-        // Step 6: bind a server socket to 127.0.0.1:0; returns the socket and the
-        // OS-assigned port.  relay_proc accepts the one inbound connection on this socket.
+        // Binds a server socket to 127.0.0.1:0 and associates it with the IOCP;
+        // returns the socket and the OS-assigned port.  Throws on failure.
 
-        std::pair<WinSocket, uint16_t> create_local_listener()
+        std::pair<WinSocket, uint16_t> create_local_listener(int backlog)
         {
-            WinSocket listen_sock(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+            WinSocket listen_sock(NewLocalSocket());
             if (listen_sock.get() == INVALID_SOCKET)
             {
                 throw std::runtime_error("DirectForward: local socket() failed");
@@ -188,197 +272,251 @@ namespace ssh_tunnel {
                 throw std::runtime_error("DirectForward: local bind failed");
             }
 
-            if (::listen(listen_sock.get(), 1) != 0)
+            if (::listen(listen_sock.get(), backlog) != 0)
             {
                 throw std::runtime_error("DirectForward: local listen failed");
             }
 
+            if (IoEngine::Associate(listen_sock.get()) != ErrorCode::Success)
+            {
+                throw std::runtime_error("DirectForward: IOCP association failed");
+            }
+
             sockaddr_in bound{};
-            int bound_len = sizeof(bound);
+            socklen_t bound_len = sizeof(bound);
             ::getsockname(listen_sock.get(), reinterpret_cast<sockaddr*>(&bound), &bound_len);
             uint16_t port = ::ntohs(bound.sin_port);
 
             return { std::move(listen_sock), port };
         }
 
-    } // namespace
+        //
+        // ── ForwardState ──────────────────────────────────────────────────────────────
+        //
+        // Everything the IOCP and SSH I/O callbacks share with the destructor.
+        // `transport` is only dereferenced under `mutex` while !stopped.
+
+        struct ForwardState {
+            std::mutex                                  mutex;
+            bool                                        stopped   = false;
+            SshTransport*                               transport = nullptr;
+            WinSocket                                   listen_sock;
+            std::vector<std::weak_ptr<ForwardSession>>  sessions;
+            std::shared_ptr<ForwardSession>             parked;   // SingleAccept: awaiting its caller
+
+            // The one outstanding AcceptEx.
+            IoContext                                   accept_ctx;
+            SOCKET                                      accept_sock = INVALID_SOCKET;
+            char                                        accept_buf[2 * kAcceptAddrLen] = {};
+
+            DirectForwardMode                           mode = DirectForwardMode::SingleAccept;
+            std::string                                 target_host;
+            uint16_t                                    target_port = 0;
+            std::atomic<bool>                           alive{ true };
+        };
+
+        void OnAccepted(const std::shared_ptr<ForwardState>& state, ErrorCode ec);
+
+        // Closes the listener through IoEngine, so a pending accept completes
+        // with Shutdown on both backends.  Caller holds state.mutex.
+        void CloseListener(ForwardState& state)
+        {
+            SOCKET listener = state.listen_sock.release();
+            if (listener != INVALID_SOCKET) IoEngine::CloseSocket(listener);
+        }
 
-    //
-    // ── accept_connection ─────────────────────────────────────────────────────────
-    //
-    // Blocks on m_listen_sock until one local caller connects, then closes
-    // m_listen_sock (single-accept — a second caller would block forever).
-    // On success stores the accepted socket in impl->m_relay_sock and returns true.
-    // Returns false if accept() fails (listen_sock was closed by cancel/dtor)
-    // or if m_cancel was set before a caller arrived.
+        //
+        // ── NewSession ────────────────────────────────────────────────────────────────
+        //
+        // SSH I/O thread: wraps an opened channel, records it for Stop(), and
+        // returns the pump for the transport to register.
 
-    bool DirectForward::accept_connection(Impl* impl)
-    {
-        WinSocket accepted(::accept(impl->m_listen_sock, nullptr, nullptr));
+        std::shared_ptr<ForwardSession> NewSession(const std::shared_ptr<ForwardState>& state,
+                                                   std::unique_ptr<SshChannel> channel)
         {
-            std::lock_guard<std::mutex> lock(impl->m_socket_mutex);
-            if (impl->m_listen_sock != INVALID_SOCKET)
+            std::function<void()> on_closed;
+            if (state->mode == DirectForwardMode::SingleAccept)
             {
-                ::closesocket(impl->m_listen_sock);
-                impl->m_listen_sock = INVALID_SOCKET;
+                std::weak_ptr<ForwardState> weak = state;
+                on_closed = [weak]()
+                {
+                    if (auto s = weak.lock()) s->alive.store(false);
+                };
             }
-        }
 
-        if (accepted.get() == INVALID_SOCKET)
-            return false;
-        if (impl->m_cancel.load())
-            return false;
+            auto session = std::make_shared<ForwardSession>(std::move(channel), RelayOptions{},
+                                                            std::move(on_closed));
+            session->Start();
 
-        std::lock_guard<std::mutex> lock(impl->m_socket_mutex);
-        impl->m_relay_sock = accepted.release();
-        return true;
-    }
-
-    //
-    // ── run_relay_loop ────────────────────────────────────────────────────────────
-    //
-    // Shuttles bytes between impl->m_relay_sock and the SSH channel until either
-    // side closes, libssh2_channel_eof() fires, or m_cancel is set.
-    // Closes impl->m_relay_sock before returning.
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->sessions.erase(
+                std::remove_if(state->sessions.begin(), state->sessions.end(),
+                    [](const std::weak_ptr<ForwardSession>& w) { return w.expired(); }),
+                state->sessions.end());
+            state->sessions.push_back(session);
+            return session;
+        }
 
-    void DirectForward::run_relay_loop(Impl* impl)
-    {
-        ::SOCKET relay_sock = impl->m_relay_sock;
-        static constexpr int BUF_SIZE = 16384;
-        std::vector<char> buf(BUF_SIZE);
+        //
+        // ── PostAccept ────────────────────────────────────────────────────────────────
+        //
+        // Issues the next AcceptEx.  The completion callback holds the state
+        // alive; IoEngine moves it out before invoking, so no cycle remains.
+        // Caller holds state->mutex.
 
-        bool running = true;
-        while (running && !impl->m_cancel.load())
+        void PostAccept(const std::shared_ptr<ForwardState>& state)
         {
-            fd_set rfds;
-            FD_ZERO(&rfds);
-            FD_SET(impl->m_ssh_socket, &rfds);
-            FD_SET(relay_sock, &rfds);
-            struct timeval tv{ 0, 50000 };  // 50 ms
+            if (state->stopped) return;
 
-            if (::select(0, &rfds, nullptr, nullptr, &tv) < 0)
+            state->accept_sock = NewLocalSocket();
+            if (state->accept_sock == INVALID_SOCKET)
             {
-                break;
+                Logger::Error("DirectForward: accept socket failed: %d", LastSocketError());
+                return;
             }
 
-            // SSH channel → relay_sock
-            if (FD_ISSET(impl->m_ssh_socket, &rfds))
+            state->accept_ctx.op       = IoOp::Accept;
+            state->accept_ctx.socket   = state->listen_sock.get();
+            state->accept_ctx.callback = [state](IoContext*, DWORD, ErrorCode ec)
             {
-                while (running)
-                {
-                    ssize_t n = ::libssh2_channel_read(impl->m_channel, buf.data(), BUF_SIZE);
-                    if (n > 0)
-                    {
-                        if (::send(relay_sock, buf.data(), static_cast<int>(n), 0) <= 0)
-                        {
-                            running = false;
-                        }
-                    }
-                    else if (n == LIBSSH2_ERROR_EAGAIN)
-                    {
-                        break;
-                    }
-                    else
-                    {
-                        running = false;
-                    }
-                }
+                OnAccepted(state, ec);
+            };
+
+            // A completion — even an immediate one — runs after we return,
+            // so OnAccepted never re-enters under state->mutex.
+            ErrorCode started = IoEngine::StartAccept(&state->accept_ctx, state->accept_sock,
+                                                      state->accept_buf, kAcceptAddrLen);
+            if (started != ErrorCode::Success)
+            {
+                Logger::Error("DirectForward: AcceptEx failed: %s", ErrorCodeToString(started));
+                state->accept_ctx.callback = nullptr;
+                ::closesocket(state->accept_sock);
+                state->accept_sock = INVALID_SOCKET;
             }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////
+        //
+        // OnAccepted
+        //
+        // AcceptEx completion (IOCP worker).  The accepted socket inherits the
+        // listener's properties via SO_UPDATE_ACCEPT_CONTEXT and becomes a
+        // TcpConnection.  SingleAccept hands it to the parked session and closes
+        // the listener; Persistent requests a channel for it and re-arms AcceptEx.
+        // After Stop() — or when the listener was closed under the pending
+        // accept — the socket is simply discarded.
+        //
+        //////////////////////////////////////////////////////////////////////////////
+
+        void OnAccepted(const std::shared_ptr<ForwardState>& state, ErrorCode ec)
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            SOCKET accepted    = state->accept_sock;
+            state->accept_sock = INVALID_SOCKET;
 
-            // relay_sock → SSH channel
-            if (running && FD_ISSET(relay_sock, &rfds))
+            if (state->stopped || ec != ErrorCode::Success)
             {
-                int n = ::recv(relay_sock, buf.data(), BUF_SIZE, 0);
-                if (n <= 0)
+                if (accepted != INVALID_SOCKET) ::closesocket(accepted);
+                if (!state->stopped)
                 {
-                    running = false;
-                }
-                else
-                {
-                    int written = 0;
-                    while (running && written < n)
-                    {
-                        ssize_t w = ::libssh2_channel_write(impl->m_channel, buf.data() + written, static_cast<size_t>(n - written));
-                        if (w == LIBSSH2_ERROR_EAGAIN)
-                        {
-                            ::Sleep(1);
-                            continue;
-                        }
-                        if (w <= 0)
-                        {
-                            running = false;
-                            break;
-                        }
-                        written += static_cast<int>(w);
-                    }
+                    Logger::Warn("DirectForward: accept failed: %s", ErrorCodeToString(ec));
+                    PostAccept(state);
                 }
+                return;
             }
 
-            if (running && ::libssh2_channel_eof(impl->m_channel))
+#ifdef _WIN32
+            SOCKET listen_raw = state->listen_sock.get();
+            ::setsockopt(accepted, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT,
+                         reinterpret_cast<const char*>(&listen_raw), sizeof(listen_raw));
+#endif
+
+            auto tcp = std::make_shared<TcpConnection>();
+            if (tcp->Adopt(accepted) != ErrorCode::Success)
             {
-                running = false;
+                PostAccept(state);
+                return;
             }
-        }
 
-        {
-            std::lock_guard<std::mutex> lock(impl->m_socket_mutex);
-            if (impl->m_relay_sock != INVALID_SOCKET)
+            if (state->mode == DirectForwardMode::SingleAccept)
             {
-                ::closesocket(impl->m_relay_sock);
-                impl->m_relay_sock = INVALID_SOCKET;
+                std::shared_ptr<ForwardSession> session = std::move(state->parked);
+                CloseListener(*state);              // single-accept: no second caller
+                lock.unlock();
+                if (session) session->Attach(std::move(tcp));
+                else         tcp->Close();          // channel already gone
+                return;
             }
-        }
-    }
 
-    //////////////////////////////////////////////////////////////////////////////
-    //
-    // run_relay
-    //
-    // Thread entry point. Owns all libssh2 calls after the constructor returns
-    // (libssh2 is not thread-safe; the constructor is the sole caller during
-    // setup, this thread is the sole caller from here on).
-    //
-    // The select() loop uses a 50 ms timeout: short enough to detect m_cancel
-    // promptly, long enough to avoid busy-waiting when both sides are idle.
-    //
-    // Blocking mode is re-enabled before channel teardown because send_eof /
-    // wait_eof / channel_close are blocking libssh2 operations that must complete
-    // before session teardown proceeds.
-    //
-    //////////////////////////////////////////////////////////////////////////////
+            std::weak_ptr<ForwardState> weak = state;
+            state->transport->OpenDirectChannel(state->target_host, state->target_port,
+                [weak, tcp](std::unique_ptr<SshChannel> channel) -> SshTransport::SessionPumpFn
+                {
+                    auto s = weak.lock();
+                    if (!s || !channel)
+                    {
+                        tcp->Close();   // target refused — the caller sees a close
+                        return nullptr;
+                    }
+                    auto session = NewSession(s, std::move(channel));
+                    session->Attach(tcp);
+                    return [session]() { return session->Pump(); };
+                });
+            PostAccept(state);
+        }
 
-    void DirectForward::run_relay(Impl* impl)
-    {
-        if (accept_connection(impl))
-            run_relay_loop(impl);
+        //
+        // ── Stop ──────────────────────────────────────────────────────────────────────
+        //
+        // Stops accepting and closes every relay.  Idempotent; called by the
+        // destructor and by on_disconnect when the SSH session drops.
 
-        // Channel cleanup — this thread is the sole libssh2 user now
-        if (impl->m_channel != nullptr)
+        void Stop(const std::shared_ptr<ForwardState>& state)
         {
-            ::libssh2_session_set_blocking(impl->m_session, 1);
-            ::libssh2_channel_send_eof(impl->m_channel);
-            ::libssh2_channel_wait_eof(impl->m_channel);
-            ::libssh2_channel_close(impl->m_channel);
-            ::libssh2_channel_free(impl->m_channel);
-            impl->m_channel = nullptr;
+            std::vector<std::weak_ptr<ForwardSession>> sessions;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->stopped   = true;
+                state->transport = nullptr;
+                CloseListener(*state);              // aborts the pending accept
+                state->parked.reset();
+                sessions.swap(state->sessions);
+            }
+            state->alive.store(false);
+
+            for (auto& w : sessions)
+            {
+                if (auto session = w.lock()) session->Close();
+            }
         }
 
-        impl->m_alive.store(false);
-    }
+    } // namespace
+
+    struct DirectForward::Impl {
+        // Declared first so it is destroyed last: relays and callbacks
+        // captured by the transport hold only weak references into it.
+        std::shared_ptr<ForwardState> state = std::make_shared<ForwardState>();
+        SshTransport                  transport;
+        ::uint16_t                    local_port = 0;
+    };
 
     //////////////////////////////////////////////////////////////////////////////
     //
     // Constructor
     //
-    // Sequences the setup helpers; all steps are blocking and throw on failure.
+    // Sequences the setup steps; all are blocking and throw on failure.
     // A successfully constructed DirectForward is ready to relay immediately.
     //
-    //   Step 1  libssh2_init()          one-time process-wide crypto init (idempotent)
-    //   Step 2  connect_tcp             DNS resolve + connect with timeout
-    //   Steps 3+4  open_ssh_session     handshake + password auth
-    //   Step 5  open_direct_tcpip       ask server to connect to target
-    //   Step 6  create_local_listener   bind 127.0.0.1:0, record ephemeral port
-    //   Step 7  commit + launch         non-blocking mode, hand off to run_relay
+    //   Step 1  IoEngine::Init, libssh2_init   process-wide, idempotent
+    //   Step 2  SshTransport::Connect          TCP + handshake + user auth (key
+    //                                          read via SshKeyCache), no remote
+    //                                          forward
+    //   Step 3  StartAccepting                 launches the SSH I/O thread
+    //   Step 4  OpenDirectChannel              ask server to connect to target
+    //                                          (single-accept only — waits up to
+    //                                          connect_timeout_ms; persistent mode
+    //                                          opens one channel per caller)
+    //   Step 5  create_local_listener          bind 127.0.0.1:0, first AcceptEx
     //
     //////////////////////////////////////////////////////////////////////////////
 
@@ -389,48 +527,111 @@ namespace ssh_tunnel {
         uint16_t     target_port,
         std::string  target_host,
         uint16_t     ssh_port,
-        uint32_t     connect_timeout_ms)
+        uint32_t     connect_timeout_ms,
+        DirectForwardMode mode,
+        const ssh_proxy::AuthOptions& auth_options)
     {
+        if (IoEngine::Init(0) != ErrorCode::Success)
+        {
+            throw std::runtime_error("DirectForward: IoEngine init failed");     // Step 1
+        }
         if (::libssh2_init(0) != 0)
         {
-            throw std::runtime_error("DirectForward: libssh2_init failed");     // Step 1
+            throw std::runtime_error("DirectForward: libssh2_init failed");
         }
 
-        auto impl = std::make_unique<Impl>();
+        // The destructor stops the transport before the state goes away, so a
+        // throw from here on must do the same.
+        std::unique_ptr<Impl> impl(new Impl());
+        struct StopOnThrow {
+            Impl* impl;
+            ~StopOnThrow()
+            {
+                if (impl == nullptr) return;
+                Stop(impl->state);
+                impl->transport.Close();
+            }
+        } stop_guard{ impl.get() };
+
+        const std::shared_ptr<ForwardState>& state = impl->state;
+        state->mode        = mode;
+        state->target_host = std::move(target_host);
+        state->target_port = target_port;
+        state->transport   = &impl->transport;
+
+        SshAuth auth;                                                                                // Step 2
+        Result prepared = MakeSshAuth(username, password, auth_options, auth);
+        if (!prepared.ok())
+        {
+            throw std::runtime_error(std::string("DirectForward: ") + prepared.what());
+        }
+        Result connected = impl->transport.Connect(ssh_host, ssh_port, auth,
+                                                   ssh_proxy::SshAlgorithms{},
+                                                   /*forward_ports=*/ {},
+                                                   connect_timeout_ms, 0);
+        if (!connected.ok())
+        {
+            throw std::runtime_error(std::string("DirectForward: ") + connected.what());
+        }
 
-        WinSocket     ssh_sock = connect_tcp(ssh_host, ssh_port, connect_timeout_ms);        // Step 2
-        SshSessionPtr session  = open_ssh_session(ssh_sock.get(), username, password);       // Steps 3+4
-        SshChannelPtr channel  = open_direct_tcpip(session.get(), target_host, target_port); // Step 5
+        std::weak_ptr<ForwardState> weak = state;
+        impl->transport.StartAccepting({},                                                          // Step 3
+            [weak](ErrorCode reason)
+            {
+                Logger::Warn("DirectForward: SSH session closed: %s", ErrorCodeToString(reason));
+                if (auto s = weak.lock()) Stop(s);
+            });
 
-        auto [listen_sock, local_port] = create_local_listener();                            // Step 6
-        impl->m_local_port = local_port;
+        if (mode == DirectForwardMode::SingleAccept)                                                // Step 4
+        {
+            auto opened = std::make_shared<std::promise<bool>>();
+            std::future<bool> result = opened->get_future();
+            impl->transport.OpenDirectChannel(state->target_host, target_port,
+                [weak, opened](std::unique_ptr<SshChannel> channel) -> SshTransport::SessionPumpFn
+                {
+                    auto s = weak.lock();
+                    if (!s || !channel)
+                    {
+                        opened->set_value(false);
+                        return nullptr;
+                    }
+                    auto session = NewSession(s, std::move(channel));
+                    {
+                        std::lock_guard<std::mutex> lock(s->mutex);
+                        s->parked = session;
+                    }
+                    opened->set_value(true);
+                    return [session]() { return session->Pump(); };
+                });
 
-        // Step 7: switch to non-blocking, commit all resources, launch relay thread
-        ::libssh2_session_set_blocking(session.get(), 0);
-        impl->m_ssh_socket  = ssh_sock.release();
-        impl->m_session     = session.release();
-        impl->m_channel     = channel.release();
-        impl->m_listen_sock = listen_sock.release();
+            if (result.wait_for(std::chrono::milliseconds(connect_timeout_ms)) != std::future_status::ready ||
+                !result.get())
+            {
+                throw std::runtime_error("DirectForward: channel_direct_tcpip to " + state->target_host + ":" +
+                                         std::to_string(target_port) + " failed");
+            }
+        }
+
+        auto [listen_sock, local_port] =                                                            // Step 5
+            create_local_listener(mode == DirectForwardMode::Persistent ? SOMAXCONN : 1);
+        impl->local_port = local_port;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->listen_sock = std::move(listen_sock);
+            PostAccept(state);
+        }
+
+        stop_guard.impl = nullptr;
         m_impl = impl.release();
-        m_impl->m_relay_thread = std::thread(&DirectForward::run_relay, m_impl);
     }
 
     //////////////////////////////////////////////////////////////////////////////
     //
     // Destructor
     //
-    // Threading: the constructor is the sole libssh2 caller during setup; run_relay
-    // is the sole libssh2 caller after that.  The destructor never calls libssh2
-    // directly — it signals shutdown then joins run_relay, so there is no concurrent
-    // access at any point.
-    //
-    // Shutdown sequence:
-    //   1. Signal shutdown — sets m_cancel, closes m_listen_sock (unblocks accept())
-    //      and m_relay_sock (unblocks recv()/select()), both under m_socket_mutex.
-    //   2. Join run_relay — by the time join() returns, the channel has been freed
-    //      and libssh2 is no longer in use.
-    //   3. Free any remaining session/socket resources (covers the case where
-    //      run_relay was never reached, e.g. accept() failed immediately).
+    // Stop() first — no new callers, every relay closed, the pending AcceptEx
+    // aborted — then SshTransport::Close() joins the I/O thread, which frees
+    // the channels' pumps and tears down the SSH session.
     //
     //////////////////////////////////////////////////////////////////////////////
 
@@ -438,44 +639,8 @@ namespace ssh_tunnel {
     {
         if (m_impl == nullptr) return;
 
-        m_impl->m_cancel.store(true);
-        {
-            std::lock_guard<std::mutex> lock(m_impl->m_socket_mutex);
-            if (m_impl->m_listen_sock != INVALID_SOCKET)
-            {
-                ::closesocket(m_impl->m_listen_sock);
-                m_impl->m_listen_sock = INVALID_SOCKET;
-            }
-            if (m_impl->m_relay_sock != INVALID_SOCKET)
-            {
-                ::closesocket(m_impl->m_relay_sock);
-                m_impl->m_relay_sock = INVALID_SOCKET;
-            }
-        }
-
-        if (m_impl->m_relay_thread.joinable())
-            m_impl->m_relay_thread.join();
-
-        // Session cleanup (run_relay already freed the channel, or it was never started)
-        if (m_impl->m_channel != nullptr)
-        {
-            ::libssh2_session_set_blocking(m_impl->m_session, 1);
-            ::libssh2_channel_close(m_impl->m_channel);
-            ::libssh2_channel_free(m_impl->m_channel);
-            m_impl->m_channel = nullptr;
-        }
-        if (m_impl->m_session != nullptr)
-        {
-            ::libssh2_session_set_blocking(m_impl->m_session, 1);
-            libssh2_session_disconnect(m_impl->m_session, "Shutdown");
-            ::libssh2_session_free(m_impl->m_session);
-            m_impl->m_session = nullptr;
-        }
-        if (m_impl->m_ssh_socket != INVALID_SOCKET) 
-        {
-            ::closesocket(m_impl->m_ssh_socket);
-            m_impl->m_ssh_socket = INVALID_SOCKET;
-        }
+        Stop(m_impl->state);
+        m_impl->transport.Close();
 
         delete m_impl;
         m_impl = nullptr;
@@ -491,7 +656,7 @@ namespace ssh_tunnel {
 
     uint16_t DirectForward::local_port() const
     {
-        return m_impl ? m_impl->m_local_port : 0;
+        return m_impl ? m_impl->local_port : 0;
     }
 
     //
@@ -500,7 +665,7 @@ namespace ssh_tunnel {
 
     bool DirectForward::is_alive() const
     {
-        return m_impl && m_impl->m_alive.load();
+        return m_impl && m_impl->state->alive.load();
     }
 
-} // namespace ssh_tunnel
\ No newline at end of file
+} // namespace ssh_tunnel
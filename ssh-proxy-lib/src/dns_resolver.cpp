@@ -0,0 +1,448 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// DnsResolver — asynchronous, cached host name resolution
+//
+// PURPOSE
+//   Resolves SOCKS5 CONNECT targets without tying up a thread per lookup.
+//   The blocking getaddrinfo used to run on an IOCP worker; a burst of
+//   CONNECTs to slow names could then occupy every worker and stall relay
+//   completions for healthy sessions.
+//
+// POSIX
+//   The same design over glibc's getaddrinfo_a with SIGEV_THREAD
+//   notification: QueryComplete runs on a thread of the resolver's own,
+//   like the Windows completion routine, and getaddrinfo_a never completes
+//   synchronously.  EAI_NONAME / EAI_NODATA are the definitive failures.
+//
+// OVERLAPPED GetAddrInfoExW
+//   A cache miss issues GetAddrInfoExW with an OVERLAPPED and a completion
+//   routine, which the system invokes on its own thread when the query ends.
+//   Numeric hosts (and some cached-by-OS names) complete synchronously; the
+//   completion routine is then not called, so Resolve() finishes the query
+//   itself.  Either way FinishQuery() converts the result, updates the cache,
+//   and posts every waiter to the IOCP workers.
+//
+// CACHE AND COALESCING
+//   DnsCache is a bounded LRU keyed by normalised host name.  Successful
+//   results and definitive failures (WSAHOST_NOT_FOUND, WSANO_DATA) are
+//   cached with separate TTLs; transient errors are not.  While a query is in
+//   flight, further lookups of the same host join its waiter list instead of
+//   issuing their own — at most kMaxWaitersPerQuery; beyond that a lookup
+//   fails at once rather than queueing behind one name without bound.
+//
+// TIMEOUT AND CANCELLATION
+//   Each query arms an IoEngine::PostWorkAfter timer for the configured
+//   timeout.  A query still in flight when it fires is dropped from the
+//   waiter table, its waiters fail with DnsResolutionFailed, and the system
+//   is told to stop it (GetAddrInfoExCancel / gai_cancel), so one hung name
+//   cannot hold sessions in Resolving forever.  CancelAll does the same for
+//   every query, with ErrorCode::Shutdown, when the last Connect goes.
+//
+// LIFETIME
+//   Resolver state is intentionally leaked: a query may complete after
+//   static destructors have run at process exit.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "dns_resolver.h"
+#include "async_io.h"
+#include "logger.h"
+#include <atomic>
+#include <cctype>
+#include <mutex>
+#ifndef _WIN32
+#include <netdb.h>
+#endif
+
+// ── DnsCache ──────────────────────────────────────────────────────────────────
+
+DnsCache::DnsCache(size_t max_entries, uint32_t ttl_ms, uint32_t negative_ttl_ms)
+    : m_max_entries(max_entries)
+    , m_ttl_ms(ttl_ms)
+    , m_negative_ttl_ms(negative_ttl_ms)
+{}
+
+void DnsCache::Configure(size_t max_entries, uint32_t ttl_ms, uint32_t negative_ttl_ms)
+{
+    m_max_entries     = max_entries;
+    m_ttl_ms          = ttl_ms;
+    m_negative_ttl_ms = negative_ttl_ms;
+    Evict();
+}
+
+std::string DnsCache::NormalizeHost(const std::string& host)
+{
+    std::string key;
+    key.reserve(host.size());
+    for (char c : host)
+        key.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    if (!key.empty() && key.back() == '.') key.pop_back();
+    return key;
+}
+
+bool DnsCache::Lookup(const std::string& host, uint64_t now_ms, Entry& out)
+{
+    auto it = m_index.find(NormalizeHost(host));
+    if (it == m_index.end()) return false;
+
+    auto node = it->second;
+    if (now_ms >= node->expires_ms)
+    {
+        m_lru.erase(node);
+        m_index.erase(it);
+        return false;
+    }
+    m_lru.splice(m_lru.begin(), m_lru, node);
+    out = node->entry;
+    return true;
+}
+
+void DnsCache::Insert(const std::string& host, Entry entry, uint64_t now_ms)
+{
+    uint32_t ttl = entry.status == ErrorCode::Success ? m_ttl_ms : m_negative_ttl_ms;
+    if (ttl == 0 || m_max_entries == 0) return;
+
+    std::string key = NormalizeHost(host);
+    auto it = m_index.find(key);
+    if (it != m_index.end())
+    {
+        m_lru.erase(it->second);
+        m_index.erase(it);
+    }
+    m_lru.push_front(Node{ key, std::move(entry), now_ms + ttl });
+    m_index.emplace(std::move(key), m_lru.begin());
+    Evict();
+}
+
+void DnsCache::Clear()
+{
+    m_index.clear();
+    m_lru.clear();
+}
+
+void DnsCache::Evict()
+{
+    while (m_index.size() > m_max_entries)
+    {
+        m_index.erase(m_lru.back().key);
+        m_lru.pop_back();
+    }
+}
+
+// ── DnsResolver ───────────────────────────────────────────────────────────────
+
+namespace {
+
+void Deliver(DnsResolver::OnResolved fn, const DnsCache::Entry& entry)
+{
+    IoEngine::PostWork([fn = std::move(fn), entry]() { fn(entry.status, entry.addresses); });
+}
+
+// Failures that are cached as negative results.
+#ifdef _WIN32
+constexpr int kHostNotFound = WSAHOST_NOT_FOUND;
+constexpr int kNoData       = WSANO_DATA;
+#else
+constexpr int kHostNotFound = EAI_NONAME;
+constexpr int kNoData       = EAI_NODATA;
+#endif
+
+} // namespace
+
+// `self` keeps the query alive until FinishQuery runs; ExpireQuery and
+// CancelAll take a reference of their own (through `in_flight`) for the
+// time they cancel it.
+#ifdef _WIN32
+struct DnsResolver::Query : OVERLAPPED {
+    std::string             key;
+    uint64_t                id = 0;
+    std::shared_ptr<Query>  self;
+    std::atomic<bool>       finished{false};
+    std::wstring            host_w;
+    ADDRINFOEXW*            result = nullptr;
+    HANDLE                  cancel = nullptr;
+
+    Query() { ::ZeroMemory(static_cast<OVERLAPPED*>(this), sizeof(OVERLAPPED)); }
+    void FreeResult() { if (result != nullptr) ::FreeAddrInfoExW(result); }
+};
+#else
+struct DnsResolver::Query {
+    std::string             key;
+    uint64_t                id = 0;
+    std::shared_ptr<Query>  self;
+    std::atomic<bool>       finished{false};
+    addrinfo                hints{};
+    gaicb                   request{};
+    addrinfo*               result = nullptr;
+
+    void FreeResult() { if (result != nullptr) ::freeaddrinfo(result); }
+};
+#endif
+
+// A query in flight and the lookups waiting on it, keyed by host.  `id`
+// tells a late completion or timer from the query now in flight for the
+// same host.
+struct DnsResolver::State {
+    struct InFlight {
+        uint64_t                 id = 0;
+        std::weak_ptr<Query>     query;
+        std::vector<OnResolved>  waiters;
+    };
+
+    std::mutex                                 mutex;
+    DnsCache                                   cache{
+        kDefaultMaxEntries, kDefaultTtlMs, kDefaultNegativeTtlMs };
+    uint32_t                                   timeout_ms = kDefaultTimeoutMs;
+    uint64_t                                   next_id    = 0;
+    std::unordered_map<std::string, InFlight>  in_flight;
+};
+
+DnsResolver::State& DnsResolver::GetState()
+{
+    static State* state = new State();
+    return *state;
+}
+
+//
+// ── Resolve ───────────────────────────────────────────────────────────────────
+//
+// Cache hit → post the cached result.  Query already in flight → join it,
+// unless kMaxWaitersPerQuery lookups already wait on it.  Otherwise start a
+// new overlapped query and arm its timeout; the lock is released first
+// because a synchronous completion re-enters FinishQuery, which takes it
+// again.
+//
+
+void DnsResolver::Resolve(const std::string& host, OnResolved on_resolved)
+{
+    State& st = GetState();
+    std::string key = DnsCache::NormalizeHost(host);
+    std::shared_ptr<Query> q;
+    uint32_t timeout_ms = 0;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        DnsCache::Entry hit;
+        if (st.cache.Lookup(key, ::GetTickCount64(), hit))
+        {
+            Deliver(std::move(on_resolved), hit);
+            return;
+        }
+        State::InFlight& flight = st.in_flight[key];
+        if (!flight.waiters.empty())
+        {
+            if (flight.waiters.size() < kMaxWaitersPerQuery)
+                flight.waiters.push_back(std::move(on_resolved));
+            else
+                Deliver(std::move(on_resolved), DnsCache::Entry{ ErrorCode::DnsResolutionFailed, nullptr });
+            return;
+        }
+        q       = std::make_shared<Query>();
+        q->key  = key;
+        q->id   = ++st.next_id;
+        q->self = q;
+        flight.id    = q->id;
+        flight.query = q;
+        flight.waiters.push_back(std::move(on_resolved));
+        timeout_ms = st.timeout_ms;
+    }
+
+    if (timeout_ms > 0)
+        IoEngine::PostWorkAfter(timeout_ms, [key, id = q->id]() { ExpireQuery(key, id); });
+
+#ifdef _WIN32
+    int wlen = ::MultiByteToWideChar(CP_UTF8, 0, key.c_str(), -1, nullptr, 0);
+    if (key.empty() || wlen <= 0)
+    {
+        FinishQuery(q.get(), kHostNotFound);
+        return;
+    }
+    q->host_w.resize(static_cast<size_t>(wlen));
+    ::MultiByteToWideChar(CP_UTF8, 0, key.c_str(), -1, &q->host_w[0], wlen);
+
+    ADDRINFOEXW hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    int rc = ::GetAddrInfoExW(q->host_w.c_str(), nullptr, NS_ALL, nullptr, &hints,
+                              &q->result, nullptr, q.get(), &DnsResolver::QueryComplete,
+                              &q->cancel);
+    if (rc != WSA_IO_PENDING)
+        FinishQuery(q.get(), rc);
+#else
+    if (key.empty())
+    {
+        FinishQuery(q.get(), kHostNotFound);
+        return;
+    }
+    q->hints.ai_family    = AF_UNSPEC;
+    q->hints.ai_socktype  = SOCK_STREAM;
+    q->hints.ai_protocol  = IPPROTO_TCP;
+    q->request.ar_name    = q->key.c_str();
+    q->request.ar_request = &q->hints;
+
+    sigevent notify{};
+    notify.sigev_notify          = SIGEV_THREAD;
+    notify.sigev_notify_function = &DnsResolver::QueryComplete;
+    notify.sigev_value.sival_ptr = q.get();
+    gaicb* requests[1] = { &q->request };
+    int rc = ::getaddrinfo_a(GAI_NOWAIT, requests, 1, &notify);
+    if (rc != 0)
+        FinishQuery(q.get(), rc);
+#endif
+}
+
+#ifdef _WIN32
+void CALLBACK DnsResolver::QueryComplete(DWORD error, DWORD /*bytes*/, LPWSAOVERLAPPED overlapped)
+{
+    FinishQuery(static_cast<Query*>(overlapped), static_cast<int>(error));
+}
+#else
+void DnsResolver::QueryComplete(sigval value)
+{
+    auto* q   = static_cast<Query*>(value.sival_ptr);
+    q->result = q->request.ar_result;
+    FinishQuery(q, ::gai_error(&q->request));
+}
+#endif
+
+//
+// ── FinishQuery ───────────────────────────────────────────────────────────────
+//
+// Converts the ADDRINFOEXW / addrinfo chain into an AddressList, caches definitive
+// outcomes, and hands the result to every waiter — unless the query timed
+// out or was cancelled, which answered them already.  Releases q's hold on
+// itself; q goes once no canceller holds it either.
+//
+
+void DnsResolver::FinishQuery(Query* q, int error)
+{
+    std::shared_ptr<Query> owner = std::move(q->self);
+    q->finished.store(true);
+
+    DnsCache::Entry entry;
+    if (error == 0)
+    {
+        auto list = std::make_shared<AddressList>();
+        for (auto* ai = q->result; ai != nullptr; ai = ai->ai_next)
+        {
+            if (ai->ai_addr == nullptr || ai->ai_addrlen > sizeof(sockaddr_storage)) continue;
+            if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6) continue;
+            ResolvedAddress ra;
+            std::memcpy(&ra.addr, ai->ai_addr, ai->ai_addrlen);
+            ra.len = static_cast<int>(ai->ai_addrlen);
+            list->push_back(ra);
+        }
+        if (list->empty())
+        {
+            error = kNoData;
+            entry.status = ErrorCode::DnsResolutionFailed;
+        }
+        else
+        {
+            entry.addresses = std::move(list);
+        }
+    }
+    else
+    {
+        entry.status = ErrorCode::DnsResolutionFailed;
+    }
+    q->FreeResult();
+    q->result = nullptr;
+
+    bool definitive = error == 0 || error == kHostNotFound || error == kNoData;
+
+    std::vector<OnResolved> waiters;
+    {
+        State& st = GetState();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (definitive) st.cache.Insert(q->key, entry, ::GetTickCount64());
+        auto it = st.in_flight.find(q->key);
+        if (it != st.in_flight.end() && it->second.id == q->id)
+        {
+            waiters.swap(it->second.waiters);
+            st.in_flight.erase(it);
+        }
+    }
+
+    if (error != 0 && !waiters.empty())
+        Logger::Warn("DNS resolve failed for %s: %d", q->key.c_str(), error);
+    for (auto& fn : waiters) Deliver(std::move(fn), entry);
+}
+
+//
+// ── ExpireQuery / CancelAll / AbandonQuery ────────────────────────────────────
+//
+// A query that outlives its timeout (or the last Connect) is taken out of
+// in_flight, its waiters fail, and the system is asked to stop it.  On
+// Windows the cancelled query still completes through QueryComplete with
+// WSA_E_CANCELLED; a getaddrinfo_a request that gai_cancel removed before it
+// ran never notifies, so it is finished here.  FinishQuery then finds no
+// waiters to answer.
+//
+
+void DnsResolver::ExpireQuery(const std::string& key, uint64_t id)
+{
+    State& st = GetState();
+    std::shared_ptr<Query>  q;
+    std::vector<OnResolved> waiters;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        auto it = st.in_flight.find(key);
+        if (it == st.in_flight.end() || it->second.id != id) return;   // answered
+        q = it->second.query.lock();
+        waiters.swap(it->second.waiters);
+        st.in_flight.erase(it);
+    }
+
+    Logger::Warn("DNS resolve for %s timed out; failing %zu waiting connect(s)",
+                 key.c_str(), waiters.size());
+    if (q) AbandonQuery(q);
+    DnsCache::Entry failed{ ErrorCode::DnsResolutionFailed, nullptr };
+    for (auto& fn : waiters) Deliver(std::move(fn), failed);
+}
+
+void DnsResolver::CancelAll()
+{
+    State& st = GetState();
+    std::vector<State::InFlight> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        for (auto& kv : st.in_flight) cancelled.push_back(std::move(kv.second));
+        st.in_flight.clear();
+    }
+
+    DnsCache::Entry shutdown{ ErrorCode::Shutdown, nullptr };
+    for (auto& flight : cancelled)
+    {
+        if (auto q = flight.query.lock()) AbandonQuery(q);
+        for (auto& fn : flight.waiters) Deliver(std::move(fn), shutdown);
+    }
+}
+
+void DnsResolver::AbandonQuery(const std::shared_ptr<Query>& q)
+{
+    if (q->finished.load()) return;   // its handle may already be reused
+#ifdef _WIN32
+    ::GetAddrInfoExCancel(&q->cancel);
+#else
+    if (::gai_cancel(&q->request) == EAI_CANCELED)
+        FinishQuery(q.get(), EAI_CANCELED);
+#endif
+}
+
+void DnsResolver::Configure(size_t max_entries, uint32_t ttl_ms, uint32_t negative_ttl_ms,
+                            uint32_t timeout_ms)
+{
+    State& st = GetState();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    st.cache.Configure(max_entries, ttl_ms, negative_ttl_ms);
+    st.timeout_ms = timeout_ms;
+}
+
+void DnsResolver::ClearCache()
+{
+    State& st = GetState();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    st.cache.Clear();
+}
@@ -0,0 +1,270 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Instrumentation — hot-path latency histograms and TraceLogging events
+//
+// PURPOSE
+//   Counters (GetMetrics) say how much; these say how long.  Five points on
+//   the data path — SOCKS CONNECT, DNS, ConnectEx, the SSH I/O loop tick and
+//   the channel write queue — record their durations into process-wide
+//   histograms that Metrics summarises as percentiles, and emit an ETW event
+//   each so WPA can line them up against kernel network events.
+//
+// BUCKETING
+//   HDR-style: exact buckets below 16 µs, then 8 linear sub-buckets per power
+//   of two.  The bucket index is the position of the top set bit plus the
+//   next three bits — one bit scan, no floating point, no loops — so a
+//   record costs a bucket add, a count add, a sum add and (rarely) a max
+//   CAS, all relaxed.  A summary reports each percentile as the upper bound
+//   of its bucket, capped at the observed maximum.
+//
+// TRACELOGGING
+//   Provider "SshReverseSocksProxy", keywords per area (see kKeyword*), all
+//   events at verbose level with a single DurationUs field.  For example:
+//     tracelog -start p -f p.etl -guid #5605eb62-b286-56fc-7d12-fcd8dc33e328 -level 5
+//   TraceLoggingWrite tests the provider's enable state inline, so with no
+//   listener an event costs one load and a branch.
+//
+// POSIX
+//   No ETW: the histograms record as on Windows and Register() is a no-op.
+//   The tick clock is CLOCK_MONOTONIC in nanoseconds.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "instrumentation.h"
+
+#ifdef _WIN32
+#include <intrin.h>
+#include <TraceLoggingProvider.h>
+#include <winmeta.h>
+
+TRACELOGGING_DEFINE_PROVIDER(g_ssh_proxy_trace, "SshReverseSocksProxy",
+    (0x5605eb62, 0xb286, 0x56fc, 0x7d, 0x12, 0xfc, 0xd8, 0xdc, 0x33, 0xe3, 0x28));
+#else
+#include <ctime>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+constexpr uint64_t kKeywordSession = 0x1;   // SocksConnect
+constexpr uint64_t kKeywordConnect = 0x2;   // DnsResolve, TcpConnect
+constexpr uint64_t kKeywordIoLoop  = 0x4;   // IoLoopTick, WriteQueueWait
+#endif
+
+constexpr size_t kPointCount = static_cast<size_t>(LatencyPoint::kCount);
+
+LatencyHistogram s_histograms[kPointCount];
+bool             s_registered = false;
+
+int64_t QpcFrequency()
+{
+#ifdef _WIN32
+    static const int64_t freq = []()
+    {
+        LARGE_INTEGER f;
+        ::QueryPerformanceFrequency(&f);
+        return f.QuadPart;
+    }();
+    return freq;
+#else
+    return 1000000000;
+#endif
+}
+
+} // namespace
+
+// ── QPC helpers ───────────────────────────────────────────────────────────────
+
+int64_t QpcNow()
+{
+#ifdef _WIN32
+    LARGE_INTEGER t;
+    ::QueryPerformanceCounter(&t);
+    return t.QuadPart;
+#else
+    timespec ts{};
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+uint64_t QpcToUs(int64_t ticks)
+{
+    if (ticks <= 0) return 0;
+    // Split so ticks * 10^6 cannot overflow, however long the interval.
+    int64_t freq = QpcFrequency();
+    return static_cast<uint64_t>(ticks / freq) * 1000000 +
+           static_cast<uint64_t>((ticks % freq) * 1000000 / freq);
+}
+
+double QpcToSeconds(int64_t ticks)
+{
+    return static_cast<double>(ticks) / static_cast<double>(QpcFrequency());
+}
+
+// ── LatencyHistogram ──────────────────────────────────────────────────────────
+
+size_t LatencyHistogram::BucketOf(uint64_t us)
+{
+    if (us < kExactBelow) return static_cast<size_t>(us);
+#ifdef _WIN32
+    unsigned long top = 0;
+    _BitScanReverse64(&top, us);                         // >= 4
+#else
+    unsigned long top = 63 - static_cast<unsigned long>(__builtin_clzll(us));
+#endif
+    size_t sub = static_cast<size_t>(us >> (top - 3)) & (kSubBuckets - 1);
+    return kExactBelow + (static_cast<size_t>(top) - 4) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t bucket)
+{
+    if (bucket < kExactBelow) return bucket;
+    size_t   top   = (bucket - kExactBelow) / kSubBuckets + 4;
+    uint64_t sub   = (bucket - kExactBelow) % kSubBuckets;
+    uint64_t width = uint64_t{1} << (top - 3);
+    return ((kSubBuckets + sub) << (top - 3)) + (width - 1);
+}
+
+void LatencyHistogram::Record(uint64_t us)
+{
+    m_buckets[BucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum_us.fetch_add(us, std::memory_order_relaxed);
+
+    uint64_t max = m_max_us.load(std::memory_order_relaxed);
+    while (us > max &&
+           !m_max_us.compare_exchange_weak(max, us, std::memory_order_relaxed))
+    {
+    }
+}
+
+ssh_proxy::LatencyStats LatencyHistogram::Summarize() const
+{
+    uint64_t counts[kBucketCount];
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; ++i)
+    {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    ssh_proxy::LatencyStats st;
+    if (total == 0) return st;
+
+    uint64_t sum = m_sum_us.load(std::memory_order_relaxed);
+    uint64_t n   = m_count.load(std::memory_order_relaxed);
+    st.count  = total;
+    st.max_us = m_max_us.load(std::memory_order_relaxed);
+    st.mean_us = n ? static_cast<double>(sum) / static_cast<double>(n) : 0.0;
+
+    // Nearest rank: the smallest bucket covering ceil(q * total) records.
+    auto percentile = [&](uint64_t per_mille) -> uint64_t
+    {
+        uint64_t rank = (total * per_mille + 999) / 1000;
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                uint64_t v = BucketUpperBound(i);
+                return v < st.max_us ? v : st.max_us;
+            }
+        }
+        return st.max_us;
+    };
+    st.p50_us  = percentile(500);
+    st.p90_us  = percentile(900);
+    st.p99_us  = percentile(990);
+    st.p999_us = percentile(999);
+    return st;
+}
+
+void LatencyHistogram::Reset()
+{
+    for (auto& b : m_buckets) b.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum_us.store(0, std::memory_order_relaxed);
+    m_max_us.store(0, std::memory_order_relaxed);
+}
+
+// ── Instrumentation ───────────────────────────────────────────────────────────
+
+void Instrumentation::Register()
+{
+    if (s_registered) return;
+#ifdef _WIN32
+    s_registered = SUCCEEDED(::TraceLoggingRegister(g_ssh_proxy_trace));
+#endif
+}
+
+void Instrumentation::Unregister()
+{
+    if (!s_registered) return;
+#ifdef _WIN32
+    ::TraceLoggingUnregister(g_ssh_proxy_trace);
+#endif
+    s_registered = false;
+}
+
+//
+// ── RecordLatency ─────────────────────────────────────────────────────────────
+//
+// TraceLoggingWrite needs the event name and keyword as compile-time
+// constants, hence one call per point.
+//
+
+void Instrumentation::RecordLatency(LatencyPoint point, uint64_t us)
+{
+    s_histograms[static_cast<size_t>(point)].Record(us);
+
+#ifdef _WIN32
+    switch (point)
+    {
+    case LatencyPoint::SocksConnect:
+        TraceLoggingWrite(g_ssh_proxy_trace, "SocksConnect",
+            TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+            TraceLoggingKeyword(kKeywordSession),
+            TraceLoggingUInt64(us, "DurationUs"));
+        break;
+    case LatencyPoint::DnsResolve:
+        TraceLoggingWrite(g_ssh_proxy_trace, "DnsResolve",
+            TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+            TraceLoggingKeyword(kKeywordConnect),
+            TraceLoggingUInt64(us, "DurationUs"));
+        break;
+    case LatencyPoint::TcpConnect:
+        TraceLoggingWrite(g_ssh_proxy_trace, "TcpConnect",
+            TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+            TraceLoggingKeyword(kKeywordConnect),
+            TraceLoggingUInt64(us, "DurationUs"));
+        break;
+    case LatencyPoint::IoLoopTick:
+        TraceLoggingWrite(g_ssh_proxy_trace, "IoLoopTick",
+            TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+            TraceLoggingKeyword(kKeywordIoLoop),
+            TraceLoggingUInt64(us, "DurationUs"));
+        break;
+    case LatencyPoint::WriteQueueWait:
+        TraceLoggingWrite(g_ssh_proxy_trace, "WriteQueueWait",
+            TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+            TraceLoggingKeyword(kKeywordIoLoop),
+            TraceLoggingUInt64(us, "DurationUs"));
+        break;
+    case LatencyPoint::kCount:
+        break;
+    }
+#endif
+}
+
+ssh_proxy::LatencyStats Instrumentation::Summarize(LatencyPoint point)
+{
+    return s_histograms[static_cast<size_t>(point)].Summarize();
+}
+
+void Instrumentation::Reset()
+{
+    for (auto& h : s_histograms) h.Reset();
+}
@@ -0,0 +1,182 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// IoAffinity — processor placement for IoEngine's workers and the SSH I/O threads
+//
+// PURPOSE
+//   With affinity on, every completion for a socket tends to run on a warm
+//   cache, and the SSH I/O threads — the one serial stage of the relay —
+//   never queue behind a worker on their own processor.  Off by default:
+//   on a busy shared machine pinning can only take choices away from the
+//   scheduler.
+//
+// PLAN
+//   PlanIoAffinity is a pure function of the processor layout so the split
+//   can be tested anywhere.  The lowest processors go to the I/O threads
+//   (they are shared by every transport), the rest to the workers: one
+//   processor each in Core mode, one node's processors each in NumaNode
+//   mode, wrapping when there are more workers than slots.
+//
+// LIMITS
+//   One processor group (Windows) / the first 64 CPUs.  Where the node
+//   masks are unknown (POSIX reads them from sysfs, which may be absent),
+//   NumaNode treats all processors as one node.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "io_affinity.h"
+#include "platform.h"
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sched.h>
+#include <cstdio>
+#include <cstdlib>
+#endif
+
+namespace {
+
+// The n-th set bit of mask (n < ProcessorCount(mask)).
+uint64_t NthProcessor(uint64_t mask, int n)
+{
+    for (int bit = 0; bit < 64; ++bit)
+    {
+        uint64_t b = uint64_t{1} << bit;
+        if ((mask & b) != 0 && n-- == 0) return b;
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+// Parses a sysfs cpulist ("0-3,8,10-11") into a mask of the first 64 CPUs.
+uint64_t ParseCpuList(const char* list)
+{
+    uint64_t mask = 0;
+    const char* p = list;
+    while (*p != '\0' && *p != '\n')
+    {
+        char* end = nullptr;
+        long first = std::strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            last = std::strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < 64; ++cpu)
+            if (cpu >= 0) mask |= uint64_t{1} << cpu;
+        if (*p == ',') ++p;
+    }
+    return mask;
+}
+#endif
+
+} // namespace
+
+int ProcessorCount(uint64_t mask)
+{
+    int n = 0;
+    for (; mask != 0; mask &= mask - 1) ++n;
+    return n;
+}
+
+IoAffinityPlan PlanIoAffinity(IoAffinity mode, const ProcessorLayout& layout,
+                              int workers, uint32_t io_processors)
+{
+    IoAffinityPlan plan;
+    int total = ProcessorCount(layout.available);
+    if (mode == IoAffinity::None || total == 0 || workers <= 0)
+        return plan;
+
+    int reserved = (std::min)(static_cast<int>(io_processors), total - 1);
+    for (int i = 0; i < reserved; ++i)
+        plan.io_threads |= NthProcessor(layout.available, i);
+    uint64_t rest = layout.available & ~plan.io_threads;
+
+    std::vector<uint64_t> slots;
+    if (mode == IoAffinity::NumaNode)
+    {
+        for (uint64_t node : layout.nodes)
+            if ((node & rest) != 0) slots.push_back(node & rest);
+        if (slots.empty()) slots.push_back(rest);
+    }
+    else
+    {
+        for (int i = 0; i < ProcessorCount(rest); ++i)
+            slots.push_back(NthProcessor(rest, i));
+    }
+
+    plan.workers.reserve(static_cast<size_t>(workers));
+    for (int i = 0; i < workers; ++i)
+        plan.workers.push_back(slots[static_cast<size_t>(i) % slots.size()]);
+    return plan;
+}
+
+#ifdef _WIN32
+
+ProcessorLayout QueryProcessorLayout()
+{
+    ProcessorLayout layout;
+    DWORD_PTR process_mask = 0, system_mask = 0;
+    if (::GetProcessAffinityMask(::GetCurrentProcess(), &process_mask, &system_mask))
+        layout.available = static_cast<uint64_t>(process_mask);
+
+    GROUP_AFFINITY current{};
+    ULONG highest = 0;
+    if (!::GetThreadGroupAffinity(::GetCurrentThread(), &current) ||
+        !::GetNumaHighestNodeNumber(&highest))
+        return layout;
+    for (ULONG node = 0; node <= highest; ++node)
+    {
+        GROUP_AFFINITY ga{};
+        if (::GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &ga) &&
+            ga.Group == current.Group && (ga.Mask & process_mask) != 0)
+            layout.nodes.push_back(static_cast<uint64_t>(ga.Mask & process_mask));
+    }
+    return layout;
+}
+
+bool PinCurrentThread(uint64_t mask)
+{
+    return ::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(mask)) != 0;
+}
+
+#else
+
+ProcessorLayout QueryProcessorLayout()
+{
+    ProcessorLayout layout;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < 64; ++cpu)
+            if (CPU_ISSET(cpu, &set)) layout.available |= uint64_t{1} << cpu;
+    }
+
+    for (int node = 0; node < 64; ++node)
+    {
+        char path[64];
+        std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        std::FILE* f = std::fopen(path, "r");
+        if (f == nullptr) break;
+        char list[256] = {};
+        bool got = std::fgets(list, sizeof(list), f) != nullptr;
+        std::fclose(f);
+        uint64_t mask = got ? ParseCpuList(list) & layout.available : 0;
+        if (mask != 0) layout.nodes.push_back(mask);
+    }
+    return layout;
+}
+
+bool PinCurrentThread(uint64_t mask)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < 64; ++cpu)
+        if ((mask & (uint64_t{1} << cpu)) != 0) CPU_SET(cpu, &set);
+    return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#endif
@@ -1,50 +1,531 @@
 //////////////////////////////////////////////////////////////////////////////
 //
-// Logger — thread-safe circular log buffer with optional live callback
+// Logger — lock-free log ring with a background callback drain
 //
 // PURPOSE
 //   Process-wide structured logging at four levels (Debug, Info, Warn, Error).
-//   Entries accumulate in a fixed-size deque (k_max_entries = 100); the oldest
-//   entry is evicted when the buffer is full.  ssh_proxy::GetLog() formats
-//   the current snapshot as a newline-separated string for public API callers.
+//   Entries are written into a preallocated ring of fixed-size records
+//   (k_ring_entries until SetCapacity() says otherwise); the newest
+//   k_max_entries are visible through Snapshot(), and ssh_proxy::GetLog()
+//   formats that snapshot as a newline-separated string.  Since() returns
+//   what followed a given sequence number, so a poller reads only what is
+//   new — ssh_proxy::GetLogSince().
 //
-// LOCKING
-//   A single s_mutex protects s_buffer, s_min_level, and s_callback.
-//   Log() checks the level under the lock first, then formats the message
-//   outside it (vsnprintf can be slow).  The live callback is copied under
-//   the lock and invoked outside to prevent re-entrancy deadlocks if the
-//   callback itself calls Logger methods.
+// HOT PATH
+//   Log() does no locking and no heap allocation: an atomic level check,
+//   vsnprintf into a stack buffer, a raw FILETIME-unit clock read, one
+//   fetch_add on s_head to claim a ticket, and a copy into the ticket's
+//   record.  Timestamps are only formatted when an entry leaves the ring
+//   (Snapshot(), drain thread).
+//
+// RECORDS
+//   Ticket t lives in records[t % capacity] and is reported as sequence
+//   number t + 1.  Each record carries a sequence word: 2t+1 while ticket t
+//   is being written, 2t+2 once it is published.  Readers copy a record and
+//   accept it only if the sequence read before and after the copy both
+//   equal 2t+2 — a record overwritten mid-copy is simply skipped.  A writer
+//   lapped by `capacity` newer tickets before it could claim its record
+//   drops its entry.  Readers take no lock and never make a writer wait, so
+//   Since() costs the entries it returns, whatever the ring's size.
+//
+// RESIZE
+//   SetCapacity() builds a new ring, copies the newest entries that fit,
+//   publishes it and then sets its `first` to the head at that moment.  A
+//   writer re-checks the ring after publishing its record and, if it was
+//   replaced, writes the record into the new one too — unless its ticket is
+//   below `first`, which readers already treat as lost when unpublished.
+//   Tickets at or above `first` were claimed after the new ring went up, so
+//   every one of them ends up published there.  A replaced ring cannot be
+//   freed — a writer may still be copying into it — so only the static
+//   default ring is ever replaced: the first resize takes effect and later
+//   ones are refused, which bounds what is left behind to that one ring,
+//   itself static storage.
+//
+// DRAIN THREAD
+//   Started by the first SetCallback() with a non-null callback.  It follows
+//   s_head, formats each published entry and invokes the callback under
+//   s_drain.callback_mutex, so SetCallback() can swap the callback (and
+//   wait out an in-flight call) without the writers ever touching that lock.
+//   Writers wake it through an auto-reset signal (WakeSignal: an event on
+//   Windows, an eventfd on POSIX), but only when a callback is installed and
+//   the thread has announced that it is about to sleep.  If it falls more
+//   than a ring behind, the lost entries are reported to the callback as a
+//   single Warn entry.
 //
 //////////////////////////////////////////////////////////////////////////////
 
 #include "logger.h"
+#include <algorithm>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
-#include <sstream>
-#include <iomanip>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/eventfd.h>
+#include <ctime>
+#endif
+
+static_assert((Logger::k_ring_entries & (Logger::k_ring_entries - 1)) == 0,
+              "k_ring_entries must be a power of two");
+static_assert(Logger::k_min_ring_entries > Logger::k_max_entries,
+              "the ring must hold at least one Snapshot()");
+
+std::atomic<ssh_proxy::LogLevel> Logger::s_min_level{ssh_proxy::LogLevel::Info};
+
+namespace {
+
+struct Record {
+    std::atomic<uint64_t> seq;     // 0 = never written, 2t+1 = writing, 2t+2 = ticket t
+    uint64_t              time;    // FILETIME (UTC, 100 ns units)
+    ssh_proxy::LogLevel   level;
+    uint16_t              len;
+    char                  text[Logger::k_message_bytes];
+};
+
+struct Ring {
+    Record*               records;
+    uint64_t              mask;    // capacity - 1
+    std::atomic<uint64_t> first;   // unpublished tickets below this are lost (RESIZE)
+};
+
+// Zero-initialised static storage — usable before and after dynamic
+// initialisation, so logging from other static constructors is safe.
+Record                s_default_records[Logger::k_ring_entries];
+Ring                  s_default_ring{ s_default_records, Logger::k_ring_entries - 1, {0} };
+std::atomic<Ring*>    s_ring{&s_default_ring};
+std::mutex            s_resize_mutex;
+std::atomic<uint64_t> s_head{0};              // next ticket to hand out
+std::atomic<bool>     s_callback_set{false};  // writers wake the drain only when set
+
+// The drain thread's auto-reset wake-up.  Set() is one system call and
+// takes no lock, so writers can afford it.
+class WakeSignal {
+public:
+#ifdef _WIN32
+    bool Create()
+    {
+        m_event = ::CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        return m_event != nullptr;
+    }
+    void Set()   { if (m_event) ::SetEvent(m_event); }
+    void Wait()  { ::WaitForSingleObject(m_event, INFINITE); }
+    void Close() { if (m_event) ::CloseHandle(m_event); m_event = nullptr; }
+private:
+    HANDLE m_event = nullptr;
+#else
+    bool Create() { m_fd = ::eventfd(0, EFD_CLOEXEC); return m_fd >= 0; }
+    void Set()
+    {
+        if (m_fd < 0) return;
+        uint64_t one = 1;
+        ssize_t n = ::write(m_fd, &one, sizeof(one));
+        (void)n;   // a full counter already means "wake up"
+    }
+    void Wait()
+    {
+        uint64_t drained = 0;
+        ssize_t n = ::read(m_fd, &drained, sizeof(drained));   // blocks, then resets
+        (void)n;
+    }
+    void Close()  { if (m_fd >= 0) ::close(m_fd); m_fd = -1; }
+private:
+    int m_fd = -1;
+#endif
+};
+
+#ifndef _WIN32
+constexpr uint64_t kUnixEpochAsFileTime = 116444736000000000ull;   // 1970 - 1601
+#endif
+
+// Now as FILETIME units — 100 ns since 1601-01-01 UTC — on every platform.
+uint64_t NowFileTime()
+{
+#ifdef _WIN32
+    FILETIME ft;
+    ::GetSystemTimePreciseAsFileTime(&ft);
+    return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+#else
+    timespec ts{};
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return kUnixEpochAsFileTime + static_cast<uint64_t>(ts.tv_sec) * 10000000u +
+           static_cast<uint64_t>(ts.tv_nsec) / 100u;
+#endif
+}
+
+// Spin-wait hint while a record's previous writer finishes.
+inline void CpuRelax()
+{
+#if defined(_WIN32)
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+struct DrainState {
+    std::mutex              callback_mutex;   // held while the callback runs
+    Logger::LogCallback     callback;
+    std::atomic<uint64_t>   deliver_from{0};  // tickets below this predate the callback
+    std::thread             thread;
+    WakeSignal              wake;
+    std::atomic<bool>       waiting{false};   // thread is about to wait on `wake`
+    std::atomic<bool>       stop{false};
+    std::atomic<uint64_t>   drained{0};       // all tickets below this are handled
+    std::atomic<int>        flush_waiters{0};
+    std::mutex              flush_mutex;
+    std::condition_variable flush_cv;
+
+    ~DrainState()
+    {
+        s_callback_set.store(false);
+        if (thread.joinable())
+        {
+            stop.store(true);
+            wake.Set();
+            thread.join();
+        }
+        wake.Close();
+    }
+};
+
+DrainState s_drain;
+thread_local bool s_on_drain_thread = false;
+
+// Copy ticket t out of `ring`.  Returns 1 on success, 0 if the ticket is
+// not published yet, -1 if it has already been overwritten (or torn) or
+// was lost in a resize.
+int ReadRecord(const Ring& ring, uint64_t t, Record& out)
+{
+    const Record& r = ring.records[t & ring.mask];
+    const uint64_t want = 2 * t + 2;
+
+    uint64_t before = r.seq.load(std::memory_order_acquire);
+    if (before < want) return t < ring.first.load() ? -1 : 0;
+    if (before > want) return -1;
+
+    out.time  = r.time;
+    out.level = r.level;
+    out.len   = r.len;
+    std::memcpy(out.text, r.text, out.len);
+    out.text[out.len] = '\0';
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return r.seq.load(std::memory_order_relaxed) == want ? 1 : -1;
+}
 
-// Static member definitions
-std::mutex            Logger::s_mutex;
-std::deque<LogEntry>  Logger::s_buffer;
-ssh_proxy::LogLevel   Logger::s_min_level = ssh_proxy::LogLevel::Info;
-Logger::LogCallback   Logger::s_callback;
+std::string FormatTimestamp(uint64_t filetime)
+{
+#ifdef _WIN32
+    FILETIME   ft;
+    ft.dwLowDateTime  = static_cast<DWORD>(filetime);
+    ft.dwHighDateTime = static_cast<DWORD>(filetime >> 32);
+
+    SYSTEMTIME utc, st;
+    if (!::FileTimeToSystemTime(&ft, &utc) ||
+        !::SystemTimeToTzSpecificLocalTime(nullptr, &utc, &st))
+        ::GetLocalTime(&st);
+
+    char ts_buf[32];
+    ::snprintf(ts_buf, sizeof(ts_buf), "%04u-%02u-%02u %02u:%02u:%02u.%03u",
+        st.wYear, st.wMonth, st.wDay,
+        st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+    return ts_buf;
+#else
+    uint64_t since_epoch = filetime > kUnixEpochAsFileTime ? filetime - kUnixEpochAsFileTime : 0;
+    time_t   secs        = static_cast<time_t>(since_epoch / 10000000u);
+    unsigned millis      = static_cast<unsigned>(since_epoch % 10000000u / 10000u);
+
+    tm local{};
+    ::localtime_r(&secs, &local);
+    char ts_buf[40];
+    ::snprintf(ts_buf, sizeof(ts_buf), "%04d-%02d-%02d %02d:%02d:%02d.%03u",
+        local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+        local.tm_hour, local.tm_min, local.tm_sec, millis);
+    return ts_buf;
+#endif
+}
+
+LogEntry ToEntry(uint64_t t, const Record& r)
+{
+    LogEntry entry;
+    entry.seq       = t + 1;
+    entry.timestamp = FormatTimestamp(r.time);
+    entry.level     = r.level;
+    entry.message.assign(r.text, r.len);
+    return entry;
+}
+
+void MarkDrained(uint64_t next)
+{
+    s_drain.drained.store(next);
+    if (s_drain.flush_waiters.load() > 0)
+    {
+        { std::lock_guard<std::mutex> lock(s_drain.flush_mutex); }
+        s_drain.flush_cv.notify_all();
+    }
+}
+
+// Hand one record to the callback.  Entries that predate the current
+// callback are skipped; `dropped` is reported first if anything was lost.
+void Deliver(uint64_t t, const Record& r, uint64_t& dropped)
+{
+    std::lock_guard<std::mutex> lock(s_drain.callback_mutex);
+    if (!s_drain.callback || t < s_drain.deliver_from.load())
+    {
+        dropped = 0;
+        return;
+    }
+
+    if (dropped > 0)
+    {
+        LogEntry lost;
+        lost.timestamp = FormatTimestamp(r.time);
+        lost.level     = ssh_proxy::LogLevel::Warn;
+        lost.message   = "Logger: " + std::to_string(dropped) +
+                         " entries dropped before reaching the callback";
+        dropped = 0;
+        s_drain.callback(lost);
+    }
+    s_drain.callback(ToEntry(t, r));
+}
+
+// Claims ticket t's record in `ring` and publishes the entry there (see
+// RECORDS).  The claim only spins while the previous occupant of the record
+// is still being written.
+void Publish(Ring& ring, uint64_t t, uint64_t time, ssh_proxy::LogLevel level,
+             const char* text, size_t len)
+{
+    Record& r = ring.records[t & ring.mask];
+
+    uint64_t prev = r.seq.load(std::memory_order_acquire);
+    for (;;)
+    {
+        if (prev > 2 * t)
+            return;   // lapped: a newer ticket already owns the record
+        if ((prev & 1) == 0)
+        {
+            if (r.seq.compare_exchange_weak(prev, 2 * t + 1, std::memory_order_acquire))
+                break;
+            continue;
+        }
+        CpuRelax();
+        prev = r.seq.load(std::memory_order_acquire);
+    }
+
+    r.time  = time;
+    r.level = level;
+    r.len   = static_cast<uint16_t>(len);
+    std::memcpy(r.text, text, len);
+    r.seq.store(2 * t + 2, std::memory_order_release);
+}
+
+// Tickets [from, to) that are still in the ring, oldest first.  With
+// stop_at_pending the walk ends at the first ticket still being written,
+// so an incremental reader resumes there instead of skipping it.
+std::vector<LogEntry> ReadRange(uint64_t from, uint64_t to, bool stop_at_pending)
+{
+    const Ring& ring = *s_ring.load();
+    std::vector<LogEntry> out;
+    out.reserve(static_cast<size_t>(to - from));
+    Record rec;
+    for (uint64_t t = from; t < to; ++t)
+    {
+        int got = ReadRecord(ring, t, rec);
+        if (got > 0)
+            out.push_back(ToEntry(t, rec));
+        else if (got == 0 && stop_at_pending)
+            break;
+    }
+    return out;
+}
+
+//
+// ── DrainThreadProc ───────────────────────────────────────────────────────────
+//
+// Follows s_head one ticket at a time.  The sleep handshake pairs with the
+// wake check at the end of Logger::Log(): the thread publishes `waiting`
+// before its final look at s_head, and a writer bumps s_head before it
+// reads `waiting`, so one of the two always sees the other.
+//
+
+void DrainThreadProc()
+{
+    s_on_drain_thread = true;
+
+    // Start where the first callback's entries start, not at s_head: the
+    // thread may only get going after the first entries were logged.
+    uint64_t next    = s_drain.deliver_from.load();
+    uint64_t dropped = 0;
+    Record   rec;
+
+    while (!s_drain.stop.load())
+    {
+        // Skip whatever was logged before the current callback was set.
+        uint64_t from = s_drain.deliver_from.load();
+        if (next < from)
+        {
+            next    = from;
+            dropped = 0;
+        }
+
+        const Ring& ring = *s_ring.load();
+        uint64_t head = s_head.load();
+        if (next == head)
+        {
+            MarkDrained(next);
+            s_drain.waiting.store(true);
+            if (s_head.load() == next && !s_drain.stop.load())
+                s_drain.wake.Wait();
+            s_drain.waiting.store(false);
+            continue;
+        }
+
+        const uint64_t capacity = ring.mask + 1;
+        if (head - next > capacity)
+        {
+            dropped += head - capacity - next;
+            next     = head - capacity;
+        }
+
+        int got = ReadRecord(ring, next, rec);
+        if (got == 0)
+        {
+            // Claimed but not yet published — the writer is mid-copy.
+            std::this_thread::yield();
+            continue;
+        }
+        if (got > 0)
+            Deliver(next, rec, dropped);
+        else
+            ++dropped;
+        MarkDrained(++next);
+    }
+
+    MarkDrained(s_head.load());
+}
+
+} // namespace
 
 void Logger::SetMinLevel(ssh_proxy::LogLevel level)
 {
-    std::lock_guard<std::mutex> lock(s_mutex);
-    s_min_level = level;
+    s_min_level.store(level, std::memory_order_relaxed);
 }
 
 void Logger::SetCallback(LogCallback cb)
 {
-    std::lock_guard<std::mutex> lock(s_mutex);
-    s_callback = std::move(cb);
+    std::lock_guard<std::mutex> lock(s_drain.callback_mutex);
+    s_drain.callback     = std::move(cb);
+    s_drain.deliver_from.store(s_head.load());
+
+    bool has_callback = static_cast<bool>(s_drain.callback);
+    if (has_callback && !s_drain.thread.joinable())
+    {
+        if (!s_drain.wake.Create())
+        {
+            s_drain.callback = nullptr;
+            return;
+        }
+        s_drain.thread = std::thread(DrainThreadProc);
+    }
+    s_callback_set.store(has_callback);
+}
+
+//
+// ── Flush ─────────────────────────────────────────────────────────────────────
+//
+// Waits until the drain thread has moved past every ticket handed out before
+// the call.  Writers of those tickets that are still mid-copy are waited for
+// by the drain thread itself.
+//
+
+void Logger::Flush()
+{
+    if (s_on_drain_thread || !s_callback_set.load())
+        return;
+
+    const uint64_t target = s_head.load();
+    s_drain.flush_waiters.fetch_add(1);
+    s_drain.wake.Set();
+    {
+        std::unique_lock<std::mutex> lock(s_drain.flush_mutex);
+        s_drain.flush_cv.wait(lock, [target]() {
+            return s_drain.drained.load() >= target || s_drain.stop.load();
+        });
+    }
+    s_drain.flush_waiters.fetch_sub(1);
 }
 
 std::vector<LogEntry> Logger::Snapshot()
 {
-    std::lock_guard<std::mutex> lock(s_mutex);
-    return std::vector<LogEntry>(s_buffer.begin(), s_buffer.end());
+    const uint64_t head  = s_head.load();
+    const uint64_t first = head > k_max_entries ? head - k_max_entries : 0;
+    return ReadRange(first, head, false);
+}
+
+std::vector<LogEntry> Logger::Since(uint64_t after_seq, size_t max_entries)
+{
+    // Sequence number s is ticket s - 1, so the first ticket wanted is after_seq.
+    const uint64_t head     = s_head.load();
+    const uint64_t capacity = Capacity();
+    uint64_t first = head > capacity ? head - capacity : 0;
+    first = (std::max)(first, after_seq);
+    if (first >= head) return {};
+    uint64_t last = head - first > max_entries ? first + max_entries : head;
+    return ReadRange(first, last, true);
+}
+
+//
+// ── SetCapacity ───────────────────────────────────────────────────────────────
+//
+// See RESIZE in the file header.  The records are taken from calloc so a
+// large ring costs address space, not memory, until it fills — their
+// constructors are trivial and the zero bytes are the initial state.
+//
+
+bool Logger::SetCapacity(size_t entries)
+{
+    size_t capacity = k_min_ring_entries;
+    while (capacity < entries && capacity < k_max_ring_entries) capacity <<= 1;
+
+    std::unique_lock<std::mutex> lock(s_resize_mutex);
+    Ring* old = s_ring.load();
+    if (old->mask + 1 == capacity) return true;
+    if (old != &s_default_ring)
+    {
+        lock.unlock();
+        Warn("Log capacity is already %zu; resize to %zu refused",
+             static_cast<size_t>(old->mask + 1), capacity);
+        return false;
+    }
+
+    void* mem = std::calloc(capacity, sizeof(Record));
+    if (mem == nullptr) return false;   // keep the ring we have
+    Record* records = static_cast<Record*>(mem);
+    for (size_t i = 0; i < capacity; ++i) ::new (&records[i]) Record;
+    Ring* fresh = new Ring{ records, capacity - 1, {0} };
+
+    // Carry over the newest entries that fit.
+    const uint64_t head  = s_head.load();
+    const uint64_t keep  = (std::min)(static_cast<uint64_t>(capacity), old->mask + 1);
+    Record rec;
+    for (uint64_t t = head > keep ? head - keep : 0; t < head; ++t)
+        if (ReadRecord(*old, t, rec) > 0)
+            Publish(*fresh, t, rec.time, rec.level, rec.text, rec.len);
+
+    s_ring.store(fresh);
+    fresh->first.store(s_head.load());
+    return true;
+}
+
+size_t Logger::Capacity()
+{
+    return static_cast<size_t>(s_ring.load()->mask + 1);
 }
 
 void Logger::Debug(const char* fmt, ...)
@@ -79,51 +560,37 @@ void Logger::Error(const char* fmt, ...)
 // ── Log ───────────────────────────────────────────────────────────────────────
 //
 // Internal implementation called by all public level helpers.  Checks the
-// minimum level under the lock before doing any formatting to avoid the cost
-// of vsnprintf for suppressed messages.  The callback is invoked after the
-// lock is released — see LOCKING note in the file header.
+// minimum level before doing any formatting, formats into a stack buffer,
+// then claims a ticket and publishes the record — see RECORDS and RESIZE in
+// the file header.
 //
 
 void Logger::Log(ssh_proxy::LogLevel level, const char* fmt, va_list args)
 {
-    // Check level before formatting
-    {
-        std::lock_guard<std::mutex> lock(s_mutex);
-        if (static_cast<int>(level) < static_cast<int>(s_min_level))
-            return;
-    }
-
-    // Format message
-    char msg_buf[1024];
-    ::vsnprintf(msg_buf, sizeof(msg_buf), fmt, args);
+    if (static_cast<int>(level) <
+        static_cast<int>(s_min_level.load(std::memory_order_relaxed)))
+        return;
 
-    // Build timestamp
-    SYSTEMTIME st;
-    ::GetLocalTime(&st);
-    char ts_buf[32];
-    ::snprintf(ts_buf, sizeof(ts_buf), "%04u-%02u-%02u %02u:%02u:%02u.%03u",
-        st.wYear, st.wMonth, st.wDay,
-        st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+    char msg_buf[k_message_bytes];
+    int  n   = ::vsnprintf(msg_buf, sizeof(msg_buf), fmt, args);
+    size_t len = n < 0 ? 0 : (std::min)(static_cast<size_t>(n), sizeof(msg_buf) - 1);
 
-    LogEntry entry;
-    entry.timestamp = ts_buf;
-    entry.level     = level;
-    entry.message   = msg_buf;
-
-    LogCallback cb_copy;
+    const uint64_t time = NowFileTime();
+    const uint64_t t    = s_head.fetch_add(1);
+    Ring* ring = s_ring.load();
+    for (;;)
     {
-        std::lock_guard<std::mutex> lock(s_mutex);
-        if (s_buffer.size() >= k_max_entries)
-            s_buffer.pop_front();
-        s_buffer.push_back(entry);
-        cb_copy = s_callback;
+        Publish(*ring, t, time, level, msg_buf, len);
+        Ring* now = s_ring.load();
+        if (now == ring || t < now->first.load()) break;
+        ring = now;   // resized mid-write — see RESIZE
     }
 
-    if (cb_copy)
-        cb_copy(entry);
+    if (s_callback_set.load() && s_drain.waiting.exchange(false))
+        s_drain.wake.Set();
 }
 
-// ── ssh_proxy::GetLog() ───────────────────────────────────────────────────────
+// ── ssh_proxy::GetLog() / GetLogSince() ───────────────────────────────────────
 
 namespace ssh_proxy {
 
@@ -148,4 +615,14 @@ std::string GetLog()
     return out;
 }
 
+std::vector<LogRecord> GetLogSince(uint64_t after_seq, size_t max_entries)
+{
+    return Logger::Since(after_seq, max_entries);
+}
+
+void SetLogCapacity(size_t entries)
+{
+    Logger::SetCapacity(entries);
+}
+
 } // namespace ssh_proxy
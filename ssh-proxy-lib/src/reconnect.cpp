@@ -0,0 +1,38 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// ReconnectBackoff — jittered exponential delays for the reconnect supervisor
+//
+// PURPOSE
+//   Connect's supervisor thread re-establishes transports that dropped.  A
+//   server that is down must not be hammered, and several transports (or
+//   several proxies) that lost the same server must not come back in one
+//   synchronised burst — the backoff doubles per failed attempt and each
+//   delay is drawn from the upper half of its window.
+//
+// CEILING
+//   The doubling saturates: once initial_ms << n would pass max_ms (or
+//   overflow), every further retry waits within [max_ms/2, max_ms].
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "reconnect.h"
+#include <algorithm>
+
+ReconnectBackoff::ReconnectBackoff(uint32_t initial_ms, uint32_t max_ms, uint32_t seed)
+    : m_initial_ms(initial_ms)
+    , m_max_ms((std::max)(initial_ms, max_ms))
+    , m_rng(seed != 0 ? seed : 1)   // minstd_rand must not be seeded with 0
+{
+}
+
+uint32_t ReconnectBackoff::Next()
+{
+    uint64_t ceiling = m_max_ms;
+    if (m_attempt < 32)
+        ceiling = (std::min)(uint64_t{m_initial_ms} << m_attempt, uint64_t{m_max_ms});
+    ++m_attempt;
+
+    uint32_t c    = static_cast<uint32_t>(ceiling);
+    uint32_t half = c / 2;
+    return half + static_cast<uint32_t>(m_rng() % (c - half + 1));
+}
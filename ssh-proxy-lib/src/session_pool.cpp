@@ -0,0 +1,164 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// SessionPool — per-transport recycling of session memory
+//
+// PURPOSE
+//   A SOCKS5 session is a Socks5Session plus its TcpConnection, each behind
+//   a shared_ptr.  Built with make_shared that is two heap allocations per
+//   accepted channel, freed again moments later for short CONNECT bursts.
+//   Carving both (control blocks included) from one pooled Block makes a
+//   session's setup and teardown two uncontended lock round-trips instead.
+//
+// WHY MEMORY, NOT OBJECTS
+//   The objects themselves are constructed and destroyed as usual; only
+//   their storage is recycled.  A session object cannot be "reset" and
+//   handed out again while an IOCP completion or a weak_ptr callback of the
+//   previous session might still reach it — the control block's final
+//   deallocation is the one point where nothing can, and that is exactly
+//   when the block returns to the free list.
+//
+// BLOCK LAYOUT
+//   [Block header | pad to 64][object 1 | pad to 64][object 2 | pad] ...
+//   `used` is a bump offset; `refs` counts live sub-allocations plus the
+//   creator's reference.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "session_pool.h"
+#include <algorithm>
+#include <new>
+
+struct alignas(SessionPool::kCacheLine) SessionPool::Block {
+    std::shared_ptr<SessionPool> owner;   // set while the block is out of the pool
+    std::atomic<uint32_t>        refs{0};
+    size_t                       used = 0;
+
+    uint8_t* base() { return reinterpret_cast<uint8_t*>(this); }
+};
+
+namespace {
+
+constexpr std::align_val_t kBlockAlign{ SessionPool::kCacheLine };
+
+SessionPool::Block* NewBlock()
+{
+    void* mem = ::operator new(SessionPool::kBlockSize, kBlockAlign);
+    return new (mem) SessionPool::Block();
+}
+
+void DeleteBlock(SessionPool::Block* b)
+{
+    b->~Block();
+    ::operator delete(b, kBlockAlign);
+}
+
+size_t RoundUp(size_t n, size_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+} // namespace
+
+std::shared_ptr<SessionPool> SessionPool::Create()
+{
+    std::shared_ptr<SessionPool> pool(new SessionPool());
+    pool->m_idle.reserve(kMaxIdle);   // Recycle() must not allocate
+    return pool;
+}
+
+SessionPool::~SessionPool()
+{
+    for (Block* b : m_idle) DeleteBlock(b);
+}
+
+SessionPool::Block* SessionPool::Acquire()
+{
+    Block* b = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_idle.empty())
+        {
+            b = m_idle.back();
+            m_idle.pop_back();
+        }
+    }
+    if (b != nullptr) m_reused.fetch_add(1, std::memory_order_relaxed);
+    else              b = NewBlock();
+    m_acquired.fetch_add(1, std::memory_order_relaxed);
+
+    b->owner = shared_from_this();
+    b->refs.store(1, std::memory_order_relaxed);
+    b->used  = RoundUp(sizeof(Block), kCacheLine);
+    return b;
+}
+
+void SessionPool::Release(Block* block)
+{
+    if (block->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    // Take the owner out first: the free list must not keep its pool alive.
+    std::shared_ptr<SessionPool> owner = std::move(block->owner);
+    owner->Recycle(block);
+}
+
+void SessionPool::Recycle(Block* block)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_idle.size() < kMaxIdle)
+        {
+            m_idle.push_back(block);
+            return;
+        }
+    }
+    DeleteBlock(block);
+}
+
+//
+// ── Allocate / Deallocate ─────────────────────────────────────────────────────
+//
+// Sub-allocations are cache-line aligned: the session is written by the SSH
+// I/O thread, its TcpConnection by IOCP workers.  Anything too big for what
+// is left of the block comes from the heap; Deallocate tells the two apart
+// by address.
+//
+
+void* SessionPool::Allocate(Block* block, size_t bytes, size_t align)
+{
+    size_t offset = RoundUp(block->used, (std::max)(align, kCacheLine));
+    if (offset + bytes <= kBlockSize)
+    {
+        block->used = offset + bytes;
+        block->refs.fetch_add(1, std::memory_order_relaxed);
+        return block->base() + offset;
+    }
+
+    block->owner->m_overflows.fetch_add(1, std::memory_order_relaxed);
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        return ::operator new(bytes, std::align_val_t{ align });
+    return ::operator new(bytes);
+}
+
+void SessionPool::Deallocate(Block* block, void* p, size_t align)
+{
+    uint8_t* q = static_cast<uint8_t*>(p);
+    if (q >= block->base() && q < block->base() + kBlockSize)
+    {
+        Release(block);
+        return;
+    }
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        ::operator delete(p, std::align_val_t{ align });
+    else
+        ::operator delete(p);
+}
+
+SessionPool::Stats SessionPool::GetStats() const
+{
+    Stats st;
+    st.acquired  = m_acquired.load(std::memory_order_relaxed);
+    st.reused    = m_reused.load(std::memory_order_relaxed);
+    st.overflows = m_overflows.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    st.idle = m_idle.size();
+    return st;
+}
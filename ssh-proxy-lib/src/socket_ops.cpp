@@ -0,0 +1,208 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// SocketOps — the SSH socket's OS calls outside IoEngine
+//
+// PURPOSE
+//   SshTransport drives its socket through libssh2 on one dedicated thread
+//   rather than through IoEngine completions: blocking during setup, then
+//   non-blocking with a readiness wait whenever a loop iteration found no
+//   work.  The calls that differ per OS live here, so SshTransport reads the
+//   same on Windows and POSIX.
+//
+// WAIT
+//   Windows  WSAEventSelect(FD_READ | FD_WRITE | FD_CLOSE) on one event and a
+//            manual-reset wake event; WSAWaitForMultipleEvents on both.
+//            WSAEnumNetworkEvents resets the socket event after the wait, so
+//            bytes that arrive later re-signal it.
+//   POSIX    poll() on the socket and an eventfd.  Level-triggered: POLLOUT
+//            is only asked for while a send would block, or the loop would
+//            never block on a socket with send-buffer room.
+//
+// RTT
+//   SIO_TCP_INFO (TCP_INFO_v0::RttUs) on Windows, TCP_INFO (tcpi_rtt) on
+//   Linux — both the kernel's smoothed estimate in microseconds.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "socket_ops.h"
+#include "logger.h"
+#include <string>
+
+#ifdef _WIN32
+#include <mstcpip.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#endif
+
+SocketWaiter::~SocketWaiter()
+{
+    Release();
+}
+
+#ifdef _WIN32
+
+void SocketWaiter::Release()
+{
+    m_socket_event.reset();
+    m_wake_event.reset();
+    m_socket = INVALID_SOCKET;
+}
+
+// WSAEventSelect also puts the socket into non-blocking mode.
+Result SocketWaiter::Attach(SOCKET sock)
+{
+    Release();
+    WsaEventPtr socket_event(::WSACreateEvent());
+    WsaEventPtr wake_event(::WSACreateEvent());
+    if (!socket_event || !wake_event)
+        return { ErrorCode::SocketError,
+                 "WSACreateEvent failed: " + std::to_string(::WSAGetLastError()) };
+    if (::WSAEventSelect(sock, socket_event.get(), FD_READ | FD_WRITE | FD_CLOSE) != 0)
+        return { ErrorCode::SocketError,
+                 "WSAEventSelect failed: " + std::to_string(::WSAGetLastError()) };
+
+    m_socket_event = std::move(socket_event);
+    m_wake_event   = std::move(wake_event);
+    m_socket       = sock;
+    return {};
+}
+
+void SocketWaiter::Wait(DWORD timeout_ms, bool /*want_write*/, bool& peer_closed)
+{
+    WSAEVENT events[2] = { m_socket_event.get(), m_wake_event.get() };
+    DWORD rc = ::WSAWaitForMultipleEvents(2, events, FALSE, timeout_ms, FALSE);
+    if (rc == WSA_WAIT_FAILED)
+    {
+        Logger::Error("WSAWaitForMultipleEvents failed: %d", ::WSAGetLastError());
+        return;
+    }
+
+    ::WSAResetEvent(m_wake_event.get());
+
+    WSANETWORKEVENTS ne{};
+    if (::WSAEnumNetworkEvents(m_socket, m_socket_event.get(), &ne) == 0 &&
+        (ne.lNetworkEvents & FD_CLOSE) != 0)
+    {
+        peer_closed = true;
+    }
+}
+
+void SocketWaiter::Wake()
+{
+    if (m_wake_event) ::WSASetEvent(m_wake_event.get());
+}
+
+void SetSocketTimeouts(SOCKET sock, DWORD timeout_ms)
+{
+    DWORD tv_ms = timeout_ms;
+    ::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv_ms), sizeof(tv_ms));
+    ::setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&tv_ms), sizeof(tv_ms));
+}
+
+bool SocketHasInput(SOCKET sock)
+{
+    u_long pending = 0;
+    return ::ioctlsocket(sock, FIONREAD, &pending) == 0 && pending > 0;
+}
+
+bool ReadTcpRttUs(SOCKET sock, uint32_t& rtt_us)
+{
+    DWORD          version = 0;
+    TCP_INFO_v0    info{};
+    DWORD          bytes   = 0;
+    if (::WSAIoctl(sock, SIO_TCP_INFO, &version, sizeof(version),
+                   &info, sizeof(info), &bytes, nullptr, nullptr) != 0)
+        return false;
+    rtt_us = static_cast<uint32_t>(info.RttUs);
+    return true;
+}
+
+#else // POSIX
+
+void SocketWaiter::Release()
+{
+    if (m_wake_fd >= 0) ::close(m_wake_fd);
+    m_wake_fd = -1;
+    m_socket  = INVALID_SOCKET;
+}
+
+Result SocketWaiter::Attach(SOCKET sock)
+{
+    Release();
+    int wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0)
+        return { ErrorCode::SocketError, "eventfd failed: " + std::to_string(errno) };
+    int flags = ::fcntl(sock, F_GETFL, 0);
+    if (flags < 0 || ::fcntl(sock, F_SETFL, flags | O_NONBLOCK) != 0)
+    {
+        ::close(wake_fd);
+        return { ErrorCode::SocketError, "fcntl(O_NONBLOCK) failed: " + std::to_string(errno) };
+    }
+
+    m_wake_fd = wake_fd;
+    m_socket  = sock;
+    return {};
+}
+
+void SocketWaiter::Wait(DWORD timeout_ms, bool want_write, bool& peer_closed)
+{
+    pollfd fds[2] = {};
+    fds[0].fd     = m_socket;
+    fds[0].events = POLLIN | POLLRDHUP | (want_write ? POLLOUT : 0);
+    fds[1].fd     = m_wake_fd;
+    fds[1].events = POLLIN;
+
+    int timeout = timeout_ms == INFINITE ? -1 : static_cast<int>(timeout_ms);
+    if (::poll(fds, 2, timeout) < 0)
+    {
+        if (errno != EINTR) Logger::Error("poll failed: %d", errno);
+        return;
+    }
+
+    if ((fds[1].revents & POLLIN) != 0)
+    {
+        uint64_t drained = 0;
+        ssize_t n = ::read(m_wake_fd, &drained, sizeof(drained));
+        (void)n;
+    }
+    if ((fds[0].revents & (POLLRDHUP | POLLHUP | POLLERR)) != 0)
+        peer_closed = true;
+}
+
+void SocketWaiter::Wake()
+{
+    if (m_wake_fd < 0) return;
+    uint64_t one = 1;
+    ssize_t n = ::write(m_wake_fd, &one, sizeof(one));
+    (void)n;   // a full counter already means "wake up"
+}
+
+void SetSocketTimeouts(SOCKET sock, DWORD timeout_ms)
+{
+    timeval tv{};
+    tv.tv_sec  = static_cast<time_t>(timeout_ms / 1000);
+    tv.tv_usec = static_cast<suseconds_t>((timeout_ms % 1000) * 1000);
+    ::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+bool SocketHasInput(SOCKET sock)
+{
+    int pending = 0;
+    return ::ioctl(sock, FIONREAD, &pending) == 0 && pending > 0;
+}
+
+bool ReadTcpRttUs(SOCKET sock, uint32_t& rtt_us)
+{
+    tcp_info  info{};
+    socklen_t len = sizeof(info);
+    if (::getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &len) != 0)
+        return false;
+    rtt_us = info.tcpi_rtt;
+    return true;
+}
+
+#endif
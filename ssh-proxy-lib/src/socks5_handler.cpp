@@ -65,8 +65,8 @@ ByteBuffer BuildMethodResponse(uint8_t method)
 // Parses the CONNECT request (RFC 1928 §4).  The address field is variable
 // length: 4 bytes (IPv4), 1+N bytes (domain — length-prefixed), or 16 bytes
 // (IPv6).  Port follows as 2 big-endian bytes.  Address and port are written
-// to out; host is decoded to a dotted/colon-hex string for use in DNS or
-// direct connect calls.
+// to out; only a domain is copied into out.host — address literals are kept
+// as raw bytes for ToSockaddr().
 //
 
 int ParseConnectRequest(const uint8_t* data, size_t len, ConnectRequest& out)
@@ -78,6 +78,7 @@ int ParseConnectRequest(const uint8_t* data, size_t len, ConnectRequest& out)
 
     uint8_t cmd = data[1];
     uint8_t atyp = data[3];
+    out.cmd  = cmd;
     out.atyp = atyp;
 
     size_t addr_start = 4;
@@ -105,9 +106,6 @@ int ParseConnectRequest(const uint8_t* data, size_t len, ConnectRequest& out)
     if (atyp == ATYP_IPV4)
     {
         ::memcpy(out.ipv4, data + addr_start, 4);
-        char buf[16];
-        ::sprintf_s(buf, "%u.%u.%u.%u", out.ipv4[0], out.ipv4[1], out.ipv4[2], out.ipv4[3]);
-        out.host = buf;
     }
     else if (atyp == ATYP_DOMAIN)
     {
@@ -117,28 +115,69 @@ int ParseConnectRequest(const uint8_t* data, size_t len, ConnectRequest& out)
     else if (atyp == ATYP_IPV6)
     {
         ::memcpy(out.ipv6, data + addr_start, 16);
-        // Build IPv6 string
-        char buf[48];
-        ::sprintf_s(buf, "%02x%02x:%02x%02x:%02x%02x:%02x%02x:%02x%02x:%02x%02x:%02x%02x:%02x%02x",
-            out.ipv6[0], out.ipv6[1], out.ipv6[2], out.ipv6[3],
-            out.ipv6[4], out.ipv6[5], out.ipv6[6], out.ipv6[7],
-            out.ipv6[8], out.ipv6[9], out.ipv6[10], out.ipv6[11],
-            out.ipv6[12], out.ipv6[13], out.ipv6[14], out.ipv6[15]);
-        out.host = buf;
     }
 
     // Port (big-endian)
     size_t port_offset = addr_start + addr_len;
     out.port = (static_cast<uint16_t>(data[port_offset]) << 8) | data[port_offset + 1];
 
-    // Validate command — we only support CONNECT
-    if (cmd != CMD_CONNECT)
+    // Only CONNECT is supported, but the full length is returned either way
+    // so the caller can answer out.cmd with REP_COMMAND_NOT_SUPPORTED.
+    return static_cast<int>(total);
+}
+
+int ToSockaddr(const ConnectRequest& req, sockaddr_storage& out)
+{
+    out = sockaddr_storage{};
+    if (req.atyp == ATYP_IPV4)
     {
-        // Still return bytes consumed so caller can send error reply
-        return static_cast<int>(total);
+        auto* a4 = reinterpret_cast<sockaddr_in*>(&out);
+        a4->sin_family = AF_INET;
+        a4->sin_port   = ::htons(req.port);
+        ::memcpy(&a4->sin_addr, req.ipv4, 4);
+        return static_cast<int>(sizeof(sockaddr_in));
     }
+    if (req.atyp == ATYP_IPV6)
+    {
+        auto* a6 = reinterpret_cast<sockaddr_in6*>(&out);
+        a6->sin6_family = AF_INET6;
+        a6->sin6_port   = ::htons(req.port);
+        ::memcpy(&a6->sin6_addr, req.ipv6, 16);
+        return static_cast<int>(sizeof(sockaddr_in6));
+    }
+    return 0;
+}
 
-    return static_cast<int>(total);
+ConnectRequest MakeConnectRequest(const std::string& host, uint16_t port)
+{
+    ConnectRequest req{};
+    req.cmd  = CMD_CONNECT;
+    req.port = port;
+    if (::inet_pton(AF_INET, host.c_str(), req.ipv4) == 1)
+        req.atyp = ATYP_IPV4;
+    else if (::inet_pton(AF_INET6, host.c_str(), req.ipv6) == 1)
+        req.atyp = ATYP_IPV6;
+    else
+    {
+        req.atyp = ATYP_DOMAIN;
+        req.host = host;
+    }
+    return req;
+}
+
+size_t FormatTarget(const ConnectRequest& req, char* buf, size_t cap)
+{
+    if (cap == 0) return 0;
+    char addr[INET6_ADDRSTRLEN] = {};
+    const char* host = addr;
+    if (req.atyp == ATYP_IPV4)      ::inet_ntop(AF_INET,  req.ipv4, addr, sizeof(addr));
+    else if (req.atyp == ATYP_IPV6) ::inet_ntop(AF_INET6, req.ipv6, addr, sizeof(addr));
+    else                            host = req.host.c_str();
+
+    const char* fmt = req.atyp == ATYP_IPV6 ? "[%s]:%u" : "%s:%u";
+    int n = ::snprintf(buf, cap, fmt, host, static_cast<unsigned>(req.port));
+    if (n < 0) { buf[0] = '\0'; return 0; }
+    return (std::min)(static_cast<size_t>(n), cap - 1);
 }
 
 //
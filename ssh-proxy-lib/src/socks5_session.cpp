@@ -7,14 +7,60 @@
 //   method negotiation → CONNECT request → async TCP connect → relay.
 //
 // TWO CONCURRENT DATA FLOWS
-//   SSH → TCP  PumpSshRead() is called by the SSH I/O thread every loop
-//              iteration.  During negotiation states it feeds the state
-//              machine; in Relaying state it forwards bytes directly to m_tcp.
+//   SSH → TCP  PumpSshRead() is called by the SSH I/O thread whenever the
+//              channel has inbound data.  During negotiation states it feeds
+//              the state machine; from Connecting on it forwards bytes
+//              directly to m_tcp.
 //
 //   TCP → SSH  StartRelay() arms a TcpConnection read callback on an IOCP
-//              worker thread.  That callback calls m_channel->Write(), which
-//              (off the I/O thread) posts to the per-channel write queue and
-//              returns without blocking.
+//              worker thread.  That callback hands the received pooled buffer
+//              to m_channel->WriteBuffer(), which (off the I/O thread) queues
+//              it on the per-channel write queue and returns without blocking.
+//
+//   Both directions move pooled buffers (BufferPool) end to end — the bytes
+//   are never copied between the socket and libssh2.
+//
+// EARLY DATA
+//   A client that pipelines its first flight (a TLS ClientHello, say) behind
+//   the CONNECT request does not wait for our reply.  Those bytes — the rest
+//   of the CONNECT read, and whatever arrives while the connect is in
+//   flight — go straight into m_tcp's send queue, which TcpConnection holds
+//   until ConnectEx completes and then flushes at once.  ConnectEx's own
+//   send buffer (TFO-style) is not used: with happy eyeballs several
+//   attempts race, and each one would carry the data.
+//
+// HALF-CLOSE
+//   The relay runs as two legs that end independently.  Channel EOF →
+//   m_tcp->ShutdownSend() (a FIN once the send queue has drained); target
+//   FIN → m_channel->SendEof() (queued behind the data already written).
+//   Each leg counts itself off m_legs_open when it has ended; the session
+//   closes when both have, or at once on any error.  While only one leg is
+//   done the other keeps relaying, so a request/response protocol that
+//   half-closes after the request still receives the whole response.
+//
+// FLOW CONTROL
+//   Both legs are bounded by m_options' watermarks.  TCP → SSH: once the channel's
+//   write backlog passes the high mark the TCP recv loop is paused; the
+//   channel's on_drained resumes it.  SSH → TCP: once the TCP send queue
+//   passes the high mark, channel read interest goes off, PumpSshRead stops
+//   consuming, and the SSH window closes on its own; the send queue's
+//   on_drained turns interest back on.
+//
+// ADMISSION
+//   The session factory hands each session its AdmissionTicket.  A session
+//   refused at accept still completes the method negotiation, then fails its
+//   CONNECT (REP_GENERAL_FAILURE); an admitted one claims the destination's
+//   slot once the CONNECT is parsed and fails it with
+//   REP_CONNECTION_NOT_ALLOWED when the destination is full.  Either way no
+//   DNS lookup or target socket is spent.  Close() returns the slots.
+//
+// FIXED TARGET
+//   A channel from a fixed host:port remote forward skips the handshake:
+//   SetFixedTarget() stands in for the CONNECT and Start() runs what
+//   HandleConnectRequest would — Admit(), StartTcpConnect() — so admission,
+//   early data, half-close and stats work unchanged.  The client speaks no
+//   SOCKS, so every reply is left out; a refusal or failed connect closes
+//   the channel, which is all ssh -R does.
 //
 // OWNERSHIP AND CYCLE PREVENTION
 //   Socks5Session owns m_tcp (shared_ptr<TcpConnection>).  All m_tcp
@@ -25,14 +71,40 @@
 //   m_state.exchange(State::Closed) ensures Close() executes exactly once
 //   regardless of which thread — IOCP or SSH I/O — arrives first.
 //
+// STATS
+//   Each byte counter has exactly one writer (SSH → TCP: the I/O thread;
+//   TCP → SSH: the recv loop, which has one completion outstanding at a
+//   time), so it is bumped with a relaxed load and store.  Queue depths are
+//   read from the two legs on demand.
+//
 //////////////////////////////////////////////////////////////////////////////
 
 #include "socks5_session.h"
 #include "logger.h"
+#include "instrumentation.h"
+#include "warm_sockets.h"
+
+namespace {
+
+void AddRelaxed(std::atomic<uint64_t>& counter, uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+} // namespace
 
-Socks5Session::Socks5Session(std::unique_ptr<IChannel> channel)
+Socks5Session::Socks5Session(std::unique_ptr<IChannel> channel,
+                             RelayOptions options)
+    : Socks5Session(std::move(channel), std::make_shared<TcpConnection>(), options)
+{}
+
+Socks5Session::Socks5Session(std::unique_ptr<IChannel> channel,
+                             std::shared_ptr<TcpConnection> tcp,
+                             RelayOptions options)
     : m_channel(std::move(channel))
-    , m_tcp(std::make_shared<TcpConnection>())
+    , m_tcp(std::move(tcp))
+    , m_options(options)
+    , m_ssh_read_sizer(options.recv_min, options.recv_max)
 {}
 
 Socks5Session::~Socks5Session()
@@ -40,42 +112,87 @@ Socks5Session::~Socks5Session()
     Close();
 }
 
+std::shared_ptr<Socks5Session> Socks5Session::Create(std::unique_ptr<IChannel> channel,
+                                                     RelayOptions options,
+                                                     SessionPool& pool)
+{
+    SessionPool::Block* block = pool.Acquire();
+    SessionAllocator<Socks5Session> alloc(block);
+    auto session = std::allocate_shared<Socks5Session>(alloc, std::move(channel),
+        std::allocate_shared<TcpConnection>(alloc), options);
+    SessionPool::Release(block);   // the two objects now hold the block
+    return session;
+}
+
 //
 // ── Start ─────────────────────────────────────────────────────────────────────
 //
-// Intentionally empty.  The full lifecycle — method negotiation, CONNECT
-// request, TCP connect, relay — is driven entirely by PumpSshRead() on the
-// SSH I/O thread.  Start() exists so callers have a uniform activation point
-// if startup work is ever needed.
+// Arms the flow-control watermarks on both legs and the target's recv-size
+// and send-batch limits before any relay data moves.
+// The full lifecycle — method negotiation, CONNECT request, TCP connect,
+// relay — is then driven by PumpSshRead() on the SSH I/O thread.
 //
 
 void Socks5Session::Start()
 {
-    // Full lifecycle (handshake + relay) is driven non-blocking by PumpSshRead().
+    std::weak_ptr<Socks5Session> weak = weak_from_this();
+
+    // Channel backlog drained (SSH I/O thread) → restart the TCP recv loop.
+    m_channel->SetWriteWatermarks(m_options.high_watermark, m_options.low_watermark,
+        [weak]()
+        {
+            if (auto self = weak.lock()) self->m_tcp->ResumeReading();
+        });
+
+    // TCP send queue drained (IOCP thread) → pump the channel again.
+    m_tcp->SetSendWatermarks(m_options.high_watermark, m_options.low_watermark,
+        [weak]()
+        {
+            if (auto self = weak.lock()) self->m_channel->SetReadInterest(true);
+        });
+
+    m_tcp->SetSendBatchLimits(m_options.send_batch_bytes, m_options.send_batch_segments);
+    m_tcp->SetRecvSizeLimits(m_options.recv_min, m_options.recv_max);
+
+    if (m_fixed && Admit(m_request))
+        StartTcpConnect(m_request);
+}
+
+void Socks5Session::SetFixedTarget(Socks5::ConnectRequest target)
+{
+    m_request = std::move(target);
+    m_fixed   = true;
 }
 
 //
 // ── OnChannelData ─────────────────────────────────────────────────────────────
 //
-// Appends newly arrived channel bytes to m_inbound_buf then dispatches to the
-// state handler.  Called only in ReadingMethods and ReadingRequest states;
-// PumpSshRead forwards directly to m_tcp in Relaying state (bypasses this).
+// Runs the handshake straight out of the pooled read buffer: with a client
+// that sends greeting and CONNECT in one piece (the usual case) both are
+// parsed in place and nothing is copied.  Only a message split across reads
+// is reassembled in m_inbound_buf.  Called only in ReadingMethods and
+// ReadingRequest states; from Connecting on PumpSshRead forwards directly to
+// m_tcp (bypasses this).
 //
 
-void Socks5Session::OnChannelData(const uint8_t* data, size_t len)
+void Socks5Session::OnChannelData(PooledBuffer data)
 {
-    m_inbound_buf.insert(m_inbound_buf.end(), data, data + len);
-
-    switch (m_state.load()) {
-    case State::ReadingMethods:
-        HandleMethodNegotiation(m_inbound_buf.data(), m_inbound_buf.size());
-        break;
-    case State::ReadingRequest:
-        HandleConnectRequest(m_inbound_buf.data(), m_inbound_buf.size());
-        break;
-    default:
-        break;
+    if (!m_inbound_buf.empty())
+    {
+        m_inbound_buf.insert(m_inbound_buf.end(), data.data(), data.data() + data.size());
+        data = BufferPool::CopyOf(m_inbound_buf.data(), m_inbound_buf.size());
+        m_inbound_buf.clear();
     }
+
+    if (m_state.load() == State::ReadingMethods)
+        HandleMethodNegotiation(data);
+    if (m_state.load() == State::ReadingRequest)
+        HandleConnectRequest(data);
+
+    // Still mid-handshake: the rest is an incomplete message — keep it.
+    State s = m_state.load();
+    if ((s == State::ReadingMethods || s == State::ReadingRequest) && !data.empty())
+        m_inbound_buf.assign(data.data(), data.data() + data.size());
 }
 
 //
@@ -83,14 +200,15 @@ void Socks5Session::OnChannelData(const uint8_t* data, size_t len)
 //
 // Completes the method-selection exchange.  Rejects the connection if the
 // client did not offer AUTH_NONE — we support no-auth only.  On acceptance,
-// advances state to ReadingRequest and immediately processes any leftover
-// bytes already in m_inbound_buf (client may pipeline the CONNECT request).
+// advances state to ReadingRequest; OnChannelData then goes straight on with
+// whatever follows in the same buffer (client may pipeline the CONNECT
+// request).
 //
 
-void Socks5Session::HandleMethodNegotiation(const uint8_t* data, size_t len)
+void Socks5Session::HandleMethodNegotiation(PooledBuffer& data)
 {
     bool supports_no_auth = false;
-    int consumed = Socks5::ParseMethodRequest(data, len, supports_no_auth);
+    int consumed = Socks5::ParseMethodRequest(data.data(), data.size(), supports_no_auth);
 
     if (consumed == 0) return;  // need more data; PumpSshRead delivers next iteration
 
@@ -103,60 +221,102 @@ void Socks5Session::HandleMethodNegotiation(const uint8_t* data, size_t len)
         return;
     }
 
-    m_inbound_buf.erase(m_inbound_buf.begin(), m_inbound_buf.begin() + consumed);
+    data.Consume(static_cast<size_t>(consumed));
     auto reply = Socks5::BuildMethodResponse(Socks5::AUTH_NONE);
     m_channel->Write(reply.data(), reply.size());
 
     m_state.store(State::ReadingRequest);
-
-    // If data was left over in m_inbound_buf, process it immediately.
-    if (!m_inbound_buf.empty())
-        HandleConnectRequest(m_inbound_buf.data(), m_inbound_buf.size());
 }
 
 //
 // ── HandleConnectRequest ──────────────────────────────────────────────────────
 //
 // Parses the CONNECT request and launches the async TCP connect.  An unknown
-// address type is caught by ParseConnectRequest (returns -1); an unrecognised
-// command would still return the byte count so we can reply before closing.
+// address type is caught by ParseConnectRequest (returns -1); any other
+// command is parsed in full and refused with REP_COMMAND_NOT_SUPPORTED, and
+// a CONNECT over an admission limit is refused by Admit().
+// Bytes after the request are client data sent ahead of our reply: the rest
+// of the read buffer is queued on m_tcp right behind the connect.
 //
 
-void Socks5Session::HandleConnectRequest(const uint8_t* data, size_t len)
+void Socks5Session::HandleConnectRequest(PooledBuffer& data)
 {
     Socks5::ConnectRequest req{};
-    int consumed = Socks5::ParseConnectRequest(data, len, req);
+    int consumed = Socks5::ParseConnectRequest(data.data(), data.size(), req);
 
     if (consumed == 0) return;  // need more data; PumpSshRead delivers next iteration
 
-    if (consumed < 0)
+    if (consumed < 0 || req.cmd != Socks5::CMD_CONNECT)
     {
-        Logger::Warn("SOCKS5: malformed connect request");
-        auto reply = Socks5::BuildConnectReply(Socks5::REP_GENERAL_FAILURE);
+        Logger::Warn(consumed < 0 ? "SOCKS5: malformed connect request"
+                                  : "SOCKS5: unsupported command");
+        auto reply = Socks5::BuildConnectReply(consumed < 0 ? Socks5::REP_GENERAL_FAILURE
+                                                            : Socks5::REP_COMMAND_NOT_SUPPORTED);
         m_channel->Write(reply.data(), reply.size());
         Close();
         return;
     }
 
     // atyp already validated by ParseConnectRequest (returns -1 on unknown type).
-    m_inbound_buf.erase(m_inbound_buf.begin(), m_inbound_buf.begin() + consumed);
+    data.Consume(static_cast<size_t>(consumed));
+    if (!Admit(req)) return;
 
-    Logger::Debug("SOCKS5: CONNECT %s:%u", req.host.c_str(), req.port);
-    StartTcpConnect(req);
+    StartTcpConnect(std::move(req));
+    if (!data.empty()) RelayToTarget(std::move(data));
 }
 
-void Socks5Session::StartTcpConnect(const Socks5::ConnectRequest& req)
+// Refusals come in floods when a limit is hit, so they are logged at Debug.
+bool Socks5Session::Admit(const Socks5::ConnectRequest& req)
 {
+    if (m_admission.admitted() && m_admission.LimitsTargets())
+    {
+        ResolvedAddress literal;
+        literal.len = Socks5::ToSockaddr(req, literal.addr);
+        m_admission.ClaimTarget(literal.len > 0 ? WarmSockets::Key(literal)
+                                                : WarmSockets::Key(req.host, req.port));
+    }
+    if (m_admission.admitted()) return true;
+
+    bool per_target = m_admission.verdict() == AdmissionVerdict::TargetLimit;
+    Logger::Debug(per_target ? "SOCKS5: destination at its session limit — CONNECT refused"
+                             : "SOCKS5: over the session or accept limit — CONNECT refused");
+    if (m_fixed)
+    {
+        Close();
+        return false;
+    }
+    auto reply = Socks5::BuildConnectReply(per_target ? Socks5::REP_CONNECTION_NOT_ALLOWED
+                                                      : Socks5::REP_GENERAL_FAILURE);
+    m_channel->Write(reply.data(), reply.size());
+    Close();
+    return false;
+}
+
+void Socks5Session::StartTcpConnect(Socks5::ConnectRequest req)
+{
+    char target[300];
+    Socks5::FormatTarget(req, target, sizeof(target));
+    Logger::Debug(m_fixed ? "Fixed forward: connecting to %s" : "SOCKS5: CONNECT %s", target);
+
+    m_request         = std::move(req);
+    m_connect_started = QpcNow();
     m_state.store(State::Connecting);
 
     // Use weak_ptr: TcpConnection must not hold a strong ref back to the session
     // (session owns m_tcp, so that would be a cycle).
     std::weak_ptr<Socks5Session> weak = weak_from_this();
-    m_tcp->ConnectAsync(req.host, req.port,
-        [weak](ErrorCode connect_ec)
-        {
-            if (auto self = weak.lock()) self->OnTcpConnected(connect_ec);
-        });
+    auto on_connected = [weak](ErrorCode connect_ec)
+    {
+        if (auto self = weak.lock()) self->OnTcpConnected(connect_ec);
+    };
+
+    // Address literals go straight to ConnectEx; only a domain is resolved.
+    ResolvedAddress literal;
+    literal.len = Socks5::ToSockaddr(m_request, literal.addr);
+    if (literal.len > 0)
+        m_tcp->ConnectAsync(literal, std::move(on_connected));
+    else
+        m_tcp->ConnectAsync(m_request.host, m_request.port, std::move(on_connected));
     // Errors (DNS failure, socket error) now arrive via the callback above.
 }
 
@@ -168,17 +328,30 @@ void Socks5Session::OnTcpConnected(ErrorCode ec)
     if (ec != ErrorCode::Success)
     {
         Logger::Warn("SOCKS5: target TCP connect failed: %s", ErrorCodeToString(ec));
-        auto reply = Socks5::BuildConnectReply(Socks5::ErrorCodeToSocks5Reply(ec));
-        m_channel->Write(reply.data(), reply.size());
+        if (!m_fixed)
+        {
+            auto reply = Socks5::BuildConnectReply(Socks5::ErrorCodeToSocks5Reply(ec));
+            m_channel->Write(reply.data(), reply.size());
+        }
         Close();
         return;
     }
 
+    uint64_t latency_us = QpcToUs(QpcNow() - m_connect_started);
+    m_connect_latency_us.store(static_cast<uint32_t>(latency_us), std::memory_order_relaxed);
+    Instrumentation::RecordLatency(LatencyPoint::SocksConnect, latency_us);
+
     // Send SOCKS5 success reply (enqueued → SSH I/O thread drains it).
-    auto reply = Socks5::BuildConnectReply(Socks5::REP_SUCCESS);
-    m_channel->Write(reply.data(), reply.size());
+    // Client data queued while connecting has already been flushed by m_tcp.
+    if (!m_fixed)
+    {
+        auto reply = Socks5::BuildConnectReply(Socks5::REP_SUCCESS);
+        m_channel->Write(reply.data(), reply.size());
+    }
 
-    m_state.store(State::Relaying);
+    // A Close() racing the connect (channel error on the I/O thread) wins.
+    State expected = State::Connecting;
+    if (!m_state.compare_exchange_strong(expected, State::Relaying)) return;
     StartRelay();
 }
 
@@ -192,53 +365,149 @@ void Socks5Session::StartRelay()
     std::weak_ptr<Socks5Session> weak = weak_from_this();
 
     m_tcp->StartReading(
-        [weak](const uint8_t* data, size_t len)
+        [weak](PooledBuffer data)
         {
-            if (auto self = weak.lock()) self->m_channel->Write(data, len);
+            auto self = weak.lock();
+            if (!self) return;
+            AddRelaxed(self->m_bytes_to_client, data.size());
+            self->m_channel->WriteBuffer(std::move(data));
+            if (self->m_channel->IsWriteBacklogged())
+            {
+                self->m_tcp->PauseReading();
+                // The backlog may have drained before the pause landed, in
+                // which case on_drained found nothing to resume.
+                if (!self->m_channel->IsWriteBacklogged())
+                    self->m_tcp->ResumeReading();
+            }
         },
-        [weak](ErrorCode)
+        [weak](ErrorCode ec)
         {
-            if (auto self = weak.lock())
+            auto self = weak.lock();
+            if (!self) return;
+            if (ec != ErrorCode::Success)
             {
-                self->m_channel->SendEof();
                 self->Close();
+                return;
             }
+            // Target sent FIN: pass it on, keep relaying client → target.
+            self->m_channel->SendEof();
+            self->EndLeg();
         });
 }
 
+void Socks5Session::RelayToTarget(PooledBuffer data)
+{
+    AddRelaxed(m_bytes_to_target, data.size());
+    m_tcp->Send(std::move(data));
+    // Send queue full: stop consuming so the SSH window closes.  The drain
+    // callback's SetReadInterest(true) is posted to this thread, so it always
+    // lands after this call.
+    if (m_tcp->IsSendBacklogged()) m_channel->SetReadInterest(false);
+}
+
+//
+// ── OnClientEof ───────────────────────────────────────────────────────────────
+//
+// SSH I/O thread.  The client will send no more: half-close the target once
+// everything relayed so far has reached it.  The channel is parked for good
+// — libssh2 reports the EOF as pending on every iteration — while the
+// target → client leg carries on.
+//
+
+void Socks5Session::OnClientEof()
+{
+    m_client_eof = true;
+    m_channel->SetReadInterest(false);
+
+    std::weak_ptr<Socks5Session> weak = weak_from_this();
+    m_tcp->ShutdownSend([weak](ErrorCode ec)
+    {
+        auto self = weak.lock();
+        if (!self) return;
+        if (ec != ErrorCode::Success) self->Close();
+        else                          self->EndLeg();
+    });
+}
+
+void Socks5Session::EndLeg()
+{
+    if (m_legs_open.fetch_sub(1) == 1) Close();
+}
+
 bool Socks5Session::PumpSshRead()
 {
-    // Called on the SSH I/O thread every loop iteration.
-    // Drives all states: ReadingMethods, ReadingRequest, Relaying.
+    // Called on the SSH I/O thread when the channel has data or EOF pending.
+    // Drives all states: ReadingMethods, ReadingRequest, Connecting, Relaying.
 
     State s = m_state.load();
     if (s == State::Closed) return false;
-    if (s == State::Connecting) return true;  // waiting for TCP connect callback
+    bool relaying = s == State::Connecting || s == State::Relaying;
 
-    uint8_t buf[4096];
+    // Read straight into a pooled buffer so the relay path can hand it to the
+    // TCP send queue without copying.  The size adapts to how full the
+    // previous reads came back.
+    size_t want = m_ssh_read_sizer.Next();
+    PooledBuffer buf = BufferPool::Acquire(want);
     size_t bytes_read = 0;
-    ErrorCode ec = m_channel->Read(buf, sizeof(buf), bytes_read);
+    ErrorCode ec = m_channel->Read(buf.tail(), (std::min)(want, buf.tailroom()), bytes_read);
 
     if (ec == ErrorCode::WouldBlock) return true;  // no data yet, try next iteration
 
+    // EOF once relaying is a half-close; before that, or any error, ends it.
+    bool eof = (ec == ErrorCode::Success && bytes_read == 0) ||
+               (ec == ErrorCode::ChannelClosed && m_channel->IsEof());
+    if (relaying && eof)
+    {
+        // A second EOF: un-parked by the send queue draining, nothing to read.
+        if (!m_client_eof) OnClientEof();
+        else               m_channel->SetReadInterest(false);
+        return true;
+    }
     if (ec != ErrorCode::Success || bytes_read == 0)
     {
         Close();
         return false;
     }
 
-    if (s == State::Relaying)
+    m_ssh_read_sizer.Record(bytes_read);
+    buf.Commit(bytes_read);
+    if (relaying)
     {
-        m_tcp->Send(buf, bytes_read);
+        RelayToTarget(std::move(buf));
     }
     else
     {
-        OnChannelData(buf, bytes_read);
+        OnChannelData(std::move(buf));
     }
 
     return m_state.load() != State::Closed;
 }
 
+Socks5Session::Stats Socks5Session::GetStats() const
+{
+    Stats st;
+    switch (m_state.load()) {
+    case State::ReadingMethods:
+    case State::ReadingRequest: st.state = ssh_proxy::SessionState::Handshake;  break;
+    case State::Connecting:     st.state = ssh_proxy::SessionState::Connecting; break;
+    case State::Relaying:       st.state = ssh_proxy::SessionState::Relaying;   break;
+    case State::Closed:         st.state = ssh_proxy::SessionState::Closed;     break;
+    }
+    // Closed can follow a handshake state directly, before m_request was written.
+    if (st.state == ssh_proxy::SessionState::Connecting ||
+        st.state == ssh_proxy::SessionState::Relaying)
+    {
+        char target[300];
+        st.target.assign(target, Socks5::FormatTarget(m_request, target, sizeof(target)));
+    }
+    st.bytes_to_target    = m_bytes_to_target.load(std::memory_order_relaxed);
+    st.bytes_to_client    = m_bytes_to_client.load(std::memory_order_relaxed);
+    st.connect_latency_us = m_connect_latency_us.load(std::memory_order_relaxed);
+    st.queued_to_target   = m_tcp->SendQueuedBytes();
+    st.queued_to_client   = m_channel ? m_channel->WriteBacklogBytes() : 0;
+    return st;
+}
+
 void Socks5Session::Close()
 {
     // Atomic exchange ensures Close runs exactly once even if called from both
@@ -247,6 +516,7 @@ void Socks5Session::Close()
     if (prev == State::Closed) return;
 
     m_tcp->Close();
+    m_admission.Release();
     if (m_channel)
     {
         m_channel->SendEof();
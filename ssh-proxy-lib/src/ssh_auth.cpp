@@ -0,0 +1,236 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// SshAuth — user authentication for SshTransport::Connect
+//
+// PURPOSE
+//   Every transport of a pool, every reconnect and every DirectForward runs
+//   its own SSH user authentication.  Password auth costs the server its
+//   PAM/password path each time and means shipping the secret; public-key
+//   auth (from a key file or an agent) is one signature per connection.
+//
+// ORDER
+//   agent → public key → password, skipping what is not configured.  With a
+//   single method configured it is attempted straight away; with several,
+//   libssh2_userauth_list (the "none" request) is asked first so a method
+//   the server does not offer costs no extra round trip.
+//
+// KEY CACHE
+//   The key file is read once per process and kept as an immutable
+//   SshPrivateKey; libssh2_userauth_publickey_frommemory signs from that
+//   buffer, so later connects never touch the disk.  libssh2 does not hand
+//   out a parsed key handle — it decodes (and, for an encrypted key,
+//   decrypts) the buffer inside each call, which is in-memory work next to
+//   the network round trips a password or an extra method would cost.
+//
+// AGENT
+//   libssh2's agent support: Pageant on Windows (and the OpenSSH agent
+//   where libssh2 provides it).  Identities are tried in the agent's order
+//   until one is accepted.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "ssh_auth.h"
+#include "logger.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+std::mutex                                                            s_keys_mutex;
+std::unordered_map<std::string, std::shared_ptr<const SshPrivateKey>> s_keys;
+
+Result AuthError(LIBSSH2_SESSION* s, std::string context)
+{
+    char* errmsg = nullptr;
+    ::libssh2_session_last_error(s, &errmsg, nullptr, 0);
+    if (errmsg != nullptr && errmsg[0] != '\0') { context += ": "; context += errmsg; }
+    return { ErrorCode::SshAuthFailed, std::move(context) };
+}
+
+// True if `method` appears in the server's comma-separated userauth list.
+// A null list means the list was not asked for — every method is tried.
+bool Offered(const char* list, const char* method)
+{
+    if (list == nullptr) return true;
+    size_t len = std::strlen(method);
+    for (const char* p = list; *p != '\0';)
+    {
+        const char* end = std::strchr(p, ',');
+        size_t n = end != nullptr ? static_cast<size_t>(end - p) : std::strlen(p);
+        if (n == len && std::strncmp(p, method, len) == 0) return true;
+        if (end == nullptr) break;
+        p = end + 1;
+    }
+    return false;
+}
+
+bool AuthWithAgent(LIBSSH2_SESSION* session, const std::string& username)
+{
+    SshAgentPtr agent(::libssh2_agent_init(session));
+    if (!agent) return false;
+    if (::libssh2_agent_connect(agent.get()) != 0)
+    {
+        Logger::Debug("SSH agent not available");
+        return false;
+    }
+    if (::libssh2_agent_list_identities(agent.get()) != 0)
+    {
+        Logger::Debug("SSH agent: listing identities failed");
+        return false;
+    }
+
+    libssh2_agent_publickey* identity = nullptr;
+    libssh2_agent_publickey* prev     = nullptr;
+    while (::libssh2_agent_get_identity(agent.get(), &identity, prev) == 0)
+    {
+        if (::libssh2_agent_userauth(agent.get(), username.c_str(), identity) == 0)
+        {
+            Logger::Debug("SSH agent identity accepted: %s",
+                          identity->comment != nullptr ? identity->comment : "");
+            return true;
+        }
+        prev = identity;
+    }
+    return false;   // 1 = end of the list, < 0 = agent error
+}
+
+} // namespace
+
+// ── SshKeyCache ───────────────────────────────────────────────────────────────
+
+Result SshKeyCache::Load(const std::string& path, const std::string& passphrase,
+                         std::shared_ptr<const SshPrivateKey>& key)
+{
+    std::string id = path;
+    id += '\0';
+    id += passphrase;
+    {
+        std::lock_guard<std::mutex> lock(s_keys_mutex);
+        auto it = s_keys.find(id);
+        if (it != s_keys.end())
+        {
+            key = it->second;
+            return {};
+        }
+    }
+
+    // Read outside the lock; of two racing first loads, the first to
+    // insert wins and both callers share its copy.
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return { ErrorCode::InvalidArgument, "cannot read private key file '" + path + "'" };
+    std::string pem((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (pem.empty())
+        return { ErrorCode::InvalidArgument, "private key file '" + path + "' is empty" };
+
+    auto loaded = std::make_shared<const SshPrivateKey>(
+        SshPrivateKey{ path, std::move(pem), passphrase });
+    std::lock_guard<std::mutex> lock(s_keys_mutex);
+    key = s_keys.emplace(std::move(id), std::move(loaded)).first->second;
+    return {};
+}
+
+size_t SshKeyCache::Size()
+{
+    std::lock_guard<std::mutex> lock(s_keys_mutex);
+    return s_keys.size();
+}
+
+void SshKeyCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(s_keys_mutex);
+    s_keys.clear();
+}
+
+Result MakeSshAuth(const std::string& username, const std::string& password,
+                   const ssh_proxy::AuthOptions& options, SshAuth& auth)
+{
+    auth = SshAuth{};
+    auth.username  = username;
+    auth.password  = password;
+    auth.use_agent = options.use_agent;
+    if (!options.private_key_file.empty())
+    {
+        Result loaded = SshKeyCache::Load(options.private_key_file, options.key_passphrase, auth.key);
+        if (!loaded.ok()) return loaded;
+    }
+    if (!auth.HasMethod())
+        return { ErrorCode::InvalidArgument,
+                 "no SSH authentication method: give a password, a private key or use_agent" };
+    return {};
+}
+
+//
+// ── SshAuthenticate ───────────────────────────────────────────────────────────
+//
+// See ORDER above.  A server that accepts the "none" request (list is null
+// and the session is authenticated) needs nothing further.
+//
+
+Result SshAuthenticate(LIBSSH2_SESSION* session, const SshAuth& auth)
+{
+    if (!auth.HasMethod())
+        return { ErrorCode::InvalidArgument, "no SSH authentication method configured" };
+
+    const std::string& user = auth.username;
+    int methods = (auth.use_agent ? 1 : 0) + (auth.key ? 1 : 0) + (auth.password.empty() ? 0 : 1);
+
+    const char* list = nullptr;
+    if (methods > 1)
+    {
+        list = ::libssh2_userauth_list(session, user.c_str(),
+                                       static_cast<unsigned int>(user.size()));
+        if (list == nullptr)
+        {
+            if (::libssh2_userauth_authenticated(session) != 0)
+            {
+                Logger::Info("SSH authenticated as '%s' (none)", user.c_str());
+                return {};
+            }
+            return AuthError(session, "SSH userauth list failed for user '" + user + "'");
+        }
+        Logger::Debug("SSH server offers auth methods: %s", list);
+    }
+
+    std::string tried;
+    if (auth.use_agent && Offered(list, "publickey"))
+    {
+        if (AuthWithAgent(session, user))
+        {
+            Logger::Info("SSH authenticated as '%s' (agent)", user.c_str());
+            return {};
+        }
+        tried = "agent";
+    }
+
+    if (auth.key && Offered(list, "publickey"))
+    {
+        const SshPrivateKey& k = *auth.key;
+        if (::libssh2_userauth_publickey_frommemory(session, user.c_str(), user.size(),
+                nullptr, 0, k.pem.data(), k.pem.size(), k.passphrase.c_str()) == 0)
+        {
+            Logger::Info("SSH authenticated as '%s' (public key %s)", user.c_str(), k.path.c_str());
+            return {};
+        }
+        Logger::Debug("SSH public-key auth with %s failed", k.path.c_str());
+        tried += tried.empty() ? "publickey" : ", publickey";
+    }
+
+    if (!auth.password.empty() && Offered(list, "password"))
+    {
+        if (::libssh2_userauth_password(session, user.c_str(), auth.password.c_str()) == 0)
+        {
+            Logger::Info("SSH authenticated as '%s'", user.c_str());
+            return {};
+        }
+        tried += tried.empty() ? "password" : ", password";
+    }
+
+    if (tried.empty())
+        return { ErrorCode::SshAuthFailed, "SSH auth failed for user '" + user +
+                 "': server offers only " + (list != nullptr ? list : "unknown methods") };
+    return AuthError(session, "SSH auth failed for user '" + user + "' (tried " + tried + ")");
+}
@@ -0,0 +1,141 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// SshMethods — algorithm preferences for SshTransport::Connect
+//
+// PURPOSE
+//   One SSH session's throughput is bounded by how fast its single I/O
+//   thread encrypts and MACs.  libssh2's built-in ordering can settle on a
+//   CTR cipher with a separate HMAC pass; an AEAD cipher (AES-GCM on
+//   AES-NI hardware, chacha20-poly1305 without it) does both in one pass.
+//
+// DEFAULT PROFILE
+//   An empty list in ssh_proxy::SshAlgorithms selects the profile below,
+//   merged with everything the libssh2 build supports
+//   (libssh2_session_supported_algs): the profile's methods are offered
+//   first, the rest after them, so a server without any of them still gets
+//   a method it knows.  Names this libssh2 build does not implement are
+//   dropped by libssh2_session_method_pref itself.
+//
+// EXPLICIT LISTS
+//   A non-empty list is passed to libssh2 as is — methods not named are never
+//   negotiated.  That is how a caller excludes, say, CBC ciphers.
+//
+// COMPRESSION
+//   Negotiated once, at key exchange, for the whole session: there is no
+//   switching it on later when the traffic turns out to be text.  With
+//   SshAlgorithms::compression libssh2 offers zlib ahead of "none", so a
+//   server without compression still connects.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "ssh_methods.h"
+#include <algorithm>
+
+namespace {
+
+const char kKexProfile[]     = "curve25519-sha256,curve25519-sha256@libssh.org,"
+                               "ecdh-sha2-nistp256";
+const char kHostKeyProfile[] = "ssh-ed25519,ecdsa-sha2-nistp256,rsa-sha2-256";
+const char kCipherProfile[]  = "aes128-gcm@openssh.com,aes256-gcm@openssh.com,"
+                               "chacha20-poly1305@openssh.com,aes128-ctr,aes256-ctr";
+const char kMacProfile[]     = "hmac-sha2-256-etm@openssh.com,hmac-sha2-256,hmac-sha2-512";
+
+std::vector<std::string> Supported(LIBSSH2_SESSION* session, int method_type)
+{
+    std::vector<std::string> names;
+    const char** algs = nullptr;
+    int n = ::libssh2_session_supported_algs(session, method_type, &algs);
+    if (n <= 0 || algs == nullptr) return names;
+    names.assign(algs, algs + n);
+    ::libssh2_free(session, algs);
+    return names;
+}
+
+// Sets one method type.  explicit_list empty → the profile merged with what
+// libssh2 supports.
+Result SetPreference(LIBSSH2_SESSION* session, int method_type, const char* what,
+                     const std::string& explicit_list, const char* profile)
+{
+    std::string prefs = explicit_list;
+    if (prefs.empty())
+    {
+        prefs = MergeMethodPreference(profile, Supported(session, method_type));
+        if (prefs.empty()) return {};   // nothing known: keep libssh2's default
+    }
+    if (::libssh2_session_method_pref(session, method_type, prefs.c_str()) != 0)
+        return { ErrorCode::InvalidArgument,
+                 std::string("no supported SSH ") + what + " in '" + prefs + "'" };
+    return {};
+}
+
+std::string Method(LIBSSH2_SESSION* session, int method_type)
+{
+    const char* name = ::libssh2_session_methods(session, method_type);
+    return name != nullptr ? name : "";
+}
+
+std::string Directional(LIBSSH2_SESSION* session, int cs_type, int sc_type)
+{
+    std::string cs = Method(session, cs_type);
+    std::string sc = Method(session, sc_type);
+    return cs == sc ? cs : cs + "/" + sc;
+}
+
+} // namespace
+
+std::string MergeMethodPreference(const std::string& preferred,
+                                  const std::vector<std::string>& supported)
+{
+    std::vector<std::string> names;
+    for (size_t pos = 0; pos <= preferred.size();)
+    {
+        size_t end = preferred.find(',', pos);
+        if (end == std::string::npos) end = preferred.size();
+        if (end > pos) names.push_back(preferred.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    for (const auto& s : supported)
+        if (!s.empty() && std::find(names.begin(), names.end(), s) == names.end())
+            names.push_back(s);
+
+    std::string out;
+    for (const auto& n : names)
+    {
+        if (!out.empty()) out += ',';
+        out += n;
+    }
+    return out;
+}
+
+Result ApplySshAlgorithms(LIBSSH2_SESSION* session, const ssh_proxy::SshAlgorithms& a)
+{
+    // Both directions get the same cipher and MAC lists.
+    struct { int type; const char* what; const std::string& list; const char* profile; } prefs[] = {
+        { LIBSSH2_METHOD_KEX,      "key exchange", a.kex,      kKexProfile     },
+        { LIBSSH2_METHOD_HOSTKEY,  "host key",     a.host_key, kHostKeyProfile },
+        { LIBSSH2_METHOD_CRYPT_CS, "cipher",       a.ciphers,  kCipherProfile  },
+        { LIBSSH2_METHOD_CRYPT_SC, "cipher",       a.ciphers,  kCipherProfile  },
+        { LIBSSH2_METHOD_MAC_CS,   "MAC",          a.macs,     kMacProfile     },
+        { LIBSSH2_METHOD_MAC_SC,   "MAC",          a.macs,     kMacProfile     },
+    };
+    for (const auto& p : prefs)
+    {
+        Result set = SetPreference(session, p.type, p.what, p.list, p.profile);
+        if (!set.ok()) return set;
+    }
+
+    if (a.compression)
+        ::libssh2_session_flag(session, LIBSSH2_FLAG_COMPRESS, 1);
+    return {};
+}
+
+SshNegotiated ReadSshNegotiated(LIBSSH2_SESSION* session)
+{
+    SshNegotiated n;
+    n.kex         = Method(session, LIBSSH2_METHOD_KEX);
+    n.host_key    = Method(session, LIBSSH2_METHOD_HOSTKEY);
+    n.cipher      = Directional(session, LIBSSH2_METHOD_CRYPT_CS, LIBSSH2_METHOD_CRYPT_SC);
+    n.mac         = Directional(session, LIBSSH2_METHOD_MAC_CS,   LIBSSH2_METHOD_MAC_SC);
+    n.compression = Directional(session, LIBSSH2_METHOD_COMP_CS,  LIBSSH2_METHOD_COMP_SC);
+    return n;
+}
@@ -4,9 +4,25 @@
 //
 // PURPOSE
 //   Manages the full SSH connection lifecycle: blocking setup on the caller's
-//   thread (TCP connect + handshake + auth + tcpip-forward listen), then a
-//   dedicated I/O thread that accepts forwarded channels, drains write queues,
-//   runs keepalives, and pumps active SOCKS5 sessions.
+//   thread (TCP connect + handshake + auth via SshAuthenticate + tcpip-forward
+//   listens), then a dedicated I/O thread that accepts forwarded channels,
+//   drains write queues, runs keepalives, and pumps active SOCKS5 sessions.
+//
+// SEVERAL REMOTE PORTS, ONE SESSION
+//   Every port in Connect()'s forward_ports is its own tcpip-forward and its
+//   own LIBSSH2_LISTENER in m_listeners.  The loop calls forward_accept on
+//   each of them every iteration — the first call drains the socket into
+//   libssh2, which files each channel-open under its listener, so channels
+//   for any port are picked up in the same tick.  The callback gets the
+//   port and picks the handler; the channels of all ports share the one
+//   cipher stream, write scheduler and pump list.
+//
+// EVENT-DRIVEN WAIT
+//   The SSH socket is attached to m_waiter (SocketWaiter: WSAEventSelect on
+//   Windows, poll() on POSIX); PostChannelWrite/PostToIoThread/Close wake it.
+//   The I/O thread only blocks once a full loop iteration did no work, and
+//   then sleeps in SocketWaiter::Wait until socket readiness, posted work, or
+//   the next keepalive deadline — an idle tunnel costs no CPU.
 //
 // THREADING MODEL
 //   Connect() runs synchronously on the caller.  After StartAccepting()
@@ -15,33 +31,141 @@
 //   calling context at runtime to choose direct call vs. queue dispatch.
 //
 // CROSS-THREAD QUEUES
-//   m_write_queues  — IOCP threads post channel data via PostChannelWrite().
-//                     DrainWriteQueues() flushes them on each I/O loop tick.
+//   ChannelSlot::writes — per-channel lock-free MPSC queue.  IOCP threads post
+//                     channel data via PostChannelWrite() without a shared
+//                     lock; the first post after a flush enlists the slot in
+//                     m_dirty_slots and wakes the loop.  DrainWriteQueues()
+//                     visits only dirty or stalled channels — never a scan of
+//                     every open channel, never a lock held across
+//                     libssh2_channel_write.
+//                     Draining is fair: see FAIR WRITE DRAINING.
 //   m_io_callbacks  — IOCP threads post arbitrary lambdas via PostToIoThread()
-//                     (e.g. SendEof, channel_close/free).  DrainIoCallbacks()
+//                     (e.g. SetReadInterest).  DrainIoCallbacks()
 //                     swaps the vector under lock, then invokes outside lock so
 //                     callbacks cannot deadlock on m_io_callbacks_mutex.
 //
+// PUMP SCHEDULING
+//   Each accepted channel gets a ChannelSlot.  forward_accept reads every
+//   pending transport packet once per iteration; PumpSessions then runs the
+//   kicked slots — those an I/O-thread event marked (just registered,
+//   un-parked, write failed, closed) — and the ones a bounded scan finds
+//   data or EOF queued for.  libssh2 does not say which channel a packet
+//   was for (the recv hook sees ciphertext, and there is no packet
+//   callback), so that can only be asked per channel: HasPendingRead, which
+//   walks libssh2's packet list.  The scan therefore checks at most
+//   kReadScanBudget channels an iteration, resuming where it stopped, and
+//   a pass over all of them is owed only once a recv() has returned data.
+//   A burst costs bounded work per iteration (the loop stays busy until the
+//   pass is done); an iteration after which nothing was read or kicked
+//   visits no channel.  Sessions that cannot consume channel data (SOCKS5
+//   Connecting) switch read interest off and are parked outside the scan.
+//
+// FAIR WRITE DRAINING
+//   The SSH socket is one pipe for every channel, so whoever writes first
+//   fills it.  Each DrainWriteQueues() call is one round over the runnable
+//   channels — left over from the last round, stalled, newly dirty — in
+//   which each may write at most kWriteQuantum bytes.  A channel with more
+//   queued goes to the back (m_ready_slots) and the loop stays busy, so a
+//   bulk download advances a quantum per iteration while an interactive
+//   session's few bytes go out in the same round they were posted.
+//
 // CHANNEL WRITE QUEUE LIFECYCLE
-//   A ChannelQueue entry is registered eagerly at accept time, before
-//   on_channel() is called, so PostChannelWrite never races the first Write().
-//   RemoveChannelWriteQueue() (via the pre_close hook) removes the entry
-//   before channel_free fires.  PostChannelWrite discards silently if the
-//   entry is already gone — the channel pointer may be freed.
+//   The slot (and its queue) exists before on_channel() is called, and the
+//   post_write hook captures it directly, so PostChannelWrite needs no lookup
+//   and never races the first Write().  SendEof and Close only raise a flag
+//   on the slot and enlist it like a write: once FlushChannelWrites has
+//   emptied the queue it sends the EOF, then closes and frees the channel
+//   and sets `closed`.  Neither can overtake data queued before it, so a
+//   half-closed stream reaches the peer whole and a session that closes
+//   right after its last write does not truncate it.  A dirty slot is kept
+//   alive by its own dirty_ref until the I/O thread dequeues it, so a
+//   session tearing down mid-post cannot free it.
+//
+// LATE FORWARD AND TEARDOWN
+//   A transport connected without a forward can be given its ports later
+//   (RequestForward) — Connect's hot standby taking over a dropped
+//   transport.  Whatever ends the loop also ends its sessions, and the
+//   object itself may only go once HasLiveChannels() is false: the hooks of
+//   a channel that an IOCP completion still holds point back at it.
+//
+// STATS
+//   Everything GetStats() reports is written by the I/O thread alone: byte
+//   and EAGAIN counts accumulate in thread-locals and are published once per
+//   iteration with relaxed stores, the SSH connection's RTT is sampled from
+//   the kernel (SIO_TCP_INFO) at most once a second.  Readers pay for the
+//   loads; nobody reading costs the loop a handful of plain stores.
+//   Each iteration's duration (idle wait excluded) and each buffer's time in
+//   a channel write queue also go to the process-wide latency histograms
+//   (Instrumentation), which emit a TraceLogging event per record.
 //
 //////////////////////////////////////////////////////////////////////////////
 
 #include "ssh_transport.h"
+#include "async_io.h"
 #include "logger.h"
+#include "instrumentation.h"
+#include "socket_ops.h"
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <deque>
 #include <stdexcept>
 
 // Thread-local flag: true only on the SSH I/O thread.
 // SshChannel uses this to decide whether to call libssh2 directly (I/O thread)
-// or to marshal the call through a queue (any other thread).
+// or to marshal the call through a queue (any other thread).  Writes are the
+// exception: they are always queued, so EAGAIN never stalls the loop.
 static thread_local bool s_is_io_thread = false;
 
+// Set by SshChannel::Read when it consumed data or observed EOF.  The I/O
+// loop clears it before PumpSessions and checks it afterwards: a read that
+// made progress may have left more data queued inside libssh2 (no further
+// socket event will announce it), so the loop must run again before blocking.
+static thread_local bool s_io_activity = false;
+
+// Channel payload moved by this I/O thread since the loop last published it
+// to the transport's Stats counters — keeps atomics off the per-read path.
+static thread_local uint64_t s_io_rx_bytes = 0;
+static thread_local uint64_t s_io_tx_bytes = 0;
+static thread_local uint64_t s_io_eagain_reads  = 0;
+static thread_local uint64_t s_io_eagain_writes = 0;
+
+// recv() calls on the SSH socket that returned data, counted by CountingRecv.
+// The loop compares it across an iteration to learn whether libssh2 took in
+// transport packets — a WINDOW_ADJUST among them can unblock a stalled write.
+static thread_local uint64_t s_io_socket_reads = 0;
+
+// Channels HasPendingRead checks per loop iteration; each check walks
+// libssh2's packet list, so this bounds the scan's cost per iteration.
+static constexpr size_t kReadScanBudget = 64;
+
+// Adds to a counter that only the calling thread writes: a relaxed load and
+// store instead of a locked read-modify-write.
+static void PublishAdd(std::atomic<uint64_t>& counter, uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// libssh2's socket receive, replaced to count the reads that returned data.
+// Failures are reported the way libssh2's own callback reports them:
+// -EAGAIN to retry, any other negative errno to fail the transport.
+static ssize_t CountingRecv(libssh2_socket_t sock, void* buffer, size_t length,
+                            int flags, void** /*abstract*/)
+{
+    ssize_t n = ::recv(sock, static_cast<char*>(buffer), static_cast<int>(length), flags);
+    if (n >= 0)
+    {
+        if (n > 0) ++s_io_socket_reads;
+        return n;
+    }
+    int err = LastSocketError();
+#ifdef _WIN32
+    return err == WSAEWOULDBLOCK || err == WSAEINTR ? -EAGAIN : -EIO;
+#else
+    return err == EAGAIN || err == EWOULDBLOCK || err == EINTR ? -EAGAIN : -err;
+#endif
+}
+
 // ── SshChannel ────────────────────────────────────────────────────────────────
 
 SshChannel::SshChannel(LIBSSH2_CHANNEL* ch, ThreadingHooks hooks)
@@ -54,7 +178,8 @@ SshChannel::SshChannel(LIBSSH2_CHANNEL* ch, ThreadingHooks hooks)
 //
 // Called on the SSH I/O thread only (libssh2 is not thread-safe).
 // Translates libssh2 return codes to ErrorCode: WouldBlock on EAGAIN,
-// ChannelClosed on EOF or zero bytes, ProtocolError on any other negative.
+// ChannelClosed on EOF or zero bytes, ProtocolError on any other negative
+// — and once the transport has failed a write on the channel.
 //
 
 ErrorCode SshChannel::Read(uint8_t* buf, size_t len, size_t& bytes_read)
@@ -62,19 +187,24 @@ ErrorCode SshChannel::Read(uint8_t* buf, size_t len, size_t& bytes_read)
     bytes_read = 0;
     LIBSSH2_CHANNEL* ch = m_channel.load();
     if (ch == nullptr) return ErrorCode::ChannelClosed;
+    if (m_hooks.write_failed && m_hooks.write_failed()) return ErrorCode::ProtocolError;
 
     ssize_t n = ::libssh2_channel_read(ch, reinterpret_cast<char*>(buf), len);
     if (n > 0)
     {
         bytes_read = static_cast<size_t>(n);
+        s_io_activity = true;
+        s_io_rx_bytes += bytes_read;
         return ErrorCode::Success;
     }
     if (n == 0 || ::libssh2_channel_eof(ch))
     {
+        s_io_activity = true;
         return ErrorCode::ChannelClosed;
     }
     if (n == LIBSSH2_ERROR_EAGAIN)
     {
+        ++s_io_eagain_reads;
         return ErrorCode::WouldBlock;
     }
     Logger::Error("libssh2_channel_read failed: %d", static_cast<int>(n));
@@ -83,18 +213,52 @@ ErrorCode SshChannel::Read(uint8_t* buf, size_t len, size_t& bytes_read)
 
 ErrorCode SshChannel::Write(const uint8_t* buf, size_t len)
 {
-    LIBSSH2_CHANNEL* ch = m_channel.load();
-    if (ch == nullptr) return ErrorCode::ChannelClosed;
+    if (m_channel.load() == nullptr) return ErrorCode::ChannelClosed;
+    if (len == 0) return ErrorCode::Success;
 
-    // If we're NOT on the SSH I/O thread, post via the write queue so libssh2
-    // is only touched by the I/O thread.
-    if (m_hooks.post_write && !s_is_io_thread)
+    // Raw pointers must be copied once; WriteBuffer does the rest.
+    if (m_hooks.post_write) return WriteBuffer(BufferPool::CopyOf(buf, len));
+    return WriteDirect(buf, len);
+}
+
+//
+// ── SshChannel::WriteBuffer ───────────────────────────────────────────────────
+//
+// Zero-copy variant: the buffer itself is queued.  Every thread — the I/O
+// thread included — goes through the transport's write queue, so a full
+// channel window or a full socket never blocks the caller: FlushChannelWrites
+// parks the slot on EAGAIN and retries it when FD_WRITE (socket drained) or
+// FD_READ (window adjust) wakes the loop, while every other channel keeps
+// being serviced.
+//
+
+ErrorCode SshChannel::WriteBuffer(PooledBuffer buf)
+{
+    if (m_channel.load() == nullptr) return ErrorCode::ChannelClosed;
+    if (buf.empty()) return ErrorCode::Success;
+
+    if (m_hooks.post_write)
     {
-        m_hooks.post_write(std::vector<uint8_t>(buf, buf + len));
+        m_hooks.post_write(std::move(buf));
         return ErrorCode::Success;
     }
+    return WriteDirect(buf.data(), buf.size());
+}
+
+//
+// ── SshChannel::WriteDirect ───────────────────────────────────────────────────
+//
+// Hook-less channels have no queue to retry from.  They belong to a session
+// in blocking mode, where libssh2 waits for the window itself; EAGAIN can
+// only mean a non-blocking session, and is surfaced as WouldBlock rather
+// than spun on.
+//
+
+ErrorCode SshChannel::WriteDirect(const uint8_t* buf, size_t len)
+{
+    LIBSSH2_CHANNEL* ch = m_channel.load();
+    if (ch == nullptr) return ErrorCode::ChannelClosed;
 
-    // On the I/O thread: call libssh2 directly (blocking with EAGAIN retry).
     size_t written = 0;
     while (written < len)
     {
@@ -104,13 +268,10 @@ ErrorCode SshChannel::Write(const uint8_t* buf, size_t len)
         if (n > 0)
         {
             written += static_cast<size_t>(n);
+            s_io_tx_bytes += static_cast<uint64_t>(n);
             continue;
         }
-        if (n == LIBSSH2_ERROR_EAGAIN)
-        {
-            ::Sleep(1);
-            continue;
-        }
+        if (n == LIBSSH2_ERROR_EAGAIN) return ErrorCode::WouldBlock;
         Logger::Error("libssh2_channel_write failed: %d", static_cast<int>(n));
         return ErrorCode::ProtocolError;
     }
@@ -121,8 +282,9 @@ ErrorCode SshChannel::Write(const uint8_t* buf, size_t len)
 // ── SshChannel::SendEof ───────────────────────────────────────────────────────
 //
 // Sends SSH_MSG_CHANNEL_EOF to signal the end of our outbound data stream.
-// If called from outside the I/O thread the call is posted via post_io so
-// libssh2 is only touched by the I/O thread.
+// With hooks the EOF goes through the transport's write queue, from every
+// thread: sent directly it could overtake data from this very session that
+// is still queued, and the peer would see the stream end early.
 //
 
 void SshChannel::SendEof()
@@ -130,37 +292,29 @@ void SshChannel::SendEof()
     LIBSSH2_CHANNEL* ch = m_channel.load();
     if (ch == nullptr) return;
 
-    if (m_hooks.post_io && !s_is_io_thread)
-    {
-        m_hooks.post_io([ch]() { ::libssh2_channel_send_eof(ch); });
-    }
+    if (m_hooks.send_eof)
+        m_hooks.send_eof();
     else
-    {
         ::libssh2_channel_send_eof(ch);
-    }
 }
 
+//
+// ── SshChannel::Close ─────────────────────────────────────────────────────────
+//
+// Clears the pointer first, so Read/Write/SendEof fail from here on.  With
+// hooks the transport lingers the channel until its queued writes — the tail
+// of a response, a SOCKS error reply — are on the wire, then closes and frees
+// it on the I/O thread (FlushChannelWrites).
+//
+
 void SshChannel::Close()
 {
     LIBSSH2_CHANNEL* ch = m_channel.exchange(nullptr);
     if (ch == nullptr) return;
 
-    // Remove from the transport's write queue before freeing.
-    // This must happen while ch is still a valid pointer so that
-    // DrainWriteQueues cannot call libssh2_channel_write on a freed channel.
-    if (m_hooks.pre_close) m_hooks.pre_close(ch);
-
-    // Always post channel_close/free to io_callbacks — never call directly,
-    // even on the IO thread. This guarantees that any io_callbacks already
-    // queued for this channel (e.g. a SendEof posted by an IOCP thread just
-    // before Close() ran) are drained in FIFO order before channel_free fires.
-    if (m_hooks.post_io)
+    if (m_hooks.close)
     {
-        m_hooks.post_io([ch]()
-        {
-            ::libssh2_channel_close(ch);
-            ::libssh2_channel_free(ch);
-        });
+        m_hooks.close();
     }
     else
     {
@@ -175,6 +329,51 @@ bool SshChannel::IsEof() const
     return ch != nullptr ? ::libssh2_channel_eof(ch) != 0 : true;
 }
 
+//
+// ── SshChannel::SetReadInterest ───────────────────────────────────────────────
+//
+// The transport's scheduling state is I/O-thread-only, so calls from IOCP
+// threads (e.g. OnTcpConnected) are posted.  Posting also wakes the I/O loop,
+// which pumps the channel once to consume anything that queued while parked.
+//
+
+void SshChannel::SetReadInterest(bool wanted)
+{
+    if (!m_hooks.read_interest) return;
+
+    if (m_hooks.post_io && !s_is_io_thread)
+    {
+        m_hooks.post_io([fn = m_hooks.read_interest, wanted]() { fn(wanted); });
+    }
+    else
+    {
+        m_hooks.read_interest(wanted);
+    }
+}
+
+//
+// ── SshChannel::SetWriteWatermarks / IsWriteBacklogged ────────────────────────
+//
+// Without hooks (direct libssh2 writes, tests) there is never a backlog.
+//
+
+void SshChannel::SetWriteWatermarks(size_t high, size_t low,
+                                    std::function<void()> on_drained)
+{
+    if (m_hooks.write_watermarks)
+        m_hooks.write_watermarks(high, low, std::move(on_drained));
+}
+
+bool SshChannel::IsWriteBacklogged() const
+{
+    return m_hooks.write_backlogged ? m_hooks.write_backlogged() : false;
+}
+
+size_t SshChannel::WriteBacklogBytes() const
+{
+    return m_hooks.write_backlog_bytes ? m_hooks.write_backlog_bytes() : 0;
+}
+
 // Appends the libssh2 last-error string to context and returns a failed Result.
 // The message travels in the Result so the caller can propagate or display it
 // without relying on a separate log call.
@@ -196,12 +395,15 @@ SshTransport::SshTransport() = default;
 SshTransport::~SshTransport()
 {
     Close();
+    // A session torn down after the loop exited may have enlisted its slot
+    // again; nothing can post any more, so drop those self-references too.
+    ReleaseWriteSlots();
 }
 
 Result SshTransport::Connect(const std::string& host, uint16_t port,
-                              const std::string& username,
-                              const std::string& password,
-                              uint16_t forward_port,
+                              const SshAuth& auth,
+                              const ssh_proxy::SshAlgorithms& algorithms,
+                              const std::vector<uint16_t>& forward_ports,
                               uint32_t timeout_ms,
                               uint32_t keepalive_interval_ms)
 {
@@ -227,19 +429,17 @@ Result SshTransport::Connect(const std::string& host, uint16_t port,
     WinSocket sock(::socket(addr->ai_family, SOCK_STREAM, IPPROTO_TCP));
     if (!sock)
         return { ErrorCode::SocketError,
-                 "socket() failed: " + std::to_string(::WSAGetLastError()) };
+                 "socket() failed: " + std::to_string(LastSocketError()) };
 
     // Apply connect timeout via SO_RCVTIMEO/SO_SNDTIMEO on a blocking socket
-    DWORD tv_ms = timeout_ms;
-    ::setsockopt(sock.get(), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv_ms), sizeof(tv_ms));
-    ::setsockopt(sock.get(), SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&tv_ms), sizeof(tv_ms));
+    SetSocketTimeouts(sock.get(), timeout_ms);
 
     if (::connect(sock.get(), addr->ai_addr, static_cast<int>(addr->ai_addrlen)) != 0)
     {
-        int err = ::WSAGetLastError();
-        return { WsaToErrorCode(err),
+        int err = LastSocketError();
+        return { SocketErrorToErrorCode(err),
                  "TCP connect to " + host + ":" + std::to_string(port) +
-                 " failed (WSA " + std::to_string(err) + ")" };
+                 " failed (error " + std::to_string(err) + ")" };
     }
     addr.reset();
     Logger::Info("TCP connected to %s:%u", host.c_str(), port);
@@ -250,6 +450,19 @@ Result SshTransport::Connect(const std::string& host, uint16_t port,
         return { ErrorCode::SshHandshakeFailed, "libssh2_session_init failed" };
 
     ::libssh2_session_set_blocking(session.get(), 1);
+#if LIBSSH2_VERSION_NUM >= 0x010b01
+    ::libssh2_session_callback_set2(session.get(), LIBSSH2_CALLBACK_RECV,
+                                    reinterpret_cast<libssh2_cb_generic*>(&CountingRecv));
+#else
+    ::libssh2_session_callback_set(session.get(), LIBSSH2_CALLBACK_RECV,
+                                   reinterpret_cast<void*>(&CountingRecv));
+#endif
+
+    // KEX / host key / cipher / MAC / compression preferences, before the
+    // handshake that negotiates them.
+    Result preferred = ApplySshAlgorithms(session.get(), algorithms);
+    if (!preferred.ok())
+        return preferred;
 
     if (::libssh2_session_handshake(session.get(), sock.get()) != 0)
         return ssh_error(session.get(), "SSH handshake failed", ErrorCode::SshHandshakeFailed);
@@ -266,22 +479,33 @@ Result SshTransport::Connect(const std::string& host, uint16_t port,
         Logger::Debug("SSH host key SHA-256: %s", fp_hex);
     }
 
-    // ── Password authentication ───────────────────────────────────────────────
-    if (::libssh2_userauth_password(session.get(), username.c_str(), password.c_str()) != 0)
-        return ssh_error(session.get(), "SSH auth failed for user '" + username + "'",
-                         ErrorCode::SshAuthFailed);
-    Logger::Info("SSH authenticated as '%s'", username.c_str());
+    SshNegotiated negotiated = ReadSshNegotiated(session.get());
+    Logger::Info("SSH methods: kex %s, host key %s, cipher %s, mac %s, compression %s",
+                 negotiated.kex.c_str(), negotiated.host_key.c_str(), negotiated.cipher.c_str(),
+                 negotiated.mac.c_str(), negotiated.compression.c_str());
+
+    // ── User authentication (agent / public key / password) ───────────────────
+    Result authenticated = SshAuthenticate(session.get(), auth);
+    if (!authenticated.ok())
+        return authenticated;
 
     // ── Remote port forwarding ────────────────────────────────────────────────
-    // SshListenerPtr declared after SshSessionPtr so it is destroyed first,
-    // before the session is freed (forward_cancel requires a live session).
-    int bound_port = 0;
-    SshListenerPtr listener(::libssh2_channel_forward_listen_ex(
-        session.get(), "127.0.0.1", forward_port, &bound_port, /*queue_maxsize=*/128));
-    if (!listener)
-        return ssh_error(session.get(), "tcpip-forward request failed (port " +
-                         std::to_string(forward_port) + ")", ErrorCode::SshChannelOpenFailed);
-    Logger::Info("Remote port forwarding active: 127.0.0.1:%d → SOCKS5", bound_port);
+    // The listeners are declared after SshSessionPtr so they are destroyed
+    // first, before the session is freed (forward_cancel requires a live
+    // session).  No ports: local-forward session, channels come only from
+    // OpenDirectChannel.
+    std::vector<Listener> listeners;
+    for (uint16_t forward_port : forward_ports)
+    {
+        int bound_port = 0;
+        SshListenerPtr listener(::libssh2_channel_forward_listen_ex(
+            session.get(), "127.0.0.1", forward_port, &bound_port, /*queue_maxsize=*/128));
+        if (!listener)
+            return ssh_error(session.get(), "tcpip-forward request failed (port " +
+                             std::to_string(forward_port) + ")", ErrorCode::SshChannelOpenFailed);
+        Logger::Info("Remote port forwarding active: 127.0.0.1:%d", bound_port);
+        listeners.push_back(Listener{ std::move(listener), forward_port });
+    }
 
     // Configure keepalives
     if (keepalive_interval_ms > 0)
@@ -291,10 +515,20 @@ Result SshTransport::Connect(const std::string& host, uint16_t port,
     // Switch to non-blocking for the accept loop
     ::libssh2_session_set_blocking(session.get(), 0);
 
+    // ── I/O thread wait ───────────────────────────────────────────────────────
+    // Attaching also puts the socket into non-blocking mode, which is what
+    // libssh2 expects from here on.  The last step that can fail, so the
+    // waiter is attached in place.
+    Result attached = m_waiter.Attach(sock.get());
+    if (!attached.ok())
+        return attached;
+
     // ── All resources acquired — commit to members ────────────────────────────
-    m_socket   = std::move(sock);
-    m_session  = std::move(session);
-    m_listener = std::move(listener);
+    m_socket       = std::move(sock);
+    m_session      = std::move(session);
+    m_listeners    = std::move(listeners);
+    m_keepalive_interval_ms = keepalive_interval_ms;
+    m_negotiated            = std::move(negotiated);
     m_connected.store(true);
     return {};
 }
@@ -303,8 +537,9 @@ Result SshTransport::Connect(const std::string& host, uint16_t port,
 // ── StartAccepting ────────────────────────────────────────────────────────────
 //
 // Launches the SSH I/O thread.  on_channel is called for each accepted
-// forwarded-tcpip channel and must return a SessionPumpFn that the I/O thread
-// calls every loop iteration.  on_disconnect is called when the loop exits.
+// forwarded-tcpip channel, on any of the ports, and must return a
+// SessionPumpFn that the I/O thread calls whenever the channel has inbound
+// data pending.  on_disconnect is called when the loop exits.
 //
 
 void SshTransport::StartAccepting(OnChannelAccepted on_channel,
@@ -314,21 +549,82 @@ void SshTransport::StartAccepting(OnChannelAccepted on_channel,
                               std::move(on_channel), std::move(on_disconnect));
 }
 
+//
+// ── PublishStats / SampleRtt ──────────────────────────────────────────────────
+//
+// End-of-iteration publication of the GetStats() counters — see STATS in the
+// file header.  The thread-locals only ever hold this iteration's counts.
+//
+
+void SshTransport::PublishStats(uint64_t drain_us)
+{
+    m_channels_open.store(m_session_pumps.size(), std::memory_order_relaxed);
+    PublishAdd(m_loop_iterations, 1);
+    if (drain_us != 0)
+    {
+        PublishAdd(m_drain_write_us, drain_us);
+        uint32_t us = static_cast<uint32_t>((std::min)(drain_us, uint64_t{UINT32_MAX}));
+        if (us > m_drain_write_us_max.load(std::memory_order_relaxed))
+            m_drain_write_us_max.store(us, std::memory_order_relaxed);
+    }
+    if (s_io_rx_bytes != 0 || s_io_tx_bytes != 0)
+    {
+        PublishAdd(m_bytes_received, s_io_rx_bytes);
+        PublishAdd(m_bytes_sent, s_io_tx_bytes);
+        s_io_rx_bytes = 0;
+        s_io_tx_bytes = 0;
+    }
+    if (s_io_eagain_reads != 0 || s_io_eagain_writes != 0)
+    {
+        PublishAdd(m_eagain_reads, s_io_eagain_reads);
+        PublishAdd(m_eagain_writes, s_io_eagain_writes);
+        s_io_eagain_reads  = 0;
+        s_io_eagain_writes = 0;
+    }
+}
+
+// libssh2 consumes keepalive replies internally and exposes no timing, so
+// the round trip comes from the kernel's smoothed RTT for the SSH socket.
+// Unsupported before Windows 10 1703 — rtt_us then stays 0.
+void SshTransport::SampleRtt()
+{
+    uint32_t rtt_us = 0;
+    if (ReadTcpRttUs(m_socket.get(), rtt_us))
+        m_rtt_us.store(rtt_us, std::memory_order_relaxed);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // IoThreadProc
 //
 // Main SSH I/O loop.  Each iteration:
-//   1. DrainIoCallbacks  — flush lambdas posted by IOCP threads (SendEof,
-//                          channel_close/free) before touching libssh2.
-//   2. keepalive_send    — sends SSH keepalive if the interval has elapsed.
-//   3. DrainWriteQueues  — flushes buffered channel writes from IOCP threads.
-//   4. PumpSessions      — calls each active session's SSH→TCP pump.
-//   5. forward_accept    — accepts the next inbound forwarded-tcpip channel.
+//   1. WaitForWork       — only if the previous iteration was idle: block until
+//                          the socket signals, work is posted, or the keepalive
+//                          deadline (from libssh2_keepalive_send) arrives.
+//   2. DrainIoCallbacks  — flush lambdas posted by IOCP threads (read
+//                          interest changes) before touching libssh2.
+//   3. keepalive_send    — sends SSH keepalive if the interval has elapsed.
+//   4. DrainWriteQueues  — flushes buffered channel writes from IOCP threads,
+//                          then any EOF / close queued behind them.
+//   5. OpenPendingChannels — advances the head direct-tcpip open request.
+//   6. forward_accept    — reads every pending transport packet, then accepts
+//                          the next inbound forwarded-tcpip channel of each
+//                          listener (PollTransport on a session without one).
+//   7. PumpSessions      — calls the pump of each kicked session and of
+//                          each the bounded read scan found inbound data or
+//                          EOF queued for in libssh2.
+//
+// An iteration is idle when none of the steps made progress.  Only then does
+// the loop block, so a busy tunnel never waits and an idle one never spins.
 //
-// When no channel is ready, select() blocks for at most 1 ms.  The short
-// timeout keeps relay latency low for active sessions without busy-waiting
-// when the tunnel is idle.
+// WHY forward_accept RUNS BEFORE THE PUMPS
+//   The socket's readiness is consumed right after the wait (on Windows the
+//   event is reset by WSAEnumNetworkEvents), before any libssh2 call.
+//   forward_accept then drains the socket into libssh2's packet queue, so
+//   every packet that arrived before the reset is visible to every pump in
+//   this iteration.  Bytes that arrive later re-signal readiness and wake the
+//   next wait — no channel's data can be stranded in libssh2's queue while
+//   the thread sleeps.
 //
 // LIBSSH2 THREAD SAFETY
 //   s_is_io_thread is set to true for this thread's lifetime.  SshChannel
@@ -340,127 +636,635 @@ void SshTransport::IoThreadProc(OnChannelAccepted on_channel,
                                  OnDisconnected on_disconnect)
 {
     s_is_io_thread = true;
+    IoEngine::PinIoThread();
     Logger::Debug("SSH I/O thread started");
 
     ErrorCode disconnect_reason = ErrorCode::Success;
+    bool      idle              = false;
+    int       next_keepalive    = 0;   // seconds, from libssh2_keepalive_send
+    uint64_t  next_rtt_sample   = 0;   // GetTickCount64 deadline
 
     while (!m_cancel.load())
     {
+        bool peer_closed = false;
+
+        // ── Block until there is something to do ──────────────────────────────
+        if (idle)
+        {
+            DWORD timeout_ms = INFINITE;
+            if (m_keepalive_interval_ms > 0 && next_keepalive > 0)
+                timeout_ms = static_cast<DWORD>(next_keepalive) * 1000;
+            WaitForWork(timeout_ms, peer_closed);
+            if (m_cancel.load()) break;
+        }
+
+        int64_t  tick_start   = QpcNow();
+        uint64_t reads_before = s_io_socket_reads;
+        bool busy = false;
+
         // ── Drain callbacks posted from IOCP threads ──────────────────────────
-        DrainIoCallbacks();
+        busy |= DrainIoCallbacks();
 
         // ── Send keepalives ───────────────────────────────────────────────────
-        int next_keepalive = 0;
         ::libssh2_keepalive_send(m_session.get(), &next_keepalive);
 
         // ── Drain per-channel write queues ────────────────────────────────────
-        DrainWriteQueues();
+        int64_t drain_start = QpcNow();
+        busy |= DrainWriteQueues();
+        uint64_t drain_us = QpcToUs(QpcNow() - drain_start);
 
-        // ── Pump active SOCKS5 sessions (SSH channel → TCP) ───────────────────
-        PumpSessions();
+        // ── Open requested direct-tcpip channels ──────────────────────────────
+        busy |= OpenPendingChannels();
+
+        // ── Late tcpip-forward request (hot standby taking over) ──────────────
+        if (m_pending_forward)
+            busy |= ListenPending(on_channel);
 
         // ── Accept new channels ───────────────────────────────────────────────
-        LIBSSH2_CHANNEL* ch = ::libssh2_channel_forward_accept(m_listener.get());
-        if (ch != nullptr)
+        // One channel per listener per iteration (see SEVERAL REMOTE PORTS).
+        // Without a remote forward there is nothing to accept; PollTransport
+        // pulls pending packets into libssh2 in its place.
+        if (m_listeners.empty())
         {
-            Logger::Debug("Accepted forwarded-tcpip channel");
-
-            // Inject thread-safety callbacks so IOCP threads never call
-            // libssh2 directly through SshChannel::Write/SendEof/Close.
-            SshChannel::ThreadingHooks hooks{
-                [this, ch](std::vector<uint8_t> data)
-                {
-                    PostChannelWrite(ch, std::move(data));
-                },
-                [this](std::function<void()> fn)
-                {
-                    PostToIoThread(std::move(fn));
-                },
-                [this](LIBSSH2_CHANNEL* c)
-                {
-                    RemoveChannelWriteQueue(c);
-                }
-            };
-
-            // Register channel in the write queue eagerly so PostChannelWrite
-            // can safely discard writes for channels not found in the queue.
+            if (!PollTransport(busy))
             {
-                std::lock_guard<std::mutex> lock(m_queues_mutex);
-                m_write_queues.push_back(ChannelQueue{ ch, {} });
+                Logger::Error("SSH transport read failed: %d",
+                              ::libssh2_session_last_errno(m_session.get()));
+                disconnect_reason = ErrorCode::ConnectionReset;
+                break;
             }
+        }
+        else if (!AcceptChannels(on_channel, busy))
+        {
+            disconnect_reason = ErrorCode::ProtocolError;
+            break;
+        }
+
+        // ── Pump active SOCKS5 sessions (SSH channel → TCP) ───────────────────
+        s_io_activity = false;
+        busy |= PumpSessions();
+        busy |= s_io_activity;
+
+        // A write stalled on a full remote window resumes on a WINDOW_ADJUST,
+        // which any read this iteration may have taken in — retry before
+        // sleeping, since nothing else will wake the loop for it.
+        if (!m_stalled_slots.empty() && s_io_socket_reads != reads_before)
+            busy = true;
+
+        // ── Publish load counters ─────────────────────────────────────────────
+        PublishStats(drain_us);
+        uint64_t now = ::GetTickCount64();
+        if (now >= next_rtt_sample)
+        {
+            SampleRtt();
+            next_rtt_sample = now + 1000;
+        }
+        Instrumentation::RecordLatency(LatencyPoint::IoLoopTick,
+                                       QpcToUs(QpcNow() - tick_start));
+
+        // ── Server closed the TCP connection ──────────────────────────────────
+        // Checked after the pumps so data that arrived with the FIN is relayed.
+        if (peer_closed)
+        {
+            Logger::Error("SSH server closed the connection");
+            disconnect_reason = ErrorCode::ConnectionReset;
+            break;
+        }
+
+        idle = !busy;
+    }
 
-            auto ssh_ch = std::make_unique<SshChannel>(ch, std::move(hooks));
-            auto pump = on_channel(std::move(ssh_ch));
-            if (pump) RegisterSessionPump(std::move(pump));
+    // Opens that never completed get their failure callback.
+    std::deque<PendingOpen> unopened;
+    unopened.swap(m_pending_opens);
+    for (auto& p : unopened) p.on_open(nullptr);
+
+    if (auto fwd = std::move(m_pending_forward))
+        fwd->on_done({ ErrorCode::ConnectionReset, "SSH session dropped before the forward was set up" });
+
+    // Sessions cannot outlive their transport's loop: dropping the pumps
+    // closes them (TCP legs included) here rather than whenever the
+    // transport object goes.  Their channels enlist a last close, so the
+    // write slots are released after.
+    m_session_pumps.clear();
+    m_kicked_slots.clear();
+    m_control_channel = nullptr;   // freed with the session
+    ReleaseWriteSlots();
+    m_channels_open.store(0, std::memory_order_relaxed);
+    m_connected.store(false);
+    Logger::Debug("SSH I/O thread exiting");
+
+    if (on_disconnect)
+        on_disconnect(disconnect_reason);
+}
+
+//
+// ── AcceptChannels ────────────────────────────────────────────────────────────
+//
+// Returns false on a session error.  EAGAIN means no channel pending on that
+// listener; CHANNEL_UNKNOWN is a stale packet for a channel that was already
+// freed — both non-fatal.
+//
+
+bool SshTransport::AcceptChannels(const OnChannelAccepted& on_channel, bool& busy)
+{
+    for (const Listener& l : m_listeners)
+    {
+        LIBSSH2_CHANNEL* ch = ::libssh2_channel_forward_accept(l.listener.get());
+        if (ch != nullptr)
+        {
+            Logger::Debug("Accepted forwarded-tcpip channel on port %u",
+                          static_cast<unsigned>(l.port));
+            busy = true;
+            const uint16_t port = l.port;
+            AdoptChannel(ch, [&on_channel, port](std::unique_ptr<SshChannel> accepted)
+            {
+                return on_channel ? on_channel(port, std::move(accepted)) : SessionPumpFn{};
+            });
             continue;
         }
 
         int rc = ::libssh2_session_last_errno(m_session.get());
-        if (rc == LIBSSH2_ERROR_EAGAIN)
+        if (rc != LIBSSH2_ERROR_EAGAIN && rc != LIBSSH2_ERROR_CHANNEL_UNKNOWN)
         {
-            // No channel yet — select on socket
-            fd_set fds;
-            FD_ZERO(&fds);
-            FD_SET(m_socket.get(), &fds);
-            struct timeval tv{ 0, 1000 };  // 1 ms — keeps relay latency low while sessions are active
-            ::select(0, &fds, nullptr, nullptr, &tv);
-            continue;
+            char* errmsg = nullptr;
+            ::libssh2_session_last_error(m_session.get(), &errmsg, nullptr, 0);
+            Logger::Error("SSH session error: %s", errmsg != nullptr ? errmsg : "unknown");
+            return false;
         }
+    }
+    return true;
+}
 
-        if (rc == LIBSSH2_ERROR_CHANNEL_UNKNOWN)
+//
+// ── AdoptChannel ──────────────────────────────────────────────────────────────
+//
+// Wraps a new channel — accepted forwarded-tcpip or opened direct-tcpip — in
+// a ChannelSlot and an SshChannel whose hooks marshal IOCP-thread calls back
+// to this thread, hands it to the callback and registers the returned pump.
+//
+
+void SshTransport::AdoptChannel(LIBSSH2_CHANNEL* ch, const OnDirectChannel& on_channel)
+{
+    auto slot = std::make_shared<ChannelSlot>();
+    slot->channel = ch;
+
+    // Inject thread-safety callbacks so IOCP threads never call
+    // libssh2 directly through SshChannel::Write/SendEof/Close.
+    // The slot holds no reference to the session, so capturing it
+    // here cannot form an ownership cycle.  `refs` marks the channel
+    // as live for HasLiveChannels().
+    SshChannel::ThreadingHooks hooks{
+        [this, slot](PooledBuffer data)
         {
-            // Stale packet arrived for a channel that was already freed — non-fatal
-            continue;
+            PostChannelWrite(slot, std::move(data));
+        },
+        [this, refs = m_channel_refs](std::function<void()> fn)
+        {
+            PostToIoThread(std::move(fn));
+        },
+        [this, slot]()
+        {
+            slot->eof_requested.store(true);
+            EnlistDirty(slot);
+        },
+        [this, slot]()
+        {
+            slot->close_requested.store(true);
+            EnlistDirty(slot);
+        },
+        [this, slot](bool wanted)
+        {
+            // I/O thread only (SshChannel::SetReadInterest marshals).
+            slot->parked = !wanted;
+            if (wanted) Kick(slot);
+        },
+        [slot](size_t high, size_t low, std::function<void()> on_drained)
+        {
+            // I/O thread, before the first cross-thread post.
+            slot->high_mark  = high;
+            slot->low_mark   = low;
+            slot->on_drained = std::move(on_drained);
+        },
+        [slot]()
+        {
+            return slot->backlogged.load();
+        },
+        [slot]()
+        {
+            return slot->pending_bytes.load(std::memory_order_relaxed);
+        },
+        [slot]()
+        {
+            return slot->write_failed;
         }
+    };
+
+    auto ssh_ch = std::make_unique<SshChannel>(ch, std::move(hooks));
+    auto pump = on_channel ? on_channel(std::move(ssh_ch)) : SessionPumpFn{};
+    if (pump) RegisterSessionPump(std::move(slot), std::move(pump));
+    m_channels_accepted.fetch_add(1, std::memory_order_relaxed);
+}
+
+//
+// ── OpenDirectChannel / OpenPendingChannels ───────────────────────────────────
+//
+// Requests are queued on the I/O thread and opened one at a time: libssh2
+// keeps a single non-blocking channel-open state per session, so the head of
+// m_pending_opens is retried each iteration until it stops returning EAGAIN.
+// Channels already open keep being serviced meanwhile.
+//
 
-        // Unexpected session error
+void SshTransport::OpenDirectChannel(std::string host, uint16_t port, OnDirectChannel on_open)
+{
+    PostToIoThread([this, host = std::move(host), port, fn = std::move(on_open)]() mutable
+    {
+        m_pending_opens.push_back(PendingOpen{ std::move(host), port, std::move(fn) });
+    });
+}
+
+bool SshTransport::OpenPendingChannels()
+{
+    if (m_pending_opens.empty()) return false;
+
+    PendingOpen& head = m_pending_opens.front();
+    LIBSSH2_CHANNEL* ch = head.control
+        ? ::libssh2_channel_open_session(m_session.get())
+        : ::libssh2_channel_direct_tcpip(m_session.get(), head.host.c_str(),
+                                         static_cast<int>(head.port));
+    if (ch == nullptr &&
+        ::libssh2_session_last_errno(m_session.get()) == LIBSSH2_ERROR_EAGAIN)
+        return false;
+
+    PendingOpen open = std::move(head);
+    m_pending_opens.pop_front();
+
+    if (open.control)
+    {
+        m_control_channel = ch;
+        if (ch != nullptr)
+            Logger::Debug("Opened the SSH control channel");
+        else if (!m_control_refused)
+            Logger::Warn("SSH server refused a session channel; the idle transport "
+                         "is read only when new data arrives");
+        m_control_refused = ch == nullptr;
+        return true;
+    }
+
+    if (ch == nullptr)
+    {
         char* errmsg = nullptr;
         ::libssh2_session_last_error(m_session.get(), &errmsg, nullptr, 0);
-        Logger::Error("SSH session error: %s", errmsg != nullptr ? errmsg : "unknown");
-        disconnect_reason = ErrorCode::ProtocolError;
-        break;
+        Logger::Warn("direct-tcpip to %s:%u failed: %s", open.host.c_str(),
+                     static_cast<unsigned>(open.port), errmsg != nullptr ? errmsg : "unknown");
+        open.on_open(nullptr);
+        return true;
     }
 
-    m_connected.store(false);
-    Logger::Debug("SSH I/O thread exiting");
+    Logger::Debug("Opened direct-tcpip channel to %s:%u", open.host.c_str(),
+                  static_cast<unsigned>(open.port));
+    AdoptChannel(ch, open.on_open);
+    return true;
+}
 
-    if (on_disconnect)
-        on_disconnect(disconnect_reason);
+//
+// ── RequestForward / ListenPending ────────────────────────────────────────────
+//
+// The tcpip-forward requests Connect() would have made, issued later on a
+// running session: non-blocking, so the head of the loop retries the
+// current one until libssh2 stops returning EAGAIN while the session's
+// other traffic (the keepalives of an idle standby) carries on.  Once every
+// listener is set the accept branch of the loop takes over with the new
+// on_channel; a refusal part way drops the listeners already bound.
+//
+
+void SshTransport::RequestForward(std::vector<uint16_t> ports, OnChannelAccepted on_channel,
+                                  OnForwardDone on_done)
+{
+    if (!m_connected.load())
+    {
+        on_done({ ErrorCode::ConnectionReset, "SSH session is down" });
+        return;
+    }
+    auto fwd = std::make_shared<PendingForward>(
+        PendingForward{ std::move(ports), std::move(on_channel), std::move(on_done), {} });
+    PostToIoThread([this, fwd]()
+    {
+        if (!m_listeners.empty() || m_pending_forward)
+        {
+            fwd->on_done({ ErrorCode::InvalidArgument, "remote forward already requested" });
+            return;
+        }
+        m_pending_forward = std::make_unique<PendingForward>(std::move(*fwd));
+    });
+}
+
+bool SshTransport::ListenPending(OnChannelAccepted& on_channel)
+{
+    PendingForward& fwd = *m_pending_forward;
+    bool progressed = false;
+    while (fwd.bound.size() < fwd.ports.size())
+    {
+        const uint16_t port = fwd.ports[fwd.bound.size()];
+        int bound_port = 0;
+        LIBSSH2_LISTENER* listener = ::libssh2_channel_forward_listen_ex(
+            m_session.get(), "127.0.0.1", port, &bound_port, /*queue_maxsize=*/128);
+        if (listener == nullptr &&
+            ::libssh2_session_last_errno(m_session.get()) == LIBSSH2_ERROR_EAGAIN)
+            return progressed;
+
+        if (listener == nullptr)
+        {
+            std::unique_ptr<PendingForward> failed = std::move(m_pending_forward);
+            failed->on_done(ssh_error(m_session.get(), "tcpip-forward request failed (port " +
+                                      std::to_string(port) + ")",
+                                      ErrorCode::SshChannelOpenFailed));
+            return true;   // `failed` cancels the ports already bound
+        }
+
+        fwd.bound.push_back(Listener{ SshListenerPtr(listener), port });
+        Logger::Info("Remote port forwarding active: 127.0.0.1:%d", bound_port);
+        progressed = true;
+    }
+
+    std::unique_ptr<PendingForward> done = std::move(m_pending_forward);
+    m_listeners = std::move(done->bound);
+    on_channel  = std::move(done->on_channel);
+    done->on_done({});
+    return true;
+}
+
+//
+// ── PollTransport ─────────────────────────────────────────────────────────────
+//
+// Stands in for forward_accept on a session without a remote forward.  A
+// zero-length channel read processes every packet waiting on the socket —
+// for all channels — and consumes nothing, which restores the guarantee that
+// the pumps see everything that arrived before the socket event was reset.
+// Returns false if the transport itself failed.
+//
+// libssh2 has no read of its own, yet with no session channel open (an
+// idle DirectForward, the hot standby) the server's packets still need
+// processing — keepalive@openssh.com wants a reply, and POSIX poll() keeps
+// returning while bytes sit unread.  So the first call queues a plain
+// "session" channel — the control channel, never given a request or data,
+// kept for the session's life — and reads through it whenever no session
+// channel is there to.  A server that refuses session channels
+// (MaxSessions 0 on a forwarding-only account) gets the open again only
+// once the socket has input: a channel open in flight reads the transport
+// while it waits, the refusal included.
+//
+
+bool SshTransport::PollTransport(bool& busy)
+{
+    LIBSSH2_CHANNEL* reader = m_control_channel;
+    for (size_t i = 0; reader == nullptr && i < m_session_pumps.size(); ++i)
+        if (!m_session_pumps[i].slot->close_requested.load())
+            reader = m_session_pumps[i].slot->channel;
+
+    if (reader != nullptr)
+    {
+        char none = 0;
+        ssize_t rc = ::libssh2_channel_read(reader, &none, 0);
+        return rc != LIBSSH2_ERROR_SOCKET_RECV && rc != LIBSSH2_ERROR_SOCKET_SEND &&
+               rc != LIBSSH2_ERROR_SOCKET_DISCONNECT;
+    }
+
+    bool opening = std::any_of(m_pending_opens.begin(), m_pending_opens.end(),
+                               [](const PendingOpen& p) { return p.control; });
+    if (!opening && (!m_control_refused || SocketHasInput(m_socket.get())))
+    {
+        PendingOpen control;
+        control.on_open = [](std::unique_ptr<SshChannel>) { return SessionPumpFn{}; };
+        control.control = true;
+        m_pending_opens.push_back(std::move(control));
+        busy = true;
+    }
+    return true;
+}
+
+//
+// ── WaitForWork ───────────────────────────────────────────────────────────────
+//
+// Sleeps in m_waiter on the socket and the wake signal.  The wake signal is
+// consumed before the iteration drains what was posted; a post that races it
+// re-signals, so the next wait returns immediately.  Write readiness is asked
+// for only while libssh2 is blocked sending — the POSIX poll() is
+// level-triggered, and a channel stalled on a full remote window sees a
+// writable socket; what unblocks it is the WINDOW_ADJUST, which arrives as
+// readable data.
+//
+
+void SshTransport::WaitForWork(DWORD timeout_ms, bool& peer_closed)
+{
+    bool want_write =
+        (::libssh2_session_block_directions(m_session.get()) & LIBSSH2_SESSION_BLOCK_OUTBOUND) != 0;
+    m_waiter.Wait(timeout_ms, want_write, peer_closed);
+}
+
+void SshTransport::Wake()
+{
+    m_waiter.Wake();
 }
 
 //
 // ── DrainWriteQueues ──────────────────────────────────────────────────────────
 //
-// Called on the SSH I/O thread.  For each channel that has pending write data
-// (posted by IOCP threads via PostChannelWrite), calls libssh2_channel_write
-// until the queue is empty or EAGAIN stalls the session.  A partial write
-// shrinks the front buffer in place rather than re-queuing.
+// Called on the SSH I/O thread.  Builds one round (see FAIR WRITE
+// DRAINING): the channels that used up their quantum last time, then those
+// that stalled on EAGAIN in an earlier iteration (woken by FD_WRITE — socket
+// drained — or FD_READ — window adjust arrived), then the whole dirty list,
+// taken with one exchange.  `queued` keeps a channel to one visit per round.
+// `dirty` is cleared before the flush, so a post that lands mid-flush
+// re-enlists the slot rather than being missed.  After each flush, a
+// backlogged channel that has drained to its low watermark gets its
+// on_drained callback.  Returns true if any bytes were written or a channel
+// is waiting for its next quantum.
+//
+
+bool SshTransport::DrainWriteQueues()
+{
+    m_write_round.swap(m_ready_slots);   // already marked queued
+    for (auto& slot : m_stalled_slots)
+    {
+        slot->stalled = false;
+        if (slot->queued) continue;
+        slot->queued = true;
+        m_write_round.push_back(std::move(slot));
+    }
+    m_stalled_slots.clear();
+
+    ChannelSlot* p = m_dirty_slots.exchange(nullptr, std::memory_order_acquire);
+    while (p != nullptr)
+    {
+        ChannelSlot* next = p->dirty_next;
+        std::shared_ptr<ChannelSlot> slot = std::move(p->dirty_ref);
+        slot->dirty.store(false);
+        if (!slot->queued)
+        {
+            slot->queued = true;
+            m_write_round.push_back(std::move(slot));
+        }
+        p = next;
+    }
+
+    bool wrote = false;
+    for (auto& slot : m_write_round)
+    {
+        slot->queued = false;
+        wrote |= FlushChannelWrites(slot, kWriteQuantum);
+        NotifyIfDrained(*slot);
+    }
+    m_write_round.clear();
+    return wrote || !m_ready_slots.empty();
+}
+
+//
+// ── FlushChannelWrites ────────────────────────────────────────────────────────
+//
+// Writes the slot's front buffer, then pops the next one, until the queue is
+// empty, libssh2 returns EAGAIN or `budget` bytes have gone — then the slot
+// waits on m_ready_slots for the next round.  A partial write consumes from
+// the front of the pooled buffer instead of copying the remainder.  A write
+// error discards everything still queued.  With the queue empty, a requested
+// EOF is sent and a requested close carried out — in that order, each only
+// once everything posted before it has gone.
 //
 
-void SshTransport::DrainWriteQueues()
+bool SshTransport::FlushChannelWrites(const std::shared_ptr<ChannelSlot>& slot,
+                                      size_t budget)
 {
-    std::lock_guard<std::mutex> lock(m_queues_mutex);
-    for (auto& q : m_write_queues)
+    ChannelSlot& s = *slot;
+    bool   wrote   = false;
+    size_t written = 0;
+    for (;;)
     {
-        while (!q.pending.empty())
+        if (!s.write_front)
         {
-            auto& buf = q.pending.front();
-            ssize_t n = ::libssh2_channel_write(q.channel,
+            Slab* next = s.writes.Pop();
+            if (next == nullptr) break;
+            Instrumentation::RecordLatency(LatencyPoint::WriteQueueWait,
+                                           QpcToUs(QpcNow() - next->queued_at));
+            s.write_front = PooledBuffer::Adopt(next);
+        }
+
+        if (s.closed.load())
+        {
+            DiscardChannelWrites(s);   // channel may be freed — drop the rest
+            return wrote;
+        }
+
+        if (written >= budget)
+        {
+            s.queued = true;
+            m_ready_slots.push_back(slot);
+            return wrote;
+        }
+
+        PooledBuffer& buf = s.write_front;
+        if (!buf.empty())
+        {
+            ssize_t n = ::libssh2_channel_write(s.channel,
                 reinterpret_cast<const char*>(buf.data()), buf.size());
-            if (n == LIBSSH2_ERROR_EAGAIN) break;
-            if (n <= 0)
+            if (n == LIBSSH2_ERROR_EAGAIN)
             {
-                q.pending.clear();
-                break;
+                ++s_io_eagain_writes;
+                if (!s.stalled)
+                {
+                    s.stalled = true;
+                    m_stalled_slots.push_back(slot);
+                }
+                return wrote;
             }
-            if (static_cast<size_t>(n) < buf.size())
+            if (n < 0)
             {
-                buf.erase(buf.begin(), buf.begin() + n);
+                Logger::Debug("libssh2_channel_write failed: %d — dropping queued data",
+                              static_cast<int>(n));
+                DiscardChannelWrites(s);
+                s.eof_sent     = true;   // the stream is broken — only the close is left
+                s.write_failed = true;
+                s.parked       = false;  // pump once: the session's Read reports it
+                Kick(slot);
                 break;
             }
-            q.pending.pop_front();
+            wrote = true;
+            written += static_cast<size_t>(n);
+            s_io_tx_bytes += static_cast<uint64_t>(n);
+            buf.Consume(static_cast<size_t>(n));
+            s.pending_bytes.fetch_sub(static_cast<size_t>(n));
+            if (!buf.empty()) continue;
+        }
+        s.write_front.Reset();
+    }
+
+    if (s.closed.load()) return wrote;   // freed by an earlier flush
+    if (s.eof_requested.load() && !s.eof_sent)
+    {
+        int rc = ::libssh2_channel_send_eof(s.channel);
+        if (rc == LIBSSH2_ERROR_EAGAIN)
+        {
+            if (!s.stalled)
+            {
+                s.stalled = true;
+                m_stalled_slots.push_back(slot);
+            }
+            return wrote;
         }
+        s.eof_sent = true;
+        wrote = true;
     }
+
+    if (s.close_requested.load())
+    {
+        ::libssh2_channel_close(s.channel);
+        ::libssh2_channel_free(s.channel);
+        s.closed.store(true);
+        DiscardChannelWrites(s);   // a post that raced the close
+        Kick(slot);                // PumpSessions drops the pump
+        wrote = true;
+    }
+    return wrote;
+}
+
+void SshTransport::DiscardChannelWrites(ChannelSlot& s)
+{
+    if (s.write_front)
+    {
+        s.pending_bytes.fetch_sub(s.write_front.size());
+        s.write_front.Reset();
+    }
+    while (Slab* next = s.writes.Pop())
+    {
+        PooledBuffer dropped = PooledBuffer::Adopt(next);
+        s.pending_bytes.fetch_sub(dropped.size());
+    }
+}
+
+void SshTransport::NotifyIfDrained(ChannelSlot& s)
+{
+    if (!s.backlogged.load() || s.close_requested.load()) return;
+    if (s.pending_bytes.load() > s.low_mark) return;
+    if (s.backlogged.exchange(false) && s.on_drained) s.on_drained();
+}
+
+void SshTransport::ReleaseWriteSlots()
+{
+    ChannelSlot* p = m_dirty_slots.exchange(nullptr, std::memory_order_acquire);
+    while (p != nullptr)
+    {
+        ChannelSlot* next = p->dirty_next;
+        std::shared_ptr<ChannelSlot> slot = std::move(p->dirty_ref);
+        slot->dirty.store(false);
+        p = next;
+    }
+    m_stalled_slots.clear();
+    m_ready_slots.clear();
+}
+
+SshTransport::ChannelSlot::~ChannelSlot()
+{
+    // Last reference — no producer can be pushing concurrently.
+    while (Slab* next = writes.Pop()) PooledBuffer::Adopt(next);
 }
 
 //
@@ -469,9 +1273,10 @@ void SshTransport::DrainWriteQueues()
 // Swaps m_io_callbacks out under the lock, then invokes the callbacks outside
 // the lock.  The swap-then-release pattern prevents deadlock if a callback
 // itself calls PostToIoThread (which acquires m_io_callbacks_mutex).
+// Returns true if any callback ran.
 //
 
-void SshTransport::DrainIoCallbacks()
+bool SshTransport::DrainIoCallbacks()
 {
     std::vector<std::function<void()>> callbacks;
     {
@@ -479,70 +1284,169 @@ void SshTransport::DrainIoCallbacks()
         callbacks.swap(m_io_callbacks);
     }
     for (auto& fn : callbacks) fn();
+    return !callbacks.empty();
 }
 
 //
 // ── PumpSessions ──────────────────────────────────────────────────────────────
 //
-// Calls each registered SessionPumpFn (i.e. Socks5Session::PumpSshRead) once
-// per I/O loop iteration.  Pumps that return false — session closed — are
-// erased in-place via the erase-remove idiom.
+// Runs the pumps of m_kicked_slots: slots kicked on the I/O thread (new
+// channel, read interest re-enabled, write failure, close) and those the
+// read scan kicked.  A recv() on the SSH socket that returned data since the
+// last look (s_io_socket_reads) owes a scan pass over every pump, because
+// only then can libssh2 hold anything new.  The pass runs kReadScanBudget
+// pumps an iteration from m_scan_cursor, which keeps rotating, so a pass
+// restarted by more data still reaches every pump.  A pump that leaves data
+// queued is kicked again for the next round.  Pumps that return false —
+// session closed — and slots whose channel was closed are swapped out of
+// m_session_pumps.  Returns true if a pump is due next round, the pass is
+// unfinished, or the pumps' own reads took in data no pass has seen.
 //
 
-void SshTransport::PumpSessions()
+bool SshTransport::PumpSessions()
+{
+    if (s_io_socket_reads != m_reads_at_scan)
+    {
+        m_reads_at_scan = s_io_socket_reads;
+        m_scan_left     = m_session_pumps.size();
+    }
+    size_t budget = std::min({ m_scan_left, kReadScanBudget, m_session_pumps.size() });
+    m_scan_left = budget < m_scan_left ? m_scan_left - budget : 0;
+    for (; budget > 0; --budget)
+    {
+        if (m_scan_cursor >= m_session_pumps.size()) m_scan_cursor = 0;
+        const SessionPump& p = m_session_pumps[m_scan_cursor++];
+        ChannelSlot& slot = *p.slot;
+        if (slot.kicked || slot.parked || slot.close_requested.load()) continue;
+        if (HasPendingRead(slot.channel)) Kick(p.slot);
+    }
+
+    // Kicks raised while the round runs (a pump re-enabling interest, a
+    // session torn down with its pump) land in m_kicked_slots, not here.
+    m_pump_round.swap(m_kicked_slots);
+    for (const auto& ref : m_pump_round)
+    {
+        ChannelSlot& slot = *ref;
+        slot.kicked = false;
+        if (slot.pump_index == SIZE_MAX) continue;   // no pump, or already gone
+        if (slot.close_requested.load())             // session is done
+        {
+            RemoveSessionPump(slot);
+            continue;
+        }
+        if (slot.parked) continue;
+        if (!m_session_pumps[slot.pump_index].fn())
+        {
+            RemoveSessionPump(slot);
+            continue;
+        }
+        if (!slot.parked && !slot.close_requested.load() && HasPendingRead(slot.channel))
+            Kick(ref);
+    }
+    m_pump_round.clear();
+
+    return !m_kicked_slots.empty() || m_scan_left > 0 ||
+           s_io_socket_reads != m_reads_at_scan;
+}
+
+bool SshTransport::HasPendingRead(LIBSSH2_CHANNEL* ch)
 {
-    m_session_pumps.erase(
-        std::remove_if(m_session_pumps.begin(), m_session_pumps.end(),
-            [](auto& fn) { return !fn(); }),
-        m_session_pumps.end());
+    unsigned long read_avail = 0;
+    ::libssh2_channel_window_read_ex(ch, &read_avail, nullptr);
+    return read_avail > 0 || ::libssh2_channel_eof(ch) != 0;
 }
 
-void SshTransport::RemoveChannelWriteQueue(LIBSSH2_CHANNEL* ch)
+void SshTransport::PostChannelWrite(const std::shared_ptr<ChannelSlot>& slot,
+                                    PooledBuffer data)
 {
-    std::lock_guard<std::mutex> lock(m_queues_mutex);
-    m_write_queues.erase(
-        std::remove_if(m_write_queues.begin(), m_write_queues.end(),
-            [ch](const ChannelQueue& q) { return q.channel == ch; }),
-        m_write_queues.end());
+    // Closed channel — discard silently.  A post racing the close is dropped
+    // by FlushChannelWrites instead.
+    if (slot->close_requested.load() || data.empty()) return;
+
+    // Count the bytes before publishing the node so the I/O thread's
+    // decrement can never underflow.  `backlogged` is raised before the
+    // dirty check below, so the flush that picks up this buffer also sees it.
+    size_t pending = slot->pending_bytes.fetch_add(data.size()) + data.size();
+    if (pending > slot->high_mark) slot->backlogged.store(true);
+
+    Slab* node = data.Detach();
+    node->queued_at = QpcNow();
+    slot->writes.Push(node);
+    EnlistDirty(slot);
 }
 
-void SshTransport::PostChannelWrite(LIBSSH2_CHANNEL* ch, std::vector<uint8_t> data)
+void SshTransport::EnlistDirty(const std::shared_ptr<ChannelSlot>& slot)
 {
-    std::lock_guard<std::mutex> lock(m_queues_mutex);
-    for (auto& q : m_write_queues)
+    // Already enlisted: the I/O thread clears `dirty` before it flushes, so
+    // it is guaranteed to see what was posted.
+    if (slot->dirty.exchange(true)) return;
+
+    slot->dirty_ref = slot;
+    ChannelSlot* head = m_dirty_slots.load(std::memory_order_relaxed);
+    do
     {
-        if (q.channel == ch)
-        {
-            q.pending.push_back(std::move(data));
-            return;
-        }
-    }
-    // Channel not registered (was closed and removed) — discard silently.
-    // Never create a new entry here: the channel pointer may already be freed.
+        slot->dirty_next = head;
+    } while (!m_dirty_slots.compare_exchange_weak(head, slot.get(),
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+    Wake();
 }
 
-void SshTransport::RegisterSessionPump(SessionPumpFn fn)
+void SshTransport::RegisterSessionPump(std::shared_ptr<ChannelSlot> slot, SessionPumpFn fn)
 {
     // Called on the SSH I/O thread (from within on_channel) — no mutex needed.
-    m_session_pumps.push_back(std::move(fn));
+    // The first pump runs regardless of readiness.
+    slot->pump_index = m_session_pumps.size();
+    Kick(slot);
+    m_session_pumps.push_back(SessionPump{ std::move(slot), std::move(fn) });
+}
+
+void SshTransport::RemoveSessionPump(ChannelSlot& slot)
+{
+    size_t index = slot.pump_index;
+    slot.pump_index = SIZE_MAX;
+    // Moved out first: destroying the pump may end its session, whose hooks
+    // can call back into Kick.
+    SessionPump removed = std::move(m_session_pumps[index]);
+    if (index + 1 != m_session_pumps.size())
+    {
+        m_session_pumps[index] = std::move(m_session_pumps.back());
+        m_session_pumps[index].slot->pump_index = index;
+        // Moved behind the scan cursor, the pump would miss the pass in
+        // progress — run it next round instead.
+        if (m_scan_left > 0 && index < m_scan_cursor)
+            Kick(m_session_pumps[index].slot);
+    }
+    m_session_pumps.pop_back();
+}
+
+void SshTransport::Kick(const std::shared_ptr<ChannelSlot>& slot)
+{
+    if (slot->kicked) return;
+    slot->kicked = true;
+    m_kicked_slots.push_back(slot);
 }
 
 void SshTransport::PostToIoThread(std::function<void()> fn)
 {
-    std::lock_guard<std::mutex> lock(m_io_callbacks_mutex);
-    m_io_callbacks.push_back(std::move(fn));
+    {
+        std::lock_guard<std::mutex> lock(m_io_callbacks_mutex);
+        m_io_callbacks.push_back(std::move(fn));
+    }
+    Wake();
 }
 
 void SshTransport::Close()
 {
     m_cancel.store(true);
+    Wake();
     if (m_io_thread.joinable())
         m_io_thread.join();
 
     // RAII destructors handle cleanup in correct order:
-    // m_listener destroyed first (forward_cancel), then m_session (disconnect + free),
+    // m_listeners destroyed first (forward_cancel), then m_session (disconnect + free),
     // then m_socket (closesocket).
-    m_listener.reset();
+    m_listeners.clear();
     m_session.reset();   // sends SSH_MSG_DISCONNECT if handshake was completed
     m_socket = WinSocket{};
     m_connected.store(false);
@@ -553,3 +1457,26 @@ bool SshTransport::IsConnected() const
 {
     return m_connected.load();
 }
+
+bool SshTransport::HasLiveChannels() const
+{
+    // Copies are only made on the I/O thread (AdoptChannel), so once the
+    // loop has exited the count can only fall.
+    return m_channel_refs.use_count() > 1;
+}
+
+SshTransport::Stats SshTransport::GetStats() const
+{
+    Stats st;
+    st.channels_accepted  = m_channels_accepted.load(std::memory_order_relaxed);
+    st.channels_open      = m_channels_open.load(std::memory_order_relaxed);
+    st.bytes_received     = m_bytes_received.load(std::memory_order_relaxed);
+    st.bytes_sent         = m_bytes_sent.load(std::memory_order_relaxed);
+    st.loop_iterations    = m_loop_iterations.load(std::memory_order_relaxed);
+    st.eagain_reads       = m_eagain_reads.load(std::memory_order_relaxed);
+    st.eagain_writes      = m_eagain_writes.load(std::memory_order_relaxed);
+    st.drain_write_us     = m_drain_write_us.load(std::memory_order_relaxed);
+    st.drain_write_us_max = m_drain_write_us_max.load(std::memory_order_relaxed);
+    st.rtt_us             = m_rtt_us.load(std::memory_order_relaxed);
+    return st;
+}
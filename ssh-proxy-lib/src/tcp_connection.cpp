@@ -1,37 +1,100 @@
 //////////////////////////////////////////////////////////////////////////////
 //
-// TcpConnection — async TCP connection to SOCKS5 target hosts (IOCP)
+// TcpConnection — async TCP connection to SOCKS5 target hosts
 //
 // PURPOSE
 //   Handles the outbound TCP leg of each SOCKS5 relay: asynchronous DNS,
-//   ConnectEx, a continuous overlapped recv loop, and a serialised send queue —
-//   all driven by the process-wide IOCP via IoEngine.
+//   an async connect, a continuous recv loop, and a serialised send queue —
+//   all driven by IoEngine's Start* operations, so the class is the same on
+//   the IOCP and the epoll backend.  Adopt() runs the same recv/send
+//   machinery over an accepted socket (DirectForward's local side).
 //
-// CONNECTEX REQUIREMENTS
-//   ConnectEx requires the socket to be bound before the call (bound to
-//   INADDR_ANY:0 here).  After the completion fires, SO_UPDATE_CONNECT_CONTEXT
-//   must be set on the socket before normal socket operations can be used.
+// CONNECT REQUIREMENTS
+//   Sockets come from IoEngine::OpenSocket, which prepares them for
+//   StartConnect (for ConnectEx: bound to the family's wildcard address,
+//   port 0).  After a successful completion IoEngine::FinishConnect
+//   (SO_UPDATE_CONNECT_CONTEXT on Windows) must run before normal socket
+//   operations can be used.
 //
-// DNS OFFLOAD
-//   getaddrinfo is blocking.  ConnectAsync posts a work item via
-//   IoEngine::PostCompletion so DNS runs on an IOCP worker thread rather than
-//   the SSH I/O thread.  m_abort is checked before and after getaddrinfo to
-//   handle Close() being called while DNS was in flight.
+// HAPPY EYEBALLS
+//   Every resolved address is tried, IPv6 and IPv4 interleaved (RFC 8305).
+//   A new attempt starts when the previous one fails or has been pending for
+//   kConnectAttemptDelayMs; attempts then race and the first connect to
+//   succeed supplies m_socket.  The losers' sockets are closed, which aborts
+//   their connects.  Attempt contexts live until the connection is
+//   destroyed, since a closed attempt still delivers its completion.
+//
+// ASYNC DNS
+//   ConnectAsync hands the host to DnsResolver (overlapped GetAddrInfoExW
+//   behind a TTL cache), so no thread — neither the SSH I/O thread nor an
+//   IoEngine worker — blocks on resolution.  The result arrives on a
+//   worker; m_abort is checked there to handle Close() being called while
+//   DNS was in flight.
 //
 // SEND SERIALISATION
-//   Only one WSASend is outstanding at a time.  Send() enqueues data and
+//   Only one send is outstanding at a time.  Send() enqueues data and
 //   starts FlushSendQueue() if no send is in progress; OnSendComplete() calls
-//   it again to drain the next entry.  Both call sites hold m_send_mutex.
+//   it again to drain what queued meanwhile.  Both call sites hold
+//   m_send_mutex.  Each StartSend gathers as many queued buffers as the batch
+//   limits allow, and the completion retires exactly `bytes` — so many small
+//   SSH reads cost one syscall and one completion, and a short send resumes
+//   mid-buffer.
+//   Send() is accepted from ConnectAsync onwards: data queued before the
+//   connect completes (a SOCKS client's first flight, sent before it saw our
+//   reply) is flushed by the winning attempt's completion, so it leaves in
+//   the same round trip as the connect instead of one later.
+//
+// HALF-CLOSE
+//   A FIN from the peer ends the recv loop with on_disconnect(Success); the
+//   send side is untouched.  ShutdownSend() is the other direction: the FIN
+//   goes out via shutdown(SD_SEND) only once the send queue has drained
+//   (TakeSendShutdown, checked wherever a flush may have emptied it), so
+//   nothing queued before the half-close is lost.
+//
+// ZERO-COPY BUFFERS
+//   Each recv fills a PooledBuffer (m_recv_buf) whose ownership moves straight
+//   to on_data.  Its size comes from m_recv_sizer: reads start small and grow
+//   towards the configured maximum while the peer keeps filling them.  The
+//   send queue holds the PooledBuffers it was given; a partial send
+//   completion consumes the sent prefix of the front buffer and resends the
+//   rest.
+//
+// FLOW CONTROL
+//   PauseReading() stops the recv loop from reposting; the completion that
+//   observes the pause parks the loop (m_recv_parked) and ResumeReading()
+//   restarts it.  Both sides re-check the other's flag after publishing their
+//   own, so exactly one of them reposts no matter how they interleave.
+//   The send queue counts its bytes; crossing the high watermark raises
+//   m_send_backlogged and draining to the low watermark fires on_drained.
+//
+// SEND FAILURE
+//   A send that fails to start or completes with an error ends the send side
+//   for good (FailSends): the queue goes back to the pool, its depth and
+//   m_send_backlogged are reset, later Send() calls return the error, and
+//   on_disconnect gets it from a posted work item — the session learns of
+//   the failure even when the recv side stays quiet.  Whichever direction
+//   fails first reports; no second error and no FIN follow it.
+//
+// WARM AND RECYCLED SOCKETS
+//   ConnectAsync first asks WarmSockets for a pre-connected socket to the
+//   destination; with one, no DNS or connect happens and on_connected
+//   fires from a posted work item.  Connect attempts take a recycled socket
+//   (DisconnectEx'd, still bound and associated) before creating one.
 //
 // CLOSE SEQUENCE
-//   CancelIoEx cancels all pending overlapped operations; each completion
-//   arrives with ERROR_OPERATION_ABORTED (mapped to ErrorCode::Shutdown).
-//   shutdown(SD_BOTH) + closesocket follow to release the socket handle.
+//   IoEngine::CancelIo aborts all pending operations; each completion
+//   arrives with ErrorCode::Shutdown.  shutdown(SD_BOTH) +
+//   IoEngine::CloseSocket follow to release the socket handle — unless
+//   socket recycling takes a socket we connected, in which case
+//   DisconnectEx closes the connection instead.
 //
 //////////////////////////////////////////////////////////////////////////////
 
 #include "tcp_connection.h"
+#include "dns_resolver.h"
 #include "logger.h"
+#include "instrumentation.h"
+#include "warm_sockets.h"
 #include <cstring>
 
 TcpConnection::TcpConnection()
@@ -47,9 +110,11 @@ TcpConnection::~TcpConnection()
 //
 // ── ConnectAsync ──────────────────────────────────────────────────────────────
 //
-// Initiates an async connect.  DNS resolution is blocking, so this posts a
-// work item to an IOCP worker thread (DoConnectOnWorkerThread) rather than
-// resolving inline, which would block the SSH I/O thread.
+// Initiates an async connect.  Resolution goes through DnsResolver, which
+// never blocks a thread (cache hit or overlapped GetAddrInfoExW) and delivers
+// its result on a worker thread, where socket setup and the connect follow.
+// An address literal takes the ResolvedAddress overload and skips the
+// resolver altogether.
 //
 
 void TcpConnection::ConnectAsync(const std::string& host, uint16_t port,
@@ -57,151 +122,373 @@ void TcpConnection::ConnectAsync(const std::string& host, uint16_t port,
 {
     m_on_connected = std::move(on_connected);
 
-    // Post DNS + socket setup as a work item on an IOCP worker thread so the
-    // SSH I/O thread is not blocked by getaddrinfo.
-    ::ZeroMemory(static_cast<OVERLAPPED*>(&m_dns_ctx), sizeof(OVERLAPPED));
-    m_dns_ctx.op = IoOp::Work;
-    m_dns_ctx.callback = [self = shared_from_this(), host, port]
-                         (IoContext*, DWORD, ErrorCode) mutable
+    if (!m_warmup)
     {
-        self->DoConnectOnWorkerThread(std::move(host), port);
-    };
-    IoEngine::PostCompletion(&m_dns_ctx);
+        int family = AF_UNSPEC;
+        SOCKET warm = WarmSockets::Take(host, port, family);
+        if (warm != INVALID_SOCKET) { UseWarmSocket(warm, family); return; }
+    }
+
+    DnsResolver::Resolve(host,
+        [self = shared_from_this(), host, port, started = QpcNow()]
+        (ErrorCode ec, std::shared_ptr<const AddressList> addresses)
+        {
+            Instrumentation::RecordLatency(LatencyPoint::DnsResolve,
+                                           QpcToUs(QpcNow() - started));
+            self->OnResolved(host, port, ec, std::move(addresses));
+        });
+}
+
+// No lookup, but socket setup still runs on a worker just as after a
+// resolve — the caller is typically the SSH I/O thread.
+void TcpConnection::ConnectAsync(const ResolvedAddress& target, OnConnected on_connected)
+{
+    m_on_connected = std::move(on_connected);
+
+    if (!m_warmup)
+    {
+        int family = AF_UNSPEC;
+        SOCKET warm = WarmSockets::Take(target, family);
+        if (warm != INVALID_SOCKET) { UseWarmSocket(warm, family); return; }
+    }
+
+    // The address waits in m_targets, so the work item captures no more
+    // than the connection.
+    {
+        std::lock_guard<std::mutex> lock(m_connect_mutex);
+        m_targets.assign(1, target);
+    }
+    IoEngine::PostWork([self = shared_from_this()]()
+    {
+        if (self->m_abort.load())
+        {
+            if (self->m_on_connected) self->m_on_connected(ErrorCode::Shutdown);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(self->m_connect_mutex);
+        if (self->StartNextAttempt())
+        {
+            lock.unlock();
+            if (self->m_on_connected) self->m_on_connected(self->m_connect_error);
+        }
+    });
+}
+
+// Still asynchronous, like every other connect outcome.  Close() racing
+// the hand-off is caught by m_abort under m_connect_mutex, as for a
+// winning connect.
+void TcpConnection::UseWarmSocket(SOCKET warm, int family)
+{
+    IoEngine::PostWork([self = shared_from_this(), warm, family]()
+    {
+        bool adopted = false;
+        {
+            std::lock_guard<std::mutex> lock(self->m_connect_mutex);
+            if (!self->m_abort.load())
+            {
+                self->m_connect_done  = true;
+                self->m_socket        = warm;
+                self->m_family        = family;
+                self->m_recyclable    = true;
+                self->m_connect_error = ErrorCode::Success;
+                self->m_connected.store(true);
+                adopted = true;
+            }
+        }
+        if (!adopted)
+        {
+            IoEngine::CloseSocket(warm);
+            if (self->m_on_connected) self->m_on_connected(ErrorCode::Shutdown);
+            return;
+        }
+        Logger::Debug("Target connected (warm socket %llu)",
+                      static_cast<unsigned long long>(warm));
+        self->FlushAfterConnect();
+        if (self->m_on_connected) self->m_on_connected(ErrorCode::Success);
+    });
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //
-// DoConnectOnWorkerThread
+// OnResolved
 //
-// Runs on an IOCP worker thread.  Performs the blocking DNS resolve, creates
-// and binds the socket (ConnectEx requires a pre-bound socket), associates it
-// with the IOCP, then fires ConnectEx to initiate the async connect.
+// Runs on a worker thread once DnsResolver has an answer.  Orders the
+// addresses for the happy-eyeballs race (RFC 8305 section 4): the family of
+// the resolver's first answer leads, then families alternate, so a broken
+// IPv6 path costs one attempt delay rather than a full connect timeout.
 //
-// m_abort is checked after getaddrinfo: if Close() was called while DNS was
-// in flight the result is discarded and the on_connected callback gets
+// m_abort is checked first: if Close() was called while DNS was in flight
+// the result is discarded and the on_connected callback gets
 // ErrorCode::Shutdown instead of proceeding with a socket that will be
 // immediately closed.
 //
 //////////////////////////////////////////////////////////////////////////////
 
-void TcpConnection::DoConnectOnWorkerThread(std::string host, uint16_t port)
+void TcpConnection::OnResolved(const std::string& host, uint16_t port, ErrorCode dns_ec,
+                               std::shared_ptr<const AddressList> addresses)
 {
-    // Guard against Close() being called before this work item was processed.
     if (m_abort.load())
     {
         if (m_on_connected) m_on_connected(ErrorCode::Shutdown);
         return;
     }
-
-    // DNS resolve (blocking, but on an IOCP worker thread — not the SSH I/O thread)
-    struct addrinfo hints{}, *result = nullptr;
-    hints.ai_family   = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_protocol = IPPROTO_TCP;
-
-    char port_str[8];
-    ::sprintf_s(port_str, "%u", port);
-
-    int ret = ::getaddrinfo(host.c_str(), port_str, &hints, &result);
-    if (ret != 0 || result == nullptr)
+    if (dns_ec != ErrorCode::Success || !addresses || addresses->empty())
     {
-        Logger::Warn("DNS resolve failed for %s: %d", host.c_str(), ret);
         if (m_on_connected) m_on_connected(ErrorCode::DnsResolutionFailed);
         return;
     }
 
-    if (m_abort.load())
+    int lead = addresses->front().family();
+    std::vector<ResolvedAddress> first, second;
+    for (const auto& ra : *addresses)
+        (ra.family() == lead ? first : second).push_back(ra);
+
+    std::unique_lock<std::mutex> lock(m_connect_mutex);
+    m_targets.reserve(addresses->size());
+    for (size_t i = 0; i < first.size() || i < second.size(); ++i)
     {
-        ::freeaddrinfo(result);
-        if (m_on_connected) m_on_connected(ErrorCode::Shutdown);
-        return;
+        if (i < first.size())  m_targets.push_back(first[i]);
+        if (i < second.size()) m_targets.push_back(second[i]);
+    }
+    for (auto& ra : m_targets)
+    {
+        if (ra.family() == AF_INET6)
+            reinterpret_cast<sockaddr_in6*>(&ra.addr)->sin6_port = ::htons(port);
+        else
+            reinterpret_cast<sockaddr_in*>(&ra.addr)->sin_port = ::htons(port);
     }
 
-    struct addrinfo* addr = result;
-    m_socket = ::WSASocketW(addr->ai_family, SOCK_STREAM, IPPROTO_TCP,
-                            nullptr, 0, WSA_FLAG_OVERLAPPED);
-    if (m_socket == INVALID_SOCKET)
+    Logger::Debug("Connecting to %s:%u (%zu addresses)", host.c_str(),
+                  static_cast<unsigned>(port), m_targets.size());
+    if (StartNextAttempt())
     {
-        ::freeaddrinfo(result);
-        if (m_on_connected) m_on_connected(ErrorCode::SocketError);
-        return;
+        lock.unlock();
+        if (m_on_connected) m_on_connected(m_connect_error);
     }
+}
 
-    // ConnectEx requires the socket to be bound
-    struct sockaddr_in bind_addr{};
-    bind_addr.sin_family      = AF_INET;
-    bind_addr.sin_addr.s_addr = INADDR_ANY;
-    bind_addr.sin_port        = 0;
+//////////////////////////////////////////////////////////////////////////////
+//
+// StartNextAttempt
+//
+// Takes a recycled socket of the next target's family, or opens a new one
+// through IoEngine, then starts the connect.  An address that fails
+// synchronously is skipped straight away.  Once an attempt is pending
+// a timer is armed for kConnectAttemptDelayMs; if it is still the newest
+// attempt when the timer fires, the next address joins the race.
+//
+// Returns true when no attempt is pending and no address is left: the
+// CONNECT has failed, and the caller delivers m_connect_error to
+// on_connected once it has released m_connect_mutex.  Close() racing with
+// this loop is caught by the m_abort check under the same lock.
+//
+//////////////////////////////////////////////////////////////////////////////
 
-    if (::bind(m_socket, reinterpret_cast<struct sockaddr*>(&bind_addr),
-               sizeof(bind_addr)) != 0)
+bool TcpConnection::StartNextAttempt()
+{
+    while (!m_connect_done && !m_abort.load() && m_next_target < m_targets.size())
     {
-        Logger::Error("bind failed: %d", ::WSAGetLastError());
-        ::closesocket(m_socket);
-        m_socket = INVALID_SOCKET;
-        ::freeaddrinfo(result);
-        if (m_on_connected) m_on_connected(ErrorCode::SocketError);
-        return;
+        auto attempt = std::make_unique<ConnectAttempt>();
+        attempt->target = m_targets[m_next_target++];
+        int family = attempt->target.family();
+
+        attempt->socket = WarmSockets::TakeRecycled(family);
+        if (attempt->socket == INVALID_SOCKET)
+            attempt->socket = OpenConnectSocket(family, m_connect_error);
+        if (attempt->socket == INVALID_SOCKET)
+            continue;
+
+        // Initiate async connect
+        ConnectAttempt* raw = attempt.get();
+        raw->ctx.op     = IoOp::Connect;
+        raw->ctx.socket = raw->socket;
+        raw->ctx.callback = [self = shared_from_this(), raw]
+                            (IoContext*, DWORD, ErrorCode ec2)
+        {
+            self->OnAttemptComplete(raw, ec2);
+        };
+
+        raw->started = QpcNow();
+        ErrorCode started = IoEngine::StartConnect(&raw->ctx,
+            reinterpret_cast<const struct sockaddr*>(&raw->target.addr), raw->target.len);
+        if (started != ErrorCode::Success)
+        {
+            Logger::Debug("Connect failed to start: %s", ErrorCodeToString(started));
+            raw->ctx.callback = nullptr;  // release shared_ptr
+            IoEngine::CloseSocket(raw->socket);
+            m_connect_error = started;
+            continue;
+        }
+
+        m_attempts.push_back(std::move(attempt));
+        ++m_attempts_pending;
+        if (m_next_target < m_targets.size())
+        {
+            size_t attempts_at_schedule = m_attempts.size();
+            IoEngine::PostWorkAfter(kConnectAttemptDelayMs,
+                [self = shared_from_this(), attempts_at_schedule]()
+                { self->OnAttemptDelay(attempts_at_schedule); });
+        }
+        return false;
     }
 
-    // Associate with IOCP
-    ErrorCode ec = IoEngine::Associate(m_socket);
-    if (ec != ErrorCode::Success)
-    {
-        ::closesocket(m_socket);
-        m_socket = INVALID_SOCKET;
-        ::freeaddrinfo(result);
-        if (m_on_connected) m_on_connected(ec);
+    if (m_connect_done || m_attempts_pending > 0) return false;
+
+    m_connect_done = true;
+    if (m_abort.load())
+        m_connect_error = ErrorCode::Shutdown;
+    else
+        Logger::Error("Connect failed: %s", ErrorCodeToString(m_connect_error));
+    return true;
+}
+
+SOCKET TcpConnection::OpenConnectSocket(int family, ErrorCode& error)
+{
+    SOCKET s = IoEngine::OpenSocket(family, error);
+    if (s == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    // Disable Nagle (a recycled socket keeps the option)
+    int nodelay = 1;
+    ::setsockopt(s, IPPROTO_TCP, TCP_NODELAY,
+                 reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+    return s;
+}
+
+// The stagger timer for the attempt that made m_attempts this long.  A newer
+// attempt (started because that one failed early) supersedes it.
+void TcpConnection::OnAttemptDelay(size_t attempts_at_schedule)
+{
+    std::unique_lock<std::mutex> lock(m_connect_mutex);
+    if (m_connect_done || m_attempts.size() != attempts_at_schedule)
         return;
+    if (StartNextAttempt())
+    {
+        lock.unlock();
+        if (m_on_connected) m_on_connected(m_connect_error);
     }
+}
 
-    // Disable Nagle
-    BOOL nodelay = TRUE;
-    ::setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY,
-                 reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+//
+// ── OnAttemptComplete ─────────────────────────────────────────────────────────
+//
+// First success wins: its socket becomes m_socket and every other attempt is
+// closed, which aborts its connect (that completion arrives here too and is
+// ignored).  A failure starts the next address immediately rather than
+// waiting out the attempt delay.
+//
 
-    // Initiate async connect
-    ::ZeroMemory(static_cast<OVERLAPPED*>(&m_connect_ctx), sizeof(OVERLAPPED));
-    m_connect_ctx.op     = IoOp::Connect;
-    m_connect_ctx.socket = m_socket;
-    m_connect_ctx.callback = [self = shared_from_this()]
-                              (IoContext*, DWORD, ErrorCode ec2)
+void TcpConnection::OnAttemptComplete(ConnectAttempt* attempt, ErrorCode ec)
+{
     {
-        if (ec2 == ErrorCode::Success)
+        std::lock_guard<std::mutex> lock(m_connect_mutex);
+        --m_attempts_pending;
+
+        // An attempt that lost the race completes when CloseAttempts aborts
+        // it — that is not a connect time, so only the open race is timed.
+        if (!m_connect_done)
+            Instrumentation::RecordLatency(LatencyPoint::TcpConnect,
+                                           QpcToUs(QpcNow() - attempt->started));
+
+        if (ec != ErrorCode::Success || m_connect_done || m_abort.load())
         {
-            ::setsockopt(self->m_socket, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT,
-                         nullptr, 0);
-            self->m_connected.store(true);
-            Logger::Debug("Target connected (socket %llu)",
-                          static_cast<unsigned long long>(self->m_socket));
+            if (attempt->socket != INVALID_SOCKET)
+            {
+                IoEngine::CloseSocket(attempt->socket);
+                attempt->socket = INVALID_SOCKET;
+            }
+            if (m_connect_done) return;   // lost the race
+            if (ec != ErrorCode::Success)
+            {
+                Logger::Debug("Connect attempt failed: %s", ErrorCodeToString(ec));
+                m_connect_error = ec;
+            }
+            if (!StartNextAttempt()) return;
         }
-        if (self->m_on_connected) self->m_on_connected(ec2);
-    };
+        else
+        {
+            m_connect_done = true;
+            m_socket = attempt->socket;
+            m_family = attempt->target.family();
+            m_recyclable = true;
+            attempt->socket = INVALID_SOCKET;
+            CloseAttempts(attempt);
+            IoEngine::FinishConnect(m_socket);
+            m_connected.store(true);
+            m_connect_error = ErrorCode::Success;
+            Logger::Debug("Target connected (socket %llu, %s)",
+                          static_cast<unsigned long long>(m_socket),
+                          attempt->target.family() == AF_INET6 ? "IPv6" : "IPv4");
+        }
+    }
 
-    LPFN_CONNECTEX connect_ex = IoEngine::GetConnectEx();
-    BOOL ok = connect_ex(m_socket, addr->ai_addr,
-                         static_cast<int>(addr->ai_addrlen),
-                         nullptr, 0, nullptr, &m_connect_ctx);
-    ::freeaddrinfo(result);
+    if (m_connect_error == ErrorCode::Success) FlushAfterConnect();
 
-    if (!ok)
+    if (m_on_connected) m_on_connected(m_connect_error);
+}
+
+// Data (and a half-close) queued while connecting goes out first.
+void TcpConnection::FlushAfterConnect()
+{
+    ErrorCode shutdown_ec = ErrorCode::Success;
+    OnSendShutdown on_shutdown;
     {
-        int err = ::WSAGetLastError();
-        if (err != ERROR_IO_PENDING)
-        {
-            Logger::Error("ConnectEx failed: %d", err);
-            m_connect_ctx.callback = nullptr;  // release shared_ptr
-            ::closesocket(m_socket);
-            m_socket = INVALID_SOCKET;
-            if (m_on_connected) m_on_connected(WsaToErrorCode(err));
-        }
+        std::lock_guard<std::mutex> lock(m_send_mutex);
+        if (!m_send_in_progress) FlushSendQueue();
+        on_shutdown = TakeSendShutdown(shutdown_ec);
     }
+    if (on_shutdown) on_shutdown(shutdown_ec);
+}
+
+void TcpConnection::CloseAttempts(const ConnectAttempt* keep)
+{
+    for (auto& a : m_attempts)
+    {
+        if (a.get() == keep || a->socket == INVALID_SOCKET) continue;
+        IoEngine::CloseSocket(a->socket);
+        a->socket = INVALID_SOCKET;
+    }
+}
+
+//
+// ── Adopt ─────────────────────────────────────────────────────────────────────
+//
+// The accepted-socket counterpart of a successful connect: no DNS, no
+// attempts — the socket becomes m_socket directly.
+//
+
+ErrorCode TcpConnection::Adopt(SOCKET connected)
+{
+    if (IoEngine::Associate(connected) != ErrorCode::Success)
+    {
+        ::closesocket(connected);
+        return ErrorCode::SocketError;
+    }
+
+    int nodelay = 1;
+    ::setsockopt(connected, IPPROTO_TCP, TCP_NODELAY,
+                 reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+
+    m_socket = connected;
+    m_connected.store(true);
+    return ErrorCode::Success;
 }
 
 void TcpConnection::StartReading(OnDataReceived on_data, OnDisconnected on_disconnect)
 {
-    m_on_data       = std::move(on_data);
-    m_on_disconnect = std::move(on_disconnect);
+    ErrorCode send_error;
+    {
+        // Under m_send_mutex so FailSends sees either no callback or this one.
+        std::lock_guard<std::mutex> lock(m_send_mutex);
+        m_on_data       = std::move(on_data);
+        m_on_disconnect = std::move(on_disconnect);
+        send_error      = m_send_error;
+    }
+    if (send_error != ErrorCode::Success)
+    {
+        PostSendFailure(send_error);   // failed before anyone listened
+        return;
+    }
     m_reading.store(true);
     PostRecv();
 }
@@ -209,92 +496,175 @@ void TcpConnection::StartReading(OnDataReceived on_data, OnDisconnected on_disco
 //
 // ── PostRecv ──────────────────────────────────────────────────────────────────
 //
-// Issues one overlapped WSARecv into m_recv_ctx.inline_buf.  The completion
-// callback (OnRecvComplete) delivers the data then re-issues PostRecv to keep
-// the recv loop running for the lifetime of the connection.
+// Starts one recv into a fresh pooled buffer.  The completion
+// callback (OnRecvComplete) hands the buffer on, then re-issues PostRecv to
+// keep the recv loop running for the lifetime of the connection.
 //
 
 void TcpConnection::PostRecv()
 {
     if (!m_connected.load() || !m_reading.load()) return;
 
-    ::ZeroMemory(static_cast<OVERLAPPED*>(&m_recv_ctx), sizeof(OVERLAPPED));
+    size_t want = m_recv_sizer.Next();
+    m_recv_buf = BufferPool::Acquire(want);
+
     m_recv_ctx.op            = IoOp::Recv;
     m_recv_ctx.socket        = m_socket;
-    m_recv_ctx.wsa_buf.buf   = reinterpret_cast<char*>(m_recv_ctx.inline_buf);
-    m_recv_ctx.wsa_buf.len   = sizeof(m_recv_ctx.inline_buf);
+    m_recv_ctx.buffer        = MakeIoBuffer(m_recv_buf.tail(),
+                                            (std::min)(want, m_recv_buf.tailroom()));
     m_recv_ctx.callback = [self = shared_from_this()](IoContext* ctx, DWORD bytes,
                                                        ErrorCode ec)
     {
         self->OnRecvComplete(ctx, bytes, ec);
     };
 
-    DWORD flags = 0;
-    int ret = ::WSARecv(m_socket, &m_recv_ctx.wsa_buf, 1, nullptr, &flags,
-                        &m_recv_ctx, nullptr);
-    if (ret == SOCKET_ERROR)
+    ErrorCode started = IoEngine::StartRecv(&m_recv_ctx);
+    if (started != ErrorCode::Success)
     {
-        int err = ::WSAGetLastError();
-        if (err != WSA_IO_PENDING)
-        {
-            Logger::Debug("WSARecv on target failed: %d", err);
-            m_reading.store(false);
-            if (m_on_disconnect) m_on_disconnect(WsaToErrorCode(err));
-        }
+        Logger::Debug("Recv on target failed: %s", ErrorCodeToString(started));
+        m_recv_ctx.callback = nullptr;  // release shared_ptr
+        m_reading.store(false);
+        NotifyDisconnect(started);
     }
 }
 
 //
 // ── OnRecvComplete ────────────────────────────────────────────────────────────
 //
-// IOCP completion for WSARecv.  Zero bytes with Success signals a graceful
-// TCP close; the on_disconnect callback receives ConnectionReset to let the
-// session close both sides cleanly.
+// Completion of the recv.  Zero bytes with Success is the peer's FIN:
+// on_disconnect receives Success, and the session decides whether the other
+// direction carries on (half-close).
 //
 
 void TcpConnection::OnRecvComplete(IoContext* /*ctx*/, DWORD bytes, ErrorCode ec)
 {
     if (ec != ErrorCode::Success || bytes == 0)
     {
+        m_recv_buf.Reset();
         m_reading.store(false);
-        if (m_on_disconnect)
-            m_on_disconnect(ec == ErrorCode::Success ? ErrorCode::ConnectionReset : ec);
+        NotifyDisconnect(ec);
         return;
     }
 
+    m_recv_sizer.Record(bytes);
+    m_recv_buf.Commit(bytes);
     if (m_on_data)
     {
-        m_on_data(m_recv_ctx.inline_buf, bytes);
+        m_on_data(std::move(m_recv_buf));
     }
+    m_recv_buf.Reset();
+
+    if (!m_reading.load()) return;
 
-    if (m_reading.load())
+    if (m_recv_paused.load())
     {
-        PostRecv();
+        m_recv_parked.store(true);
+        // ResumeReading may have run between the two stores — if it did not
+        // see the park, it is ours to undo.
+        if (m_recv_paused.load() || !m_recv_parked.exchange(false)) return;
     }
+    PostRecv();
+}
+
+void TcpConnection::SetRecvSizeLimits(size_t min_bytes, size_t max_bytes)
+{
+    m_recv_sizer = RecvSizer(min_bytes, max_bytes);
+}
+
+void TcpConnection::PauseReading()
+{
+    m_recv_paused.store(true);
+}
+
+void TcpConnection::ResumeReading()
+{
+    m_recv_paused.store(false);
+    if (m_recv_parked.exchange(false))
+        PostRecv();
 }
 
 //
 // ── Send ──────────────────────────────────────────────────────────────────────
 //
-// Thread-safe enqueue.  Copies data into the send queue and starts
-// FlushSendQueue() if no WSASend is currently outstanding.  Called from
-// IOCP worker threads (TCP→SSH relay callback) and the SSH I/O thread.
+// Thread-safe enqueue.  Queues the buffer and starts FlushSendQueue() if no
+// send is currently outstanding.  Called from IoEngine worker threads and the
+// SSH I/O thread (SSH→TCP relay).  Before the connect has completed the
+// buffer only queues; OnAttemptComplete starts the flush.
 //
 
 ErrorCode TcpConnection::Send(const uint8_t* data, size_t len)
 {
-    if (!m_connected.load()) return ErrorCode::ConnectionReset;
+    return Send(BufferPool::CopyOf(data, len));
+}
+
+ErrorCode TcpConnection::Send(PooledBuffer data)
+{
+    if (m_abort.load()) return ErrorCode::ConnectionReset;
+    if (data.empty()) return ErrorCode::Success;
 
+    size_t len = data.size();
     std::unique_lock<std::mutex> lock(m_send_mutex);
-    m_send_queue.push(ByteBuffer(data, data + len));
-    if (!m_send_in_progress)
+    if (m_send_shutdown) return ErrorCode::ConnectionReset;
+    if (m_send_error != ErrorCode::Success) return m_send_error;
+    m_send_queue.push_back(std::move(data));
+    m_send_queued_bytes += len;
+    m_send_queued_depth.store(m_send_queued_bytes, std::memory_order_relaxed);
+    if (m_send_queued_bytes > m_send_high_mark) m_send_backlogged.store(true);
+    // m_connected is published before OnAttemptComplete takes this lock, so
+    // either this call or that one starts the flush.
+    if (!m_send_in_progress && m_connected.load())
         FlushSendQueue();  // called with lock held
     return ErrorCode::Success;
 }
 
+//
+// ── ShutdownSend ──────────────────────────────────────────────────────────────
+//
+// Records the request; the FIN itself waits in TakeSendShutdown until the
+// queue is empty and the connect has completed.
+//
+
+void TcpConnection::ShutdownSend(OnSendShutdown on_done)
+{
+    ErrorCode result = ErrorCode::Success;
+    OnSendShutdown ready;
+    {
+        std::lock_guard<std::mutex> lock(m_send_mutex);
+        if (m_send_shutdown || m_abort.load()) return;
+        m_send_shutdown    = true;
+        m_on_send_shutdown = std::move(on_done);
+        ready = TakeSendShutdown(result);
+    }
+    if (ready) ready(result);
+}
+
+TcpConnection::OnSendShutdown TcpConnection::TakeSendShutdown(ErrorCode& result)
+{
+    // Must be called with m_send_mutex held
+    if (!m_on_send_shutdown) return {};
+
+    result = m_send_error;
+    if (result == ErrorCode::Success)
+    {
+        if (!m_connected.load() || m_send_in_progress || !m_send_queue.empty()) return {};
+        if (::shutdown(m_socket, SD_SEND) == SOCKET_ERROR)
+            result = SocketErrorToErrorCode(LastSocketError());
+    }
+    return std::move(m_on_send_shutdown);
+}
+
+//
+// ── FlushSendQueue ────────────────────────────────────────────────────────────
+//
+// Gathers the queued buffers, front first, into one multi-buffer StartSend —
+// up to m_send_batch_segments buffers and m_send_batch_bytes bytes (the
+// front buffer always goes, even if it alone exceeds the byte cap).  A
+// single completion then retires the whole batch.
+//
+
 void TcpConnection::FlushSendQueue()
 {
-    // Must be called with m_send_cs held
+    // Must be called with m_send_mutex held
     if (m_send_queue.empty())
     {
         m_send_in_progress = false;
@@ -302,50 +672,135 @@ void TcpConnection::FlushSendQueue()
     }
 
     m_send_in_progress = true;
-    ByteBuffer& front = m_send_queue.front();
 
-    ::ZeroMemory(static_cast<OVERLAPPED*>(&m_send_ctx), sizeof(OVERLAPPED));
+    m_send_bufs.clear();
+    size_t batch_bytes = 0;
+    for (PooledBuffer& buf : m_send_queue)
+    {
+        if (m_send_bufs.size() >= m_send_batch_segments) break;
+        if (!m_send_bufs.empty() && batch_bytes + buf.size() > m_send_batch_bytes) break;
+        m_send_bufs.push_back(MakeIoBuffer(buf.data(), buf.size()));
+        batch_bytes += buf.size();
+    }
+
     m_send_ctx.op            = IoOp::Send;
     m_send_ctx.socket        = m_socket;
-    m_send_ctx.wsa_buf.buf   = reinterpret_cast<char*>(front.data());
-    m_send_ctx.wsa_buf.len   = static_cast<ULONG>(front.size());
     m_send_ctx.callback = [self = shared_from_this()](IoContext* ctx, DWORD bytes,
                                                        ErrorCode ec)
     {
         self->OnSendComplete(ctx, bytes, ec);
     };
 
-    int ret = ::WSASend(m_socket, &m_send_ctx.wsa_buf, 1, nullptr, 0,
-                        &m_send_ctx, nullptr);
-    if (ret == SOCKET_ERROR)
+    ErrorCode started = IoEngine::StartSend(&m_send_ctx, m_send_bufs.data(), m_send_bufs.size());
+    if (started != ErrorCode::Success)
     {
-        int err = ::WSAGetLastError();
-        if (err != WSA_IO_PENDING)
-        {
-            Logger::Debug("WSASend on target failed: %d", err);
-            m_send_in_progress = false;
-        }
+        Logger::Debug("Send on target failed: %s", ErrorCodeToString(started));
+        m_send_ctx.callback = nullptr;  // release shared_ptr
+        FailSends(started);
     }
 }
 
-void TcpConnection::OnSendComplete(IoContext* /*ctx*/, DWORD /*bytes*/, ErrorCode ec)
+//
+// ── FailSends ─────────────────────────────────────────────────────────────────
+//
+// Called with m_send_mutex held.  The first error drops everything queued
+// and is posted to on_disconnect; a later one (the queue is empty by then)
+// only clears the in-progress flag.
+//
+
+void TcpConnection::FailSends(ErrorCode ec)
 {
-    std::unique_lock<std::mutex> lock(m_send_mutex);
-    if (!m_send_queue.empty())
-        m_send_queue.pop();
-    if (ec != ErrorCode::Success)
+    m_send_in_progress = false;
+    if (m_send_error != ErrorCode::Success) return;
+
+    m_send_error = ec;
+    m_send_queue.clear();
+    m_send_queued_bytes = 0;
+    m_send_queued_depth.store(0, std::memory_order_relaxed);
+    m_send_backlogged.store(false);
+    if (m_on_disconnect) PostSendFailure(ec);
+}
+
+void TcpConnection::PostSendFailure(ErrorCode ec)
+{
+    // Posted: Send() runs on the SSH I/O thread inside the session's relay,
+    // which must not see the session close under it.
+    IoEngine::PostWork([self = shared_from_this(), ec]()
     {
-        m_send_in_progress = false;
-        return;
+        if (!self->m_abort.load()) self->NotifyDisconnect(ec);
+    });
+}
+
+// One error reaches on_disconnect, from whichever direction failed first;
+// a FIN that arrives after it is not reported either.
+void TcpConnection::NotifyDisconnect(ErrorCode ec)
+{
+    bool failed = ec == ErrorCode::Success ? m_disconnect_failed.load()
+                                           : m_disconnect_failed.exchange(true);
+    if (failed || !m_on_disconnect) return;
+    m_on_disconnect(ec);
+}
+
+void TcpConnection::SetSendBatchLimits(size_t max_bytes, size_t max_segments)
+{
+    std::lock_guard<std::mutex> lock(m_send_mutex);
+    m_send_batch_bytes    = max_bytes;
+    m_send_batch_segments = (std::max)(max_segments, size_t{1});
+    m_send_bufs.reserve(m_send_batch_segments);
+}
+
+void TcpConnection::SetSendWatermarks(size_t high, size_t low,
+                                      std::function<void()> on_drained)
+{
+    std::lock_guard<std::mutex> lock(m_send_mutex);
+    m_send_high_mark  = high;
+    m_send_low_mark   = low;
+    m_on_send_drained = std::move(on_drained);
+}
+
+void TcpConnection::OnSendComplete(IoContext* /*ctx*/, DWORD bytes, ErrorCode ec)
+{
+    bool drained = false;
+    ErrorCode shutdown_ec = ErrorCode::Success;
+    OnSendShutdown on_shutdown;
+    {
+        std::unique_lock<std::mutex> lock(m_send_mutex);
+        // Retire what the kernel took — possibly several whole buffers plus
+        // a prefix of the next one, which stays at the front for the resend.
+        size_t sent = (std::min)(static_cast<size_t>(bytes), m_send_queued_bytes);
+        m_send_queued_bytes -= sent;
+        m_send_queued_depth.store(m_send_queued_bytes, std::memory_order_relaxed);
+        while (sent > 0 && !m_send_queue.empty())
+        {
+            PooledBuffer& front = m_send_queue.front();
+            size_t n = (std::min)(sent, front.size());
+            front.Consume(n);
+            sent -= n;
+            if (front.empty()) m_send_queue.pop_front();
+        }
+        if (ec != ErrorCode::Success)
+        {
+            FailSends(ec);
+        }
+        else
+        {
+            if (m_send_queued_bytes <= m_send_low_mark)
+                drained = m_send_backlogged.exchange(false);
+            FlushSendQueue();  // called with lock held
+        }
+        on_shutdown = TakeSendShutdown(shutdown_ec);
     }
-    FlushSendQueue();  // called with lock held
+
+    // Outside the lock: the callbacks typically marshal to the SSH I/O thread.
+    if (drained && m_on_send_drained) m_on_send_drained();
+    if (on_shutdown) on_shutdown(shutdown_ec);
 }
 
 //
 // ── Close ─────────────────────────────────────────────────────────────────────
 //
 // Sets the abort/connected/reading flags first so any in-flight callbacks see
-// a closed state before CancelIoEx fires their completions.  The send queue
+// a closed state before IoEngine::CancelIo fires their completions.  The send queue
 // is drained under m_send_mutex to release any pending ByteBuffer memory.
 //
 
@@ -355,15 +810,45 @@ void TcpConnection::Close()
     m_connected.store(false);
     m_reading.store(false);
 
+    {
+        // Aborts any connect still racing; OnAttemptComplete reports Shutdown.
+        std::lock_guard<std::mutex> lock(m_connect_mutex);
+        CloseAttempts(nullptr);
+    }
+
     if (m_socket != INVALID_SOCKET)
     {
-        ::CancelIoEx(reinterpret_cast<HANDLE>(m_socket), nullptr);
-        ::shutdown(m_socket, SD_BOTH);
-        ::closesocket(m_socket);
+        IoEngine::CancelIo(m_socket);
+        if (!m_recyclable || !WarmSockets::Recycle(m_socket, m_family))
+        {
+            ::shutdown(m_socket, SD_BOTH);
+            IoEngine::CloseSocket(m_socket);
+        }
         m_socket = INVALID_SOCKET;
     }
 
     std::lock_guard<std::mutex> lock(m_send_mutex);
-    while (!m_send_queue.empty()) m_send_queue.pop();
-    m_send_in_progress = false;
+    m_send_queue.clear();
+    m_send_queued_bytes = 0;
+    m_send_queued_depth.store(0, std::memory_order_relaxed);
+    m_send_in_progress  = false;
+    m_on_send_shutdown  = nullptr;
+}
+
+//
+// ── Detach ────────────────────────────────────────────────────────────────────
+//
+// Only for a WarmSockets pre-connect, from its on_connected: nothing was
+// ever read or queued, so there is no I/O to cancel.
+//
+
+SOCKET TcpConnection::Detach(int& family)
+{
+    std::lock_guard<std::mutex> lock(m_connect_mutex);
+    m_abort.store(true);
+    m_connected.store(false);
+    SOCKET s = m_socket;
+    family   = m_family;
+    m_socket = INVALID_SOCKET;
+    return s;
 }
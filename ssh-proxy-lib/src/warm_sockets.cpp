@@ -0,0 +1,474 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// WarmSockets — pre-connected and recycled target sockets
+//
+// PURPOSE
+//   Clients such as health checkers open the same host:port hundreds of
+//   times a minute.  Each CONNECT otherwise pays for DNS, socket creation,
+//   bind, IoEngine association and a TCP handshake before the SOCKS reply can
+//   go out.
+//
+// WARM TARGETS
+//   Take() counts CONNECTs per destination (HotTargets).  A hot destination
+//   is kept topped up with per_target pre-connected sockets, made by an
+//   ordinary TcpConnection (DNS cache, happy eyeballs) flagged SetWarmup()
+//   and then detached.  A CONNECT that finds one skips the whole connect;
+//   the top-up for the socket it took starts at the same time.  At most
+//   max_targets destinations are kept warm.
+//
+//   A warm socket is checked before it is handed out: a non-blocking
+//   MSG_PEEK recv that reports EOF or an error means the target closed it
+//   while it waited.  Data already waiting (a server banner) is fine — the
+//   new owner's first recv reads it.  Sockets unused for max_idle_ms are
+//   closed by a sweep, so a destination that cools off does not hold
+//   connections open on the target.
+//
+// SOCKET RECYCLING
+//   With `recycle`, TcpConnection::Close() hands a connected socket over to
+//   Recycle(), which issues IoEngine::StartDisconnect —
+//   DisconnectEx(TF_REUSE_SOCKET).  The completion parks the socket per
+//   address family; the next ConnectEx of that family takes it instead of a
+//   new socket.  It is still bound and associated with the IOCP, so
+//   WSASocket, bind and CreateIoCompletionPort are all saved.  Windows only:
+//   where the engine has no socket reuse, Recycle() always declines.
+//   Where we closed first, the disconnect completes only once the connection
+//   leaves TIME_WAIT, so recycling pays off mostly when targets close first —
+//   which is what HTTP servers and health-check endpoints do.  A
+//   disconnect that fails closes the socket.
+//
+// LOCKING
+//   One mutex over all state.  Sockets to close are collected under it and
+//   closed after it is released; pre-connects start outside it as well.
+//   State is intentionally leaked, as in DnsResolver: completions may arrive
+//   after static destructors have run at process exit.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "warm_sockets.h"
+#include "async_io.h"
+#include "logger.h"
+#include "tcp_connection.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// ── HotTargets ────────────────────────────────────────────────────────────────
+
+HotTargets::HotTargets(uint32_t threshold, uint32_t window_ms, size_t max_tracked)
+    : m_threshold(threshold)
+    , m_window_ms(window_ms)
+    , m_max_tracked(max_tracked)
+{}
+
+void HotTargets::Configure(uint32_t threshold, uint32_t window_ms, size_t max_tracked)
+{
+    m_threshold   = threshold;
+    m_window_ms   = window_ms;
+    m_max_tracked = max_tracked;
+}
+
+void HotTargets::Prune(uint64_t now_ms)
+{
+    // A window that ended more than one window ago no longer makes its
+    // destination hot and can go.
+    for (auto it = m_targets.begin(); it != m_targets.end();)
+    {
+        if (now_ms - it->second.started_ms >= 2ull * m_window_ms) it = m_targets.erase(it);
+        else ++it;
+    }
+}
+
+bool HotTargets::Record(const std::string& key, uint64_t now_ms)
+{
+    if (m_threshold == 0) return true;
+
+    auto it = m_targets.find(key);
+    if (it == m_targets.end())
+    {
+        if (m_targets.size() >= m_max_tracked)
+        {
+            Prune(now_ms);
+            if (m_targets.size() >= m_max_tracked) return false;
+        }
+        it = m_targets.emplace(key, Window{ now_ms, 0, false }).first;
+    }
+
+    Window& w = it->second;
+    if (now_ms - w.started_ms >= m_window_ms)
+    {
+        // Only the window right before this one carries over.
+        w.was_hot    = w.connects >= m_threshold && now_ms - w.started_ms < 2ull * m_window_ms;
+        w.started_ms = now_ms;
+        w.connects   = 0;
+    }
+    ++w.connects;
+    return w.connects >= m_threshold || w.was_hot;
+}
+
+bool HotTargets::IsHot(const std::string& key, uint64_t now_ms) const
+{
+    if (m_threshold == 0) return true;
+
+    auto it = m_targets.find(key);
+    if (it == m_targets.end()) return false;
+    const Window& w = it->second;
+    uint64_t age = now_ms - w.started_ms;
+    if (age < m_window_ms)      return w.connects >= m_threshold || w.was_hot;
+    if (age < 2ull * m_window_ms) return w.connects >= m_threshold;
+    return false;
+}
+
+// ── WarmSockets ───────────────────────────────────────────────────────────────
+
+namespace {
+
+// Where a destination's pre-connects go: a host name to resolve, or an
+// address literal (port set).
+struct Target {
+    std::string      host;   // empty for a literal
+    uint16_t         port = 0;
+    ResolvedAddress  literal;
+};
+
+struct Warm {
+    SOCKET   socket;
+    int      family;
+    uint64_t since_ms;
+};
+
+struct Destination {
+    Target            target;
+    std::deque<Warm>  warm;          // oldest first
+    uint32_t          pending = 0;   // pre-connects in flight
+};
+
+struct WarmState {
+    std::mutex                                    mutex;
+    WarmSockets::Options                          options;
+    HotTargets                                    hot{ 4, WarmSockets::kHotWindowMs,
+                                                       WarmSockets::kMaxTracked };
+    std::unordered_map<std::string, Destination>  destinations;   // kept warm
+    std::vector<SOCKET>                           recycled_v4;
+    std::vector<SOCKET>                           recycled_v6;
+    bool                                          sweep_scheduled = false;
+};
+
+WarmState& State()
+{
+    static WarmState* state = new WarmState();
+    return *state;
+}
+
+std::vector<SOCKET>* RecycledList(WarmState& st, int family)
+{
+    if (family == AF_INET)  return &st.recycled_v4;
+    if (family == AF_INET6) return &st.recycled_v6;
+    return nullptr;
+}
+
+void CloseAll(const std::vector<SOCKET>& sockets)
+{
+    for (SOCKET s : sockets) IoEngine::CloseSocket(s);
+}
+
+// True unless the target has closed (or reset) the idle connection.
+// Engine sockets are already non-blocking on POSIX; an overlapped Windows
+// socket is switched for the peek.
+bool Alive(SOCKET s)
+{
+    char c;
+#ifdef _WIN32
+    u_long non_blocking = 1;
+    ::ioctlsocket(s, FIONBIO, &non_blocking);
+    int n   = ::recv(s, &c, 1, MSG_PEEK);
+    int err = n == SOCKET_ERROR ? ::WSAGetLastError() : 0;
+    non_blocking = 0;
+    ::ioctlsocket(s, FIONBIO, &non_blocking);
+    return n > 0 || err == WSAEWOULDBLOCK;
+#else
+    ssize_t n = ::recv(s, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+#endif
+}
+
+void ScheduleSweep(WarmState& st);
+
+void OnWarmed(const std::string& key, SOCKET socket, int family)
+{
+    WarmState& st = State();
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        auto it = st.destinations.find(key);
+        if (it != st.destinations.end())
+        {
+            if (it->second.pending > 0) --it->second.pending;
+            if (socket != INVALID_SOCKET && st.options.per_target > 0)
+            {
+                it->second.warm.push_back(Warm{ socket, family, ::GetTickCount64() });
+                ScheduleSweep(st);
+                return;
+            }
+        }
+    }
+    if (socket != INVALID_SOCKET) IoEngine::CloseSocket(socket);
+}
+
+void Preconnect(const std::string& key, const Target& target)
+{
+    auto conn = std::make_shared<TcpConnection>();
+    conn->SetWarmup();
+
+    // Weak: the connection stores this callback.  The completion that runs
+    // it holds a strong reference of its own.
+    std::weak_ptr<TcpConnection> weak = conn;
+    auto on_connected = [weak, key](ErrorCode ec)
+    {
+        SOCKET socket = INVALID_SOCKET;
+        int    family = AF_UNSPEC;
+        if (ec == ErrorCode::Success)
+            if (auto c = weak.lock()) socket = c->Detach(family);
+        OnWarmed(key, socket, family);
+    };
+    if (target.host.empty())
+        conn->ConnectAsync(target.literal, std::move(on_connected));
+    else
+        conn->ConnectAsync(target.host, target.port, std::move(on_connected));
+}
+
+// Closes warm sockets past max_idle_ms and forgets destinations that are
+// neither warm, connecting nor hot any more.  Reschedules itself while any
+// destination is left.
+void Sweep()
+{
+    WarmState& st = State();
+    std::vector<SOCKET> expired;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        st.sweep_scheduled = false;
+        uint64_t now = ::GetTickCount64();
+        for (auto it = st.destinations.begin(); it != st.destinations.end();)
+        {
+            auto& warm = it->second.warm;
+            while (!warm.empty() && now - warm.front().since_ms >= st.options.max_idle_ms)
+            {
+                expired.push_back(warm.front().socket);
+                warm.pop_front();
+            }
+            if (warm.empty() && it->second.pending == 0 && !st.hot.IsHot(it->first, now))
+                it = st.destinations.erase(it);
+            else
+                ++it;
+        }
+        if (!st.destinations.empty()) ScheduleSweep(st);
+    }
+    if (!expired.empty())
+        Logger::Debug("Warm sockets: closed %zu idle", expired.size());
+    CloseAll(expired);
+}
+
+// Caller holds st.mutex.
+void ScheduleSweep(WarmState& st)
+{
+    if (st.sweep_scheduled) return;
+    st.sweep_scheduled = true;
+    IoEngine::PostWorkAfter((std::max)(st.options.max_idle_ms, 1000u), &Sweep);
+}
+
+SOCKET TakeFor(const std::string& key, const Target& target, int& family)
+{
+    WarmState& st = State();
+    SOCKET taken = INVALID_SOCKET;
+    uint32_t start = 0;
+    std::vector<SOCKET> dead;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (st.options.per_target == 0) return INVALID_SOCKET;
+
+        uint64_t now = ::GetTickCount64();
+        bool hot = st.hot.Record(key, now);
+        auto it = st.destinations.find(key);
+        if (it == st.destinations.end())
+        {
+            if (!hot || st.destinations.size() >= st.options.max_targets) return INVALID_SOCKET;
+            it = st.destinations.emplace(key, Destination{ target, {}, 0 }).first;
+            ScheduleSweep(st);
+        }
+
+        Destination& d = it->second;
+        while (!d.warm.empty() && taken == INVALID_SOCKET)
+        {
+            Warm w = d.warm.front();
+            d.warm.pop_front();
+            if (now - w.since_ms < st.options.max_idle_ms && Alive(w.socket))
+            {
+                taken  = w.socket;
+                family = w.family;
+            }
+            else
+            {
+                dead.push_back(w.socket);
+            }
+        }
+
+        if (hot)
+        {
+            size_t have = d.warm.size() + d.pending;
+            if (have < st.options.per_target)
+                start = st.options.per_target - static_cast<uint32_t>(have);
+            d.pending += start;
+        }
+    }
+
+    CloseAll(dead);
+    for (uint32_t i = 0; i < start; ++i) Preconnect(key, target);
+    if (taken != INVALID_SOCKET)
+        Logger::Debug("Warm socket for %s", key.c_str());
+    return taken;
+}
+
+void OnDisconnected(SOCKET socket, int family, ErrorCode ec)
+{
+    if (ec == ErrorCode::Success)
+    {
+        WarmState& st = State();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        std::vector<SOCKET>* list = RecycledList(st, family);
+        if (st.options.recycle && list != nullptr && list->size() < WarmSockets::kMaxRecycled)
+        {
+            list->push_back(socket);
+            return;
+        }
+    }
+    IoEngine::CloseSocket(socket);
+}
+
+} // namespace
+
+void WarmSockets::Configure(const Options& options)
+{
+    WarmState& st = State();
+    std::vector<SOCKET> dropped;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        st.options = options;
+        st.hot.Configure(options.hot_connects, kHotWindowMs, kMaxTracked);
+        if (options.per_target == 0)
+        {
+            for (auto& d : st.destinations)
+                for (const Warm& w : d.second.warm) dropped.push_back(w.socket);
+            st.destinations.clear();
+            st.hot.Clear();
+        }
+        if (!options.recycle)
+        {
+            dropped.insert(dropped.end(), st.recycled_v4.begin(), st.recycled_v4.end());
+            dropped.insert(dropped.end(), st.recycled_v6.begin(), st.recycled_v6.end());
+            st.recycled_v4.clear();
+            st.recycled_v6.clear();
+        }
+    }
+    CloseAll(dropped);
+}
+
+std::string WarmSockets::Key(const std::string& host, uint16_t port)
+{
+    return DnsCache::NormalizeHost(host) + ":" + std::to_string(port);
+}
+
+std::string WarmSockets::Key(const ResolvedAddress& target)
+{
+    char text[INET6_ADDRSTRLEN] = {};
+    uint16_t port = 0;
+    if (target.family() == AF_INET6)
+    {
+        const auto* a6 = reinterpret_cast<const sockaddr_in6*>(&target.addr);
+        ::inet_ntop(AF_INET6, &a6->sin6_addr, text, sizeof(text));
+        port = ::ntohs(a6->sin6_port);
+        return std::string("[") + text + "]:" + std::to_string(port);
+    }
+    const auto* a4 = reinterpret_cast<const sockaddr_in*>(&target.addr);
+    ::inet_ntop(AF_INET, &a4->sin_addr, text, sizeof(text));
+    port = ::ntohs(a4->sin_port);
+    return std::string(text) + ":" + std::to_string(port);
+}
+
+SOCKET WarmSockets::Take(const std::string& host, uint16_t port, int& family)
+{
+    Target t;
+    t.host = host;
+    t.port = port;
+    return TakeFor(Key(host, port), t, family);
+}
+
+SOCKET WarmSockets::Take(const ResolvedAddress& target, int& family)
+{
+    Target t;
+    t.literal = target;
+    return TakeFor(Key(target), t, family);
+}
+
+SOCKET WarmSockets::TakeRecycled(int family)
+{
+    WarmState& st = State();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    std::vector<SOCKET>* list = RecycledList(st, family);
+    if (list == nullptr || list->empty()) return INVALID_SOCKET;
+    SOCKET s = list->back();
+    list->pop_back();
+    return s;
+}
+
+//
+// ── Recycle ───────────────────────────────────────────────────────────────────
+//
+// The disconnect's IoContext is heap-allocated and owned by its own
+// completion, which parks or closes the socket — the TcpConnection that
+// handed it over may be gone by then.
+//
+
+bool WarmSockets::Recycle(SOCKET socket, int family)
+{
+    {
+        WarmState& st = State();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (!st.options.recycle || !IoEngine::SupportsSocketReuse() ||
+            RecycledList(st, family) == nullptr)
+            return false;
+    }
+
+    auto* ctx = new IoContext();
+    ctx->op     = IoOp::Disconnect;
+    ctx->socket = socket;
+    ctx->callback = [socket, family](IoContext* self, DWORD, ErrorCode ec)
+    {
+        std::unique_ptr<IoContext> owner(self);
+        OnDisconnected(socket, family, ec);
+    };
+    ErrorCode started = IoEngine::StartDisconnect(ctx);
+    if (started != ErrorCode::Success)
+    {
+        Logger::Debug("DisconnectEx failed: %s", ErrorCodeToString(started));
+        delete ctx;
+        return false;
+    }
+    return true;
+}
+
+void WarmSockets::Clear()
+{
+    WarmState& st = State();
+    std::vector<SOCKET> all;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        for (auto& d : st.destinations)
+            for (const Warm& w : d.second.warm) all.push_back(w.socket);
+        st.destinations.clear();
+        st.hot.Clear();
+        all.insert(all.end(), st.recycled_v4.begin(), st.recycled_v4.end());
+        all.insert(all.end(), st.recycled_v6.begin(), st.recycled_v6.end());
+        st.recycled_v4.clear();
+        st.recycled_v6.clear();
+    }
+    CloseAll(all);
+}
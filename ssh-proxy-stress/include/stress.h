@@ -0,0 +1,259 @@
+#pragma once
+#include "common.h"
+#include "instrumentation.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+// The four session shapes of the soak mix.
+//   Bulk        send bulk_bytes, read the echo back in full, then half-close
+//               and wait for the FIN to come back through the relay
+//   Rpc         long-lived and mostly idle: rpc_rounds exchanges of
+//               rpc_bytes, one every rpc_interval_ms; each round trip is a
+//               relay latency sample
+//   SlowReader  send slow_bytes but take the echo at slow_read_rate only,
+//               so the queues towards the client fill and flow control holds
+//   Abort       reset abruptly: every other one right after a CONNECT to a
+//               name that does not resolve (the lookup still in flight), the
+//               rest in the middle of a relay
+enum class Workload : uint8_t { Bulk, Rpc, SlowReader, Abort, kCount };
+constexpr size_t kWorkloadCount = static_cast<size_t>(Workload::kCount);
+
+const char* WorkloadName(Workload w);
+
+struct StressOptions {
+    // The proxy under test runs in this process and tunnels to a (loopback)
+    // sshd; the clients connect to its remote forward ports.
+    std::string  ssh_host;
+    uint16_t     ssh_port          = 22;
+    std::string  username;
+    std::string  password;
+    uint16_t     forward_port      = 1080;
+    uint32_t     transports        = 1;
+
+    // Load
+    uint32_t     sessions          = 2000;   // concurrent clients, replaced as they finish
+    uint32_t     client_threads    = 4;
+    uint32_t     open_rate         = 200;    // new sessions a second, at most
+    uint32_t     duration_s        = 3600;
+    uint32_t     warmup_s          = 120;    // excluded from the gates
+    uint32_t     sample_s          = 10;
+    uint32_t     session_timeout_s = 600;
+    uint32_t     mix[kWorkloadCount] = { 10, 60, 15, 15 };   // percent of new sessions
+
+    uint64_t     bulk_bytes        = 8ull * 1024 * 1024;
+    uint32_t     rpc_rounds        = 300;
+    uint32_t     rpc_bytes         = 64;
+    uint32_t     rpc_interval_ms   = 1000;
+    uint64_t     slow_bytes        = 4ull * 1024 * 1024;
+    uint32_t     slow_read_rate    = 16 * 1024;   // bytes a second
+    std::string  dns_suffix        = "stress.invalid";
+
+    // Gates — growth is end of run against the end of the warm-up
+    uint32_t     max_rss_growth_mb     = 64;
+    uint32_t     max_handle_growth     = 256;
+    uint64_t     max_alloc_growth      = 100000;   // live operator new blocks
+    uint32_t     max_queued_growth_mb  = 64;
+    uint32_t     max_session_growth    = 256;      // proxy sessions beyond the clients'
+    uint32_t     max_tick_p99_ms       = 50;
+    uint32_t     max_relay_p99_ms      = 250;
+    double       max_error_pct         = 1.0;
+
+    std::string  json_path;        // empty = stdout
+};
+
+// Parses argv into opts.  Returns false (after printing usage) on bad input
+// or --help; `help` tells the two apart.
+bool ParseStressArgs(int argc, char* argv[], StressOptions& opts, bool& help);
+
+// ── Client-side accounting ────────────────────────────────────────────────────
+// Cumulative, written by the client threads with relaxed atomics.  An Abort
+// session that got as far as its reset counts as completed; `failed` is
+// every session that saw a SOCKS error, a short or corrupt echo, or ran
+// out of time.
+struct ClientCounters {
+    std::atomic<uint64_t>  started[kWorkloadCount]   = {};
+    std::atomic<uint64_t>  completed[kWorkloadCount] = {};
+    std::atomic<uint64_t>  failed[kWorkloadCount]    = {};
+    std::atomic<uint64_t>  active{0};
+    std::atomic<uint64_t>  bytes_echoed{0};
+};
+
+// ── Samples and verdict ───────────────────────────────────────────────────────
+
+// One sampling window.  Latencies cover the window only; counters are
+// cumulative since the start of the run.
+struct StressSample {
+    double    t_s                = 0;
+    uint64_t  rss_bytes          = 0;
+    uint64_t  handles            = 0;
+    uint64_t  live_allocations   = 0;   // operator new blocks not yet deleted
+    uint64_t  client_sessions    = 0;   // open client connections
+    uint64_t  proxy_sessions     = 0;   // live sessions in Connect::GetMetrics()
+    uint64_t  queued_bytes       = 0;   // both directions, every live session
+    double    tick_p99_ms        = 0;   // SSH I/O loop iteration
+    double    relay_p99_ms       = 0;   // Rpc round trip through the tunnel
+    uint64_t  started            = 0;
+    uint64_t  completed          = 0;
+    uint64_t  failed             = 0;
+    uint64_t  bytes_echoed       = 0;
+};
+
+struct GateResult {
+    std::string  name;
+    double       value = 0;
+    double       limit = 0;
+    bool         pass  = true;
+};
+
+struct StressResult {
+    std::vector<StressSample>  samples;
+    std::vector<GateResult>    gates;
+    uint64_t  started[kWorkloadCount]   = {};
+    uint64_t  completed[kWorkloadCount] = {};
+    uint64_t  failed[kWorkloadCount]    = {};
+    bool      passed = false;
+};
+
+// Applies the gates to the samples after the warm-up (see report.cpp).
+void EvaluateGates(const StressOptions& opts, StressResult& result);
+
+// One sample as a single JSON line, for the progress stream on stderr.
+std::string FormatSampleJson(const StressSample& s);
+
+// The whole run, samples included, as one JSON object.
+std::string FormatJson(const StressOptions& opts, const StressResult& result);
+
+// ── Target server ─────────────────────────────────────────────────────────────
+// Loopback TCP echo server driving every connection from one poll() thread.
+// A connection is read only while nothing it sent is still waiting to go
+// back, so a slow reader on the far side stalls it instead of growing a
+// buffer here — the backpressure reaches the proxy as it would from a real
+// target.
+class TargetServer {
+public:
+    TargetServer() = default;
+    ~TargetServer() { Stop(); }
+
+    TargetServer(const TargetServer&) = delete;
+    TargetServer& operator=(const TargetServer&) = delete;
+
+    // Listens on 127.0.0.1 with an ephemeral port.
+    ErrorCode Start();
+    void      Stop();
+    uint16_t  port() const { return m_port; }
+
+private:
+    void Loop();
+
+    SOCKET             m_listen = INVALID_SOCKET;
+    uint16_t           m_port   = 0;
+    std::atomic<bool>  m_stop{false};
+    std::thread        m_thread;
+};
+
+// ── Client pool ───────────────────────────────────────────────────────────────
+// client_threads threads, each keeping its share of `sessions` SOCKS5
+// clients open against the proxy's forward ports and starting a new one
+// (workload drawn from the mix) when one finishes, at no more than
+// open_rate a second overall.
+class ClientPool {
+public:
+    ClientPool(const StressOptions& opts, uint16_t target_port);
+    ~ClientPool() { Stop(); }
+
+    ClientPool(const ClientPool&) = delete;
+    ClientPool& operator=(const ClientPool&) = delete;
+
+    void Start();
+    // Stops opening sessions and resets the ones still open.
+    void Stop();
+
+    const ClientCounters& counters() const { return m_counters; }
+    // Round trips of the Rpc sessions, microseconds.
+    LatencyHistogram&     relay_latency()  { return m_relay; }
+
+private:
+    void ThreadProc(uint32_t index, uint64_t seed);
+    bool TakeOpenToken();   // open_rate limiter shared by the threads
+
+    const StressOptions       m_opts;
+    const uint16_t            m_target_port;
+    ClientCounters            m_counters;
+    LatencyHistogram          m_relay;
+    std::atomic<bool>         m_stop{false};
+    std::atomic<uint64_t>     m_open_tokens_at_us{0};
+    std::vector<std::thread>  m_threads;
+};
+
+// ── Process resources ─────────────────────────────────────────────────────────
+
+struct ProcessStats {
+    uint64_t  rss_bytes = 0;   // working set / resident set
+    uint64_t  handles   = 0;   // kernel handles / open file descriptors
+};
+
+ProcessStats ReadProcessStats();
+
+// Operator new blocks currently allocated (counted in main.cpp).
+uint64_t LiveAllocations();
+
+// Seconds since the first call — the run's time base.
+double StressClock();
+
+// A 64 KB block of payload bytes; the byte at stream offset k of every
+// session is PayloadPattern()[k % kPayloadPatternSize], so echoes can be
+// checked in place.
+const uint8_t* PayloadPattern();
+constexpr size_t kPayloadPatternSize = 64 * 1024;
+
+// ── Socket helpers ────────────────────────────────────────────────────────────
+// Non-blocking sockets and poll() under one spelling on both platforms.
+
+#ifdef _WIN32
+using PollFd = WSAPOLLFD;
+constexpr int kSendFlags = 0;
+inline int  PollSockets(PollFd* fds, size_t n, int timeout_ms)
+{
+    return ::WSAPoll(fds, static_cast<ULONG>(n), timeout_ms);
+}
+inline bool SetNonBlocking(SOCKET s)
+{
+    u_long on = 1;
+    return ::ioctlsocket(s, FIONBIO, &on) == 0;
+}
+inline bool WouldBlock(int err)  { return err == WSAEWOULDBLOCK; }
+inline bool InProgress(int err)  { return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS; }
+#else
+using PollFd = pollfd;
+constexpr int kSendFlags = MSG_NOSIGNAL;
+inline int  PollSockets(PollFd* fds, size_t n, int timeout_ms)
+{
+    return ::poll(fds, static_cast<nfds_t>(n), timeout_ms);
+}
+inline bool SetNonBlocking(SOCKET s)
+{
+    int flags = ::fcntl(s, F_GETFL, 0);
+    return flags >= 0 && ::fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+inline bool WouldBlock(int err)  { return err == EAGAIN || err == EWOULDBLOCK; }
+inline bool InProgress(int err)  { return err == EINPROGRESS; }
+#endif
+
+// Closes with an RST instead of a FIN (SO_LINGER 0), leaving no TIME_WAIT.
+inline void ResetSocket(SOCKET s)
+{
+    struct linger lg{};
+    lg.l_onoff  = 1;
+    lg.l_linger = 0;
+    ::setsockopt(s, SOL_SOCKET, SO_LINGER, reinterpret_cast<const char*>(&lg), sizeof(lg));
+    ::closesocket(s);
+}
@@ -0,0 +1,528 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// ClientPool — the soak's SOCKS5 clients
+//
+// THREADS
+//   Each client thread owns a fixed share of the `sessions` slots and runs
+//   them all from one poll() loop over non-blocking sockets: thousands of
+//   blocking clients would measure the scheduler, not the proxy.  A slot
+//   that finishes is refilled with a new session, its workload drawn from
+//   the mix, as soon as the shared open_rate limiter allows.
+//
+// ONE CLIENT
+//   Connect to forward_port + (id % transports), send greeting and CONNECT
+//   in one write (as most real clients pipeline them), expect the 12-byte
+//   method + CONNECT reply, then run the workload.  Every echoed byte is
+//   compared against PayloadPattern() at its stream offset, so a relay that
+//   drops, duplicates or reorders data fails the session, not just one that
+//   stalls.
+//
+// CLOSING
+//   Only Bulk ends with a FIN (and waits for the relay to send one back, the
+//   half-close path).  Rpc and SlowReader reset once their echo is checked:
+//   the proxy sees the same channel EOF + close either way, and at the churn
+//   of a long soak the TIME_WAIT of FIN-closed client ports would run the
+//   machine out of ephemeral ports.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stress.h"
+#include <chrono>
+#include <cstring>
+#include <random>
+
+namespace {
+
+constexpr size_t kReplyBytes = 12;   // method response (2) + CONNECT reply, IPv4 BND (10)
+constexpr size_t kIoChunk    = 16 * 1024;
+constexpr uint64_t kAbortAfterBytes = 16 * 1024;   // mid-relay abort: echoed bytes first
+
+uint64_t NowUs()
+{
+    return static_cast<uint64_t>(StressClock() * 1e6);
+}
+
+// True if `len` bytes at stream offset `offset` match the payload pattern.
+bool MatchesPattern(const uint8_t* data, size_t len, uint64_t offset)
+{
+    const uint8_t* pattern = PayloadPattern();
+    while (len > 0)
+    {
+        size_t at = static_cast<size_t>(offset % kPayloadPatternSize);
+        size_t n  = (std::min)(len, kPayloadPatternSize - at);
+        if (std::memcmp(data, pattern + at, n) != 0) return false;
+        data   += n;
+        len    -= n;
+        offset += n;
+    }
+    return true;
+}
+
+std::vector<uint8_t> ConnectIpv4(uint16_t port)
+{
+    return {
+        0x05, 0x01, 0x00,
+        0x05, 0x01, 0x00, 0x01, 127, 0, 0, 1,
+        static_cast<uint8_t>(port >> 8), static_cast<uint8_t>(port & 0xFF),
+    };
+}
+
+std::vector<uint8_t> ConnectDomain(const std::string& host, uint16_t port)
+{
+    std::vector<uint8_t> msg = { 0x05, 0x01, 0x00, 0x05, 0x01, 0x00, 0x03,
+                                 static_cast<uint8_t>(host.size()) };
+    msg.insert(msg.end(), host.begin(), host.end());
+    msg.push_back(static_cast<uint8_t>(port >> 8));
+    msg.push_back(static_cast<uint8_t>(port & 0xFF));
+    return msg;
+}
+
+// ── Client ────────────────────────────────────────────────────────────────────
+
+enum class Phase { Connecting, Handshake, Relay, Closing, Done };
+
+struct Client {
+    Workload  kind      = Workload::Bulk;
+    uint64_t  id        = 0;
+    SOCKET    s         = INVALID_SOCKET;
+    Phase     phase     = Phase::Connecting;
+    bool      ok        = false;
+    double    started   = 0;
+    double    deadline  = 0;
+
+    std::vector<uint8_t> hello;   // greeting + CONNECT
+    size_t    hello_sent  = 0;
+    uint8_t   reply[kReplyBytes] = {};
+    size_t    reply_have  = 0;
+    bool      dns_abort   = false;   // Abort: reset once the CONNECT is out
+
+    uint64_t  payload     = 0;   // bytes to send (and get back)
+    uint64_t  sent        = 0;
+    uint64_t  echoed      = 0;
+    bool      fin_sent    = false;
+
+    // Rpc
+    uint32_t  round       = 0;
+    double    next_round  = 0;
+    double    round_start = 0;
+    bool      awaiting    = false;
+
+    // SlowReader
+    double    allowance   = 0;
+    double    refilled_at = 0;
+
+    bool WantsWrite() const
+    {
+        if (phase == Phase::Connecting) return true;
+        if (phase == Phase::Handshake)  return hello_sent < hello.size();
+        if (phase != Phase::Relay)      return false;
+        if (kind == Workload::Rpc)      return awaiting && sent < payload;
+        return sent < payload || (kind == Workload::Bulk && !fin_sent);
+    }
+
+    bool WantsRead() const
+    {
+        if (phase == Phase::Handshake) return hello_sent == hello.size();
+        if (phase == Phase::Closing)   return true;
+        if (phase != Phase::Relay)     return false;
+        if (kind == Workload::Rpc)       return awaiting;
+        if (kind == Workload::SlowReader) return allowance >= 1;
+        return true;
+    }
+};
+
+class ClientThread {
+public:
+    ClientThread(const StressOptions& opts, uint16_t target_port, ClientCounters& counters,
+                 LatencyHistogram& relay, uint32_t slots, uint64_t seed, uint32_t index)
+        : m_opts(opts), m_target_port(target_port), m_counters(counters), m_relay(relay)
+        , m_clients(slots), m_rng(seed), m_next_id(uint64_t{index} << 40)
+    {
+        uint32_t total = 0;
+        for (uint32_t w : m_opts.mix) total += w;
+        m_mix_total = total != 0 ? total : 1;
+    }
+
+    ~ClientThread()
+    {
+        for (auto& c : m_clients)
+            if (c && c->s != INVALID_SOCKET) ResetSocket(c->s);
+    }
+
+    // One poll round over every slot.  With `opening` an empty slot gets a
+    // new session whenever take_token() hands out an open_rate token.
+    template <typename TokenFn>
+    void Run(double now, TokenFn&& take_token, bool opening)
+    {
+        for (auto& c : m_clients)
+        {
+            if (c && c->phase == Phase::Done) Finish(c);
+            if (!c && opening && take_token()) c = Open(now);
+        }
+
+        m_fds.clear();
+        m_map.clear();
+        for (size_t i = 0; i < m_clients.size(); ++i)
+        {
+            Client* c = m_clients[i].get();
+            if (c == nullptr) continue;
+            if (c->kind == Workload::Rpc) Schedule(*c, now);
+            if (c->kind == Workload::SlowReader) Refill(*c, now);
+
+            PollFd fd{};
+            fd.fd     = c->s;
+            fd.events = static_cast<short>((c->WantsRead() ? POLLIN : 0) |
+                                           (c->WantsWrite() ? POLLOUT : 0));
+            if (fd.events == 0) continue;
+            m_fds.push_back(fd);
+            m_map.push_back(i);
+        }
+
+        if (m_fds.empty())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        else if (PollSockets(m_fds.data(), m_fds.size(), 10) > 0)
+        {
+            for (size_t k = 0; k < m_fds.size(); ++k)
+            {
+                if (m_fds[k].revents == 0) continue;
+                Client& c = *m_clients[m_map[k]];
+                OnReady(c, m_fds[k].revents, StressClock());
+            }
+        }
+
+        now = StressClock();
+        for (auto& c : m_clients)
+            if (c && c->phase != Phase::Done && now > c->deadline) Fail(*c);
+    }
+
+    void CloseAll()
+    {
+        for (auto& c : m_clients)
+        {
+            if (!c) continue;
+            if (c->s != INVALID_SOCKET) ResetSocket(c->s);
+            c->s = INVALID_SOCKET;
+            m_counters.active.fetch_sub(1, std::memory_order_relaxed);
+            c.reset();
+        }
+    }
+
+private:
+    Workload Draw()
+    {
+        uint32_t r = std::uniform_int_distribution<uint32_t>(0, m_mix_total - 1)(m_rng);
+        for (size_t i = 0; i < kWorkloadCount; ++i)
+        {
+            if (r < m_opts.mix[i]) return static_cast<Workload>(i);
+            r -= m_opts.mix[i];
+        }
+        return Workload::Rpc;
+    }
+
+    std::unique_ptr<Client> Open(double now)
+    {
+        auto c = std::make_unique<Client>();
+        c->kind     = Draw();
+        c->id       = m_next_id++;
+        c->started  = now;
+        c->deadline = now + m_opts.session_timeout_s;
+
+        switch (c->kind)
+        {
+        case Workload::Bulk:       c->payload = m_opts.bulk_bytes; break;
+        case Workload::Rpc:        c->payload = m_opts.rpc_bytes;  break;
+        case Workload::SlowReader: c->payload = m_opts.slow_bytes; break;
+        case Workload::Abort:      c->payload = m_opts.bulk_bytes; break;
+        default: break;
+        }
+        c->dns_abort = c->kind == Workload::Abort && (c->id & 1) == 0;
+        c->hello = c->dns_abort
+            ? ConnectDomain("s" + std::to_string(c->id) + "." + m_opts.dns_suffix, 80)
+            : ConnectIpv4(m_target_port);
+        c->refilled_at = now;
+
+        size_t k = static_cast<size_t>(c->kind);
+        m_counters.started[k].fetch_add(1, std::memory_order_relaxed);
+        m_counters.active.fetch_add(1, std::memory_order_relaxed);
+
+        c->s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (c->s == INVALID_SOCKET || !SetNonBlocking(c->s))
+        {
+            Fail(*c);
+            return c;
+        }
+        int nodelay = 1;
+        ::setsockopt(c->s, IPPROTO_TCP, TCP_NODELAY,
+                     reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+
+        struct sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+        addr.sin_port        = ::htons(static_cast<uint16_t>(
+                                   m_opts.forward_port + c->id % m_opts.transports));
+        if (::connect(c->s, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 &&
+            !InProgress(LastSocketError()))
+            Fail(*c);
+        return c;
+    }
+
+    // Accounts a finished slot and frees it.
+    void Finish(std::unique_ptr<Client>& c)
+    {
+        size_t k = static_cast<size_t>(c->kind);
+        if (c->ok) m_counters.completed[k].fetch_add(1, std::memory_order_relaxed);
+        else       m_counters.failed[k].fetch_add(1, std::memory_order_relaxed);
+        m_counters.active.fetch_sub(1, std::memory_order_relaxed);
+        c.reset();
+    }
+
+    void Done(Client& c, bool ok, bool reset)
+    {
+        if (c.s != INVALID_SOCKET)
+        {
+            if (reset) ResetSocket(c.s);
+            else       ::closesocket(c.s);
+        }
+        c.s     = INVALID_SOCKET;
+        c.ok    = ok;
+        c.phase = Phase::Done;
+    }
+
+    void Fail(Client& c) { Done(c, false, true); }
+
+    void Schedule(Client& c, double now)
+    {
+        if (c.phase != Phase::Relay || c.awaiting || now < c.next_round) return;
+        if (c.round == m_opts.rpc_rounds)
+        {
+            Done(c, true, true);
+            return;
+        }
+        c.awaiting    = true;
+        c.sent        = 0;
+        c.echoed      = 0;
+        c.round_start = now;
+    }
+
+    void Refill(Client& c, double now)
+    {
+        c.allowance   = (std::min)(c.allowance + (now - c.refilled_at) * m_opts.slow_read_rate,
+                                   static_cast<double>(kIoChunk));
+        c.refilled_at = now;
+    }
+
+    void OnReady(Client& c, short revents, double now)
+    {
+        if (c.phase == Phase::Connecting)
+        {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            ::getsockopt(c.s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &len);
+            if (err != 0) { Fail(c); return; }
+            c.phase = Phase::Handshake;
+        }
+        else if ((revents & (POLLERR | POLLHUP)) != 0 && (revents & POLLIN) == 0)
+        {
+            Fail(c);
+            return;
+        }
+
+        if (c.WantsWrite()) Write(c);
+        if (c.phase != Phase::Done && (revents & (POLLIN | POLLHUP)) != 0 && c.WantsRead())
+            Read(c, now);
+    }
+
+    void Write(Client& c)
+    {
+        if (c.phase == Phase::Handshake)
+        {
+            int n = ::send(c.s, reinterpret_cast<const char*>(c.hello.data() + c.hello_sent),
+                           static_cast<int>(c.hello.size() - c.hello_sent), kSendFlags);
+            if (n < 0 && WouldBlock(LastSocketError())) return;
+            if (n <= 0) { Fail(c); return; }
+            c.hello_sent += static_cast<size_t>(n);
+            if (c.dns_abort && c.hello_sent == c.hello.size())
+                Done(c, true, true);   // the lookup has just been started
+            return;
+        }
+
+        while (c.sent < c.payload)
+        {
+            uint64_t offset = c.kind == Workload::Rpc
+                ? uint64_t{c.round} * m_opts.rpc_bytes + c.sent : c.sent;
+            size_t at = static_cast<size_t>(offset % kPayloadPatternSize);
+            size_t n  = static_cast<size_t>((std::min)(c.payload - c.sent,
+                            static_cast<uint64_t>((std::min)(kIoChunk, kPayloadPatternSize - at))));
+            int w = ::send(c.s, reinterpret_cast<const char*>(PayloadPattern() + at),
+                           static_cast<int>(n), kSendFlags);
+            if (w < 0 && WouldBlock(LastSocketError())) return;
+            if (w <= 0) { Fail(c); return; }
+            c.sent += static_cast<uint64_t>(w);
+        }
+        if (c.kind == Workload::Bulk && !c.fin_sent)
+        {
+            ::shutdown(c.s, SD_SEND);
+            c.fin_sent = true;
+        }
+    }
+
+    void Read(Client& c, double now)
+    {
+        uint8_t buf[kIoChunk];
+        for (;;)
+        {
+            size_t want = sizeof(buf);
+            if (c.phase == Phase::Handshake)       want = kReplyBytes - c.reply_have;
+            else if (c.kind == Workload::SlowReader && c.phase == Phase::Relay)
+                want = (std::min)(want, static_cast<size_t>(c.allowance));
+            if (want == 0) return;
+
+            int n = ::recv(c.s, reinterpret_cast<char*>(buf), static_cast<int>(want), 0);
+            if (n < 0 && WouldBlock(LastSocketError())) return;
+            if (n < 0) { Fail(c); return; }
+            if (n == 0)
+            {
+                // The relay's FIN: the end of a Bulk session, an error anywhere else.
+                bool ok = c.phase == Phase::Closing;
+                Done(c, ok, !ok);
+                return;
+            }
+            if (!Consume(c, buf, static_cast<size_t>(n), now)) return;
+        }
+    }
+
+    // False once the client has finished or failed, or stops reading.
+    bool Consume(Client& c, const uint8_t* data, size_t n, double now)
+    {
+        if (c.phase == Phase::Handshake)
+        {
+            std::memcpy(c.reply + c.reply_have, data, n);
+            c.reply_have += n;
+            if (c.reply_have < kReplyBytes) return true;
+            if (c.reply[1] != 0x00 || c.reply[3] != 0x00) { Fail(c); return false; }
+            c.phase      = Phase::Relay;
+            c.next_round = now;
+            c.refilled_at = now;
+            return c.kind != Workload::Rpc && c.kind != Workload::SlowReader;
+        }
+        if (c.phase == Phase::Closing)
+        {
+            Fail(c);   // data after the full echo
+            return false;
+        }
+
+        uint64_t offset = c.kind == Workload::Rpc
+            ? uint64_t{c.round} * m_opts.rpc_bytes + c.echoed : c.echoed;
+        if (c.echoed + n > c.payload || !MatchesPattern(data, n, offset))
+        {
+            Fail(c);
+            return false;
+        }
+        c.echoed += n;
+        m_counters.bytes_echoed.fetch_add(n, std::memory_order_relaxed);
+        if (c.kind == Workload::SlowReader) c.allowance -= static_cast<double>(n);
+
+        switch (c.kind)
+        {
+        case Workload::Bulk:
+            if (c.echoed == c.payload) c.phase = Phase::Closing;
+            return true;
+        case Workload::Rpc:
+            if (c.echoed < c.payload) return true;
+            m_relay.Record(static_cast<uint64_t>((now - c.round_start) * 1e6));
+            c.awaiting   = false;
+            c.round     += 1;
+            c.next_round = c.round_start + m_opts.rpc_interval_ms / 1000.0;
+            return false;
+        case Workload::SlowReader:
+            if (c.echoed == c.payload) { Done(c, true, true); return false; }
+            return c.allowance >= 1;
+        case Workload::Abort:
+            if (c.echoed >= kAbortAfterBytes) { Done(c, true, true); return false; }
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    const StressOptions&                  m_opts;
+    const uint16_t                        m_target_port;
+    ClientCounters&                       m_counters;
+    LatencyHistogram&                     m_relay;
+    std::vector<std::unique_ptr<Client>>  m_clients;
+    std::vector<PollFd>                   m_fds;
+    std::vector<size_t>                   m_map;   // m_fds index → m_clients index
+    std::mt19937_64                       m_rng;
+    uint64_t                              m_next_id;
+    uint32_t                              m_mix_total = 1;
+};
+
+} // namespace
+
+const char* WorkloadName(Workload w)
+{
+    switch (w)
+    {
+    case Workload::Bulk:       return "bulk";
+    case Workload::Rpc:        return "rpc";
+    case Workload::SlowReader: return "slow_reader";
+    case Workload::Abort:      return "abort";
+    default:                   return "?";
+    }
+}
+
+ClientPool::ClientPool(const StressOptions& opts, uint16_t target_port)
+    : m_opts(opts), m_target_port(target_port)
+{}
+
+void ClientPool::Start()
+{
+    m_open_tokens_at_us.store(NowUs());
+    std::mt19937_64 seeder(0x5eed5eedULL);
+    for (uint32_t i = 0; i < m_opts.client_threads; ++i)
+        m_threads.emplace_back(&ClientPool::ThreadProc, this, i, seeder());
+}
+
+void ClientPool::Stop()
+{
+    m_stop.store(true);
+    for (auto& t : m_threads)
+        if (t.joinable()) t.join();
+    m_threads.clear();
+}
+
+//
+// ── TakeOpenToken ─────────────────────────────────────────────────────────────
+//
+// A token bucket in one atomic: the time up to which tokens have been spent
+// advances 1 / open_rate s per open and may trail the clock by at most one
+// second, which is the burst.
+//
+
+bool ClientPool::TakeOpenToken()
+{
+    if (m_opts.open_rate == 0) return true;
+    const uint64_t step = (std::max)(uint64_t{1}, uint64_t{1000000} / m_opts.open_rate);
+    uint64_t now = NowUs();
+    uint64_t at  = m_open_tokens_at_us.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        uint64_t from = (std::max)(at, now > 1000000 ? now - 1000000 : 0);
+        if (from + step > now) return false;
+        if (m_open_tokens_at_us.compare_exchange_weak(at, from + step,
+                                                      std::memory_order_relaxed))
+            return true;
+    }
+}
+
+void ClientPool::ThreadProc(uint32_t index, uint64_t seed)
+{
+    uint32_t slots = m_opts.sessions / m_opts.client_threads +
+                     (index < m_opts.sessions % m_opts.client_threads ? 1 : 0);
+    ClientThread thread(m_opts, m_target_port, m_counters, m_relay, slots, seed, index);
+    while (!m_stop.load())
+        thread.Run(StressClock(), [this]() { return TakeOpenToken(); }, /*opening=*/ true);
+    thread.CloseAll();
+}
@@ -0,0 +1,273 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// ssh-proxy-stress — long-running soak with resource and latency gates
+//
+// PURPOSE
+//   The unit tests and the bench each run a few seconds; leaks of a handle
+//   or a buffer per thousand sessions, queues that never quite drain and a
+//   tick that slowly gets longer only show over hours of churn.  This target
+//   runs ssh_proxy::Connect in process against a (loopback) sshd, keeps a
+//   mix of client sessions open against its forward ports for duration_s
+//   and fails the run when a resource grows or a latency exceeds its limit
+//   after the warm-up (see report.cpp for the gates).
+//
+// SAMPLING
+//   Every sample_s the main thread records the process's RSS, handle count
+//   and live operator-new blocks, the proxy's live sessions and queue depths
+//   from GetMetrics(), and the p99 of the SSH I/O loop tick and of the Rpc
+//   round trips over the window just ended — both histograms are reset
+//   after each read, so a window does not average into the run.
+//
+// SCOPE
+//   The allocation count is C++ operator new in this process: the proxy,
+//   the clients and the echo target together, but not libssh2's own malloc
+//   calls or any kernel memory (which RSS and handles cover).
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stress.h"
+#include "async_io.h"
+#include "logger.h"
+#include "../../ssh-proxy-lib/public/ssh_proxy.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// ── Allocation counting ───────────────────────────────────────────────────────
+// Replacing the global operator new counts live C++ heap blocks — news less
+// deletes of a non-null pointer.  Every form is replaced: MSVC's aligned new
+// goes straight to _aligned_malloc rather than through operator new(size_t),
+// and SessionPool's cache-line-aligned blocks are exactly what must be seen.
+
+static std::atomic<int64_t> g_live_allocations{0};
+
+static void* CountedAlloc(size_t size) noexcept
+{
+    void* p = std::malloc(size ? size : 1);
+    if (p) g_live_allocations.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+
+static void* CountedAlignedAlloc(size_t size, std::align_val_t align) noexcept
+{
+    size_t bytes = size ? size : 1;
+#ifdef _WIN32
+    void* p = ::_aligned_malloc(bytes, static_cast<size_t>(align));
+#else
+    void*  p         = nullptr;
+    size_t alignment = (std::max)(static_cast<size_t>(align), sizeof(void*));
+    if (::posix_memalign(&p, alignment, bytes) != 0) p = nullptr;
+#endif
+    if (p) g_live_allocations.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+
+static void CountedFree(void* p) noexcept
+{
+    if (!p) return;
+    g_live_allocations.fetch_sub(1, std::memory_order_relaxed);
+    std::free(p);
+}
+
+static void CountedAlignedFree(void* p) noexcept
+{
+    if (!p) return;
+    g_live_allocations.fetch_sub(1, std::memory_order_relaxed);
+#ifdef _WIN32
+    ::_aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(size_t size)
+{
+    if (void* p = CountedAlloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t align)
+{
+    if (void* p = CountedAlignedAlloc(size, align)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)                                { return operator new(size); }
+void* operator new[](size_t size, std::align_val_t align)        { return operator new(size, align); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept   { return CountedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return CountedAlignedAlloc(size, align);
+}
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return CountedAlignedAlloc(size, align);
+}
+
+void operator delete(void* p) noexcept                            { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept                    { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept     { CountedFree(p); }
+void operator delete[](void* p) noexcept                          { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept                  { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept   { CountedFree(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept                         { CountedAlignedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept                 { CountedAlignedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept  { CountedAlignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept                       { CountedAlignedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept               { CountedAlignedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { CountedAlignedFree(p); }
+
+uint64_t LiveAllocations()
+{
+    int64_t n = g_live_allocations.load(std::memory_order_relaxed);
+    return n > 0 ? static_cast<uint64_t>(n) : 0;
+}
+
+double StressClock()
+{
+    static const auto t0 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+const uint8_t* PayloadPattern()
+{
+    static const std::vector<uint8_t> pattern = []()
+    {
+        std::vector<uint8_t> p(kPayloadPatternSize);
+        for (size_t i = 0; i < p.size(); ++i) p[i] = static_cast<uint8_t>(i * 31 + 7);
+        return p;
+    }();
+    return pattern.data();
+}
+
+// ── Sampling ──────────────────────────────────────────────────────────────────
+
+static StressSample TakeSample(ssh_proxy::Connect& tunnel, ClientPool& pool)
+{
+    StressSample s;
+    s.t_s = StressClock();
+
+    ProcessStats ps    = ReadProcessStats();
+    s.rss_bytes        = ps.rss_bytes;
+    s.handles          = ps.handles;
+    s.live_allocations = LiveAllocations();
+
+    ssh_proxy::Metrics m = tunnel.GetMetrics();
+    s.proxy_sessions = m.sessions.size();
+    for (const auto& ss : m.sessions)
+        s.queued_bytes += ss.queued_to_target + ss.queued_to_client;
+
+    s.tick_p99_ms = static_cast<double>(
+        Instrumentation::Summarize(LatencyPoint::IoLoopTick).p99_us) / 1000.0;
+    Instrumentation::Reset();
+    s.relay_p99_ms = static_cast<double>(pool.relay_latency().Summarize().p99_us) / 1000.0;
+    pool.relay_latency().Reset();
+
+    const ClientCounters& c = pool.counters();
+    s.client_sessions = c.active.load(std::memory_order_relaxed);
+    for (size_t w = 0; w < kWorkloadCount; ++w)
+    {
+        s.started   += c.started[w].load(std::memory_order_relaxed);
+        s.completed += c.completed[w].load(std::memory_order_relaxed);
+        s.failed    += c.failed[w].load(std::memory_order_relaxed);
+    }
+    s.bytes_echoed = c.bytes_echoed.load(std::memory_order_relaxed);
+    return s;
+}
+
+int main(int argc, char* argv[])
+{
+    StressOptions opts;
+    bool help = false;
+    if (!ParseStressArgs(argc, argv, opts, help))
+        return help ? 0 : 1;
+
+    Logger::SetMinLevel(ssh_proxy::LogLevel::Warn);
+    Logger::SetCallback([](const LogEntry& e) {
+        fprintf(stderr, "%s %s\n", e.timestamp.c_str(), e.message.c_str());
+    });
+
+    if (IoEngine::Init(0) != ErrorCode::Success)
+    {
+        fprintf(stderr, "Fatal: IoEngine init failed\n");
+        return 1;
+    }
+    StressClock();
+    PayloadPattern();
+
+    TargetServer target;
+    if (target.Start() != ErrorCode::Success)
+    {
+        fprintf(stderr, "Fatal: target server failed to start\n");
+        return 1;
+    }
+
+    StressResult result;
+    try {
+        ssh_proxy::Connect tunnel(opts.ssh_host, opts.username, opts.password,
+                                  opts.ssh_port, opts.forward_port,
+                                  10000, 30000, ssh_proxy::LogLevel::Warn,
+                                  opts.transports);
+
+        ClientPool pool(opts, target.port());
+        Instrumentation::Reset();
+        double t_start = StressClock();
+        pool.Start();
+
+        for (double next = t_start + opts.sample_s; next <= t_start + opts.duration_s;
+             next += opts.sample_s)
+        {
+            double wait = next - StressClock();
+            if (wait > 0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            StressSample s = TakeSample(tunnel, pool);
+            s.t_s -= t_start;
+            fprintf(stderr, "%s\n", FormatSampleJson(s).c_str());
+            result.samples.push_back(s);
+        }
+
+        pool.Stop();
+        for (size_t w = 0; w < kWorkloadCount; ++w)
+        {
+            result.started[w]   = pool.counters().started[w].load();
+            result.completed[w] = pool.counters().completed[w].load();
+            result.failed[w]    = pool.counters().failed[w].load();
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Fatal: %s\n", e.what());
+        return 1;
+    }
+    target.Stop();
+    Logger::Flush();
+
+    EvaluateGates(opts, result);
+    std::string json = FormatJson(opts, result);
+    if (opts.json_path.empty())
+    {
+        fputs(json.c_str(), stdout);
+    }
+    else
+    {
+        FILE* f = nullptr;
+        if (fopen_s(&f, opts.json_path.c_str(), "w") != 0 || f == nullptr)
+        {
+            fprintf(stderr, "Error: cannot write %s\n", opts.json_path.c_str());
+            return 1;
+        }
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+
+    for (const auto& g : result.gates)
+        if (!g.pass)
+            fprintf(stderr, "Gate failed: %s = %.3f (limit %.3f)\n", g.name.c_str(), g.value, g.limit);
+    return result.passed ? 0 : 2;
+}
@@ -0,0 +1,41 @@
+#include "stress.h"
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <dirent.h>
+#include <fstream>
+#endif
+
+//
+// ── ReadProcessStats ──────────────────────────────────────────────────────────
+//
+// Windows: working set and kernel handle count.  POSIX: resident set from
+// /proc/self/statm and the open descriptors in /proc/self/fd (the directory
+// handle used to count them included).
+//
+
+ProcessStats ReadProcessStats()
+{
+    ProcessStats st;
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc{};
+    if (::GetProcessMemoryInfo(::GetCurrentProcess(), &pmc, sizeof(pmc)))
+        st.rss_bytes = pmc.WorkingSetSize;
+    DWORD handles = 0;
+    if (::GetProcessHandleCount(::GetCurrentProcess(), &handles))
+        st.handles = handles;
+#else
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size_pages = 0, resident_pages = 0;
+    if (statm >> size_pages >> resident_pages)
+        st.rss_bytes = resident_pages * static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+    if (DIR* dir = ::opendir("/proc/self/fd"))
+    {
+        while (const dirent* e = ::readdir(dir))
+            if (e->d_name[0] != '.') ++st.handles;
+        ::closedir(dir);
+    }
+#endif
+    return st;
+}
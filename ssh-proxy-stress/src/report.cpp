@@ -0,0 +1,196 @@
+#include "stress.h"
+#include <algorithm>
+#include <cstdio>
+
+//
+// ── EvaluateGates ─────────────────────────────────────────────────────────────
+//
+// Only samples taken after the warm-up count: pools, caches and the session
+// population are still filling before it.  A growth gate compares the median
+// of the last three samples with the median of the first three, so a single
+// sample caught mid-burst neither trips nor hides a leak; a latency gate
+// holds the median of the last three windows' p99 to its absolute limit.
+// The error gate covers the whole run.  MiB = 2^20 bytes.
+//
+
+namespace {
+
+constexpr double kMiB = 1024.0 * 1024.0;
+constexpr size_t kEdgeSamples = 3;
+
+using Field = double (*)(const StressSample&);
+
+// Median of field over samples [first, first + count).
+double MedianOf(const std::vector<const StressSample*>& samples, size_t first, size_t count, Field field)
+{
+    std::vector<double> v;
+    for (size_t i = first; i < first + count; ++i) v.push_back(field(*samples[i]));
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[v.size() / 2];
+}
+
+void Append(std::string& out, const char* fmt, double v)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), fmt, v);
+    out += buf;
+}
+
+std::string Quoted(const std::string& s)
+{
+    std::string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+void EvaluateGates(const StressOptions& opts, StressResult& result)
+{
+    result.gates.clear();
+
+    std::vector<const StressSample*> window;
+    for (const auto& s : result.samples)
+        if (s.t_s >= static_cast<double>(opts.warmup_s)) window.push_back(&s);
+
+    auto add = [&](const char* name, double value, double limit)
+    {
+        GateResult g;
+        g.name  = name;
+        g.value = value;
+        g.limit = limit;
+        g.pass  = value <= limit;
+        result.gates.push_back(g);
+    };
+
+    if (window.empty())
+    {
+        GateResult g;
+        g.name = "samples_after_warmup";
+        g.pass = false;
+        result.gates.push_back(g);
+    }
+    else
+    {
+        size_t edge = (std::min)(kEdgeSamples, window.size());
+        size_t last = window.size() - edge;
+        auto growth = [&](Field field)
+        {
+            return MedianOf(window, last, edge, field) - MedianOf(window, 0, edge, field);
+        };
+
+        add("rss_growth_mb",
+            growth([](const StressSample& s) { return static_cast<double>(s.rss_bytes) / kMiB; }),
+            opts.max_rss_growth_mb);
+        add("handle_growth",
+            growth([](const StressSample& s) { return static_cast<double>(s.handles); }),
+            opts.max_handle_growth);
+        add("live_allocation_growth",
+            growth([](const StressSample& s) { return static_cast<double>(s.live_allocations); }),
+            static_cast<double>(opts.max_alloc_growth));
+        add("queued_growth_mb",
+            growth([](const StressSample& s) { return static_cast<double>(s.queued_bytes) / kMiB; }),
+            opts.max_queued_growth_mb);
+        // Sessions the proxy still holds beyond the clients that are open:
+        // closes that never reached the session table.
+        add("session_growth",
+            growth([](const StressSample& s) {
+                return static_cast<double>(s.proxy_sessions) - static_cast<double>(s.client_sessions);
+            }),
+            opts.max_session_growth);
+        add("io_loop_tick_p99_ms",
+            MedianOf(window, last, edge, [](const StressSample& s) { return s.tick_p99_ms; }),
+            opts.max_tick_p99_ms);
+        add("relay_p99_ms",
+            MedianOf(window, last, edge, [](const StressSample& s) { return s.relay_p99_ms; }),
+            opts.max_relay_p99_ms);
+    }
+
+    uint64_t started = 0, failed = 0;
+    for (size_t w = 0; w < kWorkloadCount; ++w)
+    {
+        started += result.started[w];
+        failed  += result.failed[w];
+    }
+    add("error_pct",
+        started != 0 ? 100.0 * static_cast<double>(failed) / static_cast<double>(started) : 0.0,
+        opts.max_error_pct);
+
+    result.passed = std::all_of(result.gates.begin(), result.gates.end(),
+                                [](const GateResult& g) { return g.pass; });
+}
+
+//
+// ── FormatJson ────────────────────────────────────────────────────────────────
+//
+// Stable key order, as the bench's, so two runs can be diffed directly.
+//
+
+std::string FormatSampleJson(const StressSample& s)
+{
+    std::string out = "{";
+    Append(out, "\"t_s\": %.1f", s.t_s);
+    out += ", \"rss_bytes\": "        + std::to_string(s.rss_bytes);
+    out += ", \"handles\": "          + std::to_string(s.handles);
+    out += ", \"live_allocations\": " + std::to_string(s.live_allocations);
+    out += ", \"client_sessions\": "  + std::to_string(s.client_sessions);
+    out += ", \"proxy_sessions\": "   + std::to_string(s.proxy_sessions);
+    out += ", \"queued_bytes\": "     + std::to_string(s.queued_bytes);
+    Append(out, ", \"tick_p99_ms\": %.3f",  s.tick_p99_ms);
+    Append(out, ", \"relay_p99_ms\": %.3f", s.relay_p99_ms);
+    out += ", \"started\": "          + std::to_string(s.started);
+    out += ", \"completed\": "        + std::to_string(s.completed);
+    out += ", \"failed\": "           + std::to_string(s.failed);
+    out += ", \"bytes_echoed\": "     + std::to_string(s.bytes_echoed);
+    out += "}";
+    return out;
+}
+
+std::string FormatJson(const StressOptions& opts, const StressResult& result)
+{
+    std::string out = "{\n";
+    out += "  \"sessions\": "       + std::to_string(opts.sessions) + ",\n";
+    out += "  \"transports\": "     + std::to_string(opts.transports) + ",\n";
+    out += "  \"duration_s\": "     + std::to_string(opts.duration_s) + ",\n";
+    out += "  \"warmup_s\": "       + std::to_string(opts.warmup_s) + ",\n";
+    out += "  \"sample_s\": "       + std::to_string(opts.sample_s) + ",\n";
+    out += std::string("  \"passed\": ") + (result.passed ? "true" : "false") + ",\n";
+
+    out += "  \"workloads\": {";
+    for (size_t w = 0; w < kWorkloadCount; ++w)
+    {
+        out += w == 0 ? "\n" : ",\n";
+        out += "    " + Quoted(WorkloadName(static_cast<Workload>(w))) + ": {";
+        out += " \"mix_pct\": "    + std::to_string(opts.mix[w]) + ",";
+        out += " \"started\": "    + std::to_string(result.started[w]) + ",";
+        out += " \"completed\": "  + std::to_string(result.completed[w]) + ",";
+        out += " \"failed\": "     + std::to_string(result.failed[w]) + " }";
+    }
+    out += "\n  },\n";
+
+    out += "  \"gates\": [";
+    for (size_t i = 0; i < result.gates.size(); ++i)
+    {
+        const GateResult& g = result.gates[i];
+        out += i == 0 ? "\n" : ",\n";
+        out += "    { \"name\": " + Quoted(g.name) + ",";
+        Append(out, " \"value\": %.3f,", g.value);
+        Append(out, " \"limit\": %.3f,", g.limit);
+        out += std::string(" \"pass\": ") + (g.pass ? "true" : "false") + " }";
+    }
+    out += "\n  ],\n";
+
+    out += "  \"samples\": [";
+    for (size_t i = 0; i < result.samples.size(); ++i)
+    {
+        out += i == 0 ? "\n    " : ",\n    ";
+        out += FormatSampleJson(result.samples[i]);
+    }
+    out += "\n  ]\n";
+    out += "}\n";
+    return out;
+}
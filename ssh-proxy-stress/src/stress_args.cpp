@@ -0,0 +1,232 @@
+#include "stress.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void PrintUsage(const char* exe) {
+    fprintf(stderr,
+        "Usage: %s --server HOST -u USER -p PASS [options]\n"
+        "\n"
+        "Soak test: runs ssh_proxy::Connect in process against a (loopback) sshd,\n"
+        "keeps a mix of SOCKS5 sessions open against its forward ports for the\n"
+        "whole run, samples resources and latencies, and fails (exit code 2) when\n"
+        "a gate is exceeded.  Samples go to stderr as JSON lines, the verdict to\n"
+        "stdout or --json.\n"
+        "\n"
+        "SSH:\n"
+        "  --server HOST           sshd to tunnel through (required)\n"
+        "  --username / -u USER    SSH username (required)\n"
+        "  --password / -p PASS    SSH password (required)\n"
+        "  --port PORT             SSH port (default: 22)\n"
+        "  --forward-port / -f N   First remote forward port (default: 1080)\n"
+        "  --transports N          SSH transports, ports N.. N+transports-1 (default: 1)\n"
+        "\n"
+        "Load:\n"
+        "  --sessions N            Concurrent client sessions (default: 2000)\n"
+        "  --client-threads N      Client poll() threads (default: 4)\n"
+        "  --open-rate N           New sessions a second, at most (default: 200)\n"
+        "  --duration-s N          Run length (default: 3600)\n"
+        "  --warmup-s N            Start of the gated window (default: 120)\n"
+        "  --sample-s N            Sampling interval (default: 10)\n"
+        "  --session-timeout-s N   Fail a session still open after N s (default: 600)\n"
+        "  --mix B,R,S,A           Percent bulk,rpc,slow-reader,abort; sum 100\n"
+        "                          (default: 10,60,15,15)\n"
+        "\n"
+        "Workloads:\n"
+        "  --bulk-bytes N          Bytes per bulk session (default: 8388608)\n"
+        "  --rpc-rounds N          Exchanges per rpc session (default: 300)\n"
+        "  --rpc-bytes N           Bytes per exchange, <= 65536 (default: 64)\n"
+        "  --rpc-interval-ms N     Pause between exchanges (default: 1000)\n"
+        "  --slow-bytes N          Bytes per slow-reader session (default: 4194304)\n"
+        "  --slow-read-rate N      Slow reader's bytes a second (default: 16384)\n"
+        "  --dns-suffix NAME       Unresolvable domain for DNS aborts\n"
+        "                          (default: stress.invalid)\n"
+        "\n"
+        "Gates:\n"
+        "  --max-rss-growth-mb N       (default: 64)\n"
+        "  --max-handle-growth N       (default: 256)\n"
+        "  --max-alloc-growth N        Live operator new blocks (default: 100000)\n"
+        "  --max-queued-growth-mb N    (default: 64)\n"
+        "  --max-session-growth N      Proxy sessions beyond the clients' (default: 256)\n"
+        "  --max-tick-p99-ms N         SSH I/O loop iteration (default: 50)\n"
+        "  --max-relay-p99-ms N        Rpc round trip (default: 250)\n"
+        "  --max-error-pct X           Failed sessions, percent (default: 1.0)\n"
+        "\n"
+        "  --json PATH             Write the JSON result to PATH (default: stdout)\n"
+        "  --help                  Show this help\n",
+        exe);
+}
+
+static bool ParseU64(const char* val, uint64_t& out) {
+    char* end = nullptr;
+    unsigned long long v = strtoull(val, &end, 10);
+    if (end == val || *end != '\0' || v == 0) return false;
+    out = v;
+    return true;
+}
+
+// "B,R,S,A" — four percentages summing to 100; zeros allowed.
+static bool ParseMix(const char* val, uint32_t (&mix)[kWorkloadCount]) {
+    uint32_t parsed[kWorkloadCount] = {};
+    uint32_t sum = 0;
+    const char* p = val;
+    for (size_t w = 0; w < kWorkloadCount; ++w) {
+        char* end = nullptr;
+        unsigned long v = strtoul(p, &end, 10);
+        if (end == p || v > 100) return false;
+        if (*end != (w + 1 < kWorkloadCount ? ',' : '\0')) return false;
+        parsed[w] = static_cast<uint32_t>(v);
+        sum += parsed[w];
+        p = end + 1;
+    }
+    if (sum != 100) return false;
+    memcpy(mix, parsed, sizeof(parsed));
+    return true;
+}
+
+bool ParseStressArgs(int argc, char* argv[], StressOptions& opts, bool& help) {
+    opts = StressOptions{};
+    help = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            PrintUsage(argv[0]);
+            help = true;
+            return false;
+        }
+
+        // All remaining flags require a value argument
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Error: %s requires a value\n", arg);
+            return false;
+        }
+        const char* val = argv[++i];
+        uint64_t n = 0;
+
+        // Numeric flag with an upper bound; the name is echoed on error.
+        auto number = [&](const char* name, uint64_t max) {
+            if (ParseU64(val, n) && n <= max) return true;
+            fprintf(stderr, "Error: invalid %s '%s'\n", name, val);
+            return false;
+        };
+
+        if (strcmp(arg, "--server") == 0) {
+            opts.ssh_host = val;
+        } else if (strcmp(arg, "--port") == 0) {
+            if (!number("port", 65535)) return false;
+            opts.ssh_port = static_cast<uint16_t>(n);
+        } else if (strcmp(arg, "--username") == 0 || strcmp(arg, "-u") == 0) {
+            opts.username = val;
+        } else if (strcmp(arg, "--password") == 0 || strcmp(arg, "-p") == 0) {
+            opts.password = val;
+        } else if (strcmp(arg, "--forward-port") == 0 || strcmp(arg, "-f") == 0) {
+            if (!number("forward-port", 65535)) return false;
+            opts.forward_port = static_cast<uint16_t>(n);
+        } else if (strcmp(arg, "--transports") == 0) {
+            if (!number("transports", 64)) return false;
+            opts.transports = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--sessions") == 0) {
+            if (!number("sessions", 100000)) return false;
+            opts.sessions = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--client-threads") == 0) {
+            if (!number("client-threads", 64)) return false;
+            opts.client_threads = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--open-rate") == 0) {
+            if (!number("open-rate", 100000)) return false;
+            opts.open_rate = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--duration-s") == 0) {
+            if (!number("duration", UINT32_MAX)) return false;
+            opts.duration_s = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--warmup-s") == 0) {
+            if (strcmp(val, "0") == 0) { opts.warmup_s = 0; continue; }
+            if (!number("warmup", UINT32_MAX)) return false;
+            opts.warmup_s = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--sample-s") == 0) {
+            if (!number("sample interval", 3600)) return false;
+            opts.sample_s = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--session-timeout-s") == 0) {
+            if (!number("session timeout", UINT32_MAX)) return false;
+            opts.session_timeout_s = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--mix") == 0) {
+            if (!ParseMix(val, opts.mix)) {
+                fprintf(stderr, "Error: invalid mix '%s' (four percentages summing to 100)\n", val);
+                return false;
+            }
+        } else if (strcmp(arg, "--bulk-bytes") == 0) {
+            if (!number("bulk-bytes", UINT64_MAX)) return false;
+            opts.bulk_bytes = n;
+        } else if (strcmp(arg, "--rpc-rounds") == 0) {
+            if (!number("rpc-rounds", UINT32_MAX)) return false;
+            opts.rpc_rounds = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--rpc-bytes") == 0) {
+            if (!number("rpc-bytes", kPayloadPatternSize)) return false;
+            opts.rpc_bytes = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--rpc-interval-ms") == 0) {
+            if (!number("rpc-interval", 3600000)) return false;
+            opts.rpc_interval_ms = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--slow-bytes") == 0) {
+            if (!number("slow-bytes", UINT64_MAX)) return false;
+            opts.slow_bytes = n;
+        } else if (strcmp(arg, "--slow-read-rate") == 0) {
+            if (!number("slow-read-rate", UINT32_MAX)) return false;
+            opts.slow_read_rate = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--dns-suffix") == 0) {
+            if (*val == '\0' || strlen(val) > 200) {
+                fprintf(stderr, "Error: invalid dns-suffix '%s'\n", val);
+                return false;
+            }
+            opts.dns_suffix = val;
+        } else if (strcmp(arg, "--max-rss-growth-mb") == 0) {
+            if (!number("max-rss-growth-mb", UINT32_MAX)) return false;
+            opts.max_rss_growth_mb = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--max-handle-growth") == 0) {
+            if (!number("max-handle-growth", UINT32_MAX)) return false;
+            opts.max_handle_growth = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--max-alloc-growth") == 0) {
+            if (!number("max-alloc-growth", UINT64_MAX)) return false;
+            opts.max_alloc_growth = n;
+        } else if (strcmp(arg, "--max-queued-growth-mb") == 0) {
+            if (!number("max-queued-growth-mb", UINT32_MAX)) return false;
+            opts.max_queued_growth_mb = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--max-session-growth") == 0) {
+            if (!number("max-session-growth", UINT32_MAX)) return false;
+            opts.max_session_growth = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--max-tick-p99-ms") == 0) {
+            if (!number("max-tick-p99-ms", UINT32_MAX)) return false;
+            opts.max_tick_p99_ms = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--max-relay-p99-ms") == 0) {
+            if (!number("max-relay-p99-ms", UINT32_MAX)) return false;
+            opts.max_relay_p99_ms = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--max-error-pct") == 0) {
+            char* end = nullptr;
+            double v = strtod(val, &end);
+            if (end == val || *end != '\0' || v < 0 || v > 100) {
+                fprintf(stderr, "Error: invalid max-error-pct '%s'\n", val);
+                return false;
+            }
+            opts.max_error_pct = v;
+        } else if (strcmp(arg, "--json") == 0) {
+            opts.json_path = val;
+        } else {
+            fprintf(stderr, "Error: unknown option '%s'\n", arg);
+            return false;
+        }
+    }
+
+    if (opts.ssh_host.empty() || opts.username.empty() || opts.password.empty()) {
+        fprintf(stderr, "Error: --server, --username and --password are required\n");
+        return false;
+    }
+    if (static_cast<uint32_t>(opts.forward_port) + opts.transports - 1 > 65535) {
+        fprintf(stderr, "Error: forward ports run past 65535\n");
+        return false;
+    }
+    if (opts.warmup_s >= opts.duration_s) {
+        fprintf(stderr, "Error: --warmup-s must be shorter than --duration-s\n");
+        return false;
+    }
+    if (opts.client_threads > opts.sessions) opts.client_threads = opts.sessions;
+    return true;
+}
@@ -0,0 +1,147 @@
+#include "stress.h"
+#include "logger.h"
+#include <memory>
+
+//
+// ── TargetServer ──────────────────────────────────────────────────────────────
+//
+// Every connection carries one pending buffer: a read fills it, POLLOUT
+// empties it, and the socket is polled for input only while it is empty —
+// so a peer's FIN is only seen once everything before it has gone back, and
+// is answered with ours, which is what the Bulk clients wait for.  An error
+// closes the connection.
+//
+
+namespace {
+
+constexpr size_t kConnBuffer = 16 * 1024;
+
+struct Conn {
+    SOCKET   s        = INVALID_SOCKET;
+    uint8_t  buf[kConnBuffer];
+    size_t   filled   = 0;
+    size_t   sent     = 0;
+};
+
+void CloseConn(std::unique_ptr<Conn>& c)
+{
+    ::closesocket(c->s);
+    c.reset();
+}
+
+} // namespace
+
+ErrorCode TargetServer::Start()
+{
+    m_listen = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (m_listen == INVALID_SOCKET) return ErrorCode::SocketError;
+
+    struct sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    addr.sin_port        = 0;
+    socklen_t len = static_cast<socklen_t>(sizeof(addr));
+    if (::bind(m_listen, reinterpret_cast<struct sockaddr*>(&addr), len) != 0 ||
+        ::listen(m_listen, SOMAXCONN) != 0 ||
+        ::getsockname(m_listen, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0 ||
+        !SetNonBlocking(m_listen))
+    {
+        Logger::Error("Target server setup failed: %d", LastSocketError());
+        ::closesocket(m_listen);
+        m_listen = INVALID_SOCKET;
+        return ErrorCode::SocketError;
+    }
+    m_port = ::ntohs(addr.sin_port);
+
+    m_thread = std::thread([this]() { Loop(); });
+    return ErrorCode::Success;
+}
+
+void TargetServer::Loop()
+{
+    std::vector<std::unique_ptr<Conn>> conns;
+    std::vector<PollFd>                fds;
+    std::vector<size_t>                map;   // fds[i + 1] → conns index
+
+    while (!m_stop.load())
+    {
+        fds.clear();
+        map.clear();
+        PollFd lfd{};
+        lfd.fd     = m_listen;
+        lfd.events = POLLIN;
+        fds.push_back(lfd);
+        for (size_t i = 0; i < conns.size(); ++i)
+        {
+            PollFd fd{};
+            fd.fd     = conns[i]->s;
+            fd.events = static_cast<short>(conns[i]->sent < conns[i]->filled ? POLLOUT : POLLIN);
+            fds.push_back(fd);
+            map.push_back(i);
+        }
+
+        if (PollSockets(fds.data(), fds.size(), 50) <= 0) continue;
+
+        for (size_t k = 1; k < fds.size(); ++k)
+        {
+            if (fds[k].revents == 0) continue;
+            std::unique_ptr<Conn>& c = conns[map[k - 1]];
+
+            if (c->sent < c->filled)
+            {
+                int w = ::send(c->s, reinterpret_cast<const char*>(c->buf + c->sent),
+                               static_cast<int>(c->filled - c->sent), kSendFlags);
+                if (w < 0 && WouldBlock(LastSocketError())) continue;
+                if (w <= 0) { CloseConn(c); continue; }
+                c->sent += static_cast<size_t>(w);
+                if (c->sent == c->filled) c->sent = c->filled = 0;
+                continue;
+            }
+
+            int n = ::recv(c->s, reinterpret_cast<char*>(c->buf), static_cast<int>(kConnBuffer), 0);
+            if (n < 0 && WouldBlock(LastSocketError())) continue;
+            if (n < 0) { CloseConn(c); continue; }
+            if (n == 0)
+            {
+                ::shutdown(c->s, SD_SEND);
+                CloseConn(c);
+                continue;
+            }
+            c->filled = static_cast<size_t>(n);
+            c->sent   = 0;
+        }
+
+        conns.erase(std::remove_if(conns.begin(), conns.end(),
+                                   [](const std::unique_ptr<Conn>& c) { return !c; }),
+                    conns.end());
+
+        if ((fds[0].revents & POLLIN) != 0)
+        {
+            for (;;)
+            {
+                SOCKET s = ::accept(m_listen, nullptr, nullptr);
+                if (s == INVALID_SOCKET) break;   // backlog drained
+                SetNonBlocking(s);
+                int nodelay = 1;
+                ::setsockopt(s, IPPROTO_TCP, TCP_NODELAY,
+                             reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+                auto c = std::make_unique<Conn>();
+                c->s = s;
+                conns.push_back(std::move(c));
+            }
+        }
+    }
+
+    for (auto& c : conns) ::closesocket(c->s);
+}
+
+void TargetServer::Stop()
+{
+    m_stop.store(true);
+    if (m_thread.joinable()) m_thread.join();
+    if (m_listen != INVALID_SOCKET)
+    {
+        ::closesocket(m_listen);
+        m_listen = INVALID_SOCKET;
+    }
+}
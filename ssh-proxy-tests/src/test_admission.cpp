@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "admission.h"
+#include <utility>
+
+// ── TokenBucket ───────────────────────────────────────────────────────────────
+
+TEST(TokenBucket, StartsFullAndRefillsAtTheRate) {
+    TokenBucket bucket(10, 3, 1000);   // 10/s, holding 3
+    EXPECT_TRUE(bucket.TryTake(1000));
+    EXPECT_TRUE(bucket.TryTake(1000));
+    EXPECT_TRUE(bucket.TryTake(1000));
+    EXPECT_FALSE(bucket.TryTake(1000));
+
+    EXPECT_FALSE(bucket.TryTake(1099));   // 0.99 of a token
+    EXPECT_TRUE(bucket.TryTake(1100));
+    EXPECT_FALSE(bucket.TryTake(1100));
+}
+
+TEST(TokenBucket, IdleTimeFillsOnlyToTheBurst) {
+    TokenBucket bucket(5, 0, 0);   // burst 0 = one second's worth
+    for (int i = 0; i < 5; ++i) EXPECT_TRUE(bucket.TryTake(0));
+    EXPECT_FALSE(bucket.TryTake(0));
+
+    uint64_t later = uint64_t{1} << 40;   // a very long gap must not overflow
+    for (int i = 0; i < 5; ++i) EXPECT_TRUE(bucket.TryTake(later));
+    EXPECT_FALSE(bucket.TryTake(later));
+}
+
+// ── AdmissionControl ──────────────────────────────────────────────────────────
+
+TEST(AdmissionControl, SessionLimitFreesOnRelease) {
+    ssh_proxy::AdmissionLimits limits;
+    limits.max_sessions = 2;
+    auto admission = AdmissionControl::Create(limits);
+
+    AdmissionTicket a = admission->Admit();
+    AdmissionTicket b = admission->Admit();
+    AdmissionTicket c = admission->Admit();
+    EXPECT_TRUE(a.admitted());
+    EXPECT_TRUE(b.admitted());
+    EXPECT_EQ(c.verdict(), AdmissionVerdict::SessionLimit);
+
+    a.Release();
+    a.Release();   // once only
+    EXPECT_EQ(admission->GetStats().active_sessions, 1u);
+    EXPECT_TRUE(admission->Admit().admitted());   // a temporary, gone at once
+
+    ssh_proxy::AdmissionStats st = admission->GetStats();
+    EXPECT_EQ(st.active_sessions, 1u);
+    EXPECT_EQ(st.admitted, 3u);
+    EXPECT_EQ(st.refused_sessions, 1u);
+}
+
+TEST(AdmissionControl, AcceptRateRefusesBeyondTheBurst) {
+    ssh_proxy::AdmissionLimits limits;
+    limits.accepts_per_sec = 2;
+    auto admission = AdmissionControl::Create(limits);
+
+    uint64_t now = 5000;
+    EXPECT_TRUE(admission->Admit(now).admitted());
+    EXPECT_TRUE(admission->Admit(now).admitted());
+    EXPECT_EQ(admission->Admit(now).verdict(), AdmissionVerdict::AcceptRate);
+    EXPECT_EQ(admission->GetStats().refused_rate, 1u);
+}
+
+TEST(AdmissionControl, TargetSlotsMoveWithTheTicket) {
+    ssh_proxy::AdmissionLimits limits;
+    limits.max_per_target = 1;
+    auto admission = AdmissionControl::Create(limits);
+
+    AdmissionTicket a = admission->Admit();
+    ASSERT_TRUE(a.LimitsTargets());
+    EXPECT_TRUE(a.ClaimTarget("10.0.0.1:443"));
+
+    AdmissionTicket moved = std::move(a);
+    a.Release();   // moved-from: holds nothing
+
+    AdmissionTicket b = admission->Admit();
+    EXPECT_FALSE(b.ClaimTarget("10.0.0.1:443"));
+    EXPECT_EQ(b.verdict(), AdmissionVerdict::TargetLimit);
+    AdmissionTicket other = admission->Admit();
+    EXPECT_TRUE(other.ClaimTarget("10.0.0.2:443"));
+
+    moved.Release();
+    AdmissionTicket c = admission->Admit();
+    EXPECT_TRUE(c.ClaimTarget("10.0.0.1:443"));
+    EXPECT_EQ(admission->GetStats().refused_target, 1u);
+}
+
+TEST(AdmissionControl, NoLimitsAdmitsEverything) {
+    auto admission = AdmissionControl::Create({});
+    AdmissionTicket t = admission->Admit();
+    EXPECT_TRUE(t.admitted());
+    EXPECT_FALSE(t.LimitsTargets());
+    EXPECT_TRUE(t.ClaimTarget("any:1"));
+    EXPECT_EQ(admission->GetStats().active_sessions, 1u);
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "buffer_pool.h"
+#include <cstring>
+
+TEST(BufferPool, AcquireRoundsUpToSizeClass) {
+    EXPECT_EQ(BufferPool::Acquire(1).capacity(),      BufferPool::kTinySlab);
+    EXPECT_EQ(BufferPool::Acquire(5000).capacity(),   BufferPool::kSmallSlab);
+    EXPECT_EQ(BufferPool::Acquire(20000).capacity(),  BufferPool::kLargeSlab);
+    EXPECT_EQ(BufferPool::Acquire(100000).capacity(), 100000u);
+}
+
+TEST(BufferPool, CommitAndConsumeMoveTheWindow) {
+    PooledBuffer buf = BufferPool::Acquire();
+    EXPECT_TRUE(buf.empty());
+    EXPECT_EQ(buf.tailroom(), BufferPool::kSmallSlab);
+
+    std::memcpy(buf.tail(), "abcdef", 6);
+    buf.Commit(6);
+    EXPECT_EQ(buf.size(), 6u);
+
+    buf.Consume(2);
+    ASSERT_EQ(buf.size(), 4u);
+    EXPECT_EQ(std::memcmp(buf.data(), "cdef", 4), 0);
+}
+
+TEST(BufferPool, CopyOfHoldsTheBytes) {
+    const uint8_t src[] = {1, 2, 3};
+    PooledBuffer buf = BufferPool::CopyOf(src, sizeof(src));
+    ASSERT_EQ(buf.size(), 3u);
+    EXPECT_EQ(buf.data()[2], uint8_t{3});
+}
+
+TEST(BufferPool, CopiesShareTheSlab) {
+    PooledBuffer a = BufferPool::CopyOf(reinterpret_cast<const uint8_t*>("xy"), 2);
+    PooledBuffer b = a;
+    a.Reset();
+    ASSERT_TRUE(static_cast<bool>(b));
+    EXPECT_EQ(b.size(), 2u);
+    EXPECT_EQ(b.data()[0], uint8_t{'x'});
+}
+
+TEST(BufferPool, ReleasedSlabIsReused) {
+    Slab* first = nullptr;
+    {
+        PooledBuffer buf = BufferPool::Acquire();
+        buf.Commit(10);
+        first = buf.Detach();
+        PooledBuffer::Adopt(first);   // drop the reference → back to this thread's freelist
+    }
+    PooledBuffer again = BufferPool::Acquire();
+    EXPECT_EQ(again.Detach(), first);
+    PooledBuffer::Adopt(first);
+    // A recycled slab starts empty.
+    EXPECT_TRUE(BufferPool::Acquire().empty());
+}
+
+// ── RecvSizer ─────────────────────────────────────────────────────────────────
+
+TEST(RecvSizer, GrowsAfterConsecutiveFullReads) {
+    RecvSizer sizer(4096, 65536);
+    EXPECT_EQ(sizer.Next(), 4096u);
+    for (int i = 0; i < RecvSizer::kGrowAfter; ++i) sizer.Record(sizer.Next());
+    EXPECT_EQ(sizer.Next(), 8192u);
+
+    for (int step = 0; step < 10; ++step)
+        for (int i = 0; i < RecvSizer::kGrowAfter; ++i) sizer.Record(sizer.Next());
+    EXPECT_EQ(sizer.Next(), 65536u);   // capped at max
+}
+
+TEST(RecvSizer, PartialReadResetsGrowth) {
+    RecvSizer sizer(4096, 65536);
+    sizer.Record(4096);
+    sizer.Record(2048);   // half full — neither grows nor shrinks
+    sizer.Record(4096);
+    EXPECT_EQ(sizer.Next(), 4096u);
+}
+
+TEST(RecvSizer, ShrinksAfterSmallReads) {
+    RecvSizer sizer(4096, 16384);
+    for (int step = 0; step < 4; ++step)
+        for (int i = 0; i < RecvSizer::kGrowAfter; ++i) sizer.Record(sizer.Next());
+    ASSERT_EQ(sizer.Next(), 16384u);
+
+    for (int i = 0; i < RecvSizer::kShrinkAfter; ++i) sizer.Record(10);
+    EXPECT_EQ(sizer.Next(), 8192u);
+    for (int step = 0; step < 4; ++step)
+        for (int i = 0; i < RecvSizer::kShrinkAfter; ++i) sizer.Record(10);
+    EXPECT_EQ(sizer.Next(), 4096u);    // floored at min
+}
@@ -31,6 +31,11 @@ TEST_F(ParseCLITest, AllRequiredArgsSucceeds) {
     EXPECT_EQ(args.connect_timeout_ms,    uint32_t{10000});
     EXPECT_EQ(args.keepalive_interval_ms, uint32_t{30000});
     EXPECT_EQ(args.log_level,             ssh_proxy::LogLevel::Info);
+    EXPECT_EQ(args.log_entries,           0u);
+    EXPECT_EQ(args.transports,            uint32_t{1});
+    EXPECT_EQ(args.metrics_interval_ms,   uint32_t{0});
+    EXPECT_EQ(args.reconnect_ms,          uint32_t{0});
+    EXPECT_FALSE(args.standby);
 }
 
 TEST_F(ParseCLITest, MissingServerReturnsFalse) {
@@ -93,6 +98,111 @@ TEST_F(ParseCLITest, ForwardPortShortFlag) {
     EXPECT_EQ(args.forward_port, uint16_t{8888});
 }
 
+TEST_F(ParseCLITest, TransportsParsed) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u",
+                       "--password", "p", "--transports", "4"}, args));
+    EXPECT_EQ(args.transports, uint32_t{4});
+}
+
+TEST_F(ParseCLITest, InvalidTransportsReturnsFalse) {
+    CliArgs args;
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u",
+                        "--password", "p", "--transports", "0"}, args));
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u",
+                        "--password", "p", "--transports", "65"}, args));
+}
+
+TEST_F(ParseCLITest, MetricsIntervalParsed) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u",
+                       "--password", "p", "--metrics-interval", "5000"}, args));
+    EXPECT_EQ(args.metrics_interval_ms, uint32_t{5000});
+}
+
+TEST_F(ParseCLITest, ReconnectParsed) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                       "--reconnect-ms", "250", "--reconnect-max-ms", "8000",
+                       "--standby", "1"}, args));
+    EXPECT_EQ(args.reconnect_ms,     uint32_t{250});
+    EXPECT_EQ(args.reconnect_max_ms, uint32_t{8000});
+    EXPECT_TRUE(args.standby);
+}
+
+TEST_F(ParseCLITest, StandbyWithoutReconnectReturnsFalse) {
+    CliArgs args;
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u",
+                        "--password", "p", "--standby", "1"}, args));
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                        "--reconnect-ms", "500", "--standby", "yes"}, args));
+}
+
+TEST_F(ParseCLITest, KeyOrAgentReplacesPassword) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u",
+                       "-i", "C:\\keys\\id_ed25519", "--key-passphrase", "pp"}, args));
+    EXPECT_EQ(args.key_file,       "C:\\keys\\id_ed25519");
+    EXPECT_EQ(args.key_passphrase, "pp");
+    EXPECT_TRUE(args.password.empty());
+
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u", "--agent", "1"}, args));
+    EXPECT_TRUE(args.agent);
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u", "--agent", "0"}, args));
+}
+
+TEST_F(ParseCLITest, AlgorithmFlags) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p"}, args));
+    EXPECT_TRUE(args.ciphers.empty());
+    EXPECT_FALSE(args.compress);
+
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                       "--ciphers", "aes256-gcm@openssh.com,aes256-ctr",
+                       "--kex", "curve25519-sha256", "--compress", "1"}, args));
+    EXPECT_EQ(args.ciphers, "aes256-gcm@openssh.com,aes256-ctr");
+    EXPECT_EQ(args.kex,     "curve25519-sha256");
+    EXPECT_TRUE(args.compress);
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                        "--compress", "yes"}, args));
+}
+
+TEST_F(ParseCLITest, WarmTargetFlags) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                       "--warm-targets", "2", "--reuse-sockets", "1"}, args));
+    EXPECT_EQ(args.warm_per_target, 2u);
+    EXPECT_TRUE(args.reuse_sockets);
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                        "--warm-targets", "-1"}, args));
+}
+
+TEST_F(ParseCLITest, IoThreadFlags) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p"}, args));
+    EXPECT_EQ(args.io_workers, 0u);
+    EXPECT_EQ(args.io_affinity, ssh_proxy::IoAffinity::None);
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                       "--io-workers", "6", "--io-affinity", "node"}, args));
+    EXPECT_EQ(args.io_workers, 6u);
+    EXPECT_EQ(args.io_affinity, ssh_proxy::IoAffinity::NumaNode);
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                        "--io-affinity", "all"}, args));
+}
+
+TEST_F(ParseCLITest, AdmissionFlags) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                       "--max-sessions", "500", "--accept-rate", "50",
+                       "--accept-burst", "200", "--max-per-target", "8"}, args));
+    EXPECT_EQ(args.max_sessions, 500u);
+    EXPECT_EQ(args.accept_rate, 50u);
+    EXPECT_EQ(args.accept_burst, 200u);
+    EXPECT_EQ(args.max_per_target, 8u);
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                        "--accept-burst", "10"}, args));
+}
+
 TEST_F(ParseCLITest, ShortUsernameFlag) {
     CliArgs args;
     ASSERT_TRUE(Parse({"prog", "--server", "h", "-u", "alice",
@@ -128,6 +238,34 @@ TEST_F(ParseCLITest, LogLevelError) {
     EXPECT_EQ(args.log_level, ssh_proxy::LogLevel::Error);
 }
 
+TEST_F(ParseCLITest, LogEntries) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u",
+                       "--password", "p", "--log-entries", "4096"}, args));
+    EXPECT_EQ(args.log_entries, 4096u);
+}
+
+TEST_F(ParseCLITest, ForwardsSocksAndFixedTargets) {
+    CliArgs args;
+    ASSERT_TRUE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                       "--forward", "1081",
+                       "--forward", "2222:db.internal:5432",
+                       "--forward", "3333:[::1]:80"}, args));
+    ASSERT_EQ(args.forwards.size(), 3u);
+    EXPECT_EQ(args.forwards[0].remote_port, uint16_t{1081});
+    EXPECT_TRUE(args.forwards[0].target_host.empty());
+    EXPECT_EQ(args.forwards[1].remote_port, uint16_t{2222});
+    EXPECT_EQ(args.forwards[1].target_host, "db.internal");
+    EXPECT_EQ(args.forwards[1].target_port, uint16_t{5432});
+    EXPECT_EQ(args.forwards[2].target_host, "::1");
+    EXPECT_EQ(args.forwards[2].target_port, uint16_t{80});
+
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                        "--forward", "2222:host"}, args));
+    EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u", "--password", "p",
+                        "--forward", "0:host:80"}, args));
+}
+
 TEST_F(ParseCLITest, InvalidLogLevelReturnsFalse) {
     CliArgs args;
     EXPECT_FALSE(Parse({"prog", "--server", "h", "--username", "u",
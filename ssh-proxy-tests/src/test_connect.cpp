@@ -2,6 +2,7 @@
 #include "ssh_proxy.h"
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 // These tests exercise the ssh_proxy::Connect constructor against an
 // unreachable endpoint.  They use a very short timeout (200 ms) so the
@@ -52,3 +53,17 @@ TEST(ConnectTest, ThrowsOnUnresolvableHost) {
         std::runtime_error
     );
 }
+
+TEST(ConnectTest, ThrowsOnOverlappingRemoteForward) {
+    // Rejected by validation, before any connection is attempted.
+    std::vector<ssh_proxy::RemoteForward> forwards(1);
+    forwards[0].remote_port = 1081;   // forward_port 1080 + transport 1
+    try {
+        ssh_proxy::Connect("127.0.0.1", "user", "pass", 1, 1080, 200,
+            30000, ssh_proxy::LogLevel::Info, /*transport_count=*/ 2,
+            {}, {}, {}, {}, {}, {}, forwards);
+        FAIL() << "Expected std::runtime_error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_NE(std::string(e.what()).find("overlaps forward_port"), std::string::npos);
+    }
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include "dns_resolver.h"
+#include "async_io.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+DnsCache::Entry Positive()
+{
+    DnsCache::Entry e;
+    auto list = std::make_shared<AddressList>();
+    ResolvedAddress ra;
+    ra.addr.ss_family = AF_INET;
+    ra.len = static_cast<int>(sizeof(sockaddr_in));
+    list->push_back(ra);
+    e.addresses = std::move(list);
+    return e;
+}
+
+DnsCache::Entry Negative()
+{
+    DnsCache::Entry e;
+    e.status = ErrorCode::DnsResolutionFailed;
+    return e;
+}
+
+// Answers from DnsResolver, counted as they arrive on the workers.
+struct Answers {
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::vector<ErrorCode>  codes;
+
+    DnsResolver::OnResolved Callback()
+    {
+        return [this](ErrorCode ec, std::shared_ptr<const AddressList>)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            codes.push_back(ec);
+            cv.notify_all();
+        };
+    }
+    // Waits for `n` answers, then a little longer for any extra one.
+    size_t WaitFor(size_t n)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::seconds(15), [&] { return codes.size() >= n; });
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        lock.lock();
+        return codes.size();
+    }
+};
+
+void RestoreResolverDefaults()
+{
+    DnsResolver::Configure(DnsResolver::kDefaultMaxEntries, DnsResolver::kDefaultTtlMs,
+                           DnsResolver::kDefaultNegativeTtlMs, DnsResolver::kDefaultTimeoutMs);
+    DnsResolver::ClearCache();
+}
+
+} // namespace
+
+TEST(DnsCache, HitReturnsInsertedEntry) {
+    DnsCache cache(16, 1000, 100);
+    cache.Insert("example.com", Positive(), 0);
+
+    DnsCache::Entry out;
+    ASSERT_TRUE(cache.Lookup("example.com", 500, out));
+    EXPECT_EQ(out.status, ErrorCode::Success);
+    ASSERT_TRUE(out.addresses != nullptr);
+    EXPECT_EQ(out.addresses->size(), 1u);
+    EXPECT_FALSE(cache.Lookup("other.com", 500, out));
+}
+
+TEST(DnsCache, PositiveEntryExpiresAfterTtl) {
+    DnsCache cache(16, 1000, 100);
+    cache.Insert("example.com", Positive(), 0);
+
+    DnsCache::Entry out;
+    EXPECT_FALSE(cache.Lookup("example.com", 1000, out));
+    EXPECT_EQ(cache.size(), 0u);   // expired entry removed on lookup
+}
+
+TEST(DnsCache, NegativeEntryUsesNegativeTtl) {
+    DnsCache cache(16, 1000, 100);
+    cache.Insert("missing.example", Negative(), 0);
+
+    DnsCache::Entry out;
+    ASSERT_TRUE(cache.Lookup("missing.example", 99, out));
+    EXPECT_EQ(out.status, ErrorCode::DnsResolutionFailed);
+    EXPECT_EQ(out.addresses, nullptr);
+    EXPECT_FALSE(cache.Lookup("missing.example", 100, out));
+
+    DnsCache no_negative(16, 1000, 0);
+    no_negative.Insert("missing.example", Negative(), 0);
+    EXPECT_EQ(no_negative.size(), 0u);
+}
+
+TEST(DnsCache, EvictsLeastRecentlyUsed) {
+    DnsCache cache(2, 1000, 100);
+    cache.Insert("a", Positive(), 0);
+    cache.Insert("b", Positive(), 0);
+
+    DnsCache::Entry out;
+    ASSERT_TRUE(cache.Lookup("a", 1, out));   // "b" is now the oldest
+    cache.Insert("c", Positive(), 2);
+
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_TRUE(cache.Lookup("a", 3, out));
+    EXPECT_FALSE(cache.Lookup("b", 3, out));
+    EXPECT_TRUE(cache.Lookup("c", 3, out));
+}
+
+TEST(DnsCache, KeyIgnoresCaseAndTrailingDot) {
+    DnsCache cache(16, 1000, 100);
+    cache.Insert("Example.COM.", Positive(), 0);
+
+    DnsCache::Entry out;
+    EXPECT_TRUE(cache.Lookup("example.com", 1, out));
+    EXPECT_EQ(DnsCache::NormalizeHost("Host.Example."), "host.example");
+}
+
+// Whichever comes first — the answer or the 1 ms timeout — each waiter is
+// answered exactly once, and a name under .invalid never succeeds.
+TEST(DnsResolver, TimeoutAnswersEachWaiterOnce) {
+    ASSERT_EQ(IoEngine::Init(0), ErrorCode::Success);
+    DnsResolver::ClearCache();
+    DnsResolver::Configure(DnsResolver::kDefaultMaxEntries, DnsResolver::kDefaultTtlMs, 0, 1);
+
+    Answers answers;
+    for (int i = 0; i < 3; ++i)
+        DnsResolver::Resolve("dns-timeout-test.invalid", answers.Callback());
+    EXPECT_EQ(answers.WaitFor(3), 3u);
+    for (ErrorCode ec : answers.codes) EXPECT_EQ(ec, ErrorCode::DnsResolutionFailed);
+
+    RestoreResolverDefaults();
+}
+
+// CancelAll answers every waiter of a query in flight with Shutdown; one
+// that completed first keeps its own answer, but none is answered twice.
+TEST(DnsResolver, CancelAllAnswersEachWaiterOnce) {
+    ASSERT_EQ(IoEngine::Init(0), ErrorCode::Success);
+    DnsResolver::ClearCache();
+    DnsResolver::Configure(DnsResolver::kDefaultMaxEntries, DnsResolver::kDefaultTtlMs, 0);
+
+    Answers answers;
+    DnsResolver::Resolve("dns-cancel-test-a.invalid", answers.Callback());
+    DnsResolver::Resolve("dns-cancel-test-a.invalid", answers.Callback());
+    DnsResolver::Resolve("dns-cancel-test-b.invalid", answers.Callback());
+    DnsResolver::CancelAll();
+    EXPECT_EQ(answers.WaitFor(3), 3u);
+    for (ErrorCode ec : answers.codes)
+        EXPECT_TRUE(ec == ErrorCode::Shutdown || ec == ErrorCode::DnsResolutionFailed)
+            << ErrorCodeToString(ec);
+
+    RestoreResolverDefaults();
+}
@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include "inline_function.h"
+#include <memory>
+#include <string>
+
+TEST(InlineFunction, InvokesWithArgumentsAndResult) {
+    int base = 40;
+    InlineFunction<int(int), 32> add([base](int x) { return base + x; });
+    ASSERT_TRUE(add);
+    EXPECT_EQ(add(2), 42);
+
+    InlineFunction<void(std::string&), 16> append([](std::string& s) { s += "!"; });
+    std::string s = "hi";
+    append(s);
+    EXPECT_EQ(s, "hi!");
+}
+
+TEST(InlineFunction, MoveTransfersTheCallableAndEmptiesTheSource) {
+    auto owned = std::make_shared<int>(7);
+    InlineFunction<int(), 32> a([owned]() { return *owned; });
+    EXPECT_EQ(owned.use_count(), 2);
+
+    InlineFunction<int(), 32> b(std::move(a));
+    EXPECT_FALSE(a);
+    ASSERT_TRUE(b);
+    EXPECT_EQ(b(), 7);
+    EXPECT_EQ(owned.use_count(), 2);   // moved, not copied
+
+    a = std::move(b);
+    EXPECT_FALSE(b);
+    EXPECT_EQ(a(), 7);
+    EXPECT_EQ(owned.use_count(), 2);
+}
+
+TEST(InlineFunction, ResetAndReassignDestroyTheCapture) {
+    auto owned = std::make_shared<int>(1);
+    InlineFunction<void(), 32> f([owned]() {});
+    EXPECT_EQ(owned.use_count(), 2);
+    f = nullptr;
+    EXPECT_FALSE(f);
+    EXPECT_EQ(owned.use_count(), 1);
+
+    f = [owned]() {};
+    EXPECT_EQ(owned.use_count(), 2);
+    f = []() {};
+    EXPECT_EQ(owned.use_count(), 1);
+    {
+        InlineFunction<void(), 32> scoped([owned]() {});
+        EXPECT_EQ(owned.use_count(), 2);
+    }
+    EXPECT_EQ(owned.use_count(), 1);
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "instrumentation.h"
+#include <cstdint>
+#include <limits>
+
+TEST(LatencyHistogram, BucketsCoverEveryValueWithinAnEighth) {
+    for (uint64_t v = 1; v < (uint64_t{1} << 40); v = v * 3 / 2 + 1)
+    {
+        size_t b = LatencyHistogram::BucketOf(v);
+        ASSERT_LT(b, LatencyHistogram::kBucketCount);
+        uint64_t upper = LatencyHistogram::BucketUpperBound(b);
+        uint64_t lower = LatencyHistogram::BucketUpperBound(b - 1) + 1;
+        EXPECT_LE(lower, v);
+        EXPECT_GE(upper, v);
+        EXPECT_LE(upper - lower, v / 8) << "value " << v;
+    }
+    EXPECT_EQ(LatencyHistogram::BucketOf(0), 0u);
+    EXPECT_EQ(LatencyHistogram::BucketOf(std::numeric_limits<uint64_t>::max()),
+              LatencyHistogram::kBucketCount - 1);
+    EXPECT_EQ(LatencyHistogram::BucketUpperBound(LatencyHistogram::kBucketCount - 1),
+              std::numeric_limits<uint64_t>::max());
+}
+
+TEST(LatencyHistogram, EmptySummaryIsZero) {
+    LatencyHistogram h;
+    ssh_proxy::LatencyStats st = h.Summarize();
+    EXPECT_EQ(st.count, 0u);
+    EXPECT_EQ(st.p99_us, 0u);
+    EXPECT_EQ(st.max_us, 0u);
+}
+
+TEST(LatencyHistogram, PercentilesOfUniformRecords) {
+    LatencyHistogram h;
+    for (uint64_t v = 1; v <= 1000; ++v) h.Record(v);
+
+    ssh_proxy::LatencyStats st = h.Summarize();
+    EXPECT_EQ(st.count, 1000u);
+    EXPECT_DOUBLE_EQ(st.mean_us, 500.5);
+    EXPECT_EQ(st.max_us, 1000u);
+    EXPECT_GE(st.p50_us, 500u);
+    EXPECT_LE(st.p50_us, 500u + 500u / 8);
+    EXPECT_GE(st.p99_us, 990u);
+    EXPECT_LE(st.p99_us, 1000u);           // capped at the observed maximum
+    EXPECT_LE(st.p90_us, st.p99_us);
+    EXPECT_LE(st.p99_us, st.p999_us);
+
+    h.Reset();
+    EXPECT_EQ(h.Summarize().count, 0u);
+}
+
+TEST(LatencyHistogram, SmallValuesAreExact) {
+    LatencyHistogram h;
+    for (int i = 0; i < 99; ++i) h.Record(3);
+    h.Record(7);
+
+    ssh_proxy::LatencyStats st = h.Summarize();
+    EXPECT_EQ(st.p50_us, 3u);
+    EXPECT_EQ(st.p99_us, 3u);
+    EXPECT_EQ(st.p999_us, 7u);
+    EXPECT_EQ(st.max_us, 7u);
+}
+
+TEST(Instrumentation, RecordLatencyFeedsOnlyItsPoint) {
+    Instrumentation::Reset();
+    Instrumentation::RecordLatency(LatencyPoint::DnsResolve, 250);
+
+    EXPECT_EQ(Instrumentation::Summarize(LatencyPoint::DnsResolve).count, 1u);
+    EXPECT_EQ(Instrumentation::Summarize(LatencyPoint::DnsResolve).max_us, 250u);
+    EXPECT_EQ(Instrumentation::Summarize(LatencyPoint::TcpConnect).count, 0u);
+    Instrumentation::Reset();
+}
+
+TEST(Instrumentation, QpcToUsHandlesLongAndNegativeIntervals) {
+    EXPECT_EQ(QpcToUs(-5), 0u);
+    int64_t t0 = QpcNow();
+    EXPECT_GE(QpcNow(), t0);
+
+    // A year of ticks must not overflow the microsecond conversion.
+    int64_t ticks_per_s = static_cast<int64_t>(1.0 / QpcToSeconds(1) + 0.5);
+    uint64_t year_us    = uint64_t{365} * 86400 * 1000000;
+    EXPECT_EQ(QpcToUs(ticks_per_s * 365 * 86400), year_us);
+}
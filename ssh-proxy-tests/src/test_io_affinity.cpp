@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include "io_affinity.h"
+
+TEST(IoAffinity, NonePinsNothing) {
+    ProcessorLayout layout;
+    layout.available = 0xFF;
+    IoAffinityPlan plan = PlanIoAffinity(IoAffinity::None, layout, 8, 1);
+    EXPECT_TRUE(plan.workers.empty());
+    EXPECT_EQ(plan.io_threads, 0u);
+}
+
+TEST(IoAffinity, CoreReservesTheLowestProcessorsAndGivesEachWorkerOne) {
+    ProcessorLayout layout;
+    layout.available = 0xF6;   // processors 1, 2, 4, 5, 6, 7
+    IoAffinityPlan plan = PlanIoAffinity(IoAffinity::Core, layout, 6, 2);
+
+    EXPECT_EQ(plan.io_threads, 0x06u);   // 1 and 2
+    ASSERT_EQ(plan.workers.size(), 6u);
+    EXPECT_EQ(plan.workers[0], 0x10u);
+    EXPECT_EQ(plan.workers[1], 0x20u);
+    EXPECT_EQ(plan.workers[2], 0x40u);
+    EXPECT_EQ(plan.workers[3], 0x80u);
+    EXPECT_EQ(plan.workers[4], 0x10u);   // more workers than processors: wraps
+    EXPECT_EQ(plan.workers[5], 0x20u);
+}
+
+TEST(IoAffinity, NumaNodeSpreadsWorkersOverNodesWithoutTheReservedProcessors) {
+    ProcessorLayout layout;
+    layout.available = 0xFF;
+    layout.nodes     = { 0x0F, 0xF0 };
+    IoAffinityPlan plan = PlanIoAffinity(IoAffinity::NumaNode, layout, 3, 1);
+
+    EXPECT_EQ(plan.io_threads, 0x01u);
+    ASSERT_EQ(plan.workers.size(), 3u);
+    EXPECT_EQ(plan.workers[0], 0x0Eu);
+    EXPECT_EQ(plan.workers[1], 0xF0u);
+    EXPECT_EQ(plan.workers[2], 0x0Eu);
+
+    // Without node information every worker gets all the rest.
+    layout.nodes.clear();
+    plan = PlanIoAffinity(IoAffinity::NumaNode, layout, 2, 1);
+    ASSERT_EQ(plan.workers.size(), 2u);
+    EXPECT_EQ(plan.workers[0], 0xFEu);
+    EXPECT_EQ(plan.workers[1], 0xFEu);
+}
+
+TEST(IoAffinity, AlwaysLeavesAProcessorForTheWorkers) {
+    ProcessorLayout layout;
+    layout.available = 0x03;
+    IoAffinityPlan plan = PlanIoAffinity(IoAffinity::Core, layout, 2, 4);
+    EXPECT_EQ(plan.io_threads, 0x01u);
+    ASSERT_EQ(plan.workers.size(), 2u);
+    EXPECT_EQ(plan.workers[0], 0x02u);
+
+    // A single processor is shared, so nothing is reserved.
+    layout.available = 0x01;
+    plan = PlanIoAffinity(IoAffinity::Core, layout, 1, 1);
+    EXPECT_EQ(plan.io_threads, 0u);
+    ASSERT_EQ(plan.workers.size(), 1u);
+    EXPECT_EQ(plan.workers[0], 0x01u);
+}
@@ -0,0 +1,367 @@
+#include <gtest/gtest.h>
+#include "async_io.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// The contract every IoEngine backend (IOCP, epoll) keeps: completions run
+// on a worker, never on the caller's stack, and a loopback connect / send /
+// recv / cancel sequence reports the same results on either.
+
+namespace {
+
+// One completion's result, handed from the worker to the test thread.
+struct Completed {
+    std::mutex              mutex;
+    std::condition_variable cv;
+    bool                    done  = false;
+    DWORD                   bytes = 0;
+    ErrorCode               ec    = ErrorCode::Success;
+
+    void Set(DWORD b, ErrorCode e)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bytes = b;
+        ec    = e;
+        done  = true;
+        cv.notify_all();
+    }
+    bool Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool ok = cv.wait_for(lock, std::chrono::seconds(5), [this] { return done; });
+        done = false;
+        return ok;
+    }
+};
+
+void Arm(IoContext& ctx, IoOp op, SOCKET s, Completed& c)
+{
+    ctx.op       = op;
+    ctx.socket   = s;
+    ctx.callback = [&c](IoContext*, DWORD bytes, ErrorCode ec) { c.Set(bytes, ec); };
+}
+
+// A listener on an ephemeral loopback port.
+sockaddr_in Listen(WinSocket& listener)
+{
+    listener = WinSocket(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    socklen_t addr_len   = sizeof(addr);
+    ::bind(listener.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    ::listen(listener.get(), 1);
+    ::getsockname(listener.get(), reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    return addr;
+}
+
+thread_local bool t_in_work = false;
+
+} // namespace
+
+TEST(IoEngine, PostWorkRunsOnAWorkerThread) {
+    ASSERT_EQ(IoEngine::Init(0), ErrorCode::Success);
+
+    Completed c;
+    std::thread::id ran_on;
+    IoEngine::PostWork([&]() { ran_on = std::this_thread::get_id(); c.Set(0, ErrorCode::Success); });
+    ASSERT_TRUE(c.Wait());
+    EXPECT_NE(ran_on, std::this_thread::get_id());
+}
+
+TEST(IoEngine, PostWorkAfterWaitsForTheDelay) {
+    ASSERT_EQ(IoEngine::Init(0), ErrorCode::Success);
+
+    Completed c;
+    auto start = std::chrono::steady_clock::now();
+    IoEngine::PostWorkAfter(50, [&c]() { c.Set(0, ErrorCode::Success); });
+    ASSERT_TRUE(c.Wait());
+    // Some slack for timer granularity.
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(40));
+}
+
+TEST(IoEngine, LoopbackConnectSendRecvCancel) {
+    ASSERT_EQ(IoEngine::Init(0), ErrorCode::Success);
+
+    WinSocket listener(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    ASSERT_TRUE(listener);
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    socklen_t addr_len   = sizeof(addr);
+    ASSERT_EQ(::bind(listener.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(::listen(listener.get(), 1), 0);
+    ASSERT_EQ(::getsockname(listener.get(), reinterpret_cast<sockaddr*>(&addr), &addr_len), 0);
+
+    ErrorCode open_ec = ErrorCode::Success;
+    SOCKET s = IoEngine::OpenSocket(AF_INET, open_ec);
+    ASSERT_NE(s, INVALID_SOCKET) << ErrorCodeToString(open_ec);
+
+    Completed c;
+    IoContext connect_ctx;
+    Arm(connect_ctx, IoOp::Connect, s, c);
+    ASSERT_EQ(IoEngine::StartConnect(&connect_ctx, reinterpret_cast<sockaddr*>(&addr),
+                                     static_cast<int>(sizeof(addr))), ErrorCode::Success);
+    WinSocket peer(::accept(listener.get(), nullptr, nullptr));
+    ASSERT_TRUE(peer);
+    ASSERT_TRUE(c.Wait());
+    ASSERT_EQ(c.ec, ErrorCode::Success);
+    IoEngine::FinishConnect(s);
+
+    // A gathered send arrives as one byte stream.
+    char part1[] = "hel";
+    char part2[] = "lo";
+    IoBuffer bufs[2] = { MakeIoBuffer(part1, 3), MakeIoBuffer(part2, 2) };
+    IoContext send_ctx;
+    Arm(send_ctx, IoOp::Send, s, c);
+    ASSERT_EQ(IoEngine::StartSend(&send_ctx, bufs, 2), ErrorCode::Success);
+    ASSERT_TRUE(c.Wait());
+    EXPECT_EQ(c.ec, ErrorCode::Success);
+    EXPECT_EQ(c.bytes, 5u);
+
+    char got[8] = {};
+    int  have   = 0;
+    while (have < 5)
+    {
+        int n = static_cast<int>(::recv(peer.get(), got + have, 5 - have, 0));
+        ASSERT_GT(n, 0);
+        have += n;
+    }
+    EXPECT_EQ(std::memcmp(got, "hello", 5), 0);
+
+    // A recv started before the data arrives completes when it does.
+    char in[16] = {};
+    IoContext recv_ctx;
+    Arm(recv_ctx, IoOp::Recv, s, c);
+    recv_ctx.buffer = MakeIoBuffer(in, sizeof(in));
+    ASSERT_EQ(IoEngine::StartRecv(&recv_ctx), ErrorCode::Success);
+    ASSERT_EQ(::send(peer.get(), "ok", 2, 0), 2);
+    ASSERT_TRUE(c.Wait());
+    EXPECT_EQ(c.ec, ErrorCode::Success);
+    ASSERT_EQ(c.bytes, 2u);
+    EXPECT_EQ(std::memcmp(in, "ok", 2), 0);
+
+    // CancelIo aborts a pending recv with Shutdown and leaves the socket open.
+    Arm(recv_ctx, IoOp::Recv, s, c);
+    ASSERT_EQ(IoEngine::StartRecv(&recv_ctx), ErrorCode::Success);
+    IoEngine::CancelIo(s);
+    ASSERT_TRUE(c.Wait());
+    EXPECT_EQ(c.ec, ErrorCode::Shutdown);
+
+    // The peer's FIN is a zero-byte Success.
+    Arm(recv_ctx, IoOp::Recv, s, c);
+    ASSERT_EQ(IoEngine::StartRecv(&recv_ctx), ErrorCode::Success);
+    ::shutdown(peer.get(), SD_SEND);
+    ASSERT_TRUE(c.Wait());
+    EXPECT_EQ(c.ec, ErrorCode::Success);
+    EXPECT_EQ(c.bytes, 0u);
+
+    IoEngine::CloseSocket(s);
+}
+
+// An operation that can finish at once (the data is already there) still
+// completes off the stack of the callback that started it.
+TEST(IoEngine, ImmediateCompletionIsNotOnTheStartersStack) {
+    ASSERT_EQ(IoEngine::Init(0), ErrorCode::Success);
+
+    WinSocket listener;
+    sockaddr_in addr = Listen(listener);
+    ASSERT_TRUE(listener);
+
+    ErrorCode open_ec = ErrorCode::Success;
+    SOCKET s = IoEngine::OpenSocket(AF_INET, open_ec);
+    ASSERT_NE(s, INVALID_SOCKET) << ErrorCodeToString(open_ec);
+    Completed c;
+    IoContext connect_ctx;
+    Arm(connect_ctx, IoOp::Connect, s, c);
+    ASSERT_EQ(IoEngine::StartConnect(&connect_ctx, reinterpret_cast<sockaddr*>(&addr),
+                                     static_cast<int>(sizeof(addr))), ErrorCode::Success);
+    WinSocket peer(::accept(listener.get(), nullptr, nullptr));
+    ASSERT_TRUE(peer);
+    ASSERT_TRUE(c.Wait());
+    ASSERT_EQ(c.ec, ErrorCode::Success);
+    IoEngine::FinishConnect(s);
+
+    ASSERT_EQ(::send(peer.get(), "x", 1, 0), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));   // let it arrive
+
+    char in[4] = {};
+    bool      in_starter = true;
+    ErrorCode started    = ErrorCode::SocketError;
+    Completed done;
+    IoContext recv_ctx;
+    recv_ctx.op     = IoOp::Recv;
+    recv_ctx.socket = s;
+    recv_ctx.buffer = MakeIoBuffer(in, sizeof(in));
+    recv_ctx.callback = [&](IoContext*, DWORD bytes, ErrorCode ec)
+    {
+        in_starter = t_in_work;
+        done.Set(bytes, ec);
+    };
+    IoEngine::PostWork([&]()
+    {
+        t_in_work = true;
+        started   = IoEngine::StartRecv(&recv_ctx);
+        t_in_work = false;
+    });
+    ASSERT_TRUE(done.Wait());
+    EXPECT_EQ(started, ErrorCode::Success);
+    EXPECT_FALSE(in_starter);
+    EXPECT_EQ(done.ec, ErrorCode::Success);
+    EXPECT_EQ(done.bytes, 1u);
+
+    IoEngine::CloseSocket(s);
+}
+
+// Sockets driven from several threads at once stay independent: each
+// thread's recvs and sends complete with its own data while the others
+// start, finish and close theirs.
+TEST(IoEngine, ConcurrentSocketsCompleteIndependently) {
+    ASSERT_EQ(IoEngine::Init(0), ErrorCode::Success);
+
+    constexpr int kThreads = 8;
+    constexpr int kRounds  = 200;
+    WinSocket listener;
+    sockaddr_in addr = Listen(listener);
+    ASSERT_TRUE(listener);
+    ::listen(listener.get(), kThreads);
+
+    SOCKET    sockets[kThreads];
+    WinSocket peers[kThreads];
+    for (int i = 0; i < kThreads; ++i)
+    {
+        ErrorCode open_ec = ErrorCode::Success;
+        sockets[i] = IoEngine::OpenSocket(AF_INET, open_ec);
+        ASSERT_NE(sockets[i], INVALID_SOCKET) << ErrorCodeToString(open_ec);
+        Completed c;
+        IoContext connect_ctx;
+        Arm(connect_ctx, IoOp::Connect, sockets[i], c);
+        ASSERT_EQ(IoEngine::StartConnect(&connect_ctx, reinterpret_cast<sockaddr*>(&addr),
+                                         static_cast<int>(sizeof(addr))), ErrorCode::Success);
+        peers[i] = WinSocket(::accept(listener.get(), nullptr, nullptr));
+        ASSERT_TRUE(peers[i]);
+        ASSERT_TRUE(c.Wait());
+        ASSERT_EQ(c.ec, ErrorCode::Success);
+        IoEngine::FinishConnect(sockets[i]);
+    }
+
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i)
+    {
+        threads.emplace_back([&, i]()
+        {
+            SOCKET s = sockets[i];
+            SOCKET peer = peers[i].get();
+            Completed c;
+            IoContext ctx;
+            for (int round = 0; round < kRounds; ++round)
+            {
+                char out = static_cast<char>('a' + (i + round) % 26);
+                char in  = 0;
+                Arm(ctx, IoOp::Recv, s, c);
+                ctx.buffer = MakeIoBuffer(&in, 1);
+                if (IoEngine::StartRecv(&ctx) != ErrorCode::Success ||
+                    ::send(peer, &out, 1, 0) != 1 || !c.Wait() ||
+                    c.ec != ErrorCode::Success || c.bytes != 1 || in != out)
+                {
+                    ++failures;
+                    return;
+                }
+
+                IoBuffer buf = MakeIoBuffer(&out, 1);
+                Arm(ctx, IoOp::Send, s, c);
+                char echoed = 0;
+                if (IoEngine::StartSend(&ctx, &buf, 1) != ErrorCode::Success ||
+                    !c.Wait() || c.ec != ErrorCode::Success ||
+                    ::recv(peer, &echoed, 1, 0) != 1 || echoed != out)
+                {
+                    ++failures;
+                    return;
+                }
+            }
+
+            // Closing with a recv parked aborts just that recv.
+            char in = 0;
+            Arm(ctx, IoOp::Recv, s, c);
+            ctx.buffer = MakeIoBuffer(&in, 1);
+            if (IoEngine::StartRecv(&ctx) != ErrorCode::Success) { ++failures; return; }
+            IoEngine::CloseSocket(s);
+            if (!c.Wait() || c.ec != ErrorCode::Shutdown) ++failures;
+        });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(failures.load(), 0);
+}
+
+#ifndef _WIN32
+
+namespace {
+
+// User + system CPU time of the whole process.
+std::chrono::microseconds ProcessCpuTime()
+{
+    rusage ru{};
+    ::getrusage(RUSAGE_SELF, &ru);
+    return std::chrono::seconds(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+           std::chrono::microseconds(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+} // namespace
+
+// epoll reports EPOLLHUP/EPOLLERR whatever the interest mask, so a socket
+// with nothing parked must not stay in the set: a reset on it would make
+// every epoll_wait return at once.  The error still reaches the next recv.
+TEST(IoEngine, ResetOnAnIdleSocketLeavesThePollerQuiet) {
+    ASSERT_EQ(IoEngine::Init(0), ErrorCode::Success);
+
+    WinSocket listener;
+    sockaddr_in addr = Listen(listener);
+    ASSERT_TRUE(listener);
+
+    ErrorCode open_ec = ErrorCode::Success;
+    SOCKET s = IoEngine::OpenSocket(AF_INET, open_ec);
+    ASSERT_NE(s, INVALID_SOCKET) << ErrorCodeToString(open_ec);
+    Completed c;
+    IoContext connect_ctx;
+    Arm(connect_ctx, IoOp::Connect, s, c);
+    ASSERT_EQ(IoEngine::StartConnect(&connect_ctx, reinterpret_cast<sockaddr*>(&addr),
+                                     static_cast<int>(sizeof(addr))), ErrorCode::Success);
+    WinSocket peer(::accept(listener.get(), nullptr, nullptr));
+    ASSERT_TRUE(peer);
+    ASSERT_TRUE(c.Wait());
+    ASSERT_EQ(c.ec, ErrorCode::Success);
+
+    linger lg{};
+    lg.l_onoff  = 1;
+    lg.l_linger = 0;
+    ASSERT_EQ(::setsockopt(peer.get(), SOL_SOCKET, SO_LINGER, &lg, sizeof(lg)), 0);
+    peer = WinSocket();   // RST
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    auto cpu_before = ProcessCpuTime();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    auto spent_us = (ProcessCpuTime() - cpu_before).count();
+    EXPECT_LT(spent_us, 100000) << "poller spinning on the reset socket";
+
+    char in[4] = {};
+    IoContext recv_ctx;
+    Arm(recv_ctx, IoOp::Recv, s, c);
+    recv_ctx.buffer = MakeIoBuffer(in, sizeof(in));
+    ASSERT_EQ(IoEngine::StartRecv(&recv_ctx), ErrorCode::Success);
+    ASSERT_TRUE(c.Wait());
+    EXPECT_NE(c.ec, ErrorCode::Success);
+
+    IoEngine::CloseSocket(s);
+}
+
+#endif // !_WIN32
@@ -2,6 +2,8 @@
 #include "logger.h"
 #include <atomic>
 #include <string>
+#include <thread>
+#include <vector>
 
 class LoggerTest : public ::testing::Test {
 protected:
@@ -19,6 +21,7 @@ TEST_F(LoggerTest, CallbackFiredForEachEntry) {
     Logger::SetCallback([&count](const LogEntry&) { ++count; });
     Logger::Info("test_cb_fired_1");
     Logger::Info("test_cb_fired_2");
+    Logger::Flush();
     EXPECT_EQ(count.load(), 2);
 }
 
@@ -26,6 +29,7 @@ TEST_F(LoggerTest, CallbackReceivesCorrectLevel) {
     LogEntry captured;
     Logger::SetCallback([&captured](const LogEntry& e) { captured = e; });
     Logger::Warn("test_cb_level_check");
+    Logger::Flush();
     EXPECT_EQ(captured.level, ssh_proxy::LogLevel::Warn);
     EXPECT_STREQ(captured.message.c_str(), "test_cb_level_check");
 }
@@ -40,6 +44,7 @@ TEST_F(LoggerTest, MinLevelFiltersCallback) {
     });
     Logger::Info("should_be_filtered");
     Logger::Error("should_pass_through");
+    Logger::Flush();
     EXPECT_FALSE(got_info.load());
     EXPECT_TRUE(got_error.load());
 }
@@ -76,6 +81,7 @@ TEST_F(LoggerTest, ClearCallbackOnNull) {
     Logger::SetCallback([&count](const LogEntry&) { ++count; });
     Logger::SetCallback(nullptr);
     Logger::Info("should_not_fire_after_clear");
+    Logger::Flush();
     EXPECT_EQ(count.load(), 0);
 }
 
@@ -83,6 +89,7 @@ TEST_F(LoggerTest, TimestampFormatPresent) {
     LogEntry captured;
     Logger::SetCallback([&captured](const LogEntry& e) { captured = e; });
     Logger::Info("ts_format_test");
+    Logger::Flush();
     // "YYYY-MM-DD HH:MM:SS.mmm" = 23 characters
     ASSERT_EQ(captured.timestamp.size(), 23u);
     EXPECT_EQ(captured.timestamp[4],  '-');
@@ -92,3 +99,79 @@ TEST_F(LoggerTest, TimestampFormatPresent) {
     EXPECT_EQ(captured.timestamp[16], ':');
     EXPECT_EQ(captured.timestamp[19], '.');
 }
+
+TEST_F(LoggerTest, CallbackRunsOffTheLoggingThread) {
+    std::thread::id cb_thread;
+    Logger::SetCallback([&cb_thread](const LogEntry&) { cb_thread = std::this_thread::get_id(); });
+    Logger::Info("drain_thread_test");
+    Logger::Flush();
+    EXPECT_NE(cb_thread, std::thread::id());
+    EXPECT_NE(cb_thread, std::this_thread::get_id());
+}
+
+TEST_F(LoggerTest, ConcurrentWritersAllDelivered) {
+    // Fewer entries than the ring holds, so none can be lapped.
+    constexpr int kThreads = 4, kPerThread = 50;
+    std::atomic<int> count{0};
+    Logger::SetCallback([&count](const LogEntry&) { ++count; });
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; ++t)
+        writers.emplace_back([t]() {
+            for (int i = 0; i < kPerThread; ++i)
+                Logger::Debug("concurrent_%d_%d", t, i);
+        });
+    for (auto& w : writers) w.join();
+
+    Logger::Flush();
+    EXPECT_EQ(count.load(), kThreads * kPerThread);
+    EXPECT_EQ(Logger::Snapshot().size(), Logger::k_max_entries);
+}
+
+TEST_F(LoggerTest, SinceReturnsOnlyNewerEntries) {
+    Logger::Info("since_marker_a");
+    auto before = Logger::Since(0, 100000);
+    ASSERT_FALSE(before.empty());
+    const uint64_t mark = before.back().seq;
+    EXPECT_EQ(before.back().message, "since_marker_a");
+
+    Logger::Info("since_marker_b");
+    Logger::Warn("since_marker_c");
+    auto after = ssh_proxy::GetLogSince(mark);
+    ASSERT_EQ(after.size(), 2u);
+    EXPECT_EQ(after[0].seq, mark + 1);
+    EXPECT_EQ(after[0].message, "since_marker_b");
+    EXPECT_EQ(after[1].seq, mark + 2);
+    EXPECT_EQ(after[1].level, ssh_proxy::LogLevel::Warn);
+
+    EXPECT_TRUE(ssh_proxy::GetLogSince(mark + 2).empty());
+    auto capped = ssh_proxy::GetLogSince(mark, 1);
+    ASSERT_EQ(capped.size(), 1u);
+    EXPECT_EQ(capped[0].message, "since_marker_b");
+}
+
+TEST_F(LoggerTest, SetCapacityKeepsTheNewestEntries) {
+    Logger::Info("capacity_carry_over");
+    const uint64_t mark = Logger::Since(0, 100000).back().seq;
+
+    ssh_proxy::SetLogCapacity(1000);
+    EXPECT_EQ(Logger::Capacity(), 1024u);
+    auto carried = Logger::Since(mark - 1, 1);
+    ASSERT_EQ(carried.size(), 1u);
+    EXPECT_EQ(carried[0].message, "capacity_carry_over");
+
+    // More than the default ring held, all still readable.
+    for (int i = 0; i < 600; ++i)
+        Logger::Debug("capacity_fill_%d", i);
+    auto all = Logger::Since(mark, 100000);
+    ASSERT_EQ(all.size(), 600u);
+    EXPECT_EQ(all.front().message, "capacity_fill_0");
+    EXPECT_EQ(all.back().seq, mark + 600);
+
+    // The ring is resized once; a second resize would strand the first
+    // ring, so it is refused and everything stays readable.
+    EXPECT_TRUE(Logger::SetCapacity(1000));   // same size: nothing to do
+    EXPECT_FALSE(Logger::SetCapacity(Logger::k_ring_entries));
+    EXPECT_EQ(Logger::Capacity(), 1024u);
+    EXPECT_EQ(Logger::Since(mark, 100000).front().message, "capacity_fill_0");
+}
@@ -1,17 +1,28 @@
 #include <gtest/gtest.h>
+#ifdef _WIN32
 #include <winsock2.h>
 #include <windows.h>
+#else
+#include <csignal>
+#endif
 
-// Global setup: initialise Winsock before any test runs.
+// Global setup: initialise Winsock before any test runs — on POSIX, ignore
+// SIGPIPE instead, so a test writing to a socket its peer reset sees EPIPE.
 // libssh2_init is called inside ssh_proxy::Connect; tests that exercise
 // it directly do so via the Connect constructor.
 int main(int argc, char** argv) {
+#ifdef _WIN32
     WSADATA wsa;
     WSAStartup(MAKEWORD(2, 2), &wsa);
+#else
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
 
     ::testing::InitGoogleTest(&argc, argv);
     int result = RUN_ALL_TESTS();
 
+#ifdef _WIN32
     WSACleanup();
+#endif
     return result;
 }
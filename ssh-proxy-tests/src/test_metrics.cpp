@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "../../ssh-proxy-lib/public/ssh_proxy.h"
+#include <string>
+
+using ssh_proxy::FormatMetricsJson;
+using ssh_proxy::Metrics;
+
+TEST(MetricsJson, EmptySnapshotHasAllSections) {
+    Metrics m;
+    m.uptime_ms = 1500;
+    std::string json = FormatMetricsJson(m);
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_EQ(json.back(),  '}');
+    EXPECT_NE(json.find("\"uptime_ms\":1500,"), std::string::npos);
+    EXPECT_NE(json.find("\"transports\":[]"), std::string::npos);
+    EXPECT_NE(json.find("\"sessions\":[]"), std::string::npos);
+    EXPECT_NE(json.find("\"workers\":[]"), std::string::npos);
+    EXPECT_EQ(json.find('\n'), std::string::npos);
+}
+
+TEST(MetricsJson, TransportAndWorkerFields) {
+    Metrics m;
+    ssh_proxy::TransportStats t;
+    t.forward_port               = 1080;
+    t.connected                  = true;
+    t.reconnects                 = 3;
+    t.io_loop_iterations         = 42;
+    t.io_loop_iterations_per_sec = 2.5;
+    t.rtt_us                     = 350;
+    m.transports.push_back(t);
+    ssh_proxy::WorkerStats w;
+    w.completions = 7;
+    m.workers.push_back(w);
+    m.workers.push_back(w);
+
+    std::string json = FormatMetricsJson(m);
+    EXPECT_NE(json.find("\"forward_port\":1080,\"connected\":true,\"reconnects\":3,"),
+              std::string::npos);
+    EXPECT_NE(json.find("\"io_loop_iterations\":42,"), std::string::npos);
+    EXPECT_NE(json.find("\"io_loop_iterations_per_sec\":2.5,"), std::string::npos);
+    EXPECT_NE(json.find("\"rtt_us\":350}"), std::string::npos);
+    EXPECT_NE(json.find("\"workers\":[{\"completions\":7,\"completions_per_sec\":0.0},{"),
+              std::string::npos);
+}
+
+TEST(MetricsJson, NegotiatedSshMethods) {
+    Metrics m;
+    ssh_proxy::TransportStats t;
+    t.connected   = true;
+    t.kex         = "curve25519-sha256";
+    t.cipher      = "aes128-gcm@openssh.com";
+    t.compression = "none";
+    m.transports.push_back(t);
+
+    std::string json = FormatMetricsJson(m);
+    EXPECT_NE(json.find("\"ssh_methods\":{\"kex\":\"curve25519-sha256\",\"host_key\":\"\","
+                        "\"cipher\":\"aes128-gcm@openssh.com\",\"mac\":\"\",\"compression\":\"none\"},"
+                        "\"channels_accepted\":"),
+              std::string::npos);
+}
+
+TEST(MetricsJson, SessionTargetIsEscaped) {
+    Metrics m;
+    ssh_proxy::SessionStats s;
+    s.id     = 3;
+    s.state  = ssh_proxy::SessionState::Relaying;
+    s.target = "a\"b\\c\x01:80";
+    m.sessions.push_back(s);
+
+    std::string json = FormatMetricsJson(m);
+    EXPECT_NE(json.find("\"state\":\"relaying\","), std::string::npos);
+    EXPECT_NE(json.find("\"target\":\"a\\\"b\\\\c\\u0001:80\","), std::string::npos);
+}
+
+TEST(MetricsJson, LatencySectionListsEveryPoint) {
+    Metrics m;
+    m.latency.io_loop_tick.count   = 4;
+    m.latency.io_loop_tick.mean_us = 12.5;
+    m.latency.io_loop_tick.p99_us  = 40;
+    m.latency.io_loop_tick.max_us  = 41;
+
+    std::string json = FormatMetricsJson(m);
+    for (const char* key : { "socks_connect", "dns_resolve", "tcp_connect",
+                             "io_loop_tick", "write_queue_wait" })
+        EXPECT_NE(json.find(std::string("\"") + key + "\":{\"count\":"), std::string::npos) << key;
+    EXPECT_NE(json.find("\"io_loop_tick\":{\"count\":4,\"mean_us\":12.5,\"p50_us\":0,"
+                        "\"p90_us\":0,\"p99_us\":40,\"p999_us\":0,\"max_us\":41}"),
+              std::string::npos);
+    EXPECT_EQ(json.substr(json.size() - 2), "}}");
+}
+
+TEST(MetricsJson, AdmissionCountersCloseTheObject) {
+    Metrics m;
+    m.admission.active_sessions = 12;
+    m.admission.refused_rate    = 3;
+
+    std::string json = FormatMetricsJson(m);
+    EXPECT_NE(json.find("\"admission\":{\"active_sessions\":12,\"admitted\":0,"
+                        "\"refused_sessions\":0,\"refused_rate\":3,\"refused_target\":0}}"),
+              std::string::npos);
+}
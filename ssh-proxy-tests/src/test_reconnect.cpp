@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include "reconnect.h"
+
+TEST(ReconnectBackoff, DelaysStayInTheUpperHalfOfADoublingWindow) {
+    ReconnectBackoff b(100, 100000, 7);
+    uint32_t ceiling = 100;
+    for (int i = 0; i < 8; ++i)
+    {
+        uint32_t d = b.Next();
+        EXPECT_GE(d, ceiling / 2) << "retry " << i;
+        EXPECT_LE(d, ceiling)     << "retry " << i;
+        ceiling *= 2;
+    }
+    EXPECT_EQ(b.attempts(), 8u);
+}
+
+TEST(ReconnectBackoff, CapsAtTheMaximum) {
+    ReconnectBackoff b(500, 2000, 1);
+    for (int i = 0; i < 40; ++i)   // well past the point where 500 << n overflows
+    {
+        uint32_t d = b.Next();
+        EXPECT_LE(d, 2000u);
+        if (i >= 2) EXPECT_GE(d, 1000u);
+    }
+}
+
+TEST(ReconnectBackoff, ResetStartsOverAndSeedsDiffer) {
+    ReconnectBackoff b(1000, 60000, 42);
+    for (int i = 0; i < 5; ++i) b.Next();
+    b.Reset();
+    EXPECT_EQ(b.attempts(), 0u);
+    EXPECT_LE(b.Next(), 1000u);
+
+    // Two transports that dropped together should not retry in lock-step.
+    ReconnectBackoff x(1000, 60000, 1);
+    ReconnectBackoff y(1000, 60000, 2);
+    bool differ = false;
+    for (int i = 0; i < 6 && !differ; ++i) differ = x.Next() != y.Next();
+    EXPECT_TRUE(differ);
+}
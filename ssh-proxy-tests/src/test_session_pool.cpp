@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include "session_pool.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+
+namespace {
+
+template <class T, class... Args>
+std::shared_ptr<T> MakeIn(SessionPool::Block* block, Args&&... args)
+{
+    return std::allocate_shared<T>(SessionAllocator<T>(block), std::forward<Args>(args)...);
+}
+
+} // namespace
+
+TEST(SessionPool, BlockReturnsOnceEveryObjectIsGone) {
+    auto pool = SessionPool::Create();
+    SessionPool::Block* block = pool->Acquire();
+    auto a = MakeIn<int>(block, 1);
+    auto b = MakeIn<double>(block, 2.0);
+    SessionPool::Release(block);
+
+    a.reset();
+    EXPECT_EQ(pool->GetStats().idle, 0u);
+    b.reset();
+    EXPECT_EQ(pool->GetStats().idle, 1u);
+
+    // The freed block is handed out again rather than allocating a new one.
+    EXPECT_EQ(pool->Acquire(), block);
+    SessionPool::Release(block);
+    SessionPool::Stats st = pool->GetStats();
+    EXPECT_EQ(st.acquired, 2u);
+    EXPECT_EQ(st.reused, 1u);
+    EXPECT_EQ(st.idle, 1u);
+}
+
+TEST(SessionPool, ObjectsStartOnSeparateCacheLines) {
+    auto pool = SessionPool::Create();
+    SessionPool::Block* block = pool->Acquire();
+    auto a = MakeIn<uint8_t>(block, uint8_t{1});
+    auto b = MakeIn<uint8_t>(block, uint8_t{2});
+    SessionPool::Release(block);
+
+    auto line = [](const void* p) { return reinterpret_cast<uintptr_t>(p) / SessionPool::kCacheLine; };
+    EXPECT_NE(line(a.get()), line(b.get()));
+    EXPECT_EQ(*a, 1);
+    EXPECT_EQ(*b, 2);
+}
+
+TEST(SessionPool, OversizeAllocationFallsBackToHeap) {
+    auto pool = SessionPool::Create();
+    SessionPool::Block* block = pool->Acquire();
+    auto big = MakeIn<std::array<uint8_t, SessionPool::kBlockSize>>(block);
+    SessionPool::Release(block);
+
+    EXPECT_EQ(pool->GetStats().overflows, 1u);
+    EXPECT_EQ(pool->GetStats().idle, 1u);   // nothing was carved from the block
+    big->fill(0xAB);
+    big.reset();
+}
+
+TEST(SessionPool, BlockOutlivesItsPool) {
+    auto pool = SessionPool::Create();
+    SessionPool::Block* block = pool->Acquire();
+    auto obj = MakeIn<int>(block, 7);
+    SessionPool::Release(block);
+
+    std::weak_ptr<SessionPool> weak = pool;
+    pool.reset();
+    EXPECT_FALSE(weak.expired());   // kept alive by the block in use
+    obj.reset();
+    EXPECT_TRUE(weak.expired());
+}
@@ -94,11 +94,88 @@ TEST(Socks5ParseConnect, IPv4ParsedCorrectly) {
     EXPECT_EQ(consumed, 10);
     EXPECT_EQ(req.atyp, uint8_t{Socks5::ATYP_IPV4});
     EXPECT_EQ(req.port, uint16_t{8080});
-    EXPECT_STREQ(req.host.c_str(), "192.168.1.1");
+    EXPECT_EQ(req.cmd, uint8_t{Socks5::CMD_CONNECT});
+    EXPECT_TRUE(req.host.empty());   // literals stay binary
     EXPECT_EQ(req.ipv4[0], uint8_t{192});
     EXPECT_EQ(req.ipv4[3], uint8_t{1});
 }
 
+TEST(Socks5ParseConnect, IPv4LiteralToSockaddr) {
+    uint8_t data[] = {0x05, 0x01, 0x00, 0x01, 10, 0, 0, 7, 0x01, 0xBB};
+    Socks5::ConnectRequest req{};
+    ASSERT_EQ(Socks5::ParseConnectRequest(data, sizeof(data), req), 10);
+
+    sockaddr_storage ss{};
+    ASSERT_EQ(Socks5::ToSockaddr(req, ss), static_cast<int>(sizeof(sockaddr_in)));
+    const auto* a4 = reinterpret_cast<const sockaddr_in*>(&ss);
+    EXPECT_EQ(a4->sin_family, AF_INET);
+    EXPECT_EQ(ntohs(a4->sin_port), 443);
+    EXPECT_EQ(std::memcmp(&a4->sin_addr, req.ipv4, 4), 0);
+
+    char buf[64];
+    EXPECT_EQ(Socks5::FormatTarget(req, buf, sizeof(buf)), std::strlen("10.0.0.7:443"));
+    EXPECT_STREQ(buf, "10.0.0.7:443");
+}
+
+TEST(Socks5ParseConnect, IPv6LiteralToSockaddr) {
+    uint8_t data[22] = {0x05, 0x01, 0x00, 0x04};
+    data[4 + 15] = 1;                       // ::1
+    data[20] = 0x1F; data[21] = 0x90;       // 8080
+    Socks5::ConnectRequest req{};
+    ASSERT_EQ(Socks5::ParseConnectRequest(data, sizeof(data), req), 22);
+
+    sockaddr_storage ss{};
+    ASSERT_EQ(Socks5::ToSockaddr(req, ss), static_cast<int>(sizeof(sockaddr_in6)));
+    const auto* a6 = reinterpret_cast<const sockaddr_in6*>(&ss);
+    EXPECT_EQ(a6->sin6_family, AF_INET6);
+    EXPECT_EQ(ntohs(a6->sin6_port), 8080);
+
+    char buf[64];
+    Socks5::FormatTarget(req, buf, sizeof(buf));
+    EXPECT_STREQ(buf, "[::1]:8080");
+}
+
+TEST(Socks5ParseConnect, DomainNeedsResolving) {
+    uint8_t data[] = {0x05, 0x01, 0x00, 0x03, 3, 'a', 'b', 'c', 0x00, 0x50};
+    Socks5::ConnectRequest req{};
+    ASSERT_EQ(Socks5::ParseConnectRequest(data, sizeof(data), req), 10);
+
+    sockaddr_storage ss{};
+    EXPECT_EQ(Socks5::ToSockaddr(req, ss), 0);
+    char buf[8];
+    EXPECT_EQ(Socks5::FormatTarget(req, buf, sizeof(buf)), 6u);
+    EXPECT_STREQ(buf, "abc:80");
+    char small[4];
+    EXPECT_EQ(Socks5::FormatTarget(req, small, sizeof(small)), 3u);   // truncated
+    EXPECT_STREQ(small, "abc");
+}
+
+TEST(Socks5ParseConnect, MakeConnectRequestKeepsLiteralsBinary) {
+    Socks5::ConnectRequest v4 = Socks5::MakeConnectRequest("10.0.0.7", 443);
+    EXPECT_EQ(v4.cmd, Socks5::CMD_CONNECT);
+    EXPECT_EQ(v4.atyp, Socks5::ATYP_IPV4);
+    sockaddr_storage ss{};
+    EXPECT_EQ(Socks5::ToSockaddr(v4, ss), static_cast<int>(sizeof(sockaddr_in)));
+
+    Socks5::ConnectRequest v6 = Socks5::MakeConnectRequest("::1", 8080);
+    EXPECT_EQ(v6.atyp, Socks5::ATYP_IPV6);
+    char buf[64];
+    Socks5::FormatTarget(v6, buf, sizeof(buf));
+    EXPECT_STREQ(buf, "[::1]:8080");
+
+    Socks5::ConnectRequest name = Socks5::MakeConnectRequest("db.internal", 5432);
+    EXPECT_EQ(name.atyp, Socks5::ATYP_DOMAIN);
+    EXPECT_EQ(name.host, "db.internal");
+    EXPECT_EQ(Socks5::ToSockaddr(name, ss), 0);
+}
+
+TEST(Socks5ParseConnect, OtherCommandsParsedInFull) {
+    uint8_t data[] = {0x05, 0x02, 0x00, 0x01, 1, 2, 3, 4, 0x1F, 0x90};   // BIND
+    Socks5::ConnectRequest req{};
+    EXPECT_EQ(Socks5::ParseConnectRequest(data, sizeof(data), req), 10);
+    EXPECT_EQ(req.cmd, uint8_t{0x02});
+}
+
 TEST(Socks5ParseConnect, IPv4IncompleteReturnsZero) {
     uint8_t data[] = {0x05, 0x01, 0x00, 0x01, 192, 168}; // addr truncated
     Socks5::ConnectRequest req{};
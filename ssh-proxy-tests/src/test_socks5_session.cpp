@@ -13,6 +13,8 @@ public:
     std::vector<uint8_t> written;
     bool eof_sent   = false;
     bool was_closed = false;
+    size_t wm_high  = 0;
+    size_t wm_low   = 0;
 
     ErrorCode Read(uint8_t* buf, size_t len, size_t& bytes_read) override {
         if (chunk_idx >= chunks.size()) {
@@ -34,6 +36,11 @@ public:
     void SendEof() override { eof_sent   = true; }
     void Close()   override { was_closed = true; }
     bool IsEof()   const override { return chunk_idx >= chunks.size(); }
+
+    void SetWriteWatermarks(size_t high, size_t low, std::function<void()>) override {
+        wm_high = high;
+        wm_low  = low;
+    }
 };
 
 // ── Helpers ───────────────────────────────────────────────────────────────────
@@ -122,6 +129,116 @@ TEST(Socks5Session, MalformedConnectRequestSendsFailure) {
     EXPECT_EQ(raw->written[3], uint8_t{Socks5::REP_GENERAL_FAILURE});
 }
 
+TEST(Socks5Session, RefusedAdmissionFailsTheConnect) {
+    ssh_proxy::AdmissionLimits limits;
+    limits.max_sessions = 1;
+    auto admission = AdmissionControl::Create(limits);
+    AdmissionTicket held = admission->Admit();
+    ASSERT_TRUE(held.admitted());
+
+    auto ch = std::make_unique<FakeChannel>();
+    FakeChannel* raw = ch.get();
+    raw->chunks = { MethodRequest({0x00}), {0x05, 0x01, 0x00, 0x01, 127, 0, 0, 1, 0x1F, 0x90} };
+
+    auto session = std::make_shared<Socks5Session>(std::move(ch));
+    session->SetAdmission(admission->Admit());
+    session->Start();
+    while (session->PumpSshRead()) {}
+
+    // Answered without a connect attempt: method response + failure reply.
+    ASSERT_EQ(raw->written.size(), 12u);
+    EXPECT_EQ(raw->written[1], uint8_t{0x00});
+    EXPECT_EQ(raw->written[3], uint8_t{Socks5::REP_GENERAL_FAILURE});
+    EXPECT_EQ(admission->GetStats().refused_sessions, 1u);
+}
+
+TEST(Socks5Session, FullDestinationIsNotAllowed) {
+    ssh_proxy::AdmissionLimits limits;
+    limits.max_per_target = 1;
+    auto admission = AdmissionControl::Create(limits);
+    AdmissionTicket held = admission->Admit();
+    ASSERT_TRUE(held.ClaimTarget("example.com:80"));
+
+    // CONNECT example.com:80 (domain, so no literal key).
+    auto ch = std::make_unique<FakeChannel>();
+    FakeChannel* raw = ch.get();
+    std::vector<uint8_t> req = {0x05, 0x01, 0x00, 0x03, 11};
+    for (char c : std::string("example.com")) req.push_back(static_cast<uint8_t>(c));
+    req.push_back(0x00);
+    req.push_back(0x50);
+    raw->chunks = { MethodRequest({0x00}), req };
+
+    auto session = std::make_shared<Socks5Session>(std::move(ch));
+    session->SetAdmission(admission->Admit());
+    session->Start();
+    while (session->PumpSshRead()) {}
+
+    ASSERT_EQ(raw->written.size(), 12u);
+    EXPECT_EQ(raw->written[3], uint8_t{Socks5::REP_CONNECTION_NOT_ALLOWED});
+    EXPECT_EQ(admission->GetStats().refused_target, 1u);
+    // The refused session gave its session slot back on close.
+    EXPECT_EQ(admission->GetStats().active_sessions, 1u);
+}
+
+TEST(Socks5Session, FixedTargetRefusalClosesWithoutReplies) {
+    ssh_proxy::AdmissionLimits limits;
+    limits.max_sessions = 1;
+    auto admission = AdmissionControl::Create(limits);
+    AdmissionTicket held = admission->Admit();
+
+    // What looks like a SOCKS greeting is payload on a fixed forward.
+    auto ch = std::make_unique<FakeChannel>();
+    FakeChannel* raw = ch.get();
+    raw->chunks = { MethodRequest({0x00}) };
+
+    auto session = std::make_shared<Socks5Session>(std::move(ch));
+    session->SetAdmission(admission->Admit());
+    session->SetFixedTarget(Socks5::MakeConnectRequest("127.0.0.1", 8080));
+    session->Start();
+
+    EXPECT_TRUE(raw->written.empty());
+    EXPECT_TRUE(raw->was_closed);
+    EXPECT_EQ(session->GetStats().state, ssh_proxy::SessionState::Closed);
+    EXPECT_EQ(raw->chunk_idx, 0u);   // nothing was read as a handshake
+}
+
+TEST(Socks5Session, PipelinedHandshakeParsedFromOneRead) {
+    auto ch = std::make_unique<FakeChannel>();
+    FakeChannel* raw = ch.get();
+
+    // Greeting and a BIND request in a single read — both answered.
+    std::vector<uint8_t> one = MethodRequest({0x00});
+    const uint8_t bind[] = {0x05, 0x02, 0x00, 0x01, 1, 2, 3, 4, 0x1F, 0x90};
+    one.insert(one.end(), bind, bind + sizeof(bind));
+    raw->chunks = { one };
+
+    auto session = std::make_shared<Socks5Session>(std::move(ch));
+    session->Start();
+    while (session->PumpSshRead()) {}
+
+    ASSERT_EQ(raw->written.size(), 12u);   // method response + connect reply
+    EXPECT_EQ(raw->written[1], uint8_t{0x00});
+    EXPECT_EQ(raw->written[3], uint8_t{Socks5::REP_COMMAND_NOT_SUPPORTED});
+}
+
+TEST(Socks5Session, SplitConnectRequestIsReassembled) {
+    auto ch = std::make_unique<FakeChannel>();
+    FakeChannel* raw = ch.get();
+
+    // The request arrives in three pieces; the first shares a read with the
+    // greeting.
+    std::vector<uint8_t> first = MethodRequest({0x00});
+    first.insert(first.end(), {0x05, 0x02, 0x00});
+    raw->chunks = { first, {0x01, 1, 2}, {3, 4, 0x1F, 0x90} };
+
+    auto session = std::make_shared<Socks5Session>(std::move(ch));
+    session->Start();
+    while (session->PumpSshRead()) {}
+
+    ASSERT_EQ(raw->written.size(), 12u);
+    EXPECT_EQ(raw->written[3], uint8_t{Socks5::REP_COMMAND_NOT_SUPPORTED});
+}
+
 TEST(Socks5Session, PartialMethodDataWaitsForMore) {
     auto ch = std::make_unique<FakeChannel>();
     FakeChannel* raw = ch.get();
@@ -142,3 +259,61 @@ TEST(Socks5Session, PartialMethodDataWaitsForMore) {
     EXPECT_EQ(raw->written[1], uint8_t{0x00}); // AUTH_NONE accepted
 }
 
+TEST(Socks5Session, StartArmsChannelWriteWatermarks) {
+    auto ch = std::make_unique<FakeChannel>();
+    FakeChannel* raw = ch.get();
+
+    RelayOptions opts;
+    opts.high_watermark = 64 * 1024;
+    opts.low_watermark  = 16 * 1024;
+    auto session = std::make_shared<Socks5Session>(std::move(ch), opts);
+    session->Start();
+
+    EXPECT_EQ(raw->wm_high, 64u * 1024u);
+    EXPECT_EQ(raw->wm_low,  16u * 1024u);
+}
+
+TEST(Socks5Session, StatsFollowSessionState) {
+    auto ch = std::make_unique<FakeChannel>();
+    FakeChannel* raw = ch.get();
+    raw->chunks = { MethodRequest({0x00}), {} };
+
+    auto session = std::make_shared<Socks5Session>(std::move(ch));
+    session->Start();
+    Socks5Session::Stats before = session->GetStats();
+    EXPECT_EQ(before.state, ssh_proxy::SessionState::Handshake);
+    EXPECT_TRUE(before.target.empty());
+
+    while (session->PumpSshRead()) {}
+
+    // Closed during the handshake: nothing relayed, no target, no latency.
+    Socks5Session::Stats after = session->GetStats();
+    EXPECT_EQ(after.state, ssh_proxy::SessionState::Closed);
+    EXPECT_TRUE(after.target.empty());
+    EXPECT_EQ(after.bytes_to_target, 0u);
+    EXPECT_EQ(after.bytes_to_client, 0u);
+    EXPECT_EQ(after.connect_latency_us, 0u);
+    EXPECT_EQ(after.queued_to_target, 0u);
+}
+
+TEST(Socks5Session, PooledSessionRecyclesOneBlock) {
+    auto pool = SessionPool::Create();
+    for (int round = 0; round < 3; ++round)
+    {
+        auto ch = std::make_unique<FakeChannel>();
+        FakeChannel* raw = ch.get();
+        raw->chunks = { MethodRequest({0x00}), {} };
+
+        auto session = Socks5Session::Create(std::move(ch), {}, *pool);
+        session->Start();
+        while (session->PumpSshRead()) {}
+        EXPECT_EQ(raw->written.size(), 2u);
+        EXPECT_EQ(pool->GetStats().idle, 0u);   // session + connection hold the block
+    }
+
+    SessionPool::Stats st = pool->GetStats();
+    EXPECT_EQ(st.acquired, 3u);
+    EXPECT_EQ(st.reused, 2u);
+    EXPECT_EQ(st.overflows, 0u);
+    EXPECT_EQ(st.idle, 1u);
+}
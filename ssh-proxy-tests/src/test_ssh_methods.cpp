@@ -0,0 +1,22 @@
+#include <gtest/gtest.h>
+#include "ssh_methods.h"
+
+TEST(MergeMethodPreference, PreferredFirstThenTheRestOfSupported) {
+    std::vector<std::string> supported = { "aes256-ctr", "aes128-gcm@openssh.com", "aes128-ctr" };
+    EXPECT_EQ(MergeMethodPreference("aes128-gcm@openssh.com,aes128-ctr", supported),
+              "aes128-gcm@openssh.com,aes128-ctr,aes256-ctr");
+}
+
+TEST(MergeMethodPreference, KeepsPreferredNamesTheBuildMayLack) {
+    // libssh2_session_method_pref drops unknown names itself; the merge
+    // only guarantees nothing supported goes missing.
+    std::vector<std::string> supported = { "aes256-ctr" };
+    EXPECT_EQ(MergeMethodPreference("chacha20-poly1305@openssh.com", supported),
+              "chacha20-poly1305@openssh.com,aes256-ctr");
+}
+
+TEST(MergeMethodPreference, EmptyPartsAndEmptyInputs) {
+    EXPECT_EQ(MergeMethodPreference(",a,,b,", { "b", "", "c" }), "a,b,c");
+    EXPECT_EQ(MergeMethodPreference("", { "x", "y" }), "x,y");
+    EXPECT_EQ(MergeMethodPreference("", {}), "");
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include "tcp_connection.h"
+#include "async_io.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The first tests run without a socket: they cover what TcpConnection
+// decides before (or instead of) touching the network.
+
+TEST(TcpConnection, SendBeforeConnectQueues) {
+    auto tcp = std::make_shared<TcpConnection>();
+    const uint8_t early[] = {0x16, 0x03, 0x01, 0x00, 0x05};
+
+    // Early data waits for the connect instead of being refused.
+    EXPECT_EQ(tcp->Send(early, sizeof(early)), ErrorCode::Success);
+    EXPECT_EQ(tcp->Send(early, sizeof(early)), ErrorCode::Success);
+    EXPECT_EQ(tcp->SendQueuedBytes(), 2 * sizeof(early));
+
+    tcp->Close();
+    EXPECT_EQ(tcp->SendQueuedBytes(), 0u);
+    EXPECT_EQ(tcp->Send(early, sizeof(early)), ErrorCode::ConnectionReset);
+}
+
+TEST(TcpConnection, ShutdownSendWaitsForConnect) {
+    auto tcp = std::make_shared<TcpConnection>();
+    const uint8_t data[] = {1, 2, 3};
+    ASSERT_EQ(tcp->Send(data, sizeof(data)), ErrorCode::Success);
+
+    int fired = 0;
+    tcp->ShutdownSend([&fired](ErrorCode) { ++fired; });
+    EXPECT_EQ(fired, 0);   // queued data and no connection yet — no FIN
+
+    // Nothing may follow the half-close.
+    EXPECT_EQ(tcp->Send(data, sizeof(data)), ErrorCode::ConnectionReset);
+    EXPECT_EQ(tcp->SendQueuedBytes(), sizeof(data));
+
+    // Close() supersedes the pending half-close without reporting it.
+    tcp->Close();
+    EXPECT_EQ(fired, 0);
+}
+
+// ── Send failure on a live socket ─────────────────────────────────────────────
+
+namespace {
+
+struct Disconnects {
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::vector<ErrorCode>  codes;
+};
+
+} // namespace
+
+// A reset peer fails the sends: the queue is dropped with its backlog, later
+// sends are refused, and the session hears about it exactly once even though
+// the recv side fails as well.
+TEST(TcpConnection, SendFailureDropsTheQueueAndReportsOnce) {
+    ASSERT_EQ(IoEngine::Init(0), ErrorCode::Success);
+
+    WinSocket listener(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    ASSERT_TRUE(listener);
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    socklen_t addr_len   = sizeof(addr);
+    ASSERT_EQ(::bind(listener.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(::listen(listener.get(), 1), 0);
+    ::getsockname(listener.get(), reinterpret_cast<sockaddr*>(&addr), &addr_len);
+
+    WinSocket peer(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    ASSERT_EQ(::connect(peer.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    SOCKET accepted = ::accept(listener.get(), nullptr, nullptr);
+    ASSERT_NE(accepted, INVALID_SOCKET);
+
+    auto tcp = std::make_shared<TcpConnection>();
+    bool drained = false;
+    tcp->SetSendWatermarks(64 * 1024, 0, [&drained] { drained = true; });
+    ASSERT_EQ(tcp->Adopt(accepted), ErrorCode::Success);
+
+    Disconnects seen;
+    tcp->StartReading([](PooledBuffer) {},
+                      [&seen](ErrorCode ec)
+                      {
+                          std::lock_guard<std::mutex> lock(seen.mutex);
+                          seen.codes.push_back(ec);
+                          seen.cv.notify_all();
+                      });
+
+    linger lg{};
+    lg.l_onoff  = 1;
+    lg.l_linger = 0;
+    ASSERT_EQ(::setsockopt(peer.get(), SOL_SOCKET, SO_LINGER,
+                           reinterpret_cast<const char*>(&lg), sizeof(lg)), 0);
+    peer = WinSocket();   // RST
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // Keep sending until the reset surfaces as a refused Send().
+    std::vector<uint8_t> chunk(16 * 1024, 0x5A);
+    ErrorCode refused = ErrorCode::Success;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (refused == ErrorCode::Success && std::chrono::steady_clock::now() < deadline)
+    {
+        refused = tcp->Send(chunk.data(), chunk.size());
+        if (refused == ErrorCode::Success)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_NE(refused, ErrorCode::Success);
+    EXPECT_EQ(tcp->SendQueuedBytes(), 0u);
+    EXPECT_FALSE(tcp->IsSendBacklogged());
+
+    {
+        std::unique_lock<std::mutex> lock(seen.mutex);
+        ASSERT_TRUE(seen.cv.wait_for(lock, std::chrono::seconds(5),
+                                     [&] { return !seen.codes.empty(); }));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    {
+        std::lock_guard<std::mutex> lock(seen.mutex);
+        ASSERT_EQ(seen.codes.size(), 1u);
+        EXPECT_NE(seen.codes[0], ErrorCode::Success);
+    }
+    EXPECT_FALSE(drained);
+
+    tcp->Close();
+}
@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+#include "warm_sockets.h"
+
+TEST(HotTargets, HotAfterThresholdWithinAWindow) {
+    HotTargets hot(3, 1000, 16);
+    EXPECT_FALSE(hot.Record("a:80", 0));
+    EXPECT_FALSE(hot.Record("a:80", 100));
+    EXPECT_TRUE(hot.Record("a:80", 200));
+    EXPECT_TRUE(hot.IsHot("a:80", 900));
+    EXPECT_FALSE(hot.IsHot("b:80", 900));
+
+    // Too slow: the window runs out before the count reaches the threshold.
+    EXPECT_FALSE(hot.Record("b:80", 0));
+    EXPECT_FALSE(hot.Record("b:80", 600));
+    EXPECT_FALSE(hot.Record("b:80", 1200));
+}
+
+TEST(HotTargets, StaysHotThroughTheNextWindowOnly) {
+    HotTargets hot(2, 1000, 16);
+    hot.Record("a:80", 0);
+    ASSERT_TRUE(hot.Record("a:80", 10));
+
+    // First CONNECT of the following window: still hot.
+    EXPECT_TRUE(hot.Record("a:80", 1500));
+    EXPECT_TRUE(hot.IsHot("a:80", 1600));
+
+    // That window stayed below the threshold, so the one after is cold.
+    EXPECT_FALSE(hot.Record("a:80", 2600));
+    EXPECT_FALSE(hot.IsHot("a:80", 5000));
+}
+
+TEST(HotTargets, TrackingIsBounded) {
+    HotTargets hot(1, 1000, 2);
+    EXPECT_TRUE(hot.Record("a:80", 0));
+    EXPECT_TRUE(hot.Record("b:80", 0));
+    EXPECT_FALSE(hot.Record("c:80", 500));   // full, nothing has run out
+    EXPECT_EQ(hot.size(), 2u);
+
+    EXPECT_TRUE(hot.Record("c:80", 2500));   // a and b are two windows old
+    EXPECT_EQ(hot.size(), 1u);
+}
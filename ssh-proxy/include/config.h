@@ -2,6 +2,7 @@
 #include "../../ssh-proxy-lib/public/ssh_proxy.h"
 #include <cstdint>
 #include <string>
+#include <vector>
 
 // CLI arguments parsed from the command line.
 // Fields mirror the ssh_proxy::Connect constructor parameters.
@@ -14,6 +15,29 @@ struct CliArgs {
     uint32_t             connect_timeout_ms    = 10000;
     uint32_t             keepalive_interval_ms = 30000;
     ssh_proxy::LogLevel  log_level             = ssh_proxy::LogLevel::Info;
+    uint32_t             log_entries           = 0;   // log ring size; 0 = library default
+    uint32_t             transports            = 1;
+    uint32_t             metrics_interval_ms   = 0;   // 0 = no periodic metrics dump
+    uint32_t             reconnect_ms          = 0;   // first reconnect backoff; 0 = exit on drop
+    uint32_t             reconnect_max_ms      = 30000;
+    bool                 standby               = false;
+    std::string          key_file;                    // private key; empty = none
+    std::string          key_passphrase;
+    bool                 agent                 = false;
+    std::string          kex;                         // algorithm lists; empty = performance profile
+    std::string          host_key;
+    std::string          ciphers;
+    std::string          macs;
+    bool                 compress              = false;
+    uint32_t             warm_per_target       = 0;   // pre-connected sockets per hot target
+    bool                 reuse_sockets         = false;
+    uint32_t             io_workers            = 0;   // 0 = one per processor
+    ssh_proxy::IoAffinity io_affinity          = ssh_proxy::IoAffinity::None;
+    uint32_t             max_sessions          = 0;   // admission limits; 0 = none
+    uint32_t             accept_rate           = 0;
+    uint32_t             accept_burst          = 0;
+    uint32_t             max_per_target        = 0;
+    std::vector<ssh_proxy::RemoteForward> forwards;   // --forward, repeatable
 };
 
 // Parse command-line arguments into CliArgs.
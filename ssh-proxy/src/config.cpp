@@ -2,6 +2,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <utility>
 
 static void PrintUsage(const char* exe) {
     fprintf(stderr,
@@ -10,7 +12,20 @@ static void PrintUsage(const char* exe) {
         "Required:\n"
         "  --server HOST           SSH server hostname or IP\n"
         "  --username / -u USER    SSH username\n"
-        "  --password / -p PASS    SSH password\n"
+        "  --password / -p PASS    SSH password (or --key / --agent)\n"
+        "\n"
+        "Authentication (tried agent, key, password):\n"
+        "  --key / -i FILE         Private key file (OpenSSH or PEM)\n"
+        "  --key-passphrase PASS   Passphrase for an encrypted key\n"
+        "  --agent 0|1             Authenticate through Pageant / the SSH agent\n"
+        "\n"
+        "SSH algorithms (comma-separated, most preferred first; default: AES-GCM /\n"
+        "chacha20-poly1305 and curve25519 first, then everything else supported):\n"
+        "  --kex LIST              Key exchange methods\n"
+        "  --host-key LIST         Host key types\n"
+        "  --ciphers LIST          Ciphers\n"
+        "  --macs LIST             MACs (unused with AEAD ciphers)\n"
+        "  --compress 0|1          Offer zlib compression (default: 0)\n"
         "\n"
         "Optional:\n"
         "  --port PORT             SSH port (default: 22)\n"
@@ -18,10 +33,68 @@ static void PrintUsage(const char* exe) {
         "  --connect-timeout N     TCP+SSH connect timeout in ms (default: 10000)\n"
         "  --keepalive-ms N        Keepalive interval in ms (default: 30000)\n"
         "  --log-level LEVEL       debug|info|warn|error (default: info)\n"
+        "  --log-entries N         Log entries kept in memory, rounded up to a\n"
+        "                          power of two in 128..131072 (default: 256)\n"
+        "  --transports N          Independent SSH sessions, one on each of the\n"
+        "                          ports forward-port .. forward-port+N-1; no\n"
+        "                          balancing between them (default: 1)\n"
+        "  --metrics-interval N    Print a JSON metrics line to stderr every N ms\n"
+        "                          (default: 0 = off)\n"
+        "  --reconnect-ms N        Re-establish dropped SSH sessions, backing off\n"
+        "                          from N ms (default: 0 = exit when they drop)\n"
+        "  --reconnect-max-ms N    Reconnect backoff ceiling in ms (default: 30000)\n"
+        "  --standby 0|1           Keep a spare authenticated SSH session for fast\n"
+        "                          failover; needs --reconnect-ms (default: 0)\n"
+        "  --warm-targets N        Keep N pre-connected sockets to each target that\n"
+        "                          sees 4+ CONNECTs in 10 s (default: 0 = off)\n"
+        "  --reuse-sockets 0|1     Recycle closed target sockets with DisconnectEx\n"
+        "                          (default: 0)\n"
+        "  --io-workers N          Target I/O worker threads (default: 0 = one per\n"
+        "                          processor)\n"
+        "  --io-affinity MODE      none|core|node: pin the workers to processors or\n"
+        "                          NUMA nodes, keeping the first processor for the\n"
+        "                          SSH I/O threads (default: none)\n"
+        "  --max-sessions N        Refuse CONNECTs beyond N concurrent sessions\n"
+        "                          (default: 0 = no limit)\n"
+        "  --accept-rate N         Refuse new sessions beyond N a second\n"
+        "                          (default: 0 = no limit)\n"
+        "  --accept-burst N        Sessions the accept rate lets through at once\n"
+        "                          (default: one second's worth)\n"
+        "  --max-per-target N      Refuse CONNECTs beyond N concurrent sessions to\n"
+        "                          one host:port (default: 0 = no limit)\n"
+        "  --forward SPEC          Another remote port on the same SSH session:\n"
+        "                          PORT for SOCKS5, or PORT:HOST:HOSTPORT to relay\n"
+        "                          to a fixed target like ssh -R; repeatable\n"
         "  --help                  Show this help\n",
         exe);
 }
 
+static bool ParsePortValue(const std::string& s, uint16_t& port) {
+    if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos) return false;
+    long p = strtol(s.c_str(), nullptr, 10);
+    if (p <= 0 || p > 65535) return false;
+    port = static_cast<uint16_t>(p);
+    return true;
+}
+
+// PORT or PORT:HOST:HOSTPORT; an IPv6 HOST goes in brackets.
+static bool ParseForward(const char* spec, ssh_proxy::RemoteForward& fwd) {
+    std::string s = spec;
+    size_t first = s.find(':');
+    if (first == std::string::npos) return ParsePortValue(s, fwd.remote_port);
+
+    size_t last = s.rfind(':');
+    if (last == first) return false;
+    if (!ParsePortValue(s.substr(0, first), fwd.remote_port) ||
+        !ParsePortValue(s.substr(last + 1), fwd.target_port))
+        return false;
+    fwd.target_host = s.substr(first + 1, last - first - 1);
+    if (fwd.target_host.size() >= 2 && fwd.target_host.front() == '[' &&
+        fwd.target_host.back() == ']')
+        fwd.target_host = fwd.target_host.substr(1, fwd.target_host.size() - 2);
+    return !fwd.target_host.empty();
+}
+
 bool ParseCommandLine(int argc, char* argv[], CliArgs& args) {
     args = CliArgs{};
 
@@ -61,6 +134,32 @@ bool ParseCommandLine(int argc, char* argv[], CliArgs& args) {
         } else if (strcmp(arg, "--password") == 0 || strcmp(arg, "-p") == 0) {
             args.password = val;
             have_password = true;
+        } else if (strcmp(arg, "--key") == 0 || strcmp(arg, "-i") == 0) {
+            args.key_file = val;
+        } else if (strcmp(arg, "--key-passphrase") == 0) {
+            args.key_passphrase = val;
+        } else if (strcmp(arg, "--agent") == 0) {
+            if      (strcmp(val, "0") == 0) args.agent = false;
+            else if (strcmp(val, "1") == 0) args.agent = true;
+            else {
+                fprintf(stderr, "Error: invalid agent '%s' (0 or 1)\n", val);
+                return false;
+            }
+        } else if (strcmp(arg, "--kex") == 0) {
+            args.kex = val;
+        } else if (strcmp(arg, "--host-key") == 0) {
+            args.host_key = val;
+        } else if (strcmp(arg, "--ciphers") == 0) {
+            args.ciphers = val;
+        } else if (strcmp(arg, "--macs") == 0) {
+            args.macs = val;
+        } else if (strcmp(arg, "--compress") == 0) {
+            if      (strcmp(val, "0") == 0) args.compress = false;
+            else if (strcmp(val, "1") == 0) args.compress = true;
+            else {
+                fprintf(stderr, "Error: invalid compress '%s' (0 or 1)\n", val);
+                return false;
+            }
         } else if (strcmp(arg, "--forward-port") == 0 || strcmp(arg, "-f") == 0) {
             int p = atoi(val);
             if (p <= 0 || p > 65535) {
@@ -72,6 +171,72 @@ bool ParseCommandLine(int argc, char* argv[], CliArgs& args) {
             args.connect_timeout_ms = static_cast<uint32_t>(atoi(val));
         } else if (strcmp(arg, "--keepalive-ms") == 0) {
             args.keepalive_interval_ms = static_cast<uint32_t>(atoi(val));
+        } else if (strcmp(arg, "--transports") == 0) {
+            int n = atoi(val);
+            if (n <= 0 || n > 64) {
+                fprintf(stderr, "Error: invalid transports '%s' (1-64)\n", val);
+                return false;
+            }
+            args.transports = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--metrics-interval") == 0) {
+            args.metrics_interval_ms = static_cast<uint32_t>(atoi(val));
+        } else if (strcmp(arg, "--reconnect-ms") == 0) {
+            args.reconnect_ms = static_cast<uint32_t>(atoi(val));
+        } else if (strcmp(arg, "--reconnect-max-ms") == 0) {
+            args.reconnect_max_ms = static_cast<uint32_t>(atoi(val));
+        } else if (strcmp(arg, "--standby") == 0) {
+            if      (strcmp(val, "0") == 0) args.standby = false;
+            else if (strcmp(val, "1") == 0) args.standby = true;
+            else {
+                fprintf(stderr, "Error: invalid standby '%s' (0 or 1)\n", val);
+                return false;
+            }
+        } else if (strcmp(arg, "--warm-targets") == 0) {
+            int n = atoi(val);
+            if (n < 0 || n > 64) {
+                fprintf(stderr, "Error: invalid warm-targets '%s' (0-64)\n", val);
+                return false;
+            }
+            args.warm_per_target = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--reuse-sockets") == 0) {
+            if      (strcmp(val, "0") == 0) args.reuse_sockets = false;
+            else if (strcmp(val, "1") == 0) args.reuse_sockets = true;
+            else {
+                fprintf(stderr, "Error: invalid reuse-sockets '%s' (0 or 1)\n", val);
+                return false;
+            }
+        } else if (strcmp(arg, "--io-workers") == 0) {
+            int n = atoi(val);
+            if (n < 0 || n > 256) {
+                fprintf(stderr, "Error: invalid io-workers '%s' (0-256)\n", val);
+                return false;
+            }
+            args.io_workers = static_cast<uint32_t>(n);
+        } else if (strcmp(arg, "--io-affinity") == 0) {
+            if      (strcmp(val, "none") == 0) args.io_affinity = ssh_proxy::IoAffinity::None;
+            else if (strcmp(val, "core") == 0) args.io_affinity = ssh_proxy::IoAffinity::Core;
+            else if (strcmp(val, "node") == 0) args.io_affinity = ssh_proxy::IoAffinity::NumaNode;
+            else {
+                fprintf(stderr, "Error: invalid io-affinity '%s' (none, core or node)\n", val);
+                return false;
+            }
+        } else if (strcmp(arg, "--max-sessions") == 0) {
+            args.max_sessions = static_cast<uint32_t>(atoi(val));
+        } else if (strcmp(arg, "--accept-rate") == 0) {
+            args.accept_rate = static_cast<uint32_t>(atoi(val));
+        } else if (strcmp(arg, "--accept-burst") == 0) {
+            args.accept_burst = static_cast<uint32_t>(atoi(val));
+        } else if (strcmp(arg, "--max-per-target") == 0) {
+            args.max_per_target = static_cast<uint32_t>(atoi(val));
+        } else if (strcmp(arg, "--forward") == 0) {
+            ssh_proxy::RemoteForward fwd;
+            if (!ParseForward(val, fwd)) {
+                fprintf(stderr, "Error: invalid forward '%s' (PORT or PORT:HOST:HOSTPORT)\n", val);
+                return false;
+            }
+            args.forwards.push_back(std::move(fwd));
+        } else if (strcmp(arg, "--log-entries") == 0) {
+            args.log_entries = static_cast<uint32_t>(atoi(val));
         } else if (strcmp(arg, "--log-level") == 0) {
             if      (strcmp(val, "debug") == 0) args.log_level = ssh_proxy::LogLevel::Debug;
             else if (strcmp(val, "info")  == 0) args.log_level = ssh_proxy::LogLevel::Info;
@@ -90,6 +255,21 @@ bool ParseCommandLine(int argc, char* argv[], CliArgs& args) {
     bool ok = true;
     if (!have_server)   { fprintf(stderr, "Error: --server is required\n");   ok = false; }
     if (!have_username) { fprintf(stderr, "Error: --username is required\n"); ok = false; }
-    if (!have_password) { fprintf(stderr, "Error: --password is required\n"); ok = false; }
+    if (!have_password && args.key_file.empty() && !args.agent) {
+        fprintf(stderr, "Error: --password (or --key / --agent) is required\n");
+        ok = false;
+    }
+    if (args.standby && args.reconnect_ms == 0) {
+        fprintf(stderr, "Error: --standby requires --reconnect-ms\n");
+        ok = false;
+    }
+    if (args.reconnect_ms > 0 && args.reconnect_max_ms < args.reconnect_ms) {
+        fprintf(stderr, "Error: --reconnect-max-ms must not be below --reconnect-ms\n");
+        ok = false;
+    }
+    if (args.accept_burst > 0 && args.accept_rate == 0) {
+        fprintf(stderr, "Error: --accept-burst requires --accept-rate\n");
+        ok = false;
+    }
     return ok;
 }
@@ -2,8 +2,14 @@
 #include "../../ssh-proxy-lib/public/ssh_proxy.h"
 #include "../../ssh-proxy-lib/include/logger.h"
 #include <cstdio>
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <csignal>
+#include <unistd.h>
+#endif
 
+#ifdef _WIN32
 // Global cancel handle — set by Ctrl-C handler, polled in main loop.
 static ssh_proxy::Connect* g_connect = nullptr;
 static BOOL WINAPI ConsoleCtrlHandler(DWORD ctrl_type) {
@@ -17,6 +23,11 @@ static BOOL WINAPI ConsoleCtrlHandler(DWORD ctrl_type) {
         return FALSE;
     }
 }
+#else
+// SIGINT / SIGTERM — a handler may only set a flag; the main loop cancels.
+static volatile std::sig_atomic_t g_stop_requested = 0;
+static void OnStopSignal(int) { g_stop_requested = 1; }
+#endif
 
 int main(int argc, char* argv[]) {
     CliArgs args;
@@ -25,6 +36,9 @@ int main(int argc, char* argv[]) {
     if (args.server_host.empty())   // --help
         return 0;
 
+    if (args.log_entries > 0)
+        ssh_proxy::SetLogCapacity(args.log_entries);
+
     // Mirror log entries to stderr in real time
     Logger::SetCallback([](const LogEntry& e) {
         static const char* tags[] = { "DBG", "INF", "WRN", "ERR" };
@@ -34,7 +48,45 @@ int main(int argc, char* argv[]) {
                 e.timestamp.c_str(), tags[idx], e.message.c_str());
     });
 
+#ifdef _WIN32
     SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
+#else
+    std::signal(SIGINT, OnStopSignal);
+    std::signal(SIGTERM, OnStopSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    ssh_proxy::ReconnectPolicy reconnect;
+    reconnect.enabled            = args.reconnect_ms > 0;
+    reconnect.initial_backoff_ms = args.reconnect_ms;
+    reconnect.max_backoff_ms     = args.reconnect_max_ms;
+    reconnect.hot_standby        = args.standby;
+
+    ssh_proxy::AuthOptions auth;
+    auth.private_key_file = args.key_file;
+    auth.key_passphrase   = args.key_passphrase;
+    auth.use_agent        = args.agent;
+
+    ssh_proxy::SshAlgorithms algorithms;
+    algorithms.kex         = args.kex;
+    algorithms.host_key    = args.host_key;
+    algorithms.ciphers     = args.ciphers;
+    algorithms.macs        = args.macs;
+    algorithms.compression = args.compress;
+
+    ssh_proxy::WarmConnectOptions warm;
+    warm.per_target      = args.warm_per_target;
+    warm.recycle_sockets = args.reuse_sockets;
+
+    ssh_proxy::IoThreadOptions io_threads;
+    io_threads.workers  = args.io_workers;
+    io_threads.affinity = args.io_affinity;
+
+    ssh_proxy::AdmissionLimits admission;
+    admission.max_sessions    = args.max_sessions;
+    admission.accepts_per_sec = args.accept_rate;
+    admission.accept_burst    = args.accept_burst;
+    admission.max_per_target  = args.max_per_target;
 
     try {
         ssh_proxy::Connect connect(
@@ -45,18 +97,43 @@ int main(int argc, char* argv[]) {
             args.forward_port,
             args.connect_timeout_ms,
             args.keepalive_interval_ms,
-            args.log_level);
+            args.log_level,
+            args.transports,
+            reconnect,
+            auth,
+            algorithms,
+            warm,
+            io_threads,
+            admission,
+            args.forwards);
 
+#ifdef _WIN32
         g_connect = &connect;
+#endif
+
+        if (args.metrics_interval_ms > 0)
+            connect.SetMetricsDump(args.metrics_interval_ms, [](const std::string& json) {
+                fprintf(stderr, "%s\n", json.c_str());
+            });
 
-        // Block until Cancel() is called (Ctrl-C) or the session drops
-        while (connect.IsConnected()) {
+        // Block until Cancel() is called (Ctrl-C) or — without --reconnect-ms —
+        // the session drops
+        while (connect.IsRunning()) {
+#ifdef _WIN32
             Sleep(500);
+#else
+            if (g_stop_requested) connect.Cancel();
+            ::usleep(500 * 1000);   // a signal cuts it short
+#endif
         }
 
+#ifdef _WIN32
         g_connect = nullptr;
+#endif
+        Logger::Flush();
 
     } catch (const std::exception& e) {
+        Logger::Flush();
         fprintf(stderr, "Fatal: %s\n", e.what());
         fprintf(stderr, "%s", ssh_proxy::GetLog().c_str());
         return 1;